@@ -0,0 +1,189 @@
+// Multithreaded stress test and read throughput benchmark for
+// hooks/PXConcurrentMap.m. Built plain and under ThreadSanitizer:
+//
+//   make -C bench stress     checks + throughput
+//   make -C bench tsan       checks under -fsanitize=thread
+//
+// Every thread walks the same key set from a different offset so inserts of
+// one key race across all threads. Checks: exactly one GetOrInsert per key
+// reports inserted and every thread reads the winner's value back; Add totals
+// match; Exchange hands back every replaced value exactly once; concurrent
+// readers only ever see a key's own value; a full map refuses new keys
+// without hanging.
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PXConcurrentMap.h"
+
+enum { kThreads = 8, kKeys = 2048, kRounds = 4 };
+
+static char gKeys[kKeys][40];
+static size_t gKeyLengths[kKeys];
+static PXConcurrentMap *gMap;
+static PXConcurrentMap *gCounters;
+static PXConcurrentMap *gSwaps;
+static _Atomic int gInsertWinners[kKeys];
+static _Atomic int64_t gSwapSum;
+static _Atomic int gFailures;
+static _Atomic bool gWritersDone;
+static pthread_barrier_t gStart;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        if (atomic_fetch_add(&gFailures, 1) < 10) { fprintf(stderr, "cmap_stress: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+static int64_t valueFor(size_t thread, size_t key) {
+    return (int64_t)(thread * kKeys + key) + 1;
+}
+
+static void *writer(void *arg) {
+    size_t thread = (size_t)arg;
+    pthread_barrier_wait(&gStart);
+    for (size_t round = 0; round < kRounds; round++) {
+        for (size_t n = 0; n < kKeys; n++) {
+            size_t k = (n + thread * (kKeys / kThreads)) % kKeys;
+            const char *key = gKeys[k];
+            size_t len = gKeyLengths[k];
+
+            bool inserted = false;
+            int64_t v = PXConcurrentMapGetOrInsert(gMap, key, len, valueFor(thread, k), &inserted);
+            if (inserted) {
+                atomic_fetch_add(&gInsertWinners[k], 1);
+                CHECK(v == valueFor(thread, k), "winner read back %lld for key %zu", (long long)v, k);
+            }
+            CHECK(v > 0 && (v - 1) % kKeys == (int64_t)k, "key %zu holds another key's value %lld", k, (long long)v);
+            int64_t again = 0;
+            CHECK(PXConcurrentMapGet(gMap, key, len, &again) && again == v,
+                  "key %zu read %lld after GetOrInsert returned %lld", k, (long long)again, (long long)v);
+
+            PXConcurrentMapAdd(gCounters, key, len, 0, 1);
+
+            int64_t old = 0;
+            if (PXConcurrentMapExchange(gSwaps, key, len, valueFor(thread, k), &old)) atomic_fetch_add(&gSwapSum, old);
+        }
+    }
+    return NULL;
+}
+
+static void *reader(void *arg) {
+    (void)arg;
+    pthread_barrier_wait(&gStart);
+    size_t k = 0;
+    while (!atomic_load(&gWritersDone)) {
+        int64_t v = 0;
+        if (PXConcurrentMapGet(gMap, gKeys[k], gKeyLengths[k], &v)) {
+            CHECK(v > 0 && (v - 1) % kKeys == (int64_t)k, "reader saw %lld for key %zu", (long long)v, k);
+        }
+        k = (k + 7) % kKeys;
+    }
+    return NULL;
+}
+
+static int runStress(void) {
+    gMap = PXConcurrentMapCreate(kKeys * 2);
+    gCounters = PXConcurrentMapCreate(kKeys * 2);
+    gSwaps = PXConcurrentMapCreate(kKeys * 2);
+    if (!gMap || !gCounters || !gSwaps) return 2;
+
+    enum { kReaders = 2 };
+    pthread_t threads[kThreads + kReaders];
+    pthread_barrier_init(&gStart, NULL, kThreads + kReaders);
+    for (size_t t = 0; t < kReaders; t++) pthread_create(&threads[kThreads + t], NULL, reader, NULL);
+    for (size_t t = 0; t < kThreads; t++) pthread_create(&threads[t], NULL, writer, (void *)t);
+    for (size_t t = 0; t < kThreads; t++) pthread_join(threads[t], NULL);
+    atomic_store(&gWritersDone, true);
+    for (size_t t = 0; t < kReaders; t++) pthread_join(threads[kThreads + t], NULL);
+    pthread_barrier_destroy(&gStart);
+
+    int64_t expectedSwapSum = 0;
+    for (size_t k = 0; k < kKeys; k++) {
+        CHECK(atomic_load(&gInsertWinners[k]) == 1, "key %zu had %d insert winners", k, atomic_load(&gInsertWinners[k]));
+        int64_t count = 0;
+        CHECK(PXConcurrentMapGet(gCounters, gKeys[k], gKeyLengths[k], &count) && count == kThreads * kRounds,
+              "key %zu counted %lld adds, expected %d", k, (long long)count, kThreads * kRounds);
+        // Every stored value but the last comes back exactly once as an old value.
+        int64_t last = 0;
+        CHECK(PXConcurrentMapGet(gSwaps, gKeys[k], gKeyLengths[k], &last), "key %zu missing from exchange map", k);
+        for (size_t t = 0; t < kThreads; t++) expectedSwapSum += valueFor(t, k) * kRounds;
+        expectedSwapSum -= last;
+    }
+    CHECK(atomic_load(&gSwapSum) == expectedSwapSum, "exchange handed back %lld, expected %lld",
+          (long long)atomic_load(&gSwapSum), (long long)expectedSwapSum);
+
+    // A full map refuses new keys and keeps answering for the ones it has.
+    PXConcurrentMap *small = PXConcurrentMapCreate(16);
+    char key[16];
+    for (int i = 0; i < 16; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        CHECK(PXConcurrentMapInsertOnce(small, key, strlen(key)), "small map refused key %d", i);
+    }
+    bool inserted = true;
+    CHECK(PXConcurrentMapGetOrInsert(small, "overflow", 8, 42, &inserted) == 42 && !inserted, "full map stored a key");
+    CHECK(!PXConcurrentMapGet(small, "overflow", 8, NULL), "full map reports a refused key");
+    CHECK(PXConcurrentMapGet(small, "k15", 3, NULL), "full map lost a key");
+    return atomic_load(&gFailures) ? 1 : 0;
+}
+
+static _Atomic bool gStopReaders;
+static _Atomic uint64_t gReads;
+
+static void *throughputReader(void *arg) {
+    uint64_t reads = 0, hits = 0;
+    size_t k = (size_t)arg;
+    pthread_barrier_wait(&gStart);
+    while (!atomic_load_explicit(&gStopReaders, memory_order_relaxed)) {
+        for (int i = 0; i < 1024; i++) {
+            hits += PXConcurrentMapGet(gMap, gKeys[k], gKeyLengths[k], NULL);
+            k = (k + 7) % kKeys;
+        }
+        reads += 1024;
+    }
+    atomic_fetch_add(&gReads, reads);
+    return (void *)(uintptr_t)hits;
+}
+
+// Read-mostly throughput: hits on a populated map from 1..kThreads threads.
+static void runThroughput(void) {
+    printf("{\"benchmark\":\"cmap_get_hit\",\"keys\":%d,\"results\":[\n", kKeys);
+    for (size_t threadCount = 1; threadCount <= kThreads; threadCount *= 2) {
+        pthread_t threads[kThreads];
+        atomic_store(&gStopReaders, false);
+        atomic_store(&gReads, 0);
+        pthread_barrier_init(&gStart, NULL, (unsigned)threadCount + 1);
+        for (size_t t = 0; t < threadCount; t++) pthread_create(&threads[t], NULL, throughputReader, (void *)(t * 97));
+        pthread_barrier_wait(&gStart);
+        struct timespec start, end, pause = { 0, 200 * 1000 * 1000 };
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        nanosleep(&pause, NULL);
+        atomic_store(&gStopReaders, true);
+        for (size_t t = 0; t < threadCount; t++) pthread_join(threads[t], NULL);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        pthread_barrier_destroy(&gStart);
+        double seconds = (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("  {\"threads\":%zu,\"mops_per_s\":%.1f}%s\n", threadCount,
+               (double)atomic_load(&gReads) / seconds / 1e6, threadCount * 2 <= kThreads ? "," : "");
+    }
+    printf("]}\n");
+}
+
+int main(int argc, char *argv[]) {
+    bool throughput = argc > 1 && strcmp(argv[1], "--throughput") == 0;
+    for (size_t k = 0; k < kKeys; k++) {
+        gKeyLengths[k] = (size_t)snprintf(gKeys[k], sizeof(gKeys[k]), "com.example.bundle%zu.extension", k);
+    }
+    int status = runStress();
+    if (status) {
+        fprintf(stderr, "cmap_stress: %d check(s) failed\n", atomic_load(&gFailures));
+        return status;
+    }
+    fprintf(stderr, "cmap_stress: %d threads x %d keys x %d rounds passed\n", kThreads, kKeys, kRounds);
+    if (throughput) runThroughput();
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Host stand-in for Apple's libcompression streaming API, on zlib. Only what
+// daemon/ProfileArchiveCore.m uses; every algorithm maps to raw deflate, so
+// archives written here round-trip here but are not LZFSE.
+#ifndef BENCH_COMPAT_COMPRESSION_H
+#define BENCH_COMPAT_COMPRESSION_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <zlib.h>
+
+typedef enum { COMPRESSION_LZFSE = 0x801, COMPRESSION_ZLIB = 0x205 } compression_algorithm;
+typedef enum { COMPRESSION_STREAM_ENCODE = 0, COMPRESSION_STREAM_DECODE = 1 } compression_stream_operation;
+enum { COMPRESSION_STREAM_FINALIZE = 0x0001 };
+typedef enum {
+    COMPRESSION_STATUS_OK = 0,
+    COMPRESSION_STATUS_ERROR = -1,
+    COMPRESSION_STATUS_END = 1,
+} compression_status;
+
+typedef struct {
+    uint8_t *dst_ptr;
+    size_t dst_size;
+    const uint8_t *src_ptr;
+    size_t src_size;
+    void *state;
+} compression_stream;
+
+typedef struct {
+    z_stream z;
+    compression_stream_operation operation;
+} compat_compression_state;
+
+static inline compression_status compression_stream_init(compression_stream *stream,
+                                                         compression_stream_operation operation,
+                                                         compression_algorithm algorithm) {
+    (void)algorithm;
+    compat_compression_state *state = calloc(1, sizeof(*state));
+    if (!state) return COMPRESSION_STATUS_ERROR;
+    state->operation = operation;
+    int rc = operation == COMPRESSION_STREAM_ENCODE
+        ? deflateInit2(&state->z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)
+        : inflateInit2(&state->z, -15);
+    if (rc != Z_OK) {
+        free(state);
+        return COMPRESSION_STATUS_ERROR;
+    }
+    stream->state = state;
+    return COMPRESSION_STATUS_OK;
+}
+
+static inline compression_status compression_stream_process(compression_stream *stream, int flags) {
+    compat_compression_state *state = stream->state;
+    state->z.next_in = (Bytef *)stream->src_ptr;
+    state->z.avail_in = (uInt)stream->src_size;
+    state->z.next_out = stream->dst_ptr;
+    state->z.avail_out = (uInt)stream->dst_size;
+    int rc = state->operation == COMPRESSION_STREAM_ENCODE
+        ? deflate(&state->z, (flags & COMPRESSION_STREAM_FINALIZE) ? Z_FINISH : Z_NO_FLUSH)
+        : inflate(&state->z, Z_NO_FLUSH);
+    stream->src_ptr = state->z.next_in;
+    stream->src_size = state->z.avail_in;
+    stream->dst_ptr = state->z.next_out;
+    stream->dst_size = state->z.avail_out;
+    if (rc == Z_STREAM_END) return COMPRESSION_STATUS_END;
+    // Z_BUF_ERROR only means no progress was possible this call.
+    return rc == Z_OK || rc == Z_BUF_ERROR ? COMPRESSION_STATUS_OK : COMPRESSION_STATUS_ERROR;
+}
+
+static inline compression_status compression_stream_destroy(compression_stream *stream) {
+    compat_compression_state *state = stream->state;
+    if (!state) return COMPRESSION_STATUS_OK;
+    if (state->operation == COMPRESSION_STREAM_ENCODE) deflateEnd(&state->z);
+    else inflateEnd(&state->z);
+    free(state);
+    stream->state = NULL;
+    return COMPRESSION_STATUS_OK;
+}
+
+#endif
@@ -0,0 +1,373 @@
+// Checks BackupRules' matcher (daemon/BackupRulesCore.m): the default rules on
+// container paths, trailing `/**` matching the directory itself, empty
+// segments, the segment limit, more than 64 rules, include rescue and minSize,
+// then random patterns and paths against a backtracking reference matcher.
+// Finally times a walk over a synthetic ~100k-entry container, carrying
+// states down the tree as pruneBundleTree does, against matching every full
+// path from scratch.
+//
+//   make -C bench test
+//   build/test_backup_rules [seed]
+#define _GNU_SOURCE
+#include <fnmatch.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "BackupRulesCore.h"
+
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_backup_rules: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+static uint32_t gRandom;
+static uint32_t nextRandom(void) {
+    gRandom = gRandom * 1664525u + 1013904223u;
+    return gRandom >> 8;
+}
+
+typedef struct {
+    BackupRule rules[128];
+    int count;
+} Program;
+
+static void addRule(Program *program, const char *pattern, bool exclude, int64_t minSize) {
+    BackupRuleError err = BackupRuleCompile(pattern, exclude, minSize, &program->rules[program->count]);
+    CHECK(err == BackupRuleOK, "\"%s\" rejected (%d)", pattern, err);
+    if (err == BackupRuleOK) program->count++;
+}
+
+static void addDefaults(Program *program) {
+    for (int i = 0; i < kBackupDefaultExcludeCount; i++) addRule(program, kBackupDefaultExcludes[i], true, 0);
+}
+
+static void freeProgram(Program *program) {
+    for (int i = 0; i < program->count; i++) BackupRuleFree(&program->rules[i]);
+    program->count = 0;
+}
+
+// Walks "a/b/c" from the root the way pruneBundleTree does; the last segment
+// is the entry decided. Returns that decision.
+static BackupDecision decide(const Program *program, const char *path, bool isDirectory, int64_t size) {
+    uint64_t states[2][128];
+    for (int i = 0; i < program->count; i++) states[0][i] = BackupRuleInitialState(&program->rules[i]);
+    BackupDecision decision = { false, false };
+    char copy[512];
+    snprintf(copy, sizeof(copy), "%s", path);
+    int current = 0;
+    char *save = NULL;
+    char *name = strtok_r(copy, "/", &save);
+    while (name) {
+        char *next = strtok_r(NULL, "/", &save);
+        decision = BackupRulesStep(program->rules, program->count, states[current], name, next ? true : isDirectory,
+                                   size, states[1 - current]);
+        current = 1 - current;
+        name = next;
+    }
+    return decision;
+}
+
+// ---- Compilation ----
+
+static void compilation(void) {
+    BackupRule rule;
+    CHECK(BackupRuleCompile("", true, 0, &rule) == BackupRuleNoSegments, "empty pattern");
+    CHECK(BackupRuleCompile("/", true, 0, &rule) == BackupRuleNoSegments, "lone slash");
+    CHECK(BackupRuleCompile("///", true, 0, &rule) == BackupRuleNoSegments, "only slashes");
+
+    // Empty segments are dropped.
+    static const char *const kSame[] = { "Library//Caches", "/Library/Caches/", "Library/Caches//", "//Library/Caches" };
+    for (size_t i = 0; i < sizeof(kSame) / sizeof(kSame[0]); i++) {
+        CHECK(BackupRuleCompile(kSame[i], true, 0, &rule) == BackupRuleOK, "\"%s\" rejected", kSame[i]);
+        CHECK(rule.count == 2 && strcmp(rule.segments[0].text, "Library") == 0 &&
+              strcmp(rule.segments[1].text, "Caches") == 0, "\"%s\" compiled to %d segments", kSame[i], rule.count);
+        BackupRuleFree(&rule);
+    }
+
+    CHECK(BackupRuleCompile("a/**/*.db/[ab]?/x", true, 0, &rule) == BackupRuleOK, "mixed pattern rejected");
+    CHECK(rule.segments[0].kind == BackupSegmentLiteral && rule.segments[1].kind == BackupSegmentAnyDepth &&
+          rule.segments[2].kind == BackupSegmentGlob && rule.segments[3].kind == BackupSegmentGlob &&
+          rule.segments[4].kind == BackupSegmentLiteral, "segment kinds");
+    BackupRuleFree(&rule);
+
+    // The state is a uint64_t: one bit per segment plus the accepting one.
+    char deep[512] = "";
+    for (int i = 0; i < kBackupRuleMaxSegments; i++) strcat(deep, i ? "/d" : "d");
+    CHECK(BackupRuleCompile(deep, true, 0, &rule) == BackupRuleOK, "%d segments rejected", kBackupRuleMaxSegments);
+    uint64_t state = BackupRuleInitialState(&rule);
+    for (int i = 0; i < kBackupRuleMaxSegments; i++) state = BackupRuleAdvance(&rule, state, "d");
+    CHECK(BackupRuleAccepts(&rule, state) && !BackupRuleAlive(&rule, state), "deepest pattern does not match");
+    BackupRuleFree(&rule);
+    strcat(deep, "/d");
+    CHECK(BackupRuleCompile(deep, true, 0, &rule) == BackupRuleTooDeep, "%d segments accepted", kBackupRuleMaxSegments + 1);
+}
+
+// ---- Default rules ----
+
+static void defaults(void) {
+    Program program = { .count = 0 };
+    addDefaults(&program);
+    static const struct { const char *path; bool isDirectory; bool excluded; } kPaths[] = {
+        // Trailing /** matches the directory itself and everything below.
+        { "Library/Caches", true, true },
+        { "Library/Caches/com.app/fsCachedData/1F2E", false, true },
+        { "Library/Caches/Snapshots/com.app/a@3x.ktx", false, true },
+        { "Library/CachesOld", true, false },
+        { "Library/CachesOld/x", false, false },
+        { "Caches/x", false, false },
+        { "Library", true, false },
+        { "tmp", true, true },
+        { "tmp/upload.part", false, true },
+        { "Documents/tmp", true, false },
+        { "Documents/tmp/x", false, false },
+        { "tmpfile", false, false },
+        // ** in the middle matches zero or more segments.
+        { "Library/WebKit/NetworkCache", true, true },
+        { "Library/WebKit/NetworkCache/Version 16/Records/x", false, true },
+        { "Library/WebKit/WebsiteData/NetworkCache/Blobs/y", false, true },
+        { "Library/WebKit/a/b/c/NetworkCache", true, true },
+        { "Library/WebKit/LocalStorage/file__0.localstorage", false, false },
+        { "Library/WebKit/NetworkCacheX/y", false, false },
+        { "Library/Saved Application State/com.app.savedState/data.data", false, true },
+        { "Library/Preferences/com.app.plist", false, false },
+        { "Library/Application Support/db.sqlite", false, false },
+        { "Documents/Caches/tmp/x", false, false },
+        { "SystemData/com.apple.SafariViewService/x", false, false },
+    };
+    for (size_t i = 0; i < sizeof(kPaths) / sizeof(kPaths[0]); i++) {
+        BackupDecision d = decide(&program, kPaths[i].path, kPaths[i].isDirectory, 100);
+        CHECK(d.exclude == kPaths[i].excluded, "default rules %s \"%s\"", d.exclude ? "exclude" : "keep",
+              kPaths[i].path);
+        CHECK(!d.rescuable, "\"%s\" rescuable without include rules", kPaths[i].path);
+    }
+    freeProgram(&program);
+}
+
+// ---- Include, minSize, many rules ----
+
+static void overrides(void) {
+    Program program = { .count = 0 };
+    addDefaults(&program);
+    addRule(&program, "Library/Caches/keep/**", false, 0);
+    BackupDecision d = decide(&program, "Library/Caches", true, 0);
+    CHECK(d.exclude && d.rescuable, "Library/Caches must be walked, not emptied");
+    d = decide(&program, "Library/Caches/keep/a/b", false, 10);
+    CHECK(!d.exclude, "include did not re-admit");
+    d = decide(&program, "Library/Caches/other", true, 0);
+    CHECK(d.exclude && !d.rescuable, "Library/Caches/other should be emptied without a walk");
+    freeProgram(&program);
+
+    addRule(&program, "**/*.mp4", true, 1 << 20);
+    CHECK(decide(&program, "Documents/v/big.mp4", false, 5 << 20).exclude, "large mp4 kept");
+    CHECK(!decide(&program, "Documents/v/small.mp4", false, 1000).exclude, "small mp4 excluded");
+    CHECK(!decide(&program, "Documents/v/dir.mp4", true, 5 << 20).exclude, "directory matched a minSize rule");
+    CHECK(decide(&program, "big.mp4", false, 1 << 20).exclude, "mp4 at the root, exactly minSize");
+    freeProgram(&program);
+
+    // More rules than bits in a state: each rule has its own state.
+    char pattern[32];
+    for (int i = 0; i < 100; i++) {
+        snprintf(pattern, sizeof(pattern), "d%d/**", i);
+        addRule(&program, pattern, true, 0);
+    }
+    addRule(&program, "d5/**", false, 0);
+    addRule(&program, "**/*.log", true, 0);
+    CHECK(program.count == 102, "compiled %d rules", program.count);
+    CHECK(decide(&program, "d99/x", false, 1).exclude, "rule 100 ignored");
+    CHECK(decide(&program, "d70/a/b", false, 1).exclude, "rule 71 ignored");
+    CHECK(!decide(&program, "d5/x", false, 1).exclude, "last match did not win");
+    CHECK(decide(&program, "d5/x.log", false, 1).exclude, "rule 102 ignored");
+    CHECK(!decide(&program, "d100/x", false, 1).exclude, "unmatched path excluded");
+    freeProgram(&program);
+
+    // Globs within a segment never cross '/'; no FNM_PERIOD, so * matches dotfiles.
+    addRule(&program, "Documents/*", true, 0);
+    CHECK(decide(&program, "Documents/.hidden", false, 1).exclude, "* skipped a dotfile");
+    CHECK(!decide(&program, "Documents/a/b", false, 1).exclude, "* crossed a slash");
+    freeProgram(&program);
+}
+
+// ---- Reference matcher ----
+
+// Backtracking over segments, straight from the pattern language.
+static bool referenceMatch(const BackupRule *rule, int si, char *const *path, int pi, int length) {
+    if (si == rule->count) return pi == length;
+    const BackupSegment *segment = &rule->segments[si];
+    if (segment->kind == BackupSegmentAnyDepth) {
+        return referenceMatch(rule, si + 1, path, pi, length) ||
+               (pi < length && referenceMatch(rule, si, path, pi + 1, length));
+    }
+    if (pi == length) return false;
+    bool ok = segment->kind == BackupSegmentLiteral ? strcmp(segment->text, path[pi]) == 0
+                                                    : fnmatch(segment->text, path[pi], 0) == 0;
+    return ok && referenceMatch(rule, si + 1, path, pi + 1, length);
+}
+
+static void randomAgainstReference(void) {
+    static const char *const kPatternParts[] = { "a", "b", "ab", "*", "?", "a*", "*b", "[ab]", "[!a]", "**" };
+    static char *const kNames[] = { "a", "b", "ab", "ba", "c", "abc" };
+    for (int round = 0; round < 4000; round++) {
+        char pattern[128] = "";
+        int parts = 1 + (int)(nextRandom() % 6);
+        for (int i = 0; i < parts; i++) {
+            if (i) strcat(pattern, "/");
+            strcat(pattern, kPatternParts[nextRandom() % 10]);
+        }
+        BackupRule rule;
+        if (BackupRuleCompile(pattern, true, 0, &rule) != BackupRuleOK) {
+            CHECK(false, "\"%s\" rejected", pattern);
+            continue;
+        }
+        for (int p = 0; p < 8; p++) {
+            char *path[8];
+            int length = (int)(nextRandom() % 8);
+            uint64_t state = BackupRuleInitialState(&rule);
+            for (int i = 0; i < length; i++) {
+                path[i] = kNames[nextRandom() % 6];
+                state = BackupRuleAdvance(&rule, state, path[i]);
+                // Alive means some extension could still match.
+                if (!BackupRuleAlive(&rule, state)) {
+                    CHECK(!referenceMatch(&rule, 0, path, 0, i + 1) || BackupRuleAccepts(&rule, state),
+                          "\"%s\": dead state but the reference matches", pattern);
+                }
+            }
+            bool accepted = BackupRuleAccepts(&rule, state);
+            bool expected = referenceMatch(&rule, 0, path, 0, length);
+            CHECK(accepted == expected, "\"%s\" on a path of %d segments: NFA %d, reference %d", pattern, length,
+                  accepted, expected);
+        }
+        BackupRuleFree(&rule);
+    }
+}
+
+// ---- Benchmark ----
+
+typedef struct {
+    int parent; // -1 for children of the root
+    int depth;  // segments from the root, 1 for top level
+    bool isDirectory;
+    char name[24];
+} Entry;
+
+static int addEntry(Entry *entries, int *count, int parent, const char *name, bool isDirectory) {
+    Entry *e = &entries[*count];
+    e->parent = parent;
+    e->depth = parent < 0 ? 1 : entries[parent].depth + 1;
+    e->isDirectory = isDirectory;
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    return (*count)++;
+}
+
+// Fills dir with a random subtree, depth-first so parents precede children.
+static void fillTree(Entry *entries, int *count, int limit, int dir, int depth) {
+    static const char *const kDirs[] = { "Records", "Blobs", "com.app", "Snapshots", "NetworkCache", "data", "v2" };
+    int children = 2 + (int)(nextRandom() % 9);
+    for (int c = 0; c < children && *count < limit; c++) {
+        char name[24];
+        if (depth < 7 && nextRandom() % 3 == 0) {
+            snprintf(name, sizeof(name), "%s%u", kDirs[nextRandom() % 7], nextRandom() % 4);
+            if (nextRandom() % 5 == 0) snprintf(name, sizeof(name), "%s", kDirs[nextRandom() % 7]);
+            int sub = addEntry(entries, count, dir, name, true);
+            fillTree(entries, count, limit, sub, depth + 1);
+        } else {
+            snprintf(name, sizeof(name), "f%u.%s", nextRandom() % 100000, nextRandom() % 4 ? "dat" : "mp4");
+            addEntry(entries, count, dir, name, false);
+        }
+    }
+}
+
+static double elapsedMs(const struct timespec *start) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)(end.tv_sec - start->tv_sec) * 1e3 + (double)(end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void benchmark(void) {
+    enum { kLimit = 100000 };
+    Entry *entries = malloc(kLimit * sizeof(Entry));
+    int count = 0;
+    static const char *const kTop[] = { "Documents", "tmp", "SystemData" };
+    static const char *const kLibrary[] = { "Caches", "Preferences", "WebKit", "Saved Application State",
+                                            "Application Support", "Cookies" };
+    gRandom = 7;
+    while (count < kLimit - 64) {
+        int library = addEntry(entries, &count, -1, "Library", true);
+        for (int i = 0; i < 6 && count < kLimit; i++) {
+            fillTree(entries, &count, kLimit, addEntry(entries, &count, library, kLibrary[i], true), 2);
+        }
+        for (int i = 0; i < 3 && count < kLimit; i++) {
+            fillTree(entries, &count, kLimit, addEntry(entries, &count, -1, kTop[i], true), 1);
+        }
+    }
+
+    Program program = { .count = 0 };
+    addDefaults(&program);
+    addRule(&program, "Library/Caches/keep/**", false, 0);
+    addRule(&program, "**/*.mp4", true, 1 << 20);
+
+    // States carried down the tree, one transition per rule per entry.
+    uint64_t *states = malloc((size_t)count * (size_t)program.count * sizeof(uint64_t));
+    uint64_t root[128];
+    for (int i = 0; i < program.count; i++) root[i] = BackupRuleInitialState(&program.rules[i]);
+    bool *excluded = malloc((size_t)count);
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int e = 0; e < count; e++) {
+        const uint64_t *parent = entries[e].parent < 0 ? root : &states[(size_t)entries[e].parent * program.count];
+        BackupDecision d = BackupRulesStep(program.rules, program.count, parent, entries[e].name,
+                                           entries[e].isDirectory, 2 << 20, &states[(size_t)e * program.count]);
+        excluded[e] = d.exclude;
+    }
+    double nfaMs = elapsedMs(&start);
+
+    // Every full path matched from scratch against every rule.
+    int mismatches = 0, excludedCount = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int e = 0; e < count; e++) {
+        char *path[16];
+        int depth = entries[e].depth;
+        for (int at = e, i = depth - 1; at >= 0; at = entries[at].parent, i--) path[i] = entries[at].name;
+        bool exclude = false;
+        for (int r = 0; r < program.count; r++) {
+            const BackupRule *rule = &program.rules[r];
+            if (referenceMatch(rule, 0, path, 0, depth) && (rule->minSize == 0 || !entries[e].isDirectory)) {
+                exclude = rule->exclude;
+            }
+        }
+        mismatches += exclude != excluded[e];
+        excludedCount += exclude;
+    }
+    double referenceMs = elapsedMs(&start);
+    CHECK(mismatches == 0, "benchmark: %d of %d entries decided differently", mismatches, count);
+    fprintf(stderr,
+            "test_backup_rules: %d entries, %d rules, %d excluded: carried states %.1f ms (%.0f ns/entry), "
+            "full-path matching %.1f ms (%.0f ns/entry)\n",
+            count, program.count, excludedCount, nfaMs, nfaMs * 1e6 / count, referenceMs, referenceMs * 1e6 / count);
+    freeProgram(&program);
+    free(states);
+    free(excluded);
+    free(entries);
+}
+
+int main(int argc, char *argv[]) {
+    gRandom = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 1;
+    compilation();
+    defaults();
+    overrides();
+    randomAgainstReference();
+    benchmark();
+    if (gFailures) {
+        fprintf(stderr, "test_backup_rules: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_backup_rules: %d checks passed\n", gChecks);
+    return 0;
+}
@@ -0,0 +1,460 @@
+// Checks DBManager's connection and statement cache (daemon/DBManagerCore.m)
+// against the shipped layout/Library/IOS.db: one statement per SQL text that
+// survives the table growing, statements reset and unbound between uses, bad
+// SQL never cached, the connection read-only, and bound arguments closing the
+// quoting hole the formatted queries had. Then times the per-profile queries
+// DataGenManager ran (a KMOS version, a device for it, a carrier) four ways:
+// formatted SQL prepared per call with rows decoded into generic cells (what
+// NSDictionary rows cost), cached and bound with generic cells, cached and
+// bound with typed rows, and the last without mmap (informational, never
+// fails).
+//
+//   make -C bench test
+//   build/test_db_manager [IOS.db [PROFILES]]
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "DBManagerCore.h"
+
+// A scratch copy of IOS.db, so a connection that is not read-only after all
+// cannot damage the shipped file.
+static char gRoot[64];
+static char gPath[128];
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_db_manager: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+static uint32_t gRandom = 1;
+static uint32_t nextRandom(void) {
+    gRandom = gRandom * 1664525u + 1013904223u;
+    return gRandom >> 8;
+}
+
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static bool countRow(sqlite3_stmt *stmt, void *context) {
+    (void)stmt;
+    (void)context;
+    return true;
+}
+
+static bool firstRowOnly(sqlite3_stmt *stmt, void *context) {
+    (void)stmt;
+    (void)context;
+    return false;
+}
+
+static bool readInt(sqlite3_stmt *stmt, void *context) {
+    *(int64_t *)context = sqlite3_column_int64(stmt, 0);
+    return false;
+}
+
+// Distinct operator codes, for lookups.
+static char gCodes[128][16];
+static int gCodeCount;
+// KMOS sortVersions in order, for ranges and device lookups.
+static char gVersions[128][16];
+static int gVersionCount;
+
+static bool collectCode(sqlite3_stmt *stmt, void *context) {
+    (void)context;
+    const char *code = (const char *)sqlite3_column_text(stmt, 0);
+    if (code && gCodeCount < 128) snprintf(gCodes[gCodeCount++], sizeof(gCodes[0]), "%s", code);
+    return true;
+}
+
+static bool collectVersion(sqlite3_stmt *stmt, void *context) {
+    (void)context;
+    const char *version = (const char *)sqlite3_column_text(stmt, 0);
+    if (version && gVersionCount < 128) snprintf(gVersions[gVersionCount++], sizeof(gVersions[0]), "%s", version);
+    return true;
+}
+
+// ---- Statement cache ----
+
+static void cacheCases(DBCore *core) {
+    sqlite3 *db = DBCoreHandle(core);
+    const char *byCode = "SELECT * FROM operator WHERE code = ?1";
+    size_t initial = DBCoreCachedCount(core);
+    sqlite3_stmt *first = DBCoreStatement(core, byCode);
+    CHECK(first != NULL, "prepare failed: %s", sqlite3_errmsg(db));
+    CHECK(DBCoreStatement(core, byCode) == first, "same SQL prepared twice");
+    CHECK(DBCoreCachedCount(core) == initial + 1, "%zu statements cached", DBCoreCachedCount(core));
+    // Different text is a different statement, even if it means the same.
+    sqlite3_stmt *spaced = DBCoreStatement(core, "SELECT * FROM operator WHERE code = ?1 ");
+    CHECK(spaced && spaced != first, "differently spelled SQL shared a statement");
+
+    // A statement left half-read is reset before its next use.
+    sqlite3_stmt *all = DBCoreStatement(core, "SELECT * FROM operator");
+    int64_t total = DBCoreRun(all, countRow, NULL);
+    CHECK(total == 358, "operator has %lld rows, expected 358", (long long)total);
+    all = DBCoreStatement(core, "SELECT * FROM operator");
+    CHECK(sqlite3_step(all) == SQLITE_ROW && sqlite3_step(all) == SQLITE_ROW, "stepping failed");
+    all = DBCoreStatement(core, "SELECT * FROM operator");
+    CHECK(DBCoreRun(all, countRow, NULL) == total, "reused statement did not start over");
+    CHECK(DBCoreRun(DBCoreStatement(core, "SELECT * FROM operator"), firstRowOnly, NULL) == 1, "early stop");
+    CHECK(DBCoreRun(DBCoreStatement(core, "SELECT * FROM operator"), countRow, NULL) == total, "after early stop");
+
+    // Bindings do not leak into the next use.
+    sqlite3_stmt *stmt = DBCoreStatement(core, byCode);
+    sqlite3_bind_text(stmt, 1, gCodes[0], -1, SQLITE_TRANSIENT);
+    int64_t rows = DBCoreRun(stmt, countRow, NULL);
+    CHECK(rows > 0, "no operators for %s", gCodes[0]);
+    stmt = DBCoreStatement(core, byCode);
+    CHECK(DBCoreRun(stmt, countRow, NULL) == 0, "binding survived into the next use");
+
+    // Many distinct texts: the table grows and every entry stays reachable.
+    sqlite3_stmt *stmts[300];
+    char sql[64];
+    size_t before = DBCoreCachedCount(core);
+    for (int i = 0; i < 300; i++) {
+        snprintf(sql, sizeof(sql), "SELECT %d + ?1", i);
+        stmts[i] = DBCoreStatement(core, sql);
+        CHECK(stmts[i] != NULL, "%s did not prepare", sql);
+    }
+    CHECK(DBCoreCachedCount(core) == before + 300, "%zu cached after 300 more", DBCoreCachedCount(core));
+    for (int i = 0; i < 300; i++) {
+        snprintf(sql, sizeof(sql), "SELECT %d + ?1", i);
+        stmt = DBCoreStatement(core, sql);
+        CHECK(stmt == stmts[i], "%s lost its statement after growing", sql);
+        sqlite3_bind_int(stmt, 1, 1000);
+        int64_t value = 0;
+        CHECK(DBCoreRun(stmt, readInt, &value) == 1 && value == i + 1000, "%s returned %lld", sql, (long long)value);
+    }
+    CHECK(DBCoreStatement(core, byCode) == first, "first statement lost after growing");
+
+    // Bad SQL is reported and not cached.
+    size_t cached = DBCoreCachedCount(core);
+    CHECK(DBCoreStatement(core, "SELECT * FROM no_such_table") == NULL, "bad SQL prepared");
+    CHECK(strstr(sqlite3_errmsg(db), "no_such_table") != NULL, "errmsg: %s", sqlite3_errmsg(db));
+    CHECK(DBCoreStatement(core, "SELECT * FROM no_such_table") == NULL, "bad SQL prepared the second time");
+    CHECK(DBCoreCachedCount(core) == cached, "bad SQL cached");
+    CHECK(DBCoreStatement(core, "") == NULL, "empty SQL gave a statement");
+
+    // The connection is read-only: writes fail when run, and the run says so.
+    stmt = DBCoreStatement(core, "DELETE FROM operator");
+    CHECK(stmt != NULL, "DELETE did not prepare");
+    CHECK(stmt && DBCoreRun(stmt, countRow, NULL) == -1, "write on a read-only connection succeeded");
+    CHECK(sqlite3_errcode(db) == SQLITE_READONLY, "write failed with %d", sqlite3_errcode(db));
+    CHECK(DBCoreRun(DBCoreStatement(core, "SELECT * FROM operator"), countRow, NULL) == total, "rows changed");
+    CHECK(DBCoreRun(DBCoreStatement(core, "PRAGMA mmap_size"), readInt, &(int64_t){ 0 }) == 1, "mmap_size");
+    int64_t mmapSize = 0;
+    DBCoreRun(DBCoreStatement(core, "PRAGMA mmap_size"), readInt, &mmapSize);
+    CHECK(mmapSize == 64 << 20, "mmap_size is %lld", (long long)mmapSize);
+
+    // Quoting: the formatted query matches every row for this code; bound,
+    // it is just an odd code.
+    const char *evil = "x' OR '1'='1";
+    snprintf(sql, sizeof(sql), "SELECT * FROM operator WHERE code = '%s'", evil);
+    CHECK(DBCoreRun(DBCoreStatement(core, sql), countRow, NULL) == total, "formatted injection matched differently");
+    stmt = DBCoreStatement(core, byCode);
+    sqlite3_bind_text(stmt, 1, evil, -1, SQLITE_TRANSIENT);
+    CHECK(DBCoreRun(stmt, countRow, NULL) == 0, "bound argument was interpreted as SQL");
+
+    DBCore *missing = (DBCore *)1;
+    CHECK(DBCoreOpen("/nonexistent/IOS.db", 0, &missing) != SQLITE_OK && missing == NULL, "missing file opened");
+}
+
+// ---- Per-profile queries ----
+
+typedef struct {
+    char version[16], build[16], sortVersion[16];
+} VersionRow;
+
+typedef struct {
+    char identifier[32], cpu[16], cpuName[16];
+    int64_t ram, cores;
+    double frequency;
+} DeviceRow;
+
+typedef struct {
+    int64_t id;
+    char name[64], mcc[8], mnc[8], code[8];
+} OperatorRow;
+
+static const char *const kVersionSQL =
+    "SELECT * FROM KMOS WHERE (?1 IS NULL OR sortVersion >= ?1) AND (?2 IS NULL OR sortVersion <= ?2) "
+    "ORDER BY RANDOM() LIMIT 1";
+static const char *const kDeviceSQL =
+    "SELECT * FROM KMDevices d LEFT JOIN CPU c ON d.CPU = c.name WHERE d.defaultOSV <= ?1 AND d.maxOSV >= ?1 "
+    "ORDER BY RANDOM() LIMIT 1";
+static const char *const kOperatorSQL = "SELECT * FROM operator WHERE code = ?1 ORDER BY RANDOM() LIMIT 1";
+
+// Generic cells, one allocation per name and text value, like the
+// NSDictionary rows: the cost of not knowing the row's shape.
+typedef struct {
+    char *name;
+    int type;
+    int64_t integer;
+    double real;
+    char *text;
+} Cell;
+
+typedef struct {
+    Cell cells[64];
+    int count;
+    size_t rows;
+} GenericRows;
+
+static bool decodeGeneric(sqlite3_stmt *stmt, void *context) {
+    GenericRows *rows = context;
+    rows->count = sqlite3_column_count(stmt);
+    if (rows->count > 64) rows->count = 64;
+    for (int i = 0; i < rows->count; i++) {
+        Cell *cell = &rows->cells[i];
+        cell->name = strdup(sqlite3_column_name(stmt, i));
+        cell->type = sqlite3_column_type(stmt, i);
+        cell->text = NULL;
+        if (cell->type == SQLITE_INTEGER) cell->integer = sqlite3_column_int64(stmt, i);
+        if (cell->type == SQLITE_FLOAT) cell->real = sqlite3_column_double(stmt, i);
+        if (cell->type == SQLITE_TEXT) cell->text = strdup((const char *)sqlite3_column_text(stmt, i));
+    }
+    rows->rows++;
+    return true;
+}
+
+static void freeGeneric(GenericRows *rows) {
+    for (int i = 0; i < rows->count; i++) {
+        free(rows->cells[i].name);
+        free(rows->cells[i].text);
+    }
+    rows->count = 0;
+}
+
+static const char *genericText(const GenericRows *rows, const char *name) {
+    for (int i = 0; i < rows->count; i++) {
+        if (strcmp(rows->cells[i].name, name) == 0) return rows->cells[i].text;
+    }
+    return NULL;
+}
+
+static void copyText(char *to, size_t size, sqlite3_stmt *stmt, int column) {
+    const char *text = (const char *)sqlite3_column_text(stmt, column);
+    snprintf(to, size, "%s", text ? text : "");
+}
+
+static bool decodeVersion(sqlite3_stmt *stmt, void *context) {
+    VersionRow *row = context;
+    copyText(row->version, sizeof(row->version), stmt, 0);
+    copyText(row->build, sizeof(row->build), stmt, 1);
+    copyText(row->sortVersion, sizeof(row->sortVersion), stmt, 2);
+    return false;
+}
+
+// KMDevices has 24 columns, then CPU's.
+static bool decodeDevice(sqlite3_stmt *stmt, void *context) {
+    DeviceRow *row = context;
+    copyText(row->identifier, sizeof(row->identifier), stmt, 4);
+    copyText(row->cpu, sizeof(row->cpu), stmt, 8);
+    row->ram = sqlite3_column_int64(stmt, 9);
+    copyText(row->cpuName, sizeof(row->cpuName), stmt, 24 + 2);
+    row->cores = sqlite3_column_int64(stmt, 24 + 5);
+    row->frequency = sqlite3_column_double(stmt, 24 + 6);
+    return false;
+}
+
+static bool decodeOperator(sqlite3_stmt *stmt, void *context) {
+    OperatorRow *row = context;
+    row->id = sqlite3_column_int64(stmt, 0);
+    copyText(row->name, sizeof(row->name), stmt, 1);
+    copyText(row->mcc, sizeof(row->mcc), stmt, 2);
+    copyText(row->mnc, sizeof(row->mnc), stmt, 3);
+    copyText(row->code, sizeof(row->code), stmt, 10);
+    return false;
+}
+
+typedef struct {
+    const char *minVersion, *maxVersion, *code;
+} Profile;
+
+static Profile randomProfile(void) {
+    Profile profile = { NULL, NULL, gCodes[nextRandom() % gCodeCount] };
+    if (nextRandom() % 2) profile.minVersion = gVersions[nextRandom() % (gVersionCount / 2)];
+    if (nextRandom() % 2) profile.maxVersion = gVersions[gVersionCount / 2 + nextRandom() % (gVersionCount / 2)];
+    return profile;
+}
+
+static void bindOptional(sqlite3_stmt *stmt, int index, const char *text) {
+    if (text) {
+        sqlite3_bind_text(stmt, index, text, -1, SQLITE_STATIC);
+    } else {
+        sqlite3_bind_null(stmt, index);
+    }
+}
+
+// The queries as DBManager ran them before: SQL text formatted per call,
+// prepared and finalized each time, rows decoded into generic cells.
+static bool formattedProfile(sqlite3 *db, const Profile *profile) {
+    char sql[512], minPart[64] = "", maxPart[64] = "";
+    if (profile->minVersion) snprintf(minPart, sizeof(minPart), " AND sortVersion >= '%s'", profile->minVersion);
+    if (profile->maxVersion) snprintf(maxPart, sizeof(maxPart), " AND sortVersion <= '%s'", profile->maxVersion);
+    const char *formats[3] = { "SELECT * FROM KMOS WHERE 1%s%s ORDER BY RANDOM() LIMIT 1",
+                               "SELECT * FROM KMDevices d LEFT JOIN CPU c ON d.CPU = c.name WHERE d.defaultOSV <= "
+                               "'%s' AND d.maxOSV >= '%s' ORDER BY RANDOM() LIMIT 1",
+                               "SELECT * FROM operator WHERE code = '%s' ORDER BY RANDOM() LIMIT 1" };
+    GenericRows rows = { .count = 0, .rows = 0 };
+    char sortVersion[16] = "";
+    for (int q = 0; q < 3; q++) {
+        if (q == 0) snprintf(sql, sizeof(sql), formats[0], minPart, maxPart);
+        if (q == 1) snprintf(sql, sizeof(sql), formats[1], sortVersion, sortVersion);
+        if (q == 2) snprintf(sql, sizeof(sql), formats[2], profile->code);
+        sqlite3_stmt *stmt = NULL;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) return false;
+        freeGeneric(&rows);
+        DBCoreRun(stmt, decodeGeneric, &rows);
+        sqlite3_finalize(stmt);
+        if (q == 0) {
+            const char *found = genericText(&rows, "sortVersion");
+            if (!found) return false;
+            snprintf(sortVersion, sizeof(sortVersion), "%s", found);
+        }
+    }
+    bool ok = rows.rows > 0;
+    freeGeneric(&rows);
+    return ok;
+}
+
+static bool cachedGenericProfile(DBCore *core, const Profile *profile) {
+    GenericRows rows = { .count = 0, .rows = 0 };
+    sqlite3_stmt *stmt = DBCoreStatement(core, kVersionSQL);
+    bindOptional(stmt, 1, profile->minVersion);
+    bindOptional(stmt, 2, profile->maxVersion);
+    DBCoreRun(stmt, decodeGeneric, &rows);
+    const char *found = genericText(&rows, "sortVersion");
+    char sortVersion[16];
+    snprintf(sortVersion, sizeof(sortVersion), "%s", found ? found : "");
+    freeGeneric(&rows);
+    if (!found) return false;
+    stmt = DBCoreStatement(core, kDeviceSQL);
+    sqlite3_bind_text(stmt, 1, sortVersion, -1, SQLITE_STATIC);
+    DBCoreRun(stmt, decodeGeneric, &rows);
+    freeGeneric(&rows);
+    rows.rows = 0;
+    stmt = DBCoreStatement(core, kOperatorSQL);
+    sqlite3_bind_text(stmt, 1, profile->code, -1, SQLITE_STATIC);
+    DBCoreRun(stmt, decodeGeneric, &rows);
+    freeGeneric(&rows);
+    return rows.rows > 0;
+}
+
+static bool typedProfile(DBCore *core, const Profile *profile, VersionRow *version, DeviceRow *device,
+                         OperatorRow *carrier) {
+    sqlite3_stmt *stmt = DBCoreStatement(core, kVersionSQL);
+    bindOptional(stmt, 1, profile->minVersion);
+    bindOptional(stmt, 2, profile->maxVersion);
+    if (DBCoreRun(stmt, decodeVersion, version) != 1) return false;
+    stmt = DBCoreStatement(core, kDeviceSQL);
+    sqlite3_bind_text(stmt, 1, version->sortVersion, -1, SQLITE_STATIC);
+    DBCoreRun(stmt, decodeDevice, device);
+    stmt = DBCoreStatement(core, kOperatorSQL);
+    sqlite3_bind_text(stmt, 1, profile->code, -1, SQLITE_STATIC);
+    return DBCoreRun(stmt, decodeOperator, carrier) == 1;
+}
+
+static void profileCases(DBCore *core) {
+    // Typed rows agree with the table.
+    for (int i = 0; i < 200; i++) {
+        Profile profile = randomProfile();
+        VersionRow version;
+        DeviceRow device = { .identifier = "" };
+        OperatorRow carrier;
+        if (!typedProfile(core, &profile, &version, &device, &carrier)) {
+            CHECK(profile.minVersion && profile.maxVersion && strcmp(profile.minVersion, profile.maxVersion) > 0,
+                  "no profile for %s..%s/%s", profile.minVersion, profile.maxVersion, profile.code);
+            continue;
+        }
+        CHECK(strcmp(carrier.code, profile.code) == 0, "carrier %s for code %s", carrier.code, profile.code);
+        CHECK((!profile.minVersion || strcmp(version.sortVersion, profile.minVersion) >= 0) &&
+              (!profile.maxVersion || strcmp(version.sortVersion, profile.maxVersion) <= 0),
+              "version %s outside %s..%s", version.sortVersion, profile.minVersion, profile.maxVersion);
+        if (device.identifier[0]) {
+            CHECK(strcmp(device.cpu, device.cpuName) == 0 || device.cpuName[0] == '\0', "join paired %s with %s",
+                  device.cpu, device.cpuName);
+        }
+    }
+}
+
+static void timing(DBCore *core, int profiles) {
+    Profile *list = malloc((size_t)profiles * sizeof(Profile));
+    for (int i = 0; i < profiles; i++) list[i] = randomProfile();
+    sqlite3 *db = DBCoreHandle(core);
+    VersionRow version;
+    DeviceRow device;
+    OperatorRow carrier;
+
+    double start = nowMs();
+    for (int i = 0; i < profiles; i++) formattedProfile(db, &list[i]);
+    double formattedMs = nowMs() - start;
+    start = nowMs();
+    for (int i = 0; i < profiles; i++) cachedGenericProfile(core, &list[i]);
+    double genericMs = nowMs() - start;
+    start = nowMs();
+    for (int i = 0; i < profiles; i++) typedProfile(core, &list[i], &version, &device, &carrier);
+    double typedMs = nowMs() - start;
+
+    // The same typed queries through a connection that reads instead of maps.
+    DBCore *unmapped = NULL;
+    double unmappedMs = -1;
+    if (DBCoreOpen(gPath, 0, &unmapped) == SQLITE_OK) {
+        start = nowMs();
+        for (int i = 0; i < profiles; i++) typedProfile(unmapped, &list[i], &version, &device, &carrier);
+        unmappedMs = nowMs() - start;
+        DBCoreClose(unmapped);
+    }
+
+    fprintf(stderr,
+            "test_db_manager: %d profiles x 3 queries: formatted + prepare per call %.1f us/profile, cached + bound "
+            "%.1f us, cached + bound + typed rows %.1f us (%.1fx), typed without mmap %.1f us\n",
+            profiles, formattedMs * 1e3 / profiles, genericMs * 1e3 / profiles, typedMs * 1e3 / profiles,
+            typedMs > 0 ? formattedMs / typedMs : 0, unmappedMs * 1e3 / profiles);
+    free(list);
+}
+
+int main(int argc, char *argv[]) {
+    snprintf(gRoot, sizeof(gRoot), "/tmp/test_db_manager.XXXXXX");
+    if (!mkdtemp(gRoot)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    snprintf(gPath, sizeof(gPath), "%s/IOS.db", gRoot);
+    char command[512];
+    snprintf(command, sizeof(command), "cp '%s' %s", argc > 1 ? argv[1] : "../layout/Library/IOS.db", gPath);
+    if (system(command) != 0) return 2;
+    DBCore *core = NULL;
+    int rc = DBCoreOpen(gPath, 64 << 20, &core);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "test_db_manager: cannot open %s: %s\n", gPath, sqlite3_errstr(rc));
+        return 2;
+    }
+    DBCoreRun(DBCoreStatement(core, "SELECT DISTINCT code FROM operator WHERE code IS NOT NULL"), collectCode, NULL);
+    DBCoreRun(DBCoreStatement(core, "SELECT sortVersion FROM KMOS ORDER BY sortVersion"), collectVersion, NULL);
+    CHECK(gCodeCount > 1 && gVersionCount > 1, "%d codes, %d versions in %s", gCodeCount, gVersionCount, gPath);
+
+    cacheCases(core);
+    profileCases(core);
+    timing(core, argc > 2 ? atoi(argv[2]) : 2000);
+    DBCoreClose(core);
+
+    snprintf(command, sizeof(command), "rm -rf %s", gRoot);
+    if (system(command) != 0) fprintf(stderr, "test_db_manager: could not remove %s\n", gRoot);
+    if (gFailures) {
+        fprintf(stderr, "test_db_manager: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_db_manager: %d checks passed\n", gChecks);
+    return 0;
+}
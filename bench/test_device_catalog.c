@@ -0,0 +1,464 @@
+// Checks DeviceCatalog's indexes and draws (daemon/DeviceCatalogCore.m) against
+// the shipped layout/Library/IOS.db: every draw can reach exactly the rows the
+// ORDER BY RANDOM() queries DataGenManager used could return (same WHERE
+// clauses, counted by SQLite), nothing outside them, NULL keys and repeated
+// sortVersions handled, and draws uniform over the candidates (the tables have
+// no weight column, so uniform is the distribution the SQL had). Then times
+// whole samples (a version in a range, a device for it, an operator for a
+// code) per second against the same three queries prepared once and bound.
+//
+//   make -C bench test
+//   build/test_device_catalog [IOS.db [SAMPLES]]
+#define _GNU_SOURCE
+#include <math.h>
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "DeviceCatalogCore.h"
+
+// A scratch copy of IOS.db, so the shipped file is never opened.
+static char gRoot[64];
+static char gPath[128];
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_device_catalog: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+static uint32_t gRandom = 1;
+static uint32_t nextRandom(void) {
+    gRandom = gRandom * 1664525u + 1013904223u;
+    return gRandom >> 8;
+}
+
+static uint32_t randomUniform(uint32_t bound) {
+    return nextRandom() % bound;
+}
+
+// Draws 0, 1, 2, ... in turn, so `bound` draws visit every candidate once.
+static uint32_t gCounter;
+static uint32_t countingUniform(uint32_t bound) {
+    return gCounter++ % bound;
+}
+
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+// ---- Catalog rows ----
+
+// Columns the catalog indexes, in the order of DeviceCatalog's queries.
+typedef struct {
+    char **keys;
+    size_t count;
+} Column;
+
+static sqlite3 *gDb;
+static Column gVersionKeys, gDeviceFrom, gDeviceTo, gOperatorCodes;
+
+static void loadColumn(const char *sql, Column *first, Column *second) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(gDb, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        CHECK(false, "%s: %s", sql, sqlite3_errmsg(gDb));
+        return;
+    }
+    size_t capacity = 0;
+    Column *columns[2] = { first, second };
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        if (first->count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            for (int c = 0; c < 2 && columns[c]; c++) {
+                columns[c]->keys = realloc(columns[c]->keys, capacity * sizeof(char *));
+            }
+        }
+        for (int c = 0; c < 2 && columns[c]; c++) {
+            const char *text = (const char *)sqlite3_column_text(stmt, c);
+            columns[c]->keys[columns[c]->count++] = text ? strdup(text) : NULL;
+        }
+    }
+    sqlite3_finalize(stmt);
+}
+
+static void freeColumn(Column *column) {
+    for (size_t i = 0; i < column->count; i++) free(column->keys[i]);
+    free(column->keys);
+}
+
+static int64_t sqlCount(const char *sql, const char *a, const char *b) {
+    sqlite3_stmt *stmt = NULL;
+    int64_t count = -1;
+    if (sqlite3_prepare_v2(gDb, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (a) sqlite3_bind_text(stmt, 1, a, -1, SQLITE_STATIC);
+    if (b) sqlite3_bind_text(stmt, 2, b, -1, SQLITE_STATIC);
+    if (sqlite3_step(stmt) == SQLITE_ROW) count = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+static DeviceCatalogIndex *buildIndex(void) {
+    return DeviceCatalogIndexBuild((const char *const *)gVersionKeys.keys, gVersionKeys.count,
+                                   (const char *const *)gDeviceFrom.keys, (const char *const *)gDeviceTo.keys,
+                                   gDeviceFrom.count, (const char *const *)gOperatorCodes.keys, gOperatorCodes.count);
+}
+
+// ---- Reachability ----
+
+static bool inRange(const char *key, const char *min, const char *max) {
+    return key && (!min || strcmp(key, min) >= 0) && (!max || strcmp(key, max) <= 0);
+}
+
+// Draws `expected` times with the counting source: every candidate once, each
+// satisfying accept, and none twice.
+typedef bool (*DrawFunc)(const DeviceCatalogIndex *index, const char *a, const char *b, size_t *row);
+typedef bool (*AcceptFunc)(size_t row, const char *a, const char *b);
+
+static bool drawVersion(const DeviceCatalogIndex *index, const char *a, const char *b, size_t *row) {
+    return DeviceCatalogRandomVersion(index, a, b, countingUniform, row);
+}
+
+static bool acceptVersion(size_t row, const char *a, const char *b) {
+    return row < gVersionKeys.count && inRange(gVersionKeys.keys[row], a, b);
+}
+
+static bool drawDevice(const DeviceCatalogIndex *index, const char *a, const char *b, size_t *row) {
+    (void)b;
+    return DeviceCatalogRandomDevice(index, a, countingUniform, row);
+}
+
+static bool acceptDevice(size_t row, const char *a, const char *b) {
+    (void)b;
+    return row < gDeviceFrom.count && gDeviceFrom.keys[row] && gDeviceTo.keys[row] &&
+           strcmp(gDeviceFrom.keys[row], a) <= 0 && strcmp(a, gDeviceTo.keys[row]) <= 0;
+}
+
+static bool drawOperator(const DeviceCatalogIndex *index, const char *a, const char *b, size_t *row) {
+    (void)b;
+    return DeviceCatalogRandomOperator(index, a, countingUniform, row);
+}
+
+static bool acceptOperator(size_t row, const char *a, const char *b) {
+    (void)b;
+    return row < gOperatorCodes.count && gOperatorCodes.keys[row] && strcmp(gOperatorCodes.keys[row], a) == 0;
+}
+
+static void checkReach(const DeviceCatalogIndex *index, DrawFunc draw, AcceptFunc accept, size_t rows,
+                       const char *a, const char *b, int64_t expected, const char *what) {
+    size_t row;
+    gCounter = 0;
+    if (expected <= 0) {
+        CHECK(!draw(index, a, b, &row), "%s %s..%s: drew from an empty set", what, a ? a : "-", b ? b : "-");
+        return;
+    }
+    bool *seen = calloc(rows, sizeof(bool));
+    bool ok = true;
+    for (int64_t i = 0; i < expected && ok; i++) {
+        ok = draw(index, a, b, &row) && accept(row, a, b) && !seen[row];
+        if (ok) seen[row] = true;
+    }
+    CHECK(ok, "%s %s..%s: %lld candidates not each drawn once", what, a ? a : "-", b ? b : "-", (long long)expected);
+    // The next draw starts the cycle over.
+    CHECK(draw(index, a, b, &row) && seen[row], "%s %s..%s: cycle did not repeat", what, a ? a : "-", b ? b : "-");
+    free(seen);
+}
+
+static void reachCases(const DeviceCatalogIndex *index) {
+    int64_t versions = sqlCount("SELECT COUNT(*) FROM KMOS WHERE sortVersion IS NOT NULL", NULL, NULL);
+    CHECK((int64_t)DeviceCatalogVersionCount(index) == versions, "%zu versions indexed, %lld in KMOS",
+          DeviceCatalogVersionCount(index), (long long)versions);
+    for (size_t i = 1; i < DeviceCatalogVersionCount(index); i++) {
+        const char *previous = gVersionKeys.keys[DeviceCatalogVersionRow(index, i - 1)];
+        const char *current = gVersionKeys.keys[DeviceCatalogVersionRow(index, i)];
+        CHECK(strcmp(previous, current) <= 0, "versions out of order at %zu: %s > %s", i, previous, current);
+    }
+
+    // Version ranges: open, one-sided, pairs of real keys, and bounds
+    // between and outside the keys.
+    checkReach(index, drawVersion, acceptVersion, gVersionKeys.count, NULL, NULL, versions, "version");
+    const char *extra[] = { "000.000.000", "012.000.000", "013.005", "999.000.000" };
+    size_t bounds = gVersionKeys.count + 4;
+    for (size_t i = 0; i < bounds; i++) {
+        const char *min = i < gVersionKeys.count ? gVersionKeys.keys[i] : extra[i - gVersionKeys.count];
+        if (!min) continue;
+        checkReach(index, drawVersion, acceptVersion, gVersionKeys.count, min, NULL,
+                   sqlCount("SELECT COUNT(*) FROM KMOS WHERE sortVersion >= ?1", min, NULL), "version");
+        checkReach(index, drawVersion, acceptVersion, gVersionKeys.count, NULL, min,
+                   sqlCount("SELECT COUNT(*) FROM KMOS WHERE sortVersion <= ?1", min, NULL), "version");
+        for (size_t j = 0; j < bounds; j += 3) {
+            const char *max = j < gVersionKeys.count ? gVersionKeys.keys[j] : extra[j - gVersionKeys.count];
+            if (!max) continue;
+            checkReach(index, drawVersion, acceptVersion, gVersionKeys.count, min, max,
+                       sqlCount("SELECT COUNT(*) FROM KMOS WHERE sortVersion >= ?1 AND sortVersion <= ?2", min, max),
+                       "version");
+        }
+    }
+
+    // Devices for every version, as DataGenManager's join filtered them.
+    for (size_t i = 0; i < gVersionKeys.count; i++) {
+        const char *key = gVersionKeys.keys[i];
+        if (!key) continue;
+        checkReach(index, drawDevice, acceptDevice, gDeviceFrom.count, key, NULL,
+                   sqlCount("SELECT COUNT(*) FROM KMDevices d left join CPU c on d.CPU = c.name "
+                            "WHERE defaultOSV <= ?1 AND ?1 <= maxOSV", key, NULL),
+                   "device");
+    }
+    size_t row;
+    CHECK(!DeviceCatalogRandomDevice(index, "013.005", randomUniform, &row), "device for a version not in KMOS");
+    CHECK(!DeviceCatalogRandomDevice(index, NULL, randomUniform, &row), "device for no version");
+
+    // Operators for every code, and codes that are not there.
+    for (size_t i = 0; i < gOperatorCodes.count; i++) {
+        const char *code = gOperatorCodes.keys[i];
+        if (!code) continue;
+        checkReach(index, drawOperator, acceptOperator, gOperatorCodes.count, code, NULL,
+                   sqlCount("SELECT COUNT(*) FROM operator WHERE code = ?1", code, NULL), "operator");
+    }
+    CHECK(!DeviceCatalogRandomOperator(index, "", randomUniform, &row), "operator for an empty code");
+    CHECK(!DeviceCatalogRandomOperator(index, "zz-none", randomUniform, &row), "operator for an unknown code");
+    CHECK(!DeviceCatalogRandomOperator(index, NULL, randomUniform, &row), "operator for no code");
+}
+
+// NULL keys, repeated sortVersions and empty tables, which IOS.db does not have.
+static void edgeCases(void) {
+    const char *versions[] = { "002.000", NULL, "001.000", "002.000", "003.000" };
+    const char *from[] = { "001.000", NULL, "002.000", "002.000" };
+    const char *to[] = { "002.000", "003.000", NULL, "003.000" };
+    const char *codes[] = { "b", NULL, "a", "b", "b" };
+    DeviceCatalogIndex *index = DeviceCatalogIndexBuild(versions, 5, from, to, 4, codes, 5);
+    CHECK(index != NULL, "edge index");
+    if (!index) return;
+    CHECK(DeviceCatalogVersionCount(index) == 4, "%zu versions with keys", DeviceCatalogVersionCount(index));
+    size_t expectedOrder[] = { 2, 0, 3, 4 };
+    for (size_t i = 0; i < 4; i++) {
+        CHECK(DeviceCatalogVersionRow(index, i) == expectedOrder[i], "version %zu is row %zu", i,
+              DeviceCatalogVersionRow(index, i));
+    }
+    size_t row;
+    bool seen[5] = { false };
+    gCounter = 0;
+    for (int i = 0; i < 2; i++) {
+        CHECK(DeviceCatalogRandomVersion(index, "002.000", "002.000", countingUniform, &row), "repeated version");
+        seen[row] = true;
+    }
+    CHECK(seen[0] && seen[3], "both rows of a repeated sortVersion reachable");
+    CHECK(!DeviceCatalogRandomVersion(index, "003.000", "001.000", randomUniform, &row), "inverted range");
+    // Devices missing a bound never match; both copies of 002.000 share a list.
+    bool devices[4] = { false };
+    gCounter = 0;
+    for (int i = 0; i < 4; i++) {
+        CHECK(DeviceCatalogRandomDevice(index, "002.000", countingUniform, &row), "device for 002.000");
+        devices[row] = true;
+    }
+    CHECK(devices[0] && devices[3] && !devices[1] && !devices[2], "devices with a NULL bound drawn");
+    CHECK(!DeviceCatalogRandomDevice(index, "004.000", randomUniform, &row), "device for a missing version");
+    gCounter = 0;
+    CHECK(DeviceCatalogRandomDevice(index, "001.000", countingUniform, &row) && row == 0, "device for 001.000");
+    bool operators[5] = { false };
+    gCounter = 0;
+    for (int i = 0; i < 3; i++) {
+        CHECK(DeviceCatalogRandomOperator(index, "b", countingUniform, &row), "operator b");
+        operators[row] = true;
+    }
+    CHECK(operators[0] && operators[3] && operators[4], "every b reachable");
+    DeviceCatalogIndexFree(index);
+
+    index = DeviceCatalogIndexBuild(NULL, 0, NULL, NULL, 0, NULL, 0);
+    CHECK(index != NULL, "empty index");
+    if (!index) return;
+    CHECK(DeviceCatalogVersionCount(index) == 0, "empty index has versions");
+    CHECK(!DeviceCatalogRandomVersion(index, NULL, NULL, randomUniform, &row), "version from an empty index");
+    CHECK(!DeviceCatalogRandomOperator(index, "a", randomUniform, &row), "operator from an empty index");
+    DeviceCatalogIndexFree(index);
+}
+
+// ---- Distribution ----
+
+// Chi-square of `draws` draws over the candidates against uniform; with df
+// degrees of freedom it stays under df + 6 sqrt(2 df) unless something is
+// skewed (the LCG is deterministic, so this never flakes).
+static void uniformity(const DeviceCatalogIndex *index) {
+    const int draws = 200000;
+    size_t rows = gVersionKeys.count > gOperatorCodes.count ? gVersionKeys.count : gOperatorCodes.count;
+    if (gDeviceFrom.count > rows) rows = gDeviceFrom.count;
+    int *hits = calloc(rows, sizeof(int));
+    size_t row;
+
+    // The operator code with the most rows, and the version with the most devices.
+    const char *code = NULL, *version = NULL;
+    int64_t codeRows = 0, versionDevices = 0;
+    for (size_t i = 0; i < gOperatorCodes.count; i++) {
+        int64_t n = gOperatorCodes.keys[i] ? sqlCount("SELECT COUNT(*) FROM operator WHERE code = ?1",
+                                                      gOperatorCodes.keys[i], NULL) : 0;
+        if (n > codeRows) codeRows = n, code = gOperatorCodes.keys[i];
+    }
+    for (size_t i = 0; i < gVersionKeys.count; i++) {
+        int64_t n = gVersionKeys.keys[i]
+            ? sqlCount("SELECT COUNT(*) FROM KMDevices WHERE defaultOSV <= ?1 AND ?1 <= maxOSV", gVersionKeys.keys[i], NULL)
+            : 0;
+        if (n > versionDevices) versionDevices = n, version = gVersionKeys.keys[i];
+    }
+
+    struct { const char *what; int64_t candidates; } cases[] = {
+        { "versions", (int64_t)DeviceCatalogVersionCount(index) },
+        { "devices", versionDevices },
+        { "operators", codeRows },
+    };
+    for (int c = 0; c < 3; c++) {
+        if (cases[c].candidates < 2) continue;
+        memset(hits, 0, rows * sizeof(int));
+        for (int i = 0; i < draws; i++) {
+            bool ok = c == 0   ? DeviceCatalogRandomVersion(index, NULL, NULL, randomUniform, &row)
+                      : c == 1 ? DeviceCatalogRandomDevice(index, version, randomUniform, &row)
+                               : DeviceCatalogRandomOperator(index, code, randomUniform, &row);
+            if (ok) hits[row]++;
+        }
+        double expected = (double)draws / (double)cases[c].candidates, chi = 0;
+        int64_t hit = 0;
+        for (size_t r = 0; r < rows; r++) {
+            if (!hits[r]) continue;
+            hit++;
+            chi += (hits[r] - expected) * (hits[r] - expected) / expected;
+        }
+        double df = (double)(cases[c].candidates - 1), limit = df + 6 * sqrt(2 * df);
+        CHECK(hit == cases[c].candidates, "%s: %lld of %lld candidates drawn", cases[c].what, (long long)hit,
+              (long long)cases[c].candidates);
+        CHECK(chi < limit, "%s: chi-square %.1f over %.1f", cases[c].what, chi, limit);
+        fprintf(stderr, "test_device_catalog: %-9s %lld candidates, chi-square %.1f (df %.0f)\n", cases[c].what,
+                (long long)cases[c].candidates, chi, df);
+    }
+    free(hits);
+}
+
+// ---- Timing ----
+
+// One profile's worth of sampling: a version in a range, a device for it and
+// an operator for a code. The SQL side steps to the first row and reads the
+// key it needs, like the old queries' single-row results.
+static void timing(const DeviceCatalogIndex *index, int samples) {
+    size_t versions = DeviceCatalogVersionCount(index);
+    if (versions < 2 || gOperatorCodes.count == 0) return;
+    const char *minKey = gVersionKeys.keys[DeviceCatalogVersionRow(index, versions / 4)];
+    const char *maxKey = gVersionKeys.keys[DeviceCatalogVersionRow(index, versions - 1)];
+    size_t drawn = 0, row;
+
+    double start = nowMs();
+    for (int i = 0; i < samples; i++) {
+        if (!DeviceCatalogRandomVersion(index, minKey, maxKey, randomUniform, &row)) continue;
+        const char *version = gVersionKeys.keys[row];
+        if (DeviceCatalogRandomDevice(index, version, randomUniform, &row)) drawn++;
+        const char *code = gOperatorCodes.keys[nextRandom() % gOperatorCodes.count];
+        if (code && DeviceCatalogRandomOperator(index, code, randomUniform, &row)) drawn++;
+    }
+    double coreMs = nowMs() - start;
+
+    sqlite3_stmt *versionStmt = NULL, *deviceStmt = NULL, *operatorStmt = NULL;
+    sqlite3_prepare_v2(gDb, "SELECT * FROM KMOS WHERE sortVersion >= ?1 AND sortVersion <= ?2 ORDER BY RANDOM() LIMIT 1",
+                       -1, &versionStmt, NULL);
+    sqlite3_prepare_v2(gDb, "SELECT * FROM KMDevices d left join CPU c on d.CPU = c.name "
+                            "WHERE defaultOSV <= ?1 AND ?1 <= maxOSV ORDER BY RANDOM() LIMIT 1",
+                       -1, &deviceStmt, NULL);
+    sqlite3_prepare_v2(gDb, "SELECT * FROM operator WHERE code = ?1 ORDER BY RANDOM() LIMIT 1", -1, &operatorStmt, NULL);
+    if (!versionStmt || !deviceStmt || !operatorStmt) {
+        CHECK(false, "preparing the sampling queries: %s", sqlite3_errmsg(gDb));
+        sqlite3_finalize(versionStmt);
+        sqlite3_finalize(deviceStmt);
+        sqlite3_finalize(operatorStmt);
+        return;
+    }
+    int sqlSamples = samples / 100 > 200 ? samples / 100 : 200;
+    size_t sqlDrawn = 0;
+    char version[32];
+    start = nowMs();
+    for (int i = 0; i < sqlSamples; i++) {
+        sqlite3_bind_text(versionStmt, 1, minKey, -1, SQLITE_STATIC);
+        sqlite3_bind_text(versionStmt, 2, maxKey, -1, SQLITE_STATIC);
+        bool found = sqlite3_step(versionStmt) == SQLITE_ROW;
+        if (found) snprintf(version, sizeof(version), "%s", (const char *)sqlite3_column_text(versionStmt, 2));
+        sqlite3_reset(versionStmt);
+        if (!found) continue;
+        sqlite3_bind_text(deviceStmt, 1, version, -1, SQLITE_STATIC);
+        if (sqlite3_step(deviceStmt) == SQLITE_ROW) sqlDrawn++;
+        sqlite3_reset(deviceStmt);
+        const char *code = gOperatorCodes.keys[nextRandom() % gOperatorCodes.count];
+        if (!code) continue;
+        sqlite3_bind_text(operatorStmt, 1, code, -1, SQLITE_STATIC);
+        if (sqlite3_step(operatorStmt) == SQLITE_ROW) sqlDrawn++;
+        sqlite3_reset(operatorStmt);
+    }
+    double sqlMs = nowMs() - start;
+    sqlite3_finalize(versionStmt);
+    sqlite3_finalize(deviceStmt);
+    sqlite3_finalize(operatorStmt);
+
+    double corePerSecond = samples / (coreMs / 1e3), sqlPerSecond = sqlSamples / (sqlMs / 1e3);
+    fprintf(stderr, "test_device_catalog: catalog %10.0f samples/s (%d samples, %zu rows, %.1f ms)\n", corePerSecond,
+            samples, drawn, coreMs);
+    fprintf(stderr, "test_device_catalog: SQL     %10.0f samples/s (%d samples, %zu rows, %.1f ms, prepared once)\n",
+            sqlPerSecond, sqlSamples, sqlDrawn, sqlMs);
+    CHECK(drawn > 0 && sqlDrawn > 0, "timing drew nothing");
+    // Orders of magnitude apart; only a broken index could lose.
+    CHECK(corePerSecond > sqlPerSecond, "catalog %.0f samples/s, SQL %.0f", corePerSecond, sqlPerSecond);
+}
+
+int main(int argc, char *argv[]) {
+    snprintf(gRoot, sizeof(gRoot), "/tmp/test_device_catalog.XXXXXX");
+    if (!mkdtemp(gRoot)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    snprintf(gPath, sizeof(gPath), "%s/IOS.db", gRoot);
+    char command[512];
+    snprintf(command, sizeof(command), "cp '%s' %s", argc > 1 ? argv[1] : "../layout/Library/IOS.db", gPath);
+    if (system(command) != 0) {
+        rmdir(gRoot);
+        return 2;
+    }
+    if (sqlite3_open_v2(gPath, &gDb, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+        fprintf(stderr, "test_device_catalog: cannot open %s: %s\n", gPath, sqlite3_errmsg(gDb));
+        return 2;
+    }
+    // The rows DeviceCatalog loads, in the same order.
+    loadColumn("SELECT sortVersion FROM KMOS", &gVersionKeys, NULL);
+    loadColumn("SELECT defaultOSV, maxOSV FROM KMDevices d left join CPU c on d.CPU = c.name", &gDeviceFrom, &gDeviceTo);
+    loadColumn("SELECT code FROM operator", &gOperatorCodes, NULL);
+    CHECK(gVersionKeys.count > 1 && gDeviceFrom.count > 1 && gOperatorCodes.count > 1, "%zu versions, %zu devices, "
+          "%zu operators in %s", gVersionKeys.count, gDeviceFrom.count, gOperatorCodes.count, gPath);
+
+    DeviceCatalogIndex *index = buildIndex();
+    CHECK(index != NULL, "building the index");
+    if (index) {
+        reachCases(index);
+        uniformity(index);
+        double start = nowMs();
+        DeviceCatalogIndex *again = buildIndex();
+        fprintf(stderr, "test_device_catalog: index built in %.2f ms\n", nowMs() - start);
+        DeviceCatalogIndexFree(again);
+        timing(index, argc > 2 ? atoi(argv[2]) : 1000000);
+        DeviceCatalogIndexFree(index);
+    }
+    edgeCases();
+
+    sqlite3_close(gDb);
+    freeColumn(&gVersionKeys);
+    freeColumn(&gDeviceFrom);
+    freeColumn(&gDeviceTo);
+    freeColumn(&gOperatorCodes);
+    snprintf(command, sizeof(command), "rm -rf %s", gRoot);
+    if (system(command) != 0) fprintf(stderr, "test_device_catalog: could not remove %s\n", gRoot);
+    if (gFailures) {
+        fprintf(stderr, "test_device_catalog: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_device_catalog: %d checks passed\n", gChecks);
+    return 0;
+}
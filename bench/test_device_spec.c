@@ -0,0 +1,161 @@
+// Checks the resolution parser behind PXDeviceSpecCache (hooks/PXHookCore.m)
+// on every distinct sc_pixel_size / sc_viewport string in IOS.db's KMDevices,
+// including the '×' and thin-space '1792 × 828' rows, on malformed input, and
+// the portrait normalization the UIScreen hooks rely on. When the sqlite3 CLI
+// is installed the live table is read as well, so a new row format fails here.
+//
+//   make -C bench test
+//   build/test_device_spec [IOS.db]
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "PXHookCore.h"
+
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_device_spec: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+// SELECT DISTINCT over both columns, long side first as stored.
+static const struct {
+    const char *text;
+    double longSide, shortSide;
+} kKMDevicesSizes[] = {
+    { "1136\xC3\x97" "640", 1136, 640 },
+    { "1334x750", 1334, 750 },
+    { "1334\xC3\x97" "750", 1334, 750 },
+    { "1792\xC3\x97" "828", 1792, 828 },
+    { "1792\xE2\x80\x89\xC3\x97\xE2\x80\x89" "828", 1792, 828 },
+    { "1920\xC3\x97" "1080", 1920, 1080 },
+    { "2208x1242", 2208, 1242 },
+    { "2278x1284", 2278, 1284 },
+    { "2340x1080", 2340, 1080 },
+    { "2436x1125", 2436, 1125 },
+    { "2436\xC3\x97" "1125", 2436, 1125 },
+    { "2532x1170", 2532, 1170 },
+    { "2556x1179", 2556, 1179 },
+    { "2688x1242", 2688, 1242 },
+    { "2688\xC3\x97" "1242", 2688, 1242 },
+    { "2778x1284", 2778, 1284 },
+    { "2796x1290", 2796, 1290 },
+};
+#define kKMDevicesSizeCount (sizeof(kKMDevicesSizes) / sizeof(kKMDevicesSizes[0]))
+
+// ---- Known rows ----
+
+static void knownRows(void) {
+    CHECK(kKMDevicesSizeCount == 17, "expected the 17 distinct KMDevices sizes, have %zu", kKMDevicesSizeCount);
+    for (size_t i = 0; i < kKMDevicesSizeCount; i++) {
+        const char *text = kKMDevicesSizes[i].text;
+        double w = 0, h = 0;
+        CHECK(PXParseResolutionCString(text, &w, &h), "rejected \"%s\"", text);
+        CHECK(w == kKMDevicesSizes[i].longSide && h == kKMDevicesSizes[i].shortSide,
+              "\"%s\" parsed as %gx%g", text, w, h);
+
+        double shortSide = 0, longSide = 0;
+        CHECK(PXParsePortraitResolution(text, &shortSide, &longSide), "portrait rejected \"%s\"", text);
+        CHECK(shortSide == kKMDevicesSizes[i].shortSide && longSide == kKMDevicesSizes[i].longSide,
+              "\"%s\" portrait %gx%g", text, shortSide, longSide);
+    }
+
+    // Portrait does not depend on the stored order.
+    double shortSide = 0, longSide = 0;
+    CHECK(PXParsePortraitResolution("1179x2556", &shortSide, &longSide) && shortSide == 1179 && longSide == 2556,
+          "short-side-first row: %gx%g", shortSide, longSide);
+    CHECK(PXParsePortraitResolution("1000x1000", &shortSide, &longSide) && shortSide == 1000 && longSide == 1000,
+          "square: %gx%g", shortSide, longSide);
+}
+
+// ---- Other accepted forms ----
+
+static void acceptedForms(void) {
+    static const struct { const char *text; double w, h; } kAccepted[] = {
+        { "2556X1179", 2556, 1179 },
+        { "2556 x 1179", 2556, 1179 },
+        { "  2556x1179  ", 2556, 1179 },
+        { "2556\t\xC3\x97\t" "1179", 2556, 1179 },
+        { "2556 1179", 2556, 1179 },
+        { "414.5x896", 414.5, 896 },
+        { "1x1", 1, 1 },
+    };
+    for (size_t i = 0; i < sizeof(kAccepted) / sizeof(kAccepted[0]); i++) {
+        double w = 0, h = 0;
+        CHECK(PXParseResolutionCString(kAccepted[i].text, &w, &h) && w == kAccepted[i].w && h == kAccepted[i].h,
+              "\"%s\" parsed as %gx%g", kAccepted[i].text, w, h);
+    }
+}
+
+// ---- Malformed input ----
+
+static void malformed(void) {
+    static const char *const kRejected[] = {
+        "", " ", "x", "\xC3\x97", "2556", "2556x", "2556 x ", "x1179", "\xC3\x97" "1179",
+        "2556x1179x3", "2556x1179 px", "2556x1179;", "0x1179", "2556x0", "-2556x1179", "2556x-1179",
+        "+2556x1179", "inf\xC3\x97" "5", "5xinf", "nanxnan", "1e3x500", "0x10x5", "2556,1179", "2556*1179",
+        "2556..1x1179", "2556x1179\n2", "abcx1179", "2556xabc", "2000000x1000",
+    };
+    for (size_t i = 0; i < sizeof(kRejected) / sizeof(kRejected[0]); i++) {
+        double w = -1, h = -1;
+        CHECK(!PXParseResolutionCString(kRejected[i], &w, &h), "accepted \"%s\" as %gx%g", kRejected[i], w, h);
+        CHECK(w == -1 && h == -1, "\"%s\" wrote outputs on failure", kRejected[i]);
+        double shortSide = -1, longSide = -1;
+        CHECK(!PXParsePortraitResolution(kRejected[i], &shortSide, &longSide), "portrait accepted \"%s\"", kRejected[i]);
+    }
+    double w = 0, h = 0;
+    CHECK(!PXParseResolutionCString(NULL, &w, &h), "accepted NULL");
+    CHECK(!PXParsePortraitResolution(NULL, &w, &h), "portrait accepted NULL");
+
+    // A truncated multi-byte separator is still a separator byte run.
+    CHECK(PXParseResolutionCString("2556\xC3" "1179", &w, &h) && w == 2556 && h == 1179,
+          "truncated UTF-8 separator: %gx%g", w, h);
+}
+
+// ---- Live IOS.db ----
+
+static void liveTable(const char *database) {
+    char command[512];
+    snprintf(command, sizeof(command),
+             "sqlite3 '%s' 'SELECT DISTINCT v FROM (SELECT sc_pixel_size AS v FROM KMDevices "
+             "UNION ALL SELECT sc_viewport FROM KMDevices) WHERE v IS NOT NULL ORDER BY v' 2>/dev/null",
+             database);
+    FILE *pipe = popen(command, "r");
+    if (!pipe) return;
+    char line[256];
+    size_t rows = 0;
+    while (fgets(line, sizeof(line), pipe)) {
+        line[strcspn(line, "\n")] = '\0';
+        if (!line[0]) continue;
+        rows++;
+        bool known = false;
+        for (size_t i = 0; i < kKMDevicesSizeCount; i++) known |= strcmp(kKMDevicesSizes[i].text, line) == 0;
+        CHECK(known, "IOS.db has a size not in this test: \"%s\"", line);
+        double shortSide = 0, longSide = 0;
+        CHECK(PXParsePortraitResolution(line, &shortSide, &longSide), "IOS.db size rejected: \"%s\"", line);
+    }
+    if (pclose(pipe) != 0 || rows == 0) {
+        fprintf(stderr, "test_device_spec: sqlite3 or %s unavailable, live table skipped\n", database);
+        return;
+    }
+    CHECK(rows == kKMDevicesSizeCount, "IOS.db has %zu distinct sizes, this test %zu", rows, kKMDevicesSizeCount);
+}
+
+int main(int argc, char *argv[]) {
+    knownRows();
+    acceptedForms();
+    malformed();
+    liveTable(argc > 1 ? argv[1] : "../layout/Library/IOS.db");
+    if (gFailures) {
+        fprintf(stderr, "test_device_spec: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_device_spec: %d checks passed\n", gChecks);
+    return 0;
+}
@@ -0,0 +1,611 @@
+// Randomized check of daemon/DiskUsageCore.m against du. Builds a scratch tree
+// of profile directories and app containers, replays the daemon's flows on it
+// (newPhone, switchBackup's swap and saved-bundle scan, pruning plus the
+// manifest ingest, content dedupe by hard link, removeBackup, untracked drift
+// and the idle reconcile) feeding the same ledger calls the daemon makes, and
+// after every step compares each profile's buckets with GNU du's per-file
+// apparent sizes (`du -ab --apparent-size`, regular files only).
+//
+//   make -C bench test                 fixed seeds
+//   build/test_disk_usage SEED STEPS   one run
+//
+// Hard links made by the dedupe step stay within one bucket or cross profiles:
+// a link between two buckets of one profile is counted in whichever bucket the
+// walk meets first, so only the profile total would be comparable.
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DiskUsageCore.h"
+
+enum { kBundles = 5, kMaxProfiles = 8, kMaxBuckets = 16 };
+
+static const char *const kBundleIds[kBundles] = {
+    "com.apple.mobilesafari", "com.burbn.instagram", "com.zhiliaoapp.musically", "net.whatsapp.WhatsApp",
+    "com.example.unscoped",
+};
+// The last bundle is never in scope, so switchBackup leaves it alone.
+enum { kScoped = kBundles - 1 };
+
+static char gRoot[64];
+static char gProfiles[kMaxProfiles][32];
+static bool gExists[kMaxProfiles];
+// Touched behind the ledger's back; only the reconcile makes it exact again.
+static bool gDirty[kMaxProfiles];
+static int gActive = -1;
+static int gNextId;
+static uint64_t gRng;
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_disk_usage: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+static uint64_t nextRandom(void) {
+    gRng ^= gRng << 13;
+    gRng ^= gRng >> 7;
+    gRng ^= gRng << 17;
+    return gRng;
+}
+
+static unsigned randomBelow(unsigned n) {
+    return (unsigned)(nextRandom() % n);
+}
+
+// ---- Filesystem helpers ----
+
+static void profilePath(int profile, char *out, size_t size) {
+    snprintf(out, size, "%s/profiles/%s", gRoot, gProfiles[profile]);
+}
+
+static void containerPath(int bundle, char *out, size_t size) {
+    snprintf(out, size, "%s/containers/%s", gRoot, kBundleIds[bundle]);
+}
+
+static void makeDirs(const char *path) {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(buf, 0755);
+        *p = '/';
+    }
+    mkdir(buf, 0755);
+}
+
+// Replaces rather than rewrites, so a deduped (linked) copy elsewhere keeps its data.
+static void writeFile(const char *path, size_t size) {
+    static char block[4096];
+    unlink(path);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return;
+    memset(block, (int)(size & 0xFF), sizeof(block));
+    for (size_t left = size; left > 0;) {
+        size_t n = left < sizeof(block) ? left : sizeof(block);
+        if (write(fd, block, n) != (ssize_t)n) break;
+        left -= n;
+    }
+    close(fd);
+}
+
+static int removeEntry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)st; (void)ftw;
+    if (type == FTW_DP) rmdir(path);
+    else unlink(path);
+    return 0;
+}
+
+static void removeTree(const char *path) {
+    nftw(path, removeEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static const char *gCopyFrom;
+static const char *gCopyTo;
+
+static int copyEntry(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)ftw;
+    char target[512];
+    snprintf(target, sizeof(target), "%s%s", gCopyTo, path + strlen(gCopyFrom));
+    if (type == FTW_D) mkdir(target, 0755);
+    else if (type == FTW_SL) {
+        char link[256];
+        ssize_t n = readlink(path, link, sizeof(link) - 1);
+        if (n >= 0) {
+            link[n] = '\0';
+            if (symlink(link, target) != 0) return 0;
+        }
+    } else if (type == FTW_F) writeFile(target, (size_t)st->st_size);
+    return 0;
+}
+
+// Copy with fresh inodes, like a clone: no links back into the source.
+static void copyTree(const char *from, const char *to) {
+    gCopyFrom = from;
+    gCopyTo = to;
+    nftw(from, copyEntry, 16, FTW_PHYS);
+}
+
+// A few files under dir at random depths, with the odd empty file and symlink.
+static void fillTree(const char *dir, unsigned files) {
+    makeDirs(dir);
+    for (unsigned i = 0; i < files; i++) {
+        char path[512];
+        int n = snprintf(path, sizeof(path), "%s", dir);
+        static const char *const kFolders[] = { "Documents", "Library", "Library/Caches", "tmp", "Library/Preferences/x" };
+        if (randomBelow(4)) {
+            n += snprintf(path + n, sizeof(path) - (size_t)n, "/%s", kFolders[randomBelow(5)]);
+            makeDirs(path);
+        }
+        snprintf(path + n, sizeof(path) - (size_t)n, "/f%llu", (unsigned long long)(nextRandom() % 100000));
+        if (randomBelow(16) == 0) {
+            unlink(path);
+            if (symlink("/etc/hostname", path) != 0) continue;
+        } else {
+            writeFile(path, randomBelow(8) == 0 ? 0 : randomBelow(20000));
+        }
+    }
+}
+
+// ---- du ----
+
+typedef struct {
+    char bucket[64];
+    uint64_t bytes;
+} Bucket;
+
+// Per-bucket sums of du's per-file apparent sizes for one profile directory.
+// du lists each hard-linked inode once per invocation.
+static size_t duBuckets(const char *dir, Bucket *buckets) {
+    char command[600];
+    snprintf(command, sizeof(command), "du -ab --apparent-size '%s' 2>/dev/null", dir);
+    FILE *du = popen(command, "r");
+    if (!du) return 0;
+    size_t count = 0, dirLength = strlen(dir);
+    char line[1024];
+    while (fgets(line, sizeof(line), du)) {
+        line[strcspn(line, "\n")] = '\0';
+        char *tab = strchr(line, '\t');
+        if (!tab) continue;
+        const char *path = tab + 1;
+        struct stat st;
+        if (lstat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        if (strlen(path) <= dirLength + 1) continue;
+        size_t length = 0;
+        const char *bucket = DiskUsageBucket(path + dirLength + 1, &length);
+        size_t i = 0;
+        while (i < count && !(strncmp(buckets[i].bucket, bucket, length) == 0 && buckets[i].bucket[length] == '\0')) i++;
+        if (i == count) {
+            if (count == kMaxBuckets) continue;
+            snprintf(buckets[count].bucket, sizeof(buckets[count].bucket), "%.*s", (int)length, bucket);
+            buckets[count++].bytes = 0;
+        }
+        buckets[i].bytes += strtoull(line, NULL, 10);
+    }
+    pclose(du);
+    return count;
+}
+
+// Compares the ledger's record for profile with du, skipping "." when the
+// flow under test has written top-level files it does not account for.
+static void compareProfile(DiskUsageLedger *ledger, int profile, bool skipTopLevel, const char *step) {
+    char dir[512];
+    profilePath(profile, dir, sizeof(dir));
+    Bucket expected[kMaxBuckets];
+    size_t expectedCount = duBuckets(dir, expected);
+    const DiskUsageEntry *entries = NULL;
+    size_t count = 0;
+    uint64_t bytes = 0, sum = 0;
+    bool found = DiskUsageLedgerGet(ledger, gProfiles[profile], &bytes, NULL, &entries, &count);
+    CHECK(found, "%s: profile %s has no record", step, gProfiles[profile]);
+    if (!found) return;
+    for (size_t i = 0; i < count; i++) {
+        sum += entries[i].bytes;
+        CHECK(entries[i].bytes > 0, "%s: %s keeps an empty bucket %s", step, gProfiles[profile], entries[i].bucket);
+    }
+    CHECK(sum == bytes, "%s: %s buckets sum to %llu, record says %llu", step, gProfiles[profile],
+          (unsigned long long)sum, (unsigned long long)bytes);
+    for (size_t i = 0; i < expectedCount; i++) {
+        if (skipTopLevel && strcmp(expected[i].bucket, kDiskUsageTopLevelBucket) == 0) continue;
+        uint64_t recorded = 0;
+        for (size_t j = 0; j < count; j++) {
+            if (strcmp(entries[j].bucket, expected[i].bucket) == 0) recorded = entries[j].bytes;
+        }
+        CHECK(recorded == expected[i].bytes, "%s: %s/%s is %llu per du, ledger has %llu", step, gProfiles[profile],
+              expected[i].bucket, (unsigned long long)expected[i].bytes, (unsigned long long)recorded);
+    }
+    for (size_t j = 0; j < count; j++) {
+        bool listed = false;
+        for (size_t i = 0; i < expectedCount; i++) listed |= strcmp(entries[j].bucket, expected[i].bucket) == 0;
+        CHECK(listed || (skipTopLevel && strcmp(entries[j].bucket, kDiskUsageTopLevelBucket) == 0),
+              "%s: %s/%s has %llu bytes in the ledger but none on disk", step, gProfiles[profile], entries[j].bucket,
+              (unsigned long long)entries[j].bytes);
+    }
+}
+
+static void compareAll(DiskUsageLedger *ledger, const char *step) {
+    size_t live = 0;
+    uint64_t total = 0;
+    for (int p = 0; p < kMaxProfiles; p++) {
+        if (!gExists[p]) continue;
+        live++;
+        uint64_t bytes = 0;
+        if (DiskUsageLedgerGet(ledger, gProfiles[p], &bytes, NULL, NULL, NULL)) total += bytes;
+        if (!gDirty[p]) compareProfile(ledger, p, false, step);
+    }
+    CHECK(DiskUsageLedgerCount(ledger) >= live, "%s: ledger lists %zu profiles, %zu exist", step,
+          DiskUsageLedgerCount(ledger), live);
+    CHECK(DiskUsageLedgerTotalBytes(ledger) >= total, "%s: running total %llu below the records' %llu", step,
+          (unsigned long long)DiskUsageLedgerTotalBytes(ledger), (unsigned long long)total);
+}
+
+// ---- Daemon flows ----
+
+// Collected in a manifest's shape, then fed in shuffled order like an
+// NSDictionary enumeration; every manifest entry carries its inode.
+typedef struct {
+    char relative[256];
+    uint64_t inode;
+    uint64_t size;
+} ManifestFile;
+
+static ManifestFile gManifest[4096];
+static size_t gManifestCount;
+static size_t gManifestRootLength;
+
+static int collectManifest(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void)ftw;
+    if (type != FTW_F || !S_ISREG(st->st_mode) || gManifestCount == 4096) return 0;
+    ManifestFile *file = &gManifest[gManifestCount++];
+    snprintf(file->relative, sizeof(file->relative), "%s", path + gManifestRootLength + 1);
+    file->inode = (uint64_t)st->st_ino;
+    file->size = (uint64_t)st->st_size;
+    return 0;
+}
+
+// ContentStore's ingest ending in setUsageFromManifest.
+static void ingest(DiskUsageLedger *ledger, int profile) {
+    char dir[512];
+    profilePath(profile, dir, sizeof(dir));
+    gManifestCount = 0;
+    gManifestRootLength = strlen(dir);
+    nftw(dir, collectManifest, 16, FTW_PHYS);
+    for (size_t i = gManifestCount; i > 1; i--) {
+        size_t j = randomBelow((unsigned)i);
+        ManifestFile swap = gManifest[i - 1];
+        gManifest[i - 1] = gManifest[j];
+        gManifest[j] = swap;
+    }
+    DiskUsageTally *tally = DiskUsageTallyCreate();
+    for (size_t i = 0; i < gManifestCount; i++) {
+        DiskUsageTallyAddFile(tally, gManifest[i].relative, gManifest[i].inode, gManifest[i].size);
+    }
+    uint64_t archived = 0;
+    DiskUsageLedgerGet(ledger, gProfiles[profile], NULL, &archived, NULL, NULL);
+    CHECK(DiskUsageLedgerStoreTally(ledger, gProfiles[profile], tally, archived) >= 0, "ingest store failed");
+    // Storing the same tally again is a no-op.
+    CHECK(DiskUsageLedgerStoreTally(ledger, gProfiles[profile], tally, archived) == 0, "repeated store reported a change");
+    DiskUsageTallyFree(tally);
+    gDirty[profile] = false;
+}
+
+// DiskUsageIndex scanBundles:ofProfile:.
+static void scanBundles(DiskUsageLedger *ledger, int profile, const char *const *bundles, size_t count) {
+    char dir[512];
+    profilePath(profile, dir, sizeof(dir));
+    DiskUsageTally *tally = DiskUsageTallyCreate();
+    CHECK(DiskUsageScanTree(dir, bundles, count, tally, NULL, NULL), "scan of %s stopped", dir);
+    int stored = bundles ? DiskUsageLedgerStoreBuckets(ledger, gProfiles[profile], tally, bundles, count)
+                         : DiskUsageLedgerStoreTally(ledger, gProfiles[profile], tally, 0);
+    CHECK(stored >= 0, "scan store failed");
+    DiskUsageTallyFree(tally);
+}
+
+// Idle work after a profile goes cold: BackupRules pruning, then ContentStore
+// dedupe and ingest. A job arriving first leaves the profile for the reconcile.
+static void coldWork(DiskUsageLedger *ledger, int profile) {
+    if (randomBelow(4) == 0) {
+        gDirty[profile] = true;
+        return;
+    }
+    char dir[512];
+    profilePath(profile, dir, sizeof(dir));
+    for (int b = 0; b < kBundles; b++) {
+        char caches[600];
+        snprintf(caches, sizeof(caches), "%s/%s/Library/Caches", dir, kBundleIds[b]);
+        if (randomBelow(2)) removeTree(caches);
+    }
+    // Dedupe: link a file to a second name in its bucket and into another profile.
+    gManifestCount = 0;
+    gManifestRootLength = strlen(dir);
+    nftw(dir, collectManifest, 16, FTW_PHYS);
+    if (gManifestCount > 0) {
+        ManifestFile *file = &gManifest[randomBelow((unsigned)gManifestCount)];
+        char from[600], to[700];
+        snprintf(from, sizeof(from), "%s/%s", dir, file->relative);
+        if (strchr(file->relative, '/')) {
+            snprintf(to, sizeof(to), "%s.dup%u", from, randomBelow(1000));
+            if (link(from, to) != 0 && errno != EEXIST) CHECK(false, "link %s failed", to);
+        }
+        int other = (int)randomBelow(kMaxProfiles);
+        if (other != profile && gExists[other]) {
+            char otherDir[512];
+            profilePath(other, otherDir, sizeof(otherDir));
+            snprintf(to, sizeof(to), "%s/%s", otherDir, file->relative);
+            char parent[700];
+            snprintf(parent, sizeof(parent), "%s", to);
+            *strrchr(parent, '/') = '\0';
+            makeDirs(parent);
+            unlink(to);
+            if (link(from, to) == 0 && !gDirty[other]) ingest(ledger, other);
+        }
+    }
+    ingest(ledger, profile);
+}
+
+static int createProfile(void) {
+    for (int p = 0; p < kMaxProfiles; p++) {
+        if (gExists[p]) continue;
+        snprintf(gProfiles[p], sizeof(gProfiles[p]), "P%04d", gNextId++);
+        char dir[512];
+        profilePath(p, dir, sizeof(dir));
+        makeDirs(dir);
+        gExists[p] = true;
+        gDirty[p] = false;
+        return p;
+    }
+    return -1;
+}
+
+// Saves bundle's container into profile, replacing what it held there.
+static void saveContainer(int profile, int bundle) {
+    char dir[512], saved[600], container[512];
+    profilePath(profile, dir, sizeof(dir));
+    snprintf(saved, sizeof(saved), "%s/%s", dir, kBundleIds[bundle]);
+    containerPath(bundle, container, sizeof(container));
+    removeTree(saved);
+    rename(container, saved);
+}
+
+static void newPhone(DiskUsageLedger *ledger) {
+    int old = gActive;
+    int fresh = createProfile();
+    if (fresh < 0) return;
+    char dir[512], path[600];
+    if (old >= 0) {
+        profilePath(old, dir, sizeof(dir));
+        for (int b = 0; b < kScoped; b++) {
+            saveContainer(old, b);
+            char container[512];
+            containerPath(b, container, sizeof(container));
+            fillTree(container, randomBelow(12));
+        }
+        snprintf(path, sizeof(path), "%s/keychain.db", dir);
+        writeFile(path, 4096 + randomBelow(50000));
+        snprintf(path, sizeof(path), "%s/phoneInfo.json", dir);
+        writeFile(path, 900 + randomBelow(200));
+    }
+    profilePath(fresh, dir, sizeof(dir));
+    snprintf(path, sizeof(path), "%s/phoneInfo.json", dir);
+    writeFile(path, 900 + randomBelow(200));
+    gActive = fresh;
+    scanBundles(ledger, fresh, NULL, 0);
+    compareProfile(ledger, fresh, false, "newPhone");
+    if (old >= 0) coldWork(ledger, old);
+}
+
+static void switchBackup(DiskUsageLedger *ledger) {
+    int target = (int)randomBelow(kMaxProfiles);
+    if (!gExists[target] || target == gActive || gActive < 0) return;
+    int from = gActive;
+    char targetDir[512], fromDir[512], path[600];
+    profilePath(target, targetDir, sizeof(targetDir));
+    profilePath(from, fromDir, sizeof(fromDir));
+    const char *scoped[kScoped];
+    for (int b = 0; b < kScoped; b++) {
+        scoped[b] = kBundleIds[b];
+        saveContainer(from, b);
+        // The target keeps its copy; the container gets a clone.
+        char container[512];
+        containerPath(b, container, sizeof(container));
+        snprintf(path, sizeof(path), "%s/%s", targetDir, kBundleIds[b]);
+        struct stat st;
+        if (stat(path, &st) == 0) copyTree(path, container);
+        else makeDirs(container);
+    }
+    snprintf(path, sizeof(path), "%s/keychain.db", fromDir);
+    writeFile(path, 4096 + randomBelow(50000));
+    gActive = target;
+
+    // Idle: the saved bundles of the from profile; keychain.db waits for the ingest.
+    scanBundles(ledger, from, scoped, kScoped);
+    if (!gDirty[from]) compareProfile(ledger, from, true, "switchBackup(from)");
+    if (!gDirty[target]) compareProfile(ledger, target, false, "switchBackup(target)");
+    coldWork(ledger, from);
+}
+
+static void removeProfile(DiskUsageLedger *ledger) {
+    int p = (int)randomBelow(kMaxProfiles);
+    if (!gExists[p] || p == gActive) return;
+    char dir[512];
+    profilePath(p, dir, sizeof(dir));
+    removeTree(dir);
+    gExists[p] = false;
+    // A removal the index missed is left for the reconcile's cleanup.
+    if (randomBelow(4)) DiskUsageLedgerDrop(ledger, gProfiles[p]);
+}
+
+static void drift(void) {
+    int p = (int)randomBelow(kMaxProfiles);
+    if (!gExists[p]) return;
+    char dir[512], bundle[600];
+    profilePath(p, dir, sizeof(dir));
+    snprintf(bundle, sizeof(bundle), "%s/%s", dir, kBundleIds[randomBelow(kBundles)]);
+    fillTree(bundle, 1 + randomBelow(4));
+    gDirty[p] = true;
+}
+
+static bool stopAfterFirstPoll(void *context) {
+    (*(int *)context)++;
+    return true;
+}
+
+static void reconcile(DiskUsageLedger *ledger) {
+    for (int p = 0; p < kMaxProfiles; p++) {
+        if (!gExists[p]) continue;
+        char dir[512];
+        profilePath(p, dir, sizeof(dir));
+        DiskUsageTally *tally = DiskUsageTallyCreate();
+        CHECK(DiskUsageScanTree(dir, NULL, 0, tally, NULL, NULL), "reconcile scan of %s stopped", dir);
+        CHECK(DiskUsageLedgerStoreTally(ledger, gProfiles[p], tally, 0) >= 0, "reconcile store failed");
+        DiskUsageTallyFree(tally);
+        gDirty[p] = false;
+    }
+    // Cleanup of records for profiles that no longer exist.
+    for (size_t i = 0; i < DiskUsageLedgerCount(ledger);) {
+        const char *id = DiskUsageLedgerProfileAt(ledger, i);
+        bool live = false;
+        for (int p = 0; p < kMaxProfiles; p++) live |= gExists[p] && strcmp(gProfiles[p], id) == 0;
+        if (live) i++;
+        else DiskUsageLedgerDrop(ledger, id);
+    }
+    uint64_t total = 0;
+    size_t live = 0;
+    for (int p = 0; p < kMaxProfiles; p++) {
+        uint64_t bytes = 0;
+        if (gExists[p] && DiskUsageLedgerGet(ledger, gProfiles[p], &bytes, NULL, NULL, NULL)) total += bytes, live++;
+    }
+    CHECK(DiskUsageLedgerCount(ledger) == live, "reconcile left %zu records for %zu profiles",
+          DiskUsageLedgerCount(ledger), live);
+    CHECK(DiskUsageLedgerTotalBytes(ledger) == total, "running total %llu, records sum to %llu",
+          (unsigned long long)DiskUsageLedgerTotalBytes(ledger), (unsigned long long)total);
+}
+
+// ---- Fixed cases ----
+
+static void fixedCases(void) {
+    size_t length = 0;
+    const char *bucket = DiskUsageBucket("com.a/Documents/x", &length);
+    CHECK(length == 5 && strncmp(bucket, "com.a", length) == 0, "bucket of a nested path");
+    bucket = DiskUsageBucket("phoneInfo.json", &length);
+    CHECK(strcmp(bucket, kDiskUsageTopLevelBucket) == 0 && length == 1, "bucket of a top-level file");
+
+    DiskUsageLedger *ledger = DiskUsageLedgerCreate();
+    DiskUsageTally *tally = DiskUsageTallyCreate();
+    DiskUsageTallyAddFile(tally, "a/x", 7, 100);
+    DiskUsageTallyAddFile(tally, "a/y", 7, 100); // hard link
+    DiskUsageTallyAddFile(tally, "b/z", 0, 0);
+    DiskUsageTallyAddFile(tally, "top", 0, 5);
+    CHECK(DiskUsageLedgerStoreTally(ledger, "p1", tally, 42) == 1, "first store is a change");
+    uint64_t bytes = 0, archived = 0;
+    size_t count = 0;
+    DiskUsageLedgerGet(ledger, "p1", &bytes, &archived, NULL, &count);
+    CHECK(bytes == 105 && archived == 42 && count == 2, "p1: %llu bytes, %llu archived, %zu buckets",
+          (unsigned long long)bytes, (unsigned long long)archived, count);
+
+    // An empty tally still creates the record: a new, empty profile is 0, not unknown.
+    DiskUsageTally *empty = DiskUsageTallyCreate();
+    CHECK(DiskUsageLedgerStoreTally(ledger, "p0", empty, 0) == 1, "empty store of a new profile is a change");
+    CHECK(DiskUsageLedgerGet(ledger, "p0", &bytes, NULL, NULL, NULL) && bytes == 0, "empty profile recorded");
+
+    // Named buckets only; "top" and the other bundles are kept.
+    DiskUsageTally *bundles = DiskUsageTallyCreate();
+    DiskUsageTallyAddFile(bundles, "c/new", 0, 30);
+    const char *const named[] = { "a", "c" };
+    CHECK(DiskUsageLedgerStoreBuckets(ledger, "p1", bundles, named, 2) == 1, "bucket store is a change");
+    DiskUsageLedgerGet(ledger, "p1", &bytes, &archived, NULL, &count);
+    CHECK(bytes == 35 && archived == 42 && count == 2, "p1 after bucket store: %llu bytes, %zu buckets",
+          (unsigned long long)bytes, count);
+    CHECK(DiskUsageLedgerTotalBytes(ledger) == 35 && DiskUsageLedgerTotalArchivedBytes(ledger) == 42, "totals");
+    DiskUsageLedgerSetArchivedBytes(ledger, "p1", 0);
+    DiskUsageLedgerDrop(ledger, "p1");
+    DiskUsageLedgerDrop(ledger, "missing");
+    CHECK(DiskUsageLedgerCount(ledger) == 1 && DiskUsageLedgerTotalBytes(ledger) == 0 &&
+          DiskUsageLedgerTotalArchivedBytes(ledger) == 0, "totals after drop");
+    DiskUsageTallyFree(bundles);
+    DiskUsageTallyFree(empty);
+    DiskUsageTallyFree(tally);
+    DiskUsageLedgerFree(ledger);
+
+    // shouldStop is polled while walking and abandons the scan.
+    char dir[512];
+    snprintf(dir, sizeof(dir), "%s/many/com.a", gRoot);
+    makeDirs(dir);
+    for (int i = 0; i < 600; i++) {
+        char path[600];
+        snprintf(path, sizeof(path), "%s/f%d", dir, i);
+        writeFile(path, 1);
+    }
+    snprintf(dir, sizeof(dir), "%s/many", gRoot);
+    int polls = 0;
+    tally = DiskUsageTallyCreate();
+    CHECK(!DiskUsageScanTree(dir, NULL, 0, tally, stopAfterFirstPoll, &polls) && polls == 1, "scan ignored shouldStop");
+    DiskUsageTallyFree(tally);
+    removeTree(dir);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long long seeds[] = { 1, 2, 3, 0x5eed, 20261019 };
+    size_t seedCount = sizeof(seeds) / sizeof(seeds[0]);
+    unsigned steps = 60;
+    if (argc > 1) {
+        seeds[0] = strtoull(argv[1], NULL, 0);
+        seedCount = 1;
+    }
+    if (argc > 2) steps = (unsigned)strtoul(argv[2], NULL, 0);
+
+    snprintf(gRoot, sizeof(gRoot), "/tmp/test_disk_usage.XXXXXX");
+    if (!mkdtemp(gRoot)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    fixedCases();
+    for (size_t s = 0; s < seedCount; s++) {
+        gRng = seeds[s] * 0x9E3779B97F4A7C15ULL + 1;
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s/profiles", gRoot);
+        removeTree(dir);
+        snprintf(dir, sizeof(dir), "%s/containers", gRoot);
+        removeTree(dir);
+        memset(gExists, 0, sizeof(gExists));
+        gActive = -1;
+        for (int b = 0; b < kBundles; b++) {
+            containerPath(b, dir, sizeof(dir));
+            fillTree(dir, randomBelow(12));
+        }
+        DiskUsageLedger *ledger = DiskUsageLedgerCreate();
+        for (unsigned step = 0; step < steps; step++) {
+            switch (randomBelow(10)) {
+            case 0: case 1: case 2: newPhone(ledger); break;
+            case 3: case 4: case 5: switchBackup(ledger); break;
+            case 6: removeProfile(ledger); break;
+            case 7: drift(); break;
+            case 8: if (gActive >= 0) coldWork(ledger, gActive); break;
+            default: reconcile(ledger); break;
+            }
+            compareAll(ledger, "step");
+        }
+        reconcile(ledger);
+        compareAll(ledger, "final reconcile");
+        DiskUsageLedgerFree(ledger);
+    }
+    removeTree(gRoot);
+    if (gFailures) {
+        fprintf(stderr, "test_disk_usage: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_disk_usage: %zu seeds x %u steps, %d checks passed\n", seedCount, steps, gChecks);
+    return 0;
+}
@@ -0,0 +1,321 @@
+// Checks daemon/FileRemoverCore.m, the walk behind removeItemTree: wide
+// directories of several thousand entries, deep nesting, symlinks that must
+// not be followed, directories without search permission, and the listing the
+// walk takes of each directory before unlinking anything in it. Then times the
+// walk against `rm -rf` on identical trees (informational, never fails).
+//
+//   make -C bench test                    all checks plus the timing
+//   build/test_file_remover FILES DIRS    timing tree of DIRS x FILES
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FileRemoverCore.h"
+
+static char gRoot[64];
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_file_remover: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+// ---- Tree helpers ----
+
+static void writeFile(const char *path, size_t bytes) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path);
+        exit(2);
+    }
+    char block[256];
+    memset(block, 'x', sizeof(block));
+    while (bytes > 0) {
+        size_t n = bytes < sizeof(block) ? bytes : sizeof(block);
+        if (write(fd, block, n) != (ssize_t)n) {
+            perror(path);
+            exit(2);
+        }
+        bytes -= n;
+    }
+    close(fd);
+}
+
+static void makeDir(const char *path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        perror(path);
+        exit(2);
+    }
+}
+
+// dirs subdirectories of files files each, plus files files at the top.
+static size_t buildWideTree(const char *root, unsigned dirs, unsigned files) {
+    char path[512];
+    size_t entries = 0;
+    makeDir(root);
+    for (unsigned f = 0; f < files; f++) {
+        snprintf(path, sizeof(path), "%s/file-%05u.dat", root, f);
+        writeFile(path, f % 7 == 0 ? 300 : 0);
+        entries++;
+    }
+    for (unsigned d = 0; d < dirs; d++) {
+        snprintf(path, sizeof(path), "%s/dir-%04u", root, d);
+        makeDir(path);
+        entries++;
+        for (unsigned f = 0; f < files; f++) {
+            snprintf(path, sizeof(path), "%s/dir-%04u/f%05u", root, d, f);
+            writeFile(path, 0);
+            entries++;
+        }
+    }
+    return entries;
+}
+
+static bool exists(const char *path) {
+    struct stat st;
+    return lstat(path, &st) == 0;
+}
+
+typedef struct {
+    int count;
+    int lastErr;
+    char lastPath[1024];
+} Reports;
+
+static void collectReport(const char *path, int err, void *context) {
+    Reports *reports = context;
+    reports->count++;
+    reports->lastErr = err;
+    snprintf(reports->lastPath, sizeof(reports->lastPath), "%s", path);
+}
+
+// Removes root/name through the core; returns the failure count.
+static size_t removeUnder(const char *root, const char *name, Reports *reports) {
+    FileRemoverContext ctx = { .onError = reports ? collectReport : NULL, .context = reports, .rootPath = root };
+    atomic_init(&ctx.failures, 0);
+    int fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(root);
+        exit(2);
+    }
+    FileRemoverRemoveDirectoryAt(&ctx, fd, name);
+    close(fd);
+    return atomic_load(&ctx.failures);
+}
+
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+// ---- Listing ----
+
+static void listingCases(void) {
+    char dir[256], path[512];
+    snprintf(dir, sizeof(dir), "%s/listing", gRoot);
+    buildWideTree(dir, 40, 100);
+    size_t topLevel = 40 + 100;
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    FileRemoverListing listing;
+    CHECK(FileRemoverReadListing(fd, &listing) == 0, "listing %s failed", dir);
+    size_t files = 0, dirs = 0;
+    const char *cursor = NULL, *name;
+    bool isDirectory;
+    while (FileRemoverListingNext(&listing, &cursor, &name, &isDirectory)) {
+        CHECK(strcmp(name, ".") != 0 && strcmp(name, "..") != 0, "listing returned %s", name);
+        bool expectDirectory = strncmp(name, "dir-", 4) == 0;
+        CHECK(isDirectory == expectDirectory, "%s listed as %s", name, isDirectory ? "directory" : "file");
+        if (isDirectory) dirs++;
+        else files++;
+    }
+    CHECK(files + dirs == topLevel, "listed %zu of %zu entries", files + dirs, topLevel);
+    CHECK(dirs == 40, "listed %zu of 40 directories", dirs);
+
+    // Unlinking everything after the listing was taken: every name is still
+    // visited, whatever the directory stream would have done.
+    cursor = NULL;
+    size_t removed = 0;
+    while (FileRemoverListingNext(&listing, &cursor, &name, &isDirectory)) {
+        if (!isDirectory && unlinkat(fd, name, 0) == 0) removed++;
+    }
+    CHECK(removed == files, "unlinked %zu of %zu listed files", removed, files);
+    FileRemoverListingFree(&listing);
+
+    // The fd's own stream position is untouched; a second listing sees what is left.
+    CHECK(FileRemoverReadListing(fd, &listing) == 0, "second listing failed");
+    size_t left = 0;
+    cursor = NULL;
+    while (FileRemoverListingNext(&listing, &cursor, &name, &isDirectory)) left++;
+    CHECK(left == dirs, "second listing has %zu entries, expected %zu", left, dirs);
+    FileRemoverListingFree(&listing);
+    close(fd);
+
+    // An empty directory lists as nothing.
+    snprintf(path, sizeof(path), "%s/empty", gRoot);
+    makeDir(path);
+    fd = open(path, O_RDONLY | O_DIRECTORY);
+    CHECK(FileRemoverReadListing(fd, &listing) == 0, "empty listing failed");
+    cursor = NULL;
+    CHECK(!FileRemoverListingNext(&listing, &cursor, &name, &isDirectory), "empty directory listed an entry");
+    FileRemoverListingFree(&listing);
+    close(fd);
+    rmdir(path);
+
+    CHECK(removeUnder(gRoot, "listing", NULL) == 0, "removing the listing tree failed");
+    CHECK(!exists(dir), "%s still exists", dir);
+}
+
+// ---- Removal ----
+
+static void removalCases(void) {
+    char dir[256], path[1024];
+    Reports reports;
+
+    // Several thousand entries in one directory, and in subdirectories.
+    snprintf(dir, sizeof(dir), "%s/wide", gRoot);
+    buildWideTree(dir, 50, 120);
+    snprintf(path, sizeof(path), "%s/wide/bulk", gRoot);
+    buildWideTree(path, 0, 6000);
+    memset(&reports, 0, sizeof(reports));
+    CHECK(removeUnder(gRoot, "wide", &reports) == 0, "wide: %d failures, last %s: %s", reports.count,
+          reports.lastPath, strerror(reports.lastErr));
+    CHECK(!exists(dir), "wide: %s still exists", dir);
+
+    // Deeper than the initial frame stack.
+    snprintf(dir, sizeof(dir), "%s/deep", gRoot);
+    makeDir(dir);
+    size_t length = (size_t)snprintf(path, sizeof(path), "%s", dir);
+    for (int level = 0; level < 200 && length + 8 < sizeof(path); level++) {
+        length += (size_t)snprintf(path + length, sizeof(path) - length, "/d%d", level % 10);
+        makeDir(path);
+        char file[1100];
+        snprintf(file, sizeof(file), "%s/f", path);
+        writeFile(file, 10);
+    }
+    memset(&reports, 0, sizeof(reports));
+    CHECK(removeUnder(gRoot, "deep", &reports) == 0, "deep: %d failures, last %s: %s", reports.count,
+          reports.lastPath, strerror(reports.lastErr));
+    CHECK(!exists(dir), "deep: %s still exists", dir);
+
+    // Symlinks are removed, never followed.
+    char outside[256], outsideFile[300];
+    snprintf(outside, sizeof(outside), "%s/outside", gRoot);
+    makeDir(outside);
+    snprintf(outsideFile, sizeof(outsideFile), "%s/keep", outside);
+    writeFile(outsideFile, 42);
+    snprintf(dir, sizeof(dir), "%s/links", gRoot);
+    makeDir(dir);
+    snprintf(path, sizeof(path), "%s/to-dir", dir);
+    CHECK(symlink(outside, path) == 0, "symlink %s", path);
+    snprintf(path, sizeof(path), "%s/to-file", dir);
+    CHECK(symlink(outsideFile, path) == 0, "symlink %s", path);
+    snprintf(path, sizeof(path), "%s/dangling", dir);
+    CHECK(symlink("/nonexistent/target", path) == 0, "symlink %s", path);
+    CHECK(removeUnder(gRoot, "links", NULL) == 0, "links: removal failed");
+    CHECK(!exists(dir), "links: %s still exists", dir);
+    CHECK(exists(outsideFile), "links: the walk followed a symlink and removed %s", outsideFile);
+
+    // A symlink as the root is not a directory to walk.
+    snprintf(path, sizeof(path), "%s/root-link", gRoot);
+    CHECK(symlink(outside, path) == 0, "symlink %s", path);
+    memset(&reports, 0, sizeof(reports));
+    // O_NOFOLLOW | O_DIRECTORY on a link: ELOOP on Darwin, ENOTDIR on Linux.
+    CHECK(removeUnder(gRoot, "root-link", &reports) == 1 && (reports.lastErr == ELOOP || reports.lastErr == ENOTDIR),
+          "root-link: expected one ELOOP, got %d (%s)", reports.count, strerror(reports.lastErr));
+    CHECK(exists(outsideFile), "root-link: removed through the link");
+    unlink(path);
+
+    // Directories without read or search permission.
+    snprintf(dir, sizeof(dir), "%s/locked", gRoot);
+    buildWideTree(dir, 3, 5);
+    snprintf(path, sizeof(path), "%s/dir-0001", dir);
+    chmod(path, 0);
+    chmod(dir, 0300);
+    CHECK(removeUnder(gRoot, "locked", NULL) == 0, "locked: removal failed");
+    CHECK(!exists(dir), "locked: %s still exists", dir);
+
+    // A missing root is not a failure.
+    memset(&reports, 0, sizeof(reports));
+    CHECK(removeUnder(gRoot, "missing", &reports) == 0 && reports.count == 0, "missing: reported %d", reports.count);
+
+    // A failure is reported with its full path: a file the walk cannot remove
+    // because its directory is read-only (not for root, which ignores that).
+    if (geteuid() != 0) {
+        snprintf(dir, sizeof(dir), "%s/ro", gRoot);
+        makeDir(dir);
+        snprintf(path, sizeof(path), "%s/ro/sub", gRoot);
+        makeDir(path);
+        snprintf(path, sizeof(path), "%s/ro/sub/pinned", gRoot);
+        writeFile(path, 1);
+        snprintf(path, sizeof(path), "%s/ro/sub", gRoot);
+        chmod(path, 0555);
+        memset(&reports, 0, sizeof(reports));
+        size_t failures = removeUnder(gRoot, "ro", &reports);
+        CHECK(failures >= 1 && (size_t)reports.count == failures, "ro: %zu failures, %d reports", failures, reports.count);
+        snprintf(path, sizeof(path), "%s/ro", gRoot);
+        CHECK(strncmp(reports.lastPath, path, strlen(path)) == 0, "ro: reported %s", reports.lastPath);
+        snprintf(path, sizeof(path), "%s/ro/sub", gRoot);
+        chmod(path, 0755);
+        CHECK(removeUnder(gRoot, "ro", NULL) == 0, "ro: second removal failed");
+    }
+
+    removeUnder(gRoot, "outside", NULL);
+}
+
+// ---- Timing against rm -rf ----
+
+static void timing(unsigned dirs, unsigned files) {
+    char a[256], b[256], command[320];
+    snprintf(a, sizeof(a), "%s/time-core", gRoot);
+    snprintf(b, sizeof(b), "%s/time-rm", gRoot);
+    size_t entries = buildWideTree(a, dirs, files);
+    buildWideTree(b, dirs, files);
+    sync();
+
+    double start = nowMs();
+    size_t failures = removeUnder(gRoot, "time-core", NULL);
+    double coreMs = nowMs() - start;
+    CHECK(failures == 0 && !exists(a), "timing tree not removed");
+
+    snprintf(command, sizeof(command), "rm -rf '%s'", b);
+    start = nowMs();
+    int status = system(command);
+    double rmMs = nowMs() - start;
+    CHECK(status == 0 && !exists(b), "rm -rf failed");
+
+    fprintf(stderr, "test_file_remover: %zu entries: walk %.1f ms, rm -rf %.1f ms (includes fork/exec)\n",
+            entries, coreMs, rmMs);
+}
+
+int main(int argc, char *argv[]) {
+    unsigned files = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 0) : 250;
+    unsigned dirs = argc > 2 ? (unsigned)strtoul(argv[2], NULL, 0) : 40;
+
+    snprintf(gRoot, sizeof(gRoot), "/tmp/test_file_remover.XXXXXX");
+    if (!mkdtemp(gRoot)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    listingCases();
+    removalCases();
+    timing(dirs, files);
+    rmdir(gRoot);
+    if (gFailures) {
+        fprintf(stderr, "test_file_remover: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_file_remover: %d checks passed\n", gChecks);
+    return 0;
+}
@@ -0,0 +1,200 @@
+// Checks DaemonJob's state machine and /jobStatus waiters (daemon/JobStateCore.m):
+// cancelling a queued job, the cancel/commit race from both sides, random step
+// sequences against the transition table, and that a parked long-poll is
+// answered exactly once, either by a change or by its timeout.
+//
+//   make -C bench test
+//   build/test_job_state [seed]
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "JobStateCore.h"
+
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_job_state: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+// ---- Cancel ----
+
+static void cancelQueued(void) {
+    JobStatus status = { 0 };
+    CHECK(JobStatusRequestCancel(&status), "queued cancel refused");
+    CHECK(status.state == JobStateCancelled, "queued cancel left state %d", status.state);
+    CHECK(JobStateIsFinished(status.state), "cancelled is not finished");
+    // The worker picks the job up afterwards and must not run it.
+    CHECK(!JobStatusTransition(&status, JobStateRunning), "cancelled job started");
+    CHECK(!JobStatusRequestCancel(&status), "second cancel accepted");
+    CHECK(status.state == JobStateCancelled, "state moved to %d", status.state);
+}
+
+static void cancelRunning(void) {
+    JobStatus status = { 0 };
+    CHECK(JobStatusTransition(&status, JobStateRunning), "start refused");
+    CHECK(JobStatusRequestCancel(&status), "running cancel refused");
+    // Running jobs stop at their next checkpoint; the state changes only then.
+    CHECK(status.state == JobStateRunning && status.cancelled, "running cancel: state %d cancelled %d",
+          status.state, status.cancelled);
+    CHECK(!JobStatusEnterCommit(&status), "commit accepted after cancel");
+    CHECK(!status.committed, "committed after a refused commit");
+    CHECK(JobFinalState(&status, false) == JobStateCancelled, "stopped cancelled job ends as %d",
+          JobFinalState(&status, false));
+    CHECK(JobStatusTransition(&status, JobFinalState(&status, false)), "final transition refused");
+    CHECK(status.state == JobStateCancelled, "ended as %d", status.state);
+}
+
+static void cancelDuringCommit(void) {
+    JobStatus status = { 0 };
+    JobStatusTransition(&status, JobStateRunning);
+    CHECK(JobStatusEnterCommit(&status), "commit refused");
+    CHECK(!JobStatusRequestCancel(&status), "cancel accepted during commit");
+    CHECK(!status.cancelled, "cancelled flag set during commit");
+    CHECK(JobFinalState(&status, true) == JobStateSucceeded, "committed job did not succeed");
+    CHECK(JobFinalState(&status, false) == JobStateFailed, "committed failure reported as %d",
+          JobFinalState(&status, false));
+}
+
+static void finishedIsTerminal(void) {
+    static const JobState kFinished[] = { JobStateSucceeded, JobStateFailed, JobStateCancelled };
+    static const JobState kAll[] = { JobStateQueued, JobStateRunning, JobStateSucceeded, JobStateFailed,
+                                     JobStateCancelled };
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 5; j++) {
+            CHECK(!JobCanTransition(kFinished[i], kAll[j]), "%d -> %d allowed", kFinished[i], kAll[j]);
+        }
+        JobStatus status = { .state = kFinished[i] };
+        CHECK(!JobStatusRequestCancel(&status), "cancel accepted in %d", kFinished[i]);
+    }
+    CHECK(!JobCanTransition(JobStateQueued, JobStateSucceeded), "queued -> succeeded allowed");
+    CHECK(!JobCanTransition(JobStateQueued, JobStateFailed), "queued -> failed allowed");
+    CHECK(!JobCanTransition(JobStateRunning, JobStateQueued), "running -> queued allowed");
+}
+
+// ---- Simulated steps ----
+
+// Random calls in random order, as the worker, the HTTP cancel handler and
+// progress reports would interleave them. Checks the invariants after each.
+static void simulatedSteps(unsigned seed) {
+    srand(seed);
+    for (int run = 0; run < 20000; run++) {
+        JobStatus status = { 0 };
+        JobState finishedAs = JobStateQueued;
+        bool everCancelled = false, everCommitted = false;
+        for (int step = 0; step < 12; step++) {
+            uint64_t seq = status.seq;
+            JobState before = status.state;
+            bool wasCommitted = status.committed, wasCancelled = status.cancelled;
+            bool applied = true;
+            switch (rand() % 5) {
+                case 0: applied = JobStatusTransition(&status, JobStateRunning); break;
+                case 1: applied = JobStatusRequestCancel(&status); break;
+                case 2: applied = JobStatusEnterCommit(&status); break;
+                case 3: JobStatusTouch(&status); break;
+                default:
+                    // The worker only finishes a job it started.
+                    if (status.state != JobStateRunning) {
+                        applied = false;
+                        break;
+                    }
+                    applied = JobStatusTransition(&status, JobFinalState(&status, rand() % 2));
+                    break;
+            }
+            CHECK(status.seq == seq + 1 || (status.seq == seq && !applied), "run %d step %d: seq %llu -> %llu",
+                  run, step, (unsigned long long)seq, (unsigned long long)status.seq);
+            CHECK(before == status.state || JobCanTransition(before, status.state),
+                  "run %d step %d: illegal %d -> %d", run, step, before, status.state);
+            CHECK(!(status.cancelled && status.committed), "run %d step %d: both cancelled and committed", run, step);
+            CHECK(!wasCommitted || status.committed, "run %d step %d: commit undone", run, step);
+            CHECK(!wasCancelled || status.cancelled, "run %d step %d: cancel undone", run, step);
+            if (finishedAs != JobStateQueued) {
+                CHECK(status.state == finishedAs, "run %d step %d: left finished state %d for %d", run, step,
+                      finishedAs, status.state);
+            } else if (JobStateIsFinished(status.state)) {
+                finishedAs = status.state;
+            }
+            everCancelled |= status.cancelled;
+            everCommitted |= status.committed;
+        }
+        if (finishedAs == JobStateCancelled) CHECK(everCancelled && !everCommitted, "run %d: cancelled without a cancel", run);
+        // A job whose work finished before its next checkpoint still succeeds, cancel or not.
+        if (finishedAs == JobStateFailed) CHECK(!everCancelled || everCommitted, "run %d: cancel reported as failure", run);
+    }
+}
+
+// ---- Waiters ----
+
+static void waiters(void) {
+    JobStatus status = { 0 };
+    JobWaiterList list = { 0 };
+    uint64_t tokens[64];
+
+    // Nothing changes: nothing is answered, the timeout removes the waiter once.
+    CHECK(JobWaitersAdd(&list, status.seq, 1), "add failed");
+    CHECK(JobWaitersTakeReady(&list, &status, tokens) == 0, "unchanged job answered a waiter");
+    CHECK(JobWaitersRemove(&list, 1), "timeout did not find its waiter");
+    CHECK(!JobWaitersRemove(&list, 1), "waiter removed twice");
+    CHECK(list.count == 0, "list not empty: %zu", list.count);
+
+    // A waiter asking for an older seq is ready at once.
+    JobStatusTransition(&status, JobStateRunning);
+    JobWaiter stale = { 0, 2 };
+    CHECK(JobWaiterReady(&stale, &status), "stale since not ready");
+
+    // A change answers every parked waiter, oldest first, and only once.
+    for (uint64_t token = 10; token < 40; token++) CHECK(JobWaitersAdd(&list, status.seq, token), "add %llu", (unsigned long long)token);
+    JobStatusTouch(&status);
+    size_t taken = JobWaitersTakeReady(&list, &status, tokens);
+    CHECK(taken == 30, "took %zu of 30", taken);
+    for (size_t i = 0; i < taken; i++) CHECK(tokens[i] == 10 + i, "order: token %llu at %zu", (unsigned long long)tokens[i], i);
+    CHECK(list.count == 0, "answered waiters kept: %zu", list.count);
+    CHECK(!JobWaitersRemove(&list, 10), "timeout found an answered waiter");
+    CHECK(JobWaitersTakeReady(&list, &status, tokens) == 0, "answered twice");
+
+    // Only the waiters behind the new seq are answered; the rest stay parked.
+    JobWaitersAdd(&list, status.seq - 1, 50);
+    JobWaitersAdd(&list, status.seq, 51);
+    JobWaitersAdd(&list, status.seq - 1, 52);
+    taken = JobWaitersTakeReady(&list, &status, tokens);
+    CHECK(taken == 2 && tokens[0] == 50 && tokens[1] == 52, "partial take: %zu", taken);
+    CHECK(list.count == 1 && list.items[0].token == 51, "partial take kept %zu", list.count);
+
+    // Finishing answers a waiter even if it asked for a seq from the future.
+    JobWaitersAdd(&list, status.seq + 100, 60);
+    JobStatusTransition(&status, JobStateSucceeded);
+    taken = JobWaitersTakeReady(&list, &status, tokens);
+    CHECK(taken == 2, "finish answered %zu of 2", taken);
+    CHECK(list.count == 0, "finish kept %zu", list.count);
+    JobWaiter late = { status.seq + 5, 70 };
+    CHECK(JobWaiterReady(&late, &status), "waiter on a finished job not ready");
+
+    // Remove from the middle keeps the others in order.
+    for (uint64_t token = 80; token < 85; token++) JobWaitersAdd(&list, UINT64_MAX, token);
+    CHECK(JobWaitersRemove(&list, 82), "middle remove failed");
+    CHECK(list.count == 4 && list.items[0].token == 80 && list.items[1].token == 81 &&
+          list.items[2].token == 83 && list.items[3].token == 84, "middle remove reordered");
+    JobWaitersFree(&list);
+    CHECK(list.items == NULL && list.count == 0 && list.capacity == 0, "free left state");
+}
+
+int main(int argc, char *argv[]) {
+    unsigned seed = argc > 1 ? (unsigned)strtoul(argv[1], NULL, 10) : 1;
+    cancelQueued();
+    cancelRunning();
+    cancelDuringCommit();
+    finishedIsTerminal();
+    simulatedSteps(seed);
+    waiters();
+    if (gFailures) {
+        fprintf(stderr, "test_job_state: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_job_state: %d checks passed\n", gChecks);
+    return 0;
+}
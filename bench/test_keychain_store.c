@@ -0,0 +1,461 @@
+// Checks KeychainStore's SQL (daemon/KeychainStoreCore.m) on a synthetic
+// database shaped like keychain-2.db: genp/cert/keys/inet with AUTOINCREMENT
+// rowids, encrypted-blob-sized data, WAL and incremental auto_vacuum. A reset
+// keeps the system rows and wipes the app rows, a snapshot round-trips them,
+// snapshots from an older or newer schema still apply, and a snapshot that
+// cannot apply still wipes. Then times a profile switch the old way (separate
+// DELETEs plus a full VACUUM) against the snapshot + single-transaction reset,
+// with the idle incremental vacuum timed separately (informational).
+//
+//   make -C bench test
+//   build/test_keychain_store ITEMS    timing keychain of ITEMS genp items
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "KeychainStoreCore.h"
+
+static char gRoot[64];
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_keychain_store: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+// ---- Synthetic keychain ----
+
+// The columns securityd matches and indexes on, plus the encrypted data blob;
+// the real tables carry a few more of the same kinds.
+static const char kSchema[] =
+    "PRAGMA auto_vacuum = INCREMENTAL;"
+    "PRAGMA journal_mode = WAL;"
+    "CREATE TABLE genp (rowid INTEGER PRIMARY KEY AUTOINCREMENT, cdat REAL, mdat REAL, desc BLOB, icmt BLOB,"
+    " crtr INTEGER, type INTEGER, scrp INTEGER, labl BLOB, alis BLOB, invi INTEGER, nega INTEGER, cusi INTEGER,"
+    " prot BLOB, acct BLOB NOT NULL DEFAULT '', svce BLOB NOT NULL DEFAULT '', gena BLOB, data BLOB,"
+    " agrp TEXT NOT NULL, pdmn TEXT, sync INTEGER NOT NULL DEFAULT 0, tomb INTEGER NOT NULL DEFAULT 0, sha1 BLOB,"
+    " vwht TEXT, tkid TEXT, musr BLOB NOT NULL DEFAULT '', UUID TEXT, persistref BLOB NOT NULL DEFAULT '',"
+    " UNIQUE(acct, svce, agrp, sync, vwht, tkid, musr));"
+    "CREATE INDEX genpagrp ON genp(agrp);"
+    "CREATE TABLE cert (rowid INTEGER PRIMARY KEY AUTOINCREMENT, cdat REAL, mdat REAL, ctyp INTEGER NOT NULL DEFAULT 0,"
+    " cenc INTEGER, labl BLOB, alis BLOB, subj BLOB, issr BLOB NOT NULL DEFAULT '', slnr BLOB NOT NULL DEFAULT '',"
+    " skid BLOB, pkhh BLOB, data BLOB, agrp TEXT NOT NULL, pdmn TEXT, sync INTEGER NOT NULL DEFAULT 0,"
+    " tomb INTEGER NOT NULL DEFAULT 0, sha1 BLOB, musr BLOB NOT NULL DEFAULT '', UUID TEXT,"
+    " UNIQUE(ctyp, issr, slnr, agrp, sync, musr));"
+    "CREATE INDEX certagrp ON cert(agrp);"
+    "CREATE TABLE keys (rowid INTEGER PRIMARY KEY AUTOINCREMENT, cdat REAL, mdat REAL, kcls INTEGER NOT NULL DEFAULT 0,"
+    " labl BLOB, alis BLOB, perm INTEGER, priv INTEGER, modi INTEGER, klbl BLOB NOT NULL DEFAULT '',"
+    " atag BLOB NOT NULL DEFAULT '', crtr INTEGER NOT NULL DEFAULT 0, type INTEGER NOT NULL DEFAULT 0,"
+    " bsiz INTEGER NOT NULL DEFAULT 0, esiz INTEGER NOT NULL DEFAULT 0, data BLOB, agrp TEXT NOT NULL, pdmn TEXT,"
+    " sync INTEGER NOT NULL DEFAULT 0, tomb INTEGER NOT NULL DEFAULT 0, sha1 BLOB, musr BLOB NOT NULL DEFAULT '',"
+    " UUID TEXT, UNIQUE(kcls, klbl, atag, crtr, type, bsiz, esiz, agrp, sync, musr));"
+    "CREATE INDEX keysagrp ON keys(agrp);"
+    "CREATE TABLE inet (rowid INTEGER PRIMARY KEY AUTOINCREMENT, cdat REAL, mdat REAL, labl BLOB,"
+    " acct BLOB NOT NULL DEFAULT '', sdmn BLOB NOT NULL DEFAULT '', srvr BLOB NOT NULL DEFAULT '',"
+    " ptcl INTEGER NOT NULL DEFAULT 0, port INTEGER NOT NULL DEFAULT 0, path BLOB NOT NULL DEFAULT '', data BLOB,"
+    " agrp TEXT NOT NULL, pdmn TEXT, sync INTEGER NOT NULL DEFAULT 0, tomb INTEGER NOT NULL DEFAULT 0, sha1 BLOB,"
+    " musr BLOB NOT NULL DEFAULT '', UUID TEXT, UNIQUE(acct, sdmn, srvr, ptcl, port, path, agrp, sync, musr));"
+    "CREATE INDEX inetagrp ON inet(agrp);"
+    "CREATE TABLE tversion (version INTEGER);"
+    "INSERT INTO tversion VALUES (11);";
+
+static uint32_t gRandom = 1;
+static uint32_t nextRandom(void) {
+    gRandom = gRandom * 1664525u + 1013904223u;
+    return gRandom >> 8;
+}
+
+static sqlite3 *openDatabase(const char *path) {
+    sqlite3 *db = NULL;
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL) != SQLITE_OK) {
+        fprintf(stderr, "test_keychain_store: cannot open %s: %s\n", path, db ? sqlite3_errmsg(db) : "no memory");
+        exit(2);
+    }
+    sqlite3_busy_timeout(db, 5000);
+    return db;
+}
+
+static void run(sqlite3 *db, const char *sql) {
+    char *message = NULL;
+    if (sqlite3_exec(db, sql, NULL, NULL, &message) != SQLITE_OK) {
+        fprintf(stderr, "test_keychain_store: %s failed: %s\n", sql, message);
+        exit(2);
+    }
+}
+
+static int64_t scalar(sqlite3 *db, const char *sql) {
+    return KeychainStorePragma(db, sql);
+}
+
+// Inserts one item; tag keeps rows of different profiles apart.
+static void insertItem(sqlite3_stmt *stmt, const char *agrp, const char *tag, int n) {
+    char acct[64], svce[64];
+    snprintf(acct, sizeof(acct), "%s-account-%d", tag, n);
+    snprintf(svce, sizeof(svce), "%s.service.%d", agrp, n % 37);
+    unsigned char data[1200];
+    int length = 200 + (int)(nextRandom() % 1000);
+    for (int i = 0; i < length; i++) data[i] = (unsigned char)nextRandom();
+    sqlite3_reset(stmt);
+    sqlite3_bind_text(stmt, 1, acct, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 2, svce, -1, SQLITE_TRANSIENT);
+    sqlite3_bind_blob(stmt, 3, data, length, SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt, 4, agrp, -1, SQLITE_TRANSIENT);
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+        fprintf(stderr, "test_keychain_store: insert failed: %s\n", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+        exit(2);
+    }
+}
+
+static const char *const kAppGroups[] = { "9X2K.com.example.mail", "9X2K.com.example.chat", "Q4L7.com.bank.app",
+                                          "com.apple.token" };
+
+// genp items, half of them Apple's; cert, keys and inet a fraction of that.
+static void addItems(sqlite3 *db, const char *tag, int genp, bool system) {
+    static const char *const kInsert[] = {
+        "INSERT INTO genp (cdat, mdat, acct, svce, data, agrp, pdmn) VALUES (1, 1, ?1, ?2, ?3, ?4, 'ak')",
+        "INSERT INTO cert (cdat, mdat, issr, slnr, data, agrp, pdmn) VALUES (1, 1, ?1, ?2, ?3, ?4, 'ak')",
+        "INSERT INTO keys (cdat, mdat, klbl, atag, data, agrp, pdmn) VALUES (1, 1, ?1, ?2, ?3, ?4, 'ak')",
+        "INSERT INTO inet (cdat, mdat, acct, srvr, data, agrp, pdmn) VALUES (1, 1, ?1, ?2, ?3, ?4, 'ak')",
+    };
+    static const int kShare[] = { 1, 16, 8, 16 };
+    run(db, "BEGIN");
+    for (int t = 0; t < 4; t++) {
+        sqlite3_stmt *stmt = NULL;
+        sqlite3_prepare_v2(db, kInsert[t], -1, &stmt, NULL);
+        int count = genp / kShare[t];
+        for (int n = 0; n < count; n++) {
+            if (system && n % 2 == 0 && t != 3) {
+                insertItem(stmt, t == 0 ? "apple" : "lockdown-identities", "system", n);
+            } else {
+                insertItem(stmt, kAppGroups[n % 4], tag, n);
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    run(db, "COMMIT");
+}
+
+static void createKeychain(const char *path, int genp) {
+    unlink(path);
+    sqlite3 *db = openDatabase(path);
+    run(db, kSchema);
+    addItems(db, "before", genp, true);
+    sqlite3_close(db);
+}
+
+static void copyFile(const char *from, const char *to) {
+    char command[512];
+    snprintf(command, sizeof(command), "cp %s %s && rm -f %s-wal %s-shm", from, to, to, to);
+    if (system(command) != 0) exit(2);
+}
+
+static int64_t count(sqlite3 *db, const char *table, const char *where) {
+    char sql[256];
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM %s WHERE %s", table, where);
+    return scalar(db, sql);
+}
+
+// Order-independent digest of a subset's items, ignoring rowids.
+static uint32_t digest(sqlite3 *db, const char *table, const char *where) {
+    char sql[256];
+    snprintf(sql, sizeof(sql), "SELECT agrp, data FROM %s WHERE %s ORDER BY data, agrp", table, where);
+    sqlite3_stmt *stmt = NULL;
+    uint32_t hash = 0x811c9dc5;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        for (int column = 0; column < 2; column++) {
+            const unsigned char *bytes = sqlite3_column_blob(stmt, column);
+            int length = sqlite3_column_bytes(stmt, column);
+            for (int i = 0; i < length; i++) hash = (hash ^ bytes[i]) * 0x01000193;
+            hash = (hash ^ 0xff) * 0x01000193;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return hash;
+}
+
+static bool integrityOk(sqlite3 *db) {
+    sqlite3_stmt *stmt = NULL;
+    bool ok = sqlite3_prepare_v2(db, "PRAGMA integrity_check", -1, &stmt, NULL) == SQLITE_OK &&
+              sqlite3_step(stmt) == SQLITE_ROW && strcmp((const char *)sqlite3_column_text(stmt, 0), "ok") == 0;
+    sqlite3_finalize(stmt);
+    return ok;
+}
+
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+// ---- Reset and snapshots ----
+
+static const char *const kSystemWhere[] = { "agrp = 'apple'", "agrp = 'lockdown-identities'",
+                                            "agrp = 'lockdown-identities'", "0" };
+
+static void resetAndRestore(void) {
+    char keychain[256], snapshot[256], second[256];
+    snprintf(keychain, sizeof(keychain), "%s/keychain-2.db", gRoot);
+    snprintf(snapshot, sizeof(snapshot), "%s/profile-a.db", gRoot);
+    snprintf(second, sizeof(second), "%s/profile-b.db", gRoot);
+    createKeychain(keychain, 800);
+    sqlite3 *db = openDatabase(keychain);
+
+    int64_t system[4], app[4];
+    uint32_t appDigest[4];
+    for (size_t t = 0; t < kKeychainAppSubsetCount; t++) {
+        const KeychainSubset *subset = &kKeychainAppSubsets[t];
+        system[t] = count(db, subset->table, kSystemWhere[t]);
+        app[t] = count(db, subset->table, subset->filter);
+        appDigest[t] = digest(db, subset->table, subset->filter);
+        CHECK(app[t] > 0 && (t == 3 || system[t] > 0), "%s not populated", subset->table);
+    }
+
+    // Profile A is saved, then wiped.
+    CHECK(KeychainStoreSaveSnapshot(db, snapshot) == SQLITE_OK, "snapshot failed: %s", sqlite3_errmsg(db));
+    struct stat st;
+    CHECK(stat(snapshot, &st) == 0 && (st.st_mode & 0777) == 0600, "snapshot mode %o", st.st_mode & 0777);
+    char tmp[300];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", snapshot);
+    CHECK(access(tmp, F_OK) != 0, "%s left behind", tmp);
+    sqlite3 *snap = openDatabase(snapshot);
+    for (size_t t = 0; t < kKeychainAppSubsetCount; t++) {
+        const char *table = kKeychainAppSubsets[t].table;
+        CHECK(count(snap, table, "1") == app[t], "snapshot %s has %lld rows, not %lld", table,
+              (long long)count(snap, table, "1"), (long long)app[t]);
+        CHECK(count(snap, table, kSystemWhere[t]) == 0, "system rows in the snapshot of %s", table);
+    }
+    sqlite3_close(snap);
+
+    bool restored = true;
+    CHECK(KeychainStoreReset(db, NULL, &restored) == SQLITE_OK, "reset failed: %s", sqlite3_errmsg(db));
+    CHECK(!restored, "restored without a snapshot");
+    for (size_t t = 0; t < kKeychainAppSubsetCount; t++) {
+        const KeychainSubset *subset = &kKeychainAppSubsets[t];
+        CHECK(count(db, subset->table, subset->filter) == 0, "%s app rows survived the reset", subset->table);
+        CHECK(count(db, subset->table, kSystemWhere[t]) == system[t], "%s system rows lost", subset->table);
+    }
+    CHECK(scalar(db, "SELECT count(*) FROM sqlite_sequence") == 0, "sqlite_sequence not cleared");
+    CHECK(scalar(db, "SELECT version FROM tversion") == 11, "tversion touched");
+
+    // Profile B gets its own items and is saved too.
+    addItems(db, "profile-b", 200, false);
+    uint32_t bDigest = digest(db, "genp", "agrp <> 'apple'");
+    CHECK(KeychainStoreSaveSnapshot(db, second) == SQLITE_OK, "second snapshot failed: %s", sqlite3_errmsg(db));
+
+    // Switching back to A: B's items go, A's come back, system rows stay.
+    CHECK(KeychainStoreReset(db, snapshot, &restored) == SQLITE_OK && restored, "restoring A failed: %s",
+          sqlite3_errmsg(db));
+    for (size_t t = 0; t < kKeychainAppSubsetCount; t++) {
+        const KeychainSubset *subset = &kKeychainAppSubsets[t];
+        CHECK(count(db, subset->table, subset->filter) == app[t], "%s has %lld app rows after restore, not %lld",
+              subset->table, (long long)count(db, subset->table, subset->filter), (long long)app[t]);
+        CHECK(digest(db, subset->table, subset->filter) == appDigest[t], "%s items differ after restore",
+              subset->table);
+        CHECK(count(db, subset->table, kSystemWhere[t]) == system[t], "%s system rows changed", subset->table);
+    }
+    CHECK(scalar(db, "SELECT count(*) FROM genp WHERE acct LIKE 'profile-b-%'") == 0, "B's items left behind");
+    CHECK(scalar(db, "SELECT count(*) FROM pragma_database_list WHERE name = 'snap'") == 0, "snapshot left attached");
+
+    // And to B again.
+    CHECK(KeychainStoreReset(db, second, &restored) == SQLITE_OK && restored, "restoring B failed");
+    CHECK(digest(db, "genp", "agrp <> 'apple'") == bDigest, "B's items differ after restore");
+    CHECK(scalar(db, "SELECT count(*) FROM genp WHERE acct LIKE 'before-%'") == 0, "A's items left behind");
+    // New items after a restore get rowids past every restored one.
+    run(db, "INSERT INTO genp (acct, svce, agrp) VALUES ('new', 'new', 'x')");
+    CHECK(scalar(db, "SELECT rowid FROM genp WHERE acct = 'new'") == scalar(db, "SELECT max(rowid) FROM genp"),
+          "new item reused a rowid");
+    sqlite3_close(db);
+}
+
+// ---- Schema drift and broken snapshots ----
+
+static void driftAndFailure(void) {
+    char keychain[256], snapshot[256];
+    snprintf(keychain, sizeof(keychain), "%s/drift.db", gRoot);
+    snprintf(snapshot, sizeof(snapshot), "%s/drift-snap.db", gRoot);
+    createKeychain(keychain, 160);
+    sqlite3 *db = openDatabase(keychain);
+    int64_t appGenp = count(db, "genp", "agrp <> 'apple'");
+    CHECK(KeychainStoreSaveSnapshot(db, snapshot) == SQLITE_OK, "snapshot failed");
+
+    // The OS update that followed added a column and dropped another.
+    run(db, "ALTER TABLE genp ADD COLUMN clip INTEGER NOT NULL DEFAULT 0");
+    sqlite3 *snap = openDatabase(snapshot);
+    run(snap, "ALTER TABLE genp ADD COLUMN retired BLOB");
+    run(snap, "ALTER TABLE inet RENAME TO inet_old");
+    sqlite3_close(snap);
+    bool restored = false;
+    CHECK(KeychainStoreReset(db, snapshot, &restored) == SQLITE_OK && restored, "drifted snapshot not applied: %s",
+          sqlite3_errmsg(db));
+    CHECK(count(db, "genp", "agrp <> 'apple'") == appGenp, "drifted genp restored %lld of %lld",
+          (long long)count(db, "genp", "agrp <> 'apple'"), (long long)appGenp);
+    CHECK(count(db, "inet", "1") == 0, "inet rows from nowhere");
+
+    // The snapshot lacks a NOT NULL column without a default: nothing applies,
+    // but the wipe still happens.
+    snap = openDatabase(snapshot);
+    run(snap, "CREATE TABLE cert_new AS SELECT rowid, cdat, mdat, data FROM cert; DROP TABLE cert;"
+              "ALTER TABLE cert_new RENAME TO cert;");
+    sqlite3_close(snap);
+    CHECK(KeychainStoreReset(db, snapshot, &restored) == SQLITE_OK, "reset with a bad snapshot failed: %s",
+          sqlite3_errmsg(db));
+    CHECK(!restored, "a snapshot violating NOT NULL reported as restored");
+    for (size_t t = 0; t < kKeychainAppSubsetCount; t++) {
+        const KeychainSubset *subset = &kKeychainAppSubsets[t];
+        CHECK(count(db, subset->table, subset->filter) == 0, "%s not wiped after a failed restore", subset->table);
+    }
+    CHECK(count(db, "genp", "agrp = 'apple'") > 0, "system rows lost after a failed restore");
+
+    // Garbage and a missing file wipe too.
+    FILE *file = fopen(snapshot, "w");
+    fputs("this is not a database", file);
+    fclose(file);
+    addItems(db, "again", 40, false);
+    CHECK(KeychainStoreReset(db, snapshot, &restored) == SQLITE_OK && !restored, "garbage snapshot");
+    CHECK(count(db, "genp", "agrp <> 'apple'") == 0, "garbage snapshot skipped the wipe");
+    addItems(db, "again2", 40, false);
+    CHECK(KeychainStoreReset(db, "/nonexistent/snap.db", &restored) == SQLITE_OK && !restored, "missing snapshot");
+    CHECK(count(db, "genp", "agrp <> 'apple'") == 0, "missing snapshot skipped the wipe");
+
+    // A snapshot that cannot be created leaves nothing behind.
+    CHECK(KeychainStoreSaveSnapshot(db, "/nonexistent/dir/snap.db") == SQLITE_CANTOPEN && errno == ENOENT,
+          "snapshot into a missing directory");
+
+    // Another connection holding the write lock: the reset waits, then fails
+    // cleanly rather than half-applying.
+    sqlite3 *other = openDatabase(keychain);
+    addItems(db, "locked", 40, false);
+    run(other, "BEGIN IMMEDIATE");
+    sqlite3_busy_timeout(db, 50);
+    CHECK(KeychainStoreReset(db, NULL, NULL) == SQLITE_BUSY, "reset under another writer did not report busy");
+    CHECK(sqlite3_get_autocommit(db), "transaction left open after busy");
+    run(other, "ROLLBACK");
+    sqlite3_close(other);
+    CHECK(count(db, "genp", "agrp <> 'apple'") > 0, "busy reset changed rows");
+    CHECK(KeychainStoreReset(db, NULL, NULL) == SQLITE_OK, "reset after the lock was released");
+    sqlite3_close(db);
+}
+
+// ---- Vacuum ----
+
+static void vacuumSteps(void) {
+    char keychain[256];
+    snprintf(keychain, sizeof(keychain), "%s/vacuum.db", gRoot);
+    createKeychain(keychain, 800);
+    sqlite3 *db = openDatabase(keychain);
+    CHECK(KeychainStoreReset(db, NULL, NULL) == SQLITE_OK, "reset failed");
+    int64_t freePages = scalar(db, "PRAGMA freelist_count");
+    int64_t pages = scalar(db, "PRAGMA page_count");
+    CHECK(freePages > 0, "reset freed no pages");
+    int steps = 0, rc;
+    while ((rc = KeychainStoreVacuumStep(db, 16, &freePages)) == SQLITE_OK) steps++;
+    CHECK(rc == SQLITE_DONE && freePages == 0, "vacuum stopped with %lld pages free (rc %d)", (long long)freePages, rc);
+    CHECK(steps > 1, "only %d vacuum steps of 16 pages", steps);
+    CHECK(scalar(db, "PRAGMA page_count") < pages, "file did not shrink");
+    CHECK(integrityOk(db), "integrity_check failed after vacuuming");
+    sqlite3_close(db);
+
+    // Not in incremental mode: a step reclaims nothing and says so.
+    snprintf(keychain, sizeof(keychain), "%s/full.db", gRoot);
+    unlink(keychain);
+    db = openDatabase(keychain);
+    run(db, "CREATE TABLE t (x BLOB); INSERT INTO t VALUES (zeroblob(400000)); DELETE FROM t;");
+    freePages = scalar(db, "PRAGMA freelist_count");
+    CHECK(freePages > 0, "no free pages to leave");
+    int64_t before = freePages;
+    CHECK(KeychainStoreVacuumStep(db, 16, &freePages) == SQLITE_DONE && freePages == before,
+          "non-incremental database vacuumed");
+    sqlite3_close(db);
+}
+
+// ---- Profile switch timing ----
+
+static void switchTiming(int genp) {
+    char base[256], keychain[256], snapshot[256];
+    snprintf(base, sizeof(base), "%s/timing-base.db", gRoot);
+    snprintf(keychain, sizeof(keychain), "%s/timing.db", gRoot);
+    snprintf(snapshot, sizeof(snapshot), "%s/timing-snap.db", gRoot);
+    createKeychain(base, genp);
+
+    // Before: the DELETEs in autocommit, then VACUUM, on the caller's path.
+    copyFile(base, keychain);
+    sqlite3 *db = openDatabase(keychain);
+    double start = nowMs();
+    run(db, "DELETE FROM genp WHERE agrp <> 'apple';");
+    run(db, "DELETE FROM cert WHERE agrp <> 'lockdown-identities';");
+    run(db, "DELETE FROM keys WHERE agrp <> 'lockdown-identities';");
+    run(db, "DELETE FROM inet;");
+    run(db, "DELETE FROM sqlite_sequence;");
+    double deleteMs = nowMs() - start;
+    run(db, "VACUUM;");
+    double oldMs = nowMs() - start;
+    sqlite3_close(db);
+
+    // After: snapshot the outgoing profile, reset restoring the incoming one in
+    // one transaction; incremental vacuum later, at idle.
+    copyFile(base, keychain);
+    db = openDatabase(keychain);
+    CHECK(KeychainStoreSaveSnapshot(db, snapshot) == SQLITE_OK, "timing snapshot failed");
+    start = nowMs();
+    CHECK(KeychainStoreSaveSnapshot(db, snapshot) == SQLITE_OK, "timing snapshot failed");
+    double saveMs = nowMs() - start;
+    start = nowMs();
+    bool restored = false;
+    CHECK(KeychainStoreReset(db, snapshot, &restored) == SQLITE_OK && restored, "timing reset failed");
+    double resetMs = nowMs() - start;
+    start = nowMs();
+    CHECK(KeychainStoreReset(db, NULL, NULL) == SQLITE_OK, "timing wipe failed");
+    double wipeMs = nowMs() - start;
+    int64_t freePages = scalar(db, "PRAGMA freelist_count");
+    int steps = 0;
+    double longestStepMs = 0;
+    start = nowMs();
+    for (;;) {
+        double stepStart = nowMs();
+        int rc = KeychainStoreVacuumStep(db, 256, &freePages);
+        double stepMs = nowMs() - stepStart;
+        if (stepMs > longestStepMs) longestStepMs = stepMs;
+        steps++;
+        if (rc != SQLITE_OK) break;
+    }
+    double vacuumMs = nowMs() - start;
+    sqlite3_close(db);
+
+    fprintf(stderr,
+            "test_keychain_store: %d genp items: before, wipe %.1f ms + VACUUM = %.1f ms on the switch path; "
+            "after, snapshot %.1f ms + swap %.1f ms (wipe alone %.1f ms), then %d idle vacuum steps in %.1f ms, "
+            "longest %.2f ms\n",
+            genp, deleteMs, oldMs, saveMs, resetMs, wipeMs, steps, vacuumMs, longestStepMs);
+}
+
+int main(int argc, char *argv[]) {
+    snprintf(gRoot, sizeof(gRoot), "/tmp/test_keychain_store.XXXXXX");
+    if (!mkdtemp(gRoot)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    resetAndRestore();
+    driftAndFailure();
+    vacuumSteps();
+    switchTiming(argc > 1 ? atoi(argv[1]) : 8000);
+
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf %s", gRoot);
+    if (system(command) != 0) fprintf(stderr, "test_keychain_store: could not remove %s\n", gRoot);
+    if (gFailures) {
+        fprintf(stderr, "test_keychain_store: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_keychain_store: %d checks passed\n", gChecks);
+    return 0;
+}
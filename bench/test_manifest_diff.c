@@ -0,0 +1,278 @@
+// Checks ManifestDiff's decisions (daemon/ManifestDiffCore.m) on real files in
+// a scratch directory: unchanged and modified files, a rewrite to the same
+// size inside the racy window, renames on both sides of that window, hard
+// links, and a clock that is ahead of or behind the file times.
+//
+//   make -C bench test
+//   build/test_manifest_diff
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ManifestDiffCore.h"
+
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_manifest_diff: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+#define kSecond 1000000000ULL
+
+static char gRoot[] = "/tmp/test_manifest_diff.XXXXXX";
+static uint64_t gNow;
+
+static const char *pathFor(const char *name) {
+    static char path[4][256];
+    static int slot;
+    slot = (slot + 1) % 4;
+    snprintf(path[slot], sizeof(path[slot]), "%s/%s", gRoot, name);
+    return path[slot];
+}
+
+static void writeFile(const char *name, const char *content) {
+    int fd = open(pathFor(name), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, content, strlen(content)) != (ssize_t)strlen(content)) {
+        perror(name);
+        exit(2);
+    }
+    close(fd);
+}
+
+// Sets the mtime the way a coarse-grained file system or a restore would.
+static void setMTime(const char *name, uint64_t mtime) {
+    struct timespec times[2] = {
+        { .tv_nsec = UTIME_OMIT },
+        { .tv_sec = (time_t)(mtime / kSecond), .tv_nsec = (long)(mtime % kSecond) },
+    };
+    if (utimensat(AT_FDCWD, pathFor(name), times, 0) != 0) {
+        perror(name);
+        exit(2);
+    }
+}
+
+// What ManifestDiff stores for a file, and what it sees on the next scan.
+static ManifestRecord record(const char *name) {
+    struct stat st;
+    if (stat(pathFor(name), &st) != 0) {
+        perror(name);
+        exit(2);
+    }
+    return (ManifestRecord){
+        .size = (uint64_t)st.st_size,
+        .mtime = (uint64_t)st.st_mtim.tv_sec * kSecond + (uint64_t)st.st_mtim.tv_nsec,
+        .ino = st.st_ino,
+    };
+}
+
+// ---- Trust window ----
+
+static void trustWindow(void) {
+    uint64_t snapshot = gNow;
+    CHECK(ManifestMTimeTrusted(snapshot - kManifestRacyWindowNs - 1, snapshot, gNow), "just outside the window");
+    CHECK(!ManifestMTimeTrusted(snapshot - kManifestRacyWindowNs, snapshot, gNow), "window edge trusted");
+    CHECK(!ManifestMTimeTrusted(snapshot - 1, snapshot, gNow), "written during the scan trusted");
+    CHECK(!ManifestMTimeTrusted(snapshot + kSecond, snapshot, gNow + 10 * kSecond), "written after the snapshot trusted");
+    CHECK(!ManifestMTimeTrusted(gNow + 1, snapshot + 3600 * kSecond, gNow), "mtime ahead of the clock trusted");
+}
+
+// ---- Main path ----
+
+static void mainPath(void) {
+    uint64_t old = gNow - 600 * kSecond;
+    writeFile("same", "unchanged content");
+    setMTime("same", old);
+    ManifestRecord manifest = record("same");
+    CHECK(ManifestRecordUnchanged(&manifest, &manifest, gNow, gNow), "untouched file reported changed");
+
+    // Appended: size differs.
+    writeFile("grown", "abc");
+    setMTime("grown", old);
+    manifest = record("grown");
+    writeFile("grown", "abcdef");
+    ManifestRecord cur = record("grown");
+    CHECK(!ManifestRecordUnchanged(&manifest, &cur, gNow, gNow), "grown file unchanged");
+
+    // Rewritten to the same size: the new mtime gives it away.
+    writeFile("rewritten", "abcd");
+    setMTime("rewritten", old);
+    manifest = record("rewritten");
+    writeFile("rewritten", "wxyz");
+    cur = record("rewritten");
+    CHECK(cur.mtime != manifest.mtime, "rewrite kept the mtime");
+    CHECK(!ManifestRecordUnchanged(&manifest, &cur, gNow, gNow), "same-size rewrite unchanged");
+}
+
+// Truncated and rewritten to the same size within one timestamp tick right
+// after the manifest was written: size and mtime both match, so only the racy
+// window catches it.
+static void truncateInRacyWindow(void) {
+    uint64_t tick = gNow - kSecond; // 1 s granularity, as on HFS+
+    writeFile("racy", "first");
+    setMTime("racy", tick);
+    ManifestRecord manifest = record("racy");
+    uint64_t snapshot = tick + kSecond / 2; // the scan saw it within the same second
+
+    int fd = open(pathFor("racy"), O_WRONLY);
+    CHECK(fd >= 0 && ftruncate(fd, 0) == 0 && write(fd, "later", 5) == 5, "rewrite failed");
+    if (fd >= 0) close(fd);
+    setMTime("racy", tick);
+    ManifestRecord cur = record("racy");
+    CHECK(cur.size == manifest.size && cur.mtime == manifest.mtime, "metadata should be identical");
+    CHECK(!ManifestRecordUnchanged(&manifest, &cur, snapshot, gNow), "racy same-size rewrite unchanged");
+    // Also on the rename path.
+    size_t from = 0;
+    CHECK(ManifestMatchRenames(&manifest, 1, &cur, 1, snapshot, gNow, &from) && from == SIZE_MAX,
+          "racy file paired as a rename");
+}
+
+// ---- Renames ----
+
+static void renames(void) {
+    uint64_t old = gNow - 600 * kSecond;
+    writeFile("before", "renamed content");
+    setMTime("before", old);
+    ManifestRecord manifest = record("before");
+    CHECK(rename(pathFor("before"), pathFor("after")) == 0, "rename failed");
+    ManifestRecord cur = record("after");
+
+    size_t from = SIZE_MAX;
+    CHECK(ManifestMatchRenames(&manifest, 1, &cur, 1, gNow, gNow, &from) && from == 0, "rename not recognised");
+
+    // A different file that happens to reuse the inode number is not a rename.
+    ManifestRecord reused = cur;
+    reused.size++;
+    CHECK(ManifestMatchRenames(&manifest, 1, &reused, 1, gNow, gNow, &from) && from == SIZE_MAX,
+          "inode reuse paired");
+
+    // Renamed within the racy window: rehashed, as on the main path.
+    CHECK(ManifestMatchRenames(&manifest, 1, &cur, 1, old + kSecond, gNow, &from) && from == SIZE_MAX,
+          "racy rename paired");
+
+    // Several renames at once pair by inode, whatever the order.
+    ManifestRecord deleted[3], added[3];
+    char name[32];
+    for (int i = 0; i < 3; i++) {
+        snprintf(name, sizeof(name), "many%d", i);
+        writeFile(name, "same size");
+        setMTime(name, old);
+        deleted[i] = record(name);
+        char renamed[32];
+        snprintf(renamed, sizeof(renamed), "moved%d", i);
+        rename(pathFor(name), pathFor(renamed));
+        added[2 - i] = record(renamed);
+    }
+    size_t pairs[3];
+    CHECK(ManifestMatchRenames(deleted, 3, added, 3, gNow, gNow, pairs), "match failed");
+    for (int i = 0; i < 3; i++) CHECK(pairs[i] == (size_t)(2 - i), "moved%d paired with %zu", 2 - i, pairs[i]);
+
+    CHECK(ManifestMatchRenames(NULL, 0, added, 3, gNow, gNow, pairs) && pairs[0] == SIZE_MAX, "nothing deleted");
+}
+
+// ---- Hard links ----
+
+static void hardLinks(void) {
+    uint64_t old = gNow - 600 * kSecond;
+    writeFile("linked", "shared inode");
+    setMTime("linked", old);
+    ManifestRecord manifest = record("linked");
+
+    // One path disappears, two links to it appear: only one inherits the entry.
+    CHECK(link(pathFor("linked"), pathFor("link1")) == 0 && link(pathFor("linked"), pathFor("link2")) == 0,
+          "link failed");
+    unlink(pathFor("linked"));
+    ManifestRecord added[2] = { record("link1"), record("link2") };
+    CHECK(added[0].ino == added[1].ino, "links have different inodes");
+    size_t pairs[2];
+    CHECK(ManifestMatchRenames(&manifest, 1, added, 2, gNow, gNow, pairs), "match failed");
+    CHECK((pairs[0] == 0) + (pairs[1] == 0) == 1, "links paired %zu, %zu", pairs[0], pairs[1]);
+
+    // Two linked paths both moved: each pairs with its own old entry.
+    ManifestRecord deleted[2] = { added[0], added[1] };
+    rename(pathFor("link1"), pathFor("link3"));
+    rename(pathFor("link2"), pathFor("link4"));
+    ManifestRecord moved[2] = { record("link4"), record("link3") };
+    CHECK(ManifestMatchRenames(deleted, 2, moved, 2, gNow, gNow, pairs), "match failed");
+    CHECK(pairs[0] != SIZE_MAX && pairs[1] != SIZE_MAX && pairs[0] != pairs[1], "moved links paired %zu, %zu",
+          pairs[0], pairs[1]);
+
+    // A link to a file that is still there is not a rename of it.
+    ManifestRecord kept = record("link3");
+    CHECK(link(pathFor("link3"), pathFor("link5")) == 0, "link failed");
+    ManifestRecord extra = record("link5");
+    CHECK(ManifestMatchRenames(NULL, 0, &extra, 1, gNow, gNow, pairs) && pairs[0] == SIZE_MAX, "extra link paired");
+    CHECK(ManifestRecordUnchanged(&kept, &kept, gNow, gNow), "linked file changed");
+}
+
+// ---- Clock skew ----
+
+static void clockSkew(void) {
+    // A file stamped ahead of the clock (restored from another device, or the
+    // clock was set back): never trusted, on either path.
+    writeFile("future", "from the future");
+    setMTime("future", gNow + 3600 * kSecond);
+    ManifestRecord future = record("future");
+    uint64_t laterSnapshot = gNow + 7200 * kSecond;
+    CHECK(!ManifestRecordUnchanged(&future, &future, laterSnapshot, gNow), "future mtime trusted on the main path");
+    rename(pathFor("future"), pathFor("future2"));
+    ManifestRecord moved = record("future2");
+    size_t from = 0;
+    CHECK(ManifestMatchRenames(&future, 1, &moved, 1, laterSnapshot, gNow, &from) && from == SIZE_MAX,
+          "future mtime trusted on the rename path");
+
+    // The clock went back after the snapshot: a later write gets an mtime
+    // before the snapshot, but it differs from the recorded one.
+    writeFile("behind", "before the jump");
+    setMTime("behind", gNow - 600 * kSecond);
+    ManifestRecord manifest = record("behind");
+    uint64_t snapshot = gNow + 3600 * kSecond;
+    writeFile("behind", "after the jump!");
+    setMTime("behind", gNow - 60 * kSecond);
+    ManifestRecord cur = record("behind");
+    CHECK(ManifestMTimeTrusted(cur.mtime, snapshot, gNow), "mtime before a later snapshot not trusted");
+    CHECK(!ManifestRecordUnchanged(&manifest, &cur, snapshot, gNow), "write after a backward jump unchanged");
+
+    // The clock jumped forward: old files stay trusted.
+    writeFile("stable", "stable");
+    setMTime("stable", gNow - 600 * kSecond);
+    ManifestRecord stable = record("stable");
+    CHECK(ManifestRecordUnchanged(&stable, &stable, gNow + 86400 * kSecond, gNow + 86400 * kSecond),
+          "old file rehashed after a forward jump");
+}
+
+int main(void) {
+    if (!mkdtemp(gRoot)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    gNow = (uint64_t)ts.tv_sec * kSecond + (uint64_t)ts.tv_nsec;
+
+    trustWindow();
+    mainPath();
+    truncateInRacyWindow();
+    renames();
+    hardLinks();
+    clockSkew();
+
+    char command[64];
+    snprintf(command, sizeof(command), "rm -rf '%s'", gRoot);
+    if (system(command) != 0) fprintf(stderr, "test_manifest_diff: could not remove %s\n", gRoot);
+    if (gFailures) {
+        fprintf(stderr, "test_manifest_diff: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_manifest_diff: %d checks passed\n", gChecks);
+    return 0;
+}
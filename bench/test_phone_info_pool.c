@@ -0,0 +1,487 @@
+// Checks PhoneInfoPool's bookkeeping (daemon/PhoneInfoPoolCore.m): a refill
+// that an invalidation overtakes drops its entry (generation), settings that
+// change without a notification drop the pool on the next take or offer
+// (fingerprint), the refill claim is cleared in the step that ends a refill so
+// an invalidation right after it is not lost, and every entry is released
+// exactly once. Then races a refill thread against settings writers and
+// takers under the same two locks PhoneInfoPool uses, checking no take ever
+// gets an entry generated for older settings than it saw. Last, times
+// takePhoneInfo four ways against a synthetic generation: inline, pooled and
+// idle, pooled while a refill generates with the fingerprint read under the
+// generation lock (as before), and the same with it read from the saved
+// settings (now).
+//
+//   make -C bench test
+//   build/test_phone_info_pool [RACE_MS [GENERATE_US]]
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "PhoneInfoPoolCore.h"
+
+static int gFailures;
+static int gChecks;
+static pthread_mutex_t gCheckLock = PTHREAD_MUTEX_INITIALIZER;
+
+// cond is evaluated before taking the lock: it may release entries, which check too.
+#define CHECK(cond, ...) do { \
+    bool passed = (cond); \
+    pthread_mutex_lock(&gCheckLock); \
+    gChecks++; \
+    if (!passed) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_phone_info_pool: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+    pthread_mutex_unlock(&gCheckLock); \
+} while (0)
+
+static uint32_t gRandom = 1;
+static uint32_t nextRandom(void) {
+    gRandom = gRandom * 1664525u + 1013904223u;
+    return gRandom >> 8;
+}
+
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static void sleepMicros(long micros) {
+    struct timespec ts = { micros / 1000000, (micros % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+// ---- Entries ----
+
+// A stand-in PhoneInfo: the settings version its fingerprint was read at and
+// the one its data was generated from, which can be newer.
+typedef struct {
+    unsigned long labelVersion;
+    unsigned long dataVersion;
+    bool released;
+} Entry;
+
+static pthread_mutex_t gCountLock = PTHREAD_MUTEX_INITIALIZER;
+static long gCreated, gReleased;
+
+static Entry *newEntry(unsigned long label, unsigned long data) {
+    Entry *entry = calloc(1, sizeof(Entry));
+    entry->labelVersion = label;
+    entry->dataVersion = data;
+    pthread_mutex_lock(&gCountLock);
+    gCreated++;
+    pthread_mutex_unlock(&gCountLock);
+    return entry;
+}
+
+static void releaseEntry(void *pointer) {
+    Entry *entry = pointer;
+    CHECK(!entry->released, "entry released twice");
+    entry->released = true;
+    pthread_mutex_lock(&gCountLock);
+    gReleased++;
+    pthread_mutex_unlock(&gCountLock);
+    free(entry);
+}
+
+static void fingerprintOf(unsigned long version, char *out, size_t size) {
+    snprintf(out, size, "US|14.0|v%lu", version);
+}
+
+// ---- Sequences ----
+
+static void generationCases(void) {
+    PhoneInfoPoolState pool = { 0 };
+    uint64_t generation;
+    CHECK(PhoneInfoPoolClaimRefill(&pool, 3), "first claim refused");
+    CHECK(!PhoneInfoPoolClaimRefill(&pool, 3), "second claim while one is scheduled");
+    CHECK(PhoneInfoPoolRefillNext(&pool, 3, false, &generation), "refill of an empty pool stopped");
+    // The settings changed and were announced while generating.
+    CHECK(PhoneInfoPoolInvalidate(&pool, releaseEntry) == 0, "empty pool dropped entries");
+    CHECK(PhoneInfoPoolOffer(&pool, generation, "US|14.0|v1", newEntry(1, 1), releaseEntry) == PhoneInfoPoolStale,
+          "entry generated across an invalidation kept");
+    CHECK(pool.count == 0 && pool.settings == NULL, "stale offer changed the pool");
+    // The same refill goes on under the new generation.
+    CHECK(PhoneInfoPoolRefillNext(&pool, 3, false, &generation), "refill stopped after a stale entry");
+    CHECK(PhoneInfoPoolOffer(&pool, generation, "US|14.0|v2", newEntry(2, 2), releaseEntry) == PhoneInfoPoolAdded,
+          "fresh entry refused");
+    CHECK(pool.count == 1 && strcmp(pool.settings, "US|14.0|v2") == 0, "pool settings %s",
+          pool.settings ? pool.settings : "(null)");
+    for (int i = 0; i < 2; i++) {
+        CHECK(PhoneInfoPoolRefillNext(&pool, 3, false, &generation), "refill stopped early");
+        PhoneInfoPoolOffer(&pool, generation, "US|14.0|v2", newEntry(2, 2), releaseEntry);
+    }
+    CHECK(!PhoneInfoPoolRefillNext(&pool, 3, false, &generation), "refill went past the target");
+    CHECK(!pool.refillScheduled, "finished refill kept its claim");
+    CHECK(!PhoneInfoPoolClaimRefill(&pool, 3), "claim on a full pool");
+
+    // An invalidation right after the refill ended can claim a new one.
+    CHECK(PhoneInfoPoolInvalidate(&pool, releaseEntry) == 3, "invalidation dropped %zu", pool.count);
+    CHECK(PhoneInfoPoolClaimRefill(&pool, 3), "claim after invalidation refused");
+    // Pending jobs end it and clear the claim too.
+    CHECK(!PhoneInfoPoolRefillNext(&pool, 3, true, &generation), "refill did not yield");
+    CHECK(PhoneInfoPoolClaimRefill(&pool, 3), "claim after yielding refused");
+    // So does a failed generation, and a missing fingerprint.
+    CHECK(PhoneInfoPoolRefillNext(&pool, 3, false, &generation), "refill of an empty pool stopped");
+    CHECK(PhoneInfoPoolOffer(&pool, generation, "US|14.0|v2", NULL, releaseEntry) == PhoneInfoPoolFailed,
+          "missing entry accepted");
+    CHECK(PhoneInfoPoolClaimRefill(&pool, 3), "claim after a failed generation refused");
+    CHECK(PhoneInfoPoolOffer(&pool, generation, NULL, newEntry(2, 2), releaseEntry) == PhoneInfoPoolFailed,
+          "entry without a fingerprint accepted");
+    CHECK(PhoneInfoPoolClaimRefill(&pool, 3), "claim after a missing fingerprint refused");
+    // A target of 0 disables the pool.
+    PhoneInfoPoolState off = { 0 };
+    CHECK(!PhoneInfoPoolClaimRefill(&off, 0), "claim with the pool disabled");
+    PhoneInfoPoolFree(&pool, releaseEntry);
+    PhoneInfoPoolFree(&off, releaseEntry);
+}
+
+static void fingerprintCases(void) {
+    PhoneInfoPoolState pool = { 0 };
+    uint64_t generation;
+    CHECK(PhoneInfoPoolTake(&pool, "US|14.0|v1", releaseEntry) == NULL, "entry from an empty pool");
+    CHECK(pool.generation == 0, "take from an empty pool invalidated it");
+    for (int i = 0; i < 2; i++) {
+        PhoneInfoPoolRefillNext(&pool, 3, false, &generation);
+        PhoneInfoPoolOffer(&pool, generation, "US|14.0|v1", newEntry(1, 1), releaseEntry);
+    }
+    // Taken oldest first while the settings hold.
+    Entry *first = pool.entries[0];
+    CHECK(PhoneInfoPoolTake(&pool, "US|14.0|v1", releaseEntry) == first, "take was not oldest first");
+    releaseEntry(first);
+
+    // Settings changed without a notification: the refill's next entry
+    // replaces the older one instead of joining it.
+    PhoneInfoPoolRefillNext(&pool, 3, false, &generation);
+    CHECK(PhoneInfoPoolOffer(&pool, generation, "JP|15.0|v2", newEntry(2, 2), releaseEntry) == PhoneInfoPoolRestarted,
+          "entry for new settings joined older ones");
+    CHECK(pool.count == 1 && strcmp(pool.settings, "JP|15.0|v2") == 0, "%zu entries for %s", pool.count,
+          pool.settings ? pool.settings : "(null)");
+    // And the generation moved, so an older refill in flight is dropped too.
+    CHECK(PhoneInfoPoolOffer(&pool, generation, "JP|15.0|v2", newEntry(2, 2), releaseEntry) == PhoneInfoPoolStale,
+          "offer under the generation before the restart kept");
+
+    // A take that sees other settings drops the pool and gets nothing.
+    uint64_t before = pool.generation;
+    CHECK(PhoneInfoPoolTake(&pool, "US|14.0|v3", releaseEntry) == NULL, "entry for other settings handed out");
+    CHECK(pool.count == 0 && pool.settings == NULL && pool.generation == before + 1, "take left the stale pool");
+    CHECK(PhoneInfoPoolTake(&pool, NULL, releaseEntry) == NULL, "entry without a fingerprint");
+    PhoneInfoPoolFree(&pool, releaseEntry);
+}
+
+// Random steps against a small model: entries only ever carry the pool's
+// settings, the pool never passes the target through a refill, and every
+// entry is released once.
+static void randomSequences(int steps) {
+    PhoneInfoPoolState pool = { 0 };
+    long created = gCreated, released = gReleased;
+    unsigned long version = 1;
+    bool refilling = false;
+    uint64_t generation = 0;
+    bool generating = false;
+    unsigned long generatingLabel = 0;
+    char fingerprint[32];
+    long held = 0;
+    for (int i = 0; i < steps; i++) {
+        size_t target = 1 + nextRandom() % 5;
+        switch (nextRandom() % 6) {
+            case 0: // settings change, notified or not
+                version++;
+                if (nextRandom() % 2) PhoneInfoPoolInvalidate(&pool, releaseEntry);
+                break;
+            case 1: { // take
+                fingerprintOf(version, fingerprint, sizeof(fingerprint));
+                Entry *entry = PhoneInfoPoolTake(&pool, fingerprint, releaseEntry);
+                if (entry) {
+                    CHECK(entry->labelVersion == version, "step %d: took v%lu under v%lu", i, entry->labelVersion,
+                          version);
+                    releaseEntry(entry);
+                }
+                break;
+            }
+            case 2:
+                if (PhoneInfoPoolClaimRefill(&pool, target)) {
+                    CHECK(!refilling, "step %d: two refills claimed", i);
+                    refilling = true;
+                }
+                break;
+            case 3:
+            case 4: // a refill step: start a generation, or offer it
+                if (!refilling) break;
+                if (!generating) {
+                    if (!PhoneInfoPoolRefillNext(&pool, target, nextRandom() % 8 == 0, &generation)) {
+                        refilling = false;
+                        break;
+                    }
+                    generating = true;
+                    generatingLabel = version;
+                } else {
+                    fingerprintOf(generatingLabel, fingerprint, sizeof(fingerprint));
+                    PhoneInfoPoolOfferResult result = PhoneInfoPoolOffer(
+                        &pool, generation, fingerprint, newEntry(generatingLabel, version), releaseEntry);
+                    generating = false;
+                    if (result == PhoneInfoPoolFailed) refilling = false;
+                    CHECK(result != PhoneInfoPoolFailed, "step %d: offer failed", i);
+                }
+                break;
+            default: // inline generation, which bypasses the pool
+                releaseEntry(newEntry(version, version));
+                break;
+        }
+        CHECK(refilling == pool.refillScheduled, "step %d: claim %d, model %d", i, pool.refillScheduled,
+              refilling);
+        for (size_t e = 0; e < pool.count; e++) {
+            Entry *entry = pool.entries[e];
+            fingerprintOf(entry->labelVersion, fingerprint, sizeof(fingerprint));
+            if (strcmp(fingerprint, pool.settings) != 0) {
+                CHECK(false, "step %d: pooled v%lu under %s", i, entry->labelVersion, pool.settings);
+                break;
+            }
+        }
+        held = (long)pool.count;
+    }
+    PhoneInfoPoolFree(&pool, releaseEntry);
+    CHECK(gCreated - created == gReleased - released, "%ld created, %ld released (%ld were pooled)",
+          gCreated - created, gReleased - released, held);
+}
+
+// ---- Races ----
+
+// PhoneInfoPool's two locks: @synchronized (self) and generateLock. Settings
+// live in "preferences" that writers change without either.
+static pthread_mutex_t gStateLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t gGenerateLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t gPrefsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gRefillWanted = PTHREAD_COND_INITIALIZER;
+static PhoneInfoPoolState gPool;
+static unsigned long gPrefsVersion = 1;
+static atomic_bool gStop;
+static long gGenerateMicros = 2000;
+static size_t gTarget = 3;
+static long gTakes, gHits, gStale, gRestarts;
+
+static unsigned long readPrefs(void) {
+    pthread_mutex_lock(&gPrefsLock);
+    unsigned long version = gPrefsVersion;
+    pthread_mutex_unlock(&gPrefsLock);
+    return version;
+}
+
+// generatePhoneInfo reads the settings again itself, so its data can be newer
+// than the fingerprint read just before it; never older.
+static Entry *generate(long micros) {
+    unsigned long label = readPrefs();
+    if (micros) sleepMicros(micros);
+    return newEntry(label, readPrefs());
+}
+
+static void scheduleRefill(void) {
+    pthread_mutex_lock(&gStateLock);
+    if (PhoneInfoPoolClaimRefill(&gPool, gTarget)) pthread_cond_signal(&gRefillWanted);
+    pthread_mutex_unlock(&gStateLock);
+}
+
+// refillYieldingToJobs:, one claimed refill at a time.
+static void *refillThread(void *unused) {
+    (void)unused;
+    pthread_mutex_lock(&gStateLock);
+    while (!atomic_load(&gStop)) {
+        if (!gPool.refillScheduled) {
+            struct timespec until;
+            clock_gettime(CLOCK_REALTIME, &until);
+            until.tv_nsec += 1000000;
+            if (until.tv_nsec >= 1000000000) until.tv_sec++, until.tv_nsec -= 1000000000;
+            pthread_cond_timedwait(&gRefillWanted, &gStateLock, &until);
+            continue;
+        }
+        uint64_t generation;
+        while (!atomic_load(&gStop) && PhoneInfoPoolRefillNext(&gPool, gTarget, false, &generation)) {
+            pthread_mutex_unlock(&gStateLock);
+            pthread_mutex_lock(&gGenerateLock);
+            unsigned long label = readPrefs();
+            char fingerprint[32];
+            fingerprintOf(label, fingerprint, sizeof(fingerprint));
+            sleepMicros(gGenerateMicros / 8 + (long)(nextRandom() % (uint32_t)(gGenerateMicros / 4 + 1)));
+            Entry *entry = newEntry(label, readPrefs());
+            pthread_mutex_unlock(&gGenerateLock);
+            pthread_mutex_lock(&gStateLock);
+            PhoneInfoPoolOfferResult result = PhoneInfoPoolOffer(&gPool, generation, fingerprint, entry, releaseEntry);
+            if (result == PhoneInfoPoolStale) gStale++;
+            if (result == PhoneInfoPoolRestarted) gRestarts++;
+            if (result == PhoneInfoPoolFailed) break;
+        }
+        if (atomic_load(&gStop)) gPool.refillScheduled = false;
+    }
+    pthread_mutex_unlock(&gStateLock);
+    return NULL;
+}
+
+// SettingManager's saveToPrefs; half the time the notification is lost.
+static void *settingsThread(void *unused) {
+    (void)unused;
+    uint32_t random = 7;
+    while (!atomic_load(&gStop)) {
+        random = random * 1664525u + 1013904223u;
+        sleepMicros(200 + (long)(random >> 8) % 2000);
+        pthread_mutex_lock(&gPrefsLock);
+        gPrefsVersion++;
+        pthread_mutex_unlock(&gPrefsLock);
+        if ((random >> 20) & 1) {
+            pthread_mutex_lock(&gStateLock);
+            PhoneInfoPoolInvalidate(&gPool, releaseEntry);
+            pthread_mutex_unlock(&gStateLock);
+            scheduleRefill();
+        }
+    }
+    return NULL;
+}
+
+// takePhoneInfo: the fingerprint from the saved settings, then the pool.
+static void *takeThread(void *unused) {
+    (void)unused;
+    uint32_t random = 11;
+    while (!atomic_load(&gStop)) {
+        random = random * 1664525u + 1013904223u;
+        sleepMicros(100 + (long)(random >> 8) % 1500);
+        unsigned long seen = readPrefs();
+        char fingerprint[32];
+        fingerprintOf(seen, fingerprint, sizeof(fingerprint));
+        pthread_mutex_lock(&gStateLock);
+        Entry *entry = PhoneInfoPoolTake(&gPool, fingerprint, releaseEntry);
+        gTakes++;
+        if (entry) gHits++;
+        pthread_mutex_unlock(&gStateLock);
+        scheduleRefill();
+        if (!entry) continue;
+        CHECK(entry->labelVersion == seen, "took an entry labelled v%lu under v%lu", entry->labelVersion, seen);
+        CHECK(entry->dataVersion >= seen, "took an entry generated from v%lu under v%lu", entry->dataVersion, seen);
+        releaseEntry(entry);
+    }
+    return NULL;
+}
+
+static void races(int milliseconds) {
+    long created = gCreated, released = gReleased;
+    atomic_store(&gStop, false);
+    pthread_t refill, settings, takers[2];
+    pthread_create(&refill, NULL, refillThread, NULL);
+    pthread_create(&settings, NULL, settingsThread, NULL);
+    for (int i = 0; i < 2; i++) pthread_create(&takers[i], NULL, takeThread, NULL);
+    scheduleRefill();
+    sleepMicros((long)milliseconds * 1000);
+    atomic_store(&gStop, true);
+    pthread_join(settings, NULL);
+    for (int i = 0; i < 2; i++) pthread_join(takers[i], NULL);
+    pthread_join(refill, NULL);
+    PhoneInfoPoolFree(&gPool, releaseEntry);
+    CHECK(gCreated - created == gReleased - released, "%ld entries created, %ld released", gCreated - created,
+          gReleased - released);
+    CHECK(gHits > 0 && gStale + gRestarts > 0, "races never hit (%ld hits, %ld stale, %ld restarts)", gHits, gStale,
+          gRestarts);
+    fprintf(stderr, "test_phone_info_pool: races %ld takes, %ld pooled, %ld stale offers, %ld restarts, %lu settings\n",
+            gTakes, gHits, gStale, gRestarts, gPrefsVersion);
+}
+
+// ---- Timing ----
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+typedef enum { TakeInline, TakePooled, TakeLockedFingerprint } TakeMode;
+
+// One takePhoneInfo, in ms. Pooled takes that find the pool empty count as
+// misses; the caller then generates inline, which is not timed here.
+static double timedTake(TakeMode mode, bool *hit) {
+    double start = nowMs();
+    if (mode == TakeInline) {
+        pthread_mutex_lock(&gGenerateLock);
+        Entry *entry = generate(gGenerateMicros);
+        pthread_mutex_unlock(&gGenerateLock);
+        releaseEntry(entry);
+        *hit = true;
+        return nowMs() - start;
+    }
+    if (mode == TakeLockedFingerprint) pthread_mutex_lock(&gGenerateLock);
+    char fingerprint[32];
+    fingerprintOf(readPrefs(), fingerprint, sizeof(fingerprint));
+    if (mode == TakeLockedFingerprint) pthread_mutex_unlock(&gGenerateLock);
+    pthread_mutex_lock(&gStateLock);
+    Entry *entry = PhoneInfoPoolTake(&gPool, fingerprint, releaseEntry);
+    pthread_mutex_unlock(&gStateLock);
+    double elapsed = nowMs() - start;
+    *hit = entry != NULL;
+    if (entry) releaseEntry(entry);
+    scheduleRefill();
+    return elapsed;
+}
+
+static double timeTakes(const char *label, TakeMode mode, bool refilling, int count, double *p99) {
+    double *samples = calloc((size_t)count, sizeof(double));
+    int hits = 0;
+    atomic_store(&gStop, false);
+    gTarget = refilling ? 1u << 20 : (size_t)count + 1;
+    pthread_t refill;
+    pthread_create(&refill, NULL, refillThread, NULL);
+    scheduleRefill();
+    // Let the refill get ahead, so takes hit.
+    sleepMicros(refilling ? gGenerateMicros * 4 : gGenerateMicros * (long)count / 2);
+    for (int i = 0; i < count; i++) {
+        bool hit;
+        samples[i] = timedTake(mode, &hit);
+        hits += hit;
+        sleepMicros(gGenerateMicros / 4);
+    }
+    atomic_store(&gStop, true);
+    pthread_join(refill, NULL);
+    PhoneInfoPoolFree(&gPool, releaseEntry);
+    qsort(samples, (size_t)count, sizeof(double), compareDoubles);
+    double p50 = samples[count / 2];
+    *p99 = samples[count * 99 / 100];
+    fprintf(stderr, "test_phone_info_pool: %-34s p50 %8.3f ms  p99 %8.3f ms  (%d of %d pooled)\n", label, p50, *p99,
+            hits, count);
+    free(samples);
+    return p50;
+}
+
+static void timing(void) {
+    double p99;
+    const int count = 200;
+    gTarget = 3;
+    double inlineP50 = timeTakes("inline generation", TakeInline, false, 40, &p99);
+    double idleP50 = timeTakes("pooled, idle", TakePooled, false, count, &p99);
+    double lockedP50 = timeTakes("pooled, refilling, locked settings", TakeLockedFingerprint, true, count, &p99);
+    double nowP50 = timeTakes("pooled, refilling, saved settings", TakePooled, true, count, &p99);
+    CHECK(idleP50 < inlineP50 / 10, "pooled take %.3f ms, inline %.3f ms", idleP50, inlineP50);
+    // Reading the settings under the generation lock waited for the refill;
+    // now a take only waits for the pool's own lock.
+    CHECK(nowP50 < gGenerateMicros / 1e3 / 4, "take during a refill %.3f ms with %ld us generations", nowP50,
+          gGenerateMicros);
+    (void)lockedP50;
+}
+
+int main(int argc, char *argv[]) {
+    int raceMs = argc > 1 ? atoi(argv[1]) : 1500;
+    if (argc > 2) gGenerateMicros = atol(argv[2]);
+    if (gGenerateMicros < 100) gGenerateMicros = 100;
+
+    generationCases();
+    fingerprintCases();
+    randomSequences(200000);
+    races(raceMs);
+    timing();
+
+    CHECK(gCreated == gReleased, "%ld entries created, %ld released", gCreated, gReleased);
+    if (gFailures) {
+        fprintf(stderr, "test_phone_info_pool: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_phone_info_pool: %d checks passed\n", gChecks);
+    return 0;
+}
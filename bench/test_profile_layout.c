@@ -0,0 +1,346 @@
+// Checks where ProfileManager keeps backup directories
+// (common/ProfileLayoutCore.m): sharded paths from the id's FNV-1a hash,
+// lookups that prefer an existing flat directory only until the migration is
+// marked complete, the marker written durably and read back as a restart
+// would, and a migration by rename leaving every profile findable.
+//
+// Then times the flat and sharded layouts at 1k, 10k and 50k profiles:
+// creating every directory (sharded creates its two parents as
+// createShardForProfileId: does), looking each up and stat()ing it (flat;
+// sharded with the flat probe before the marker; sharded after it), and
+// enumerating every profile directory.
+//
+//   make -C bench test
+//   build/test_profile_layout [profiles...]
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ProfileLayoutCore.h"
+
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_profile_layout: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+static char gRoot[] = "/tmp/test_profile_layout.XXXXXX";
+
+static uint32_t gRandom = 1;
+static uint32_t nextRandom(void) {
+    gRandom = gRandom * 1664525u + 1013904223u;
+    return gRandom >> 8;
+}
+
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+static void removeTree(const char *path) {
+    char command[512];
+    snprintf(command, sizeof(command), "rm -rf '%s'", path);
+    if (system(command) != 0) fprintf(stderr, "test_profile_layout: could not remove %s\n", path);
+}
+
+// generateProfileID: a millisecond timestamp, 13 digits.
+static void profileId(size_t i, char *out, size_t size) {
+    snprintf(out, size, "%lld", 1700000000000LL + (long long)i * 37);
+}
+
+static bool isDirectory(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// ---- Paths ----
+
+static void pathCases(void) {
+    char path[256], expected[256];
+    const char *ids[] = { "1700000000000", "1", "", "a/b" };
+    for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); i++) {
+        // FNV-1a 32, independently of ProfileJournalChecksum.
+        uint32_t hash = 0x811c9dc5;
+        for (const char *c = ids[i]; *c; c++) hash = (hash ^ (uint8_t)*c) * 0x01000193;
+        snprintf(expected, sizeof(expected), "/r/%02x/%02x/%s", hash & 0xff, (hash >> 8) & 0xff, ids[i]);
+        CHECK(ProfileLayoutShardedPath("/r", ids[i], path, sizeof(path)) && strcmp(path, expected) == 0,
+              "sharded path of \"%s\" is %s, expected %s", ids[i], path, expected);
+    }
+    // Exactly fitting, and one byte short.
+    size_t length = strlen(expected);
+    CHECK(ProfileLayoutShardedPath("/r", "a/b", path, length + 1), "path that fits refused");
+    CHECK(!ProfileLayoutShardedPath("/r", "a/b", path, length), "truncated path accepted");
+    CHECK(!ProfileLayoutResolve("/flat", "/r", "1700000000000", false, path, 8), "truncated flat path accepted");
+
+    char flatRoot[128], shardRoot[128], flat[256], sharded[256];
+    snprintf(flatRoot, sizeof(flatRoot), "%s/paths", gRoot);
+    snprintf(shardRoot, sizeof(shardRoot), "%s/paths/profiles", gRoot);
+    mkdir(flatRoot, 0755);
+    snprintf(flat, sizeof(flat), "%s/1700000000000", flatRoot);
+    ProfileLayoutShardedPath(shardRoot, "1700000000000", sharded, sizeof(sharded));
+    // No flat directory: sharded, marker or not.
+    CHECK(ProfileLayoutResolve(flatRoot, shardRoot, "1700000000000", false, path, sizeof(path)) &&
+          strcmp(path, sharded) == 0, "missing flat directory resolved to %s", path);
+    // A flat directory wins until the layout is marked migrated.
+    mkdir(flat, 0755);
+    CHECK(ProfileLayoutResolve(flatRoot, shardRoot, "1700000000000", false, path, sizeof(path)) &&
+          strcmp(path, flat) == 0, "existing flat directory resolved to %s", path);
+    CHECK(ProfileLayoutResolve(flatRoot, shardRoot, "1700000000000", true, path, sizeof(path)) &&
+          strcmp(path, sharded) == 0, "migrated layout still probed the flat path: %s", path);
+}
+
+// ---- Marker ----
+
+static void markerCases(void) {
+    char shardRoot[128], marker[192], tmp[200];
+    snprintf(shardRoot, sizeof(shardRoot), "%s/marker/profiles", gRoot);
+    snprintf(marker, sizeof(marker), "%s/%s", shardRoot, kProfileLayoutMigratedMarker);
+    snprintf(tmp, sizeof(tmp), "%s.tmp", marker);
+    CHECK(!ProfileLayoutIsMigrated(shardRoot), "migrated before anything ran");
+    // The shard root's parent must exist; the root itself is created.
+    CHECK(ProfileLayoutMarkMigrated(shardRoot) == ENOENT, "marker written without its parent");
+    char parent[128];
+    snprintf(parent, sizeof(parent), "%s/marker", gRoot);
+    mkdir(parent, 0755);
+    CHECK(ProfileLayoutMarkMigrated(shardRoot) == 0, "marking failed: %s", strerror(errno));
+    CHECK(ProfileLayoutIsMigrated(shardRoot), "marker not read back");
+    CHECK(access(tmp, F_OK) != 0, "marker .tmp left behind");
+    CHECK(isDirectory(shardRoot), "shard root not created");
+    // Marking again is harmless.
+    CHECK(ProfileLayoutMarkMigrated(shardRoot) == 0 && ProfileLayoutIsMigrated(shardRoot), "second mark");
+    // A shard root that is a file cannot hold it.
+    char file[128];
+    snprintf(file, sizeof(file), "%s/marker/file", gRoot);
+    FILE *f = fopen(file, "w");
+    if (f) fclose(f);
+    CHECK(ProfileLayoutMarkMigrated(file) == ENOTDIR, "marker written under a file");
+    CHECK(!ProfileLayoutIsMigrated(file), "file read as migrated");
+}
+
+// migrateProfileDirectory: for each flat directory, one rename into the
+// sharded layout after creating its parents.
+static void migrationCase(size_t count) {
+    char flatRoot[128], shardRoot[128], id[32], flat[256], sharded[256], path[256];
+    snprintf(flatRoot, sizeof(flatRoot), "%s/migrate", gRoot);
+    snprintf(shardRoot, sizeof(shardRoot), "%s/migrate/profiles", gRoot);
+    mkdir(flatRoot, 0755);
+    mkdir(shardRoot, 0755);
+    for (size_t i = 0; i < count; i++) {
+        profileId(i, id, sizeof(id));
+        snprintf(flat, sizeof(flat), "%s/%s", flatRoot, id);
+        mkdir(flat, 0755);
+        snprintf(path, sizeof(path), "%s/%s/data", flatRoot, id);
+        FILE *f = fopen(path, "w");
+        if (f) fclose(f);
+    }
+    size_t moved = 0;
+    for (size_t i = 0; i < count; i++) {
+        profileId(i, id, sizeof(id));
+        snprintf(flat, sizeof(flat), "%s/%s", flatRoot, id);
+        // Half way, every profile is findable wherever it is.
+        if (i == count / 2) {
+            for (size_t j = 0; j < count; j++) {
+                char other[32];
+                profileId(j, other, sizeof(other));
+                ProfileLayoutResolve(flatRoot, shardRoot, other, false, path, sizeof(path));
+                strncat(path, "/data", sizeof(path) - strlen(path) - 1);
+                if (access(path, F_OK) != 0) {
+                    CHECK(false, "profile %s lost mid-migration", other);
+                    break;
+                }
+            }
+        }
+        ProfileLayoutShardedPath(shardRoot, id, sharded, sizeof(sharded));
+        char *leaf = strrchr(sharded, '/');
+        *leaf = '\0';
+        char *middle = strrchr(sharded, '/');
+        *middle = '\0';
+        mkdir(sharded, 0755);
+        *middle = '/';
+        mkdir(sharded, 0755);
+        *leaf = '/';
+        if (rename(flat, sharded) == 0) moved++;
+    }
+    CHECK(moved == count, "%zu of %zu moved", moved, count);
+    CHECK(ProfileLayoutMarkMigrated(shardRoot) == 0, "marking the migrated layout");
+    bool migrated = ProfileLayoutIsMigrated(shardRoot);
+    for (size_t i = 0; i < count; i++) {
+        profileId(i, id, sizeof(id));
+        ProfileLayoutResolve(flatRoot, shardRoot, id, migrated, path, sizeof(path));
+        strncat(path, "/data", sizeof(path) - strlen(path) - 1);
+        if (access(path, F_OK) != 0) {
+            CHECK(false, "profile %s lost after migration", id);
+            break;
+        }
+    }
+}
+
+// ---- Timing ----
+
+static size_t countEntries(const char *path, bool directoriesOnly, const char *prefix, size_t *largest) {
+    DIR *dir = opendir(path);
+    if (!dir) return 0;
+    size_t count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir))) {
+        if (entry->d_name[0] == '.') continue;
+        if (directoriesOnly && entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) continue;
+        if (prefix && strncmp(entry->d_name, prefix, strlen(prefix)) != 0) continue;
+        count++;
+    }
+    closedir(dir);
+    if (largest && count > *largest) *largest = count;
+    return count;
+}
+
+// Every profile under the two shard levels.
+static size_t enumerateSharded(const char *shardRoot, size_t *largest) {
+    size_t total = 0;
+    char level1[512], level2[768];
+    DIR *top = opendir(shardRoot);
+    if (!top) return 0;
+    struct dirent *a;
+    while ((a = readdir(top))) {
+        if (a->d_name[0] == '.') continue;
+        snprintf(level1, sizeof(level1), "%s/%s", shardRoot, a->d_name);
+        DIR *middle = opendir(level1);
+        if (!middle) continue;
+        struct dirent *b;
+        size_t children = 0;
+        while ((b = readdir(middle))) {
+            if (b->d_name[0] == '.') continue;
+            children++;
+            snprintf(level2, sizeof(level2), "%s/%s", level1, b->d_name);
+            total += countEntries(level2, true, NULL, largest);
+        }
+        closedir(middle);
+        if (largest && children > *largest) *largest = children;
+    }
+    closedir(top);
+    return total;
+}
+
+static void timing(size_t count) {
+    char flatRoot[128], shardRoot[128], id[32], path[256];
+    snprintf(flatRoot, sizeof(flatRoot), "%s/flat%zu", gRoot, count);
+    snprintf(shardRoot, sizeof(shardRoot), "%s/sharded%zu/profiles", gRoot, count);
+    mkdir(flatRoot, 0755);
+    snprintf(path, sizeof(path), "%s/sharded%zu", gRoot, count);
+    mkdir(path, 0755);
+    mkdir(shardRoot, 0755);
+    // An empty flat root for the sharded lookups to probe, as ProjectX/ is.
+    char emptyFlat[128];
+    snprintf(emptyFlat, sizeof(emptyFlat), "%s/sharded%zu", gRoot, count);
+
+    double start = nowMs();
+    size_t created = 0;
+    for (size_t i = 0; i < count; i++) {
+        profileId(i, id, sizeof(id));
+        snprintf(path, sizeof(path), "%s/%s", flatRoot, id);
+        if (mkdir(path, 0755) == 0) created++;
+    }
+    double flatCreate = nowMs() - start;
+    CHECK(created == count, "flat: %zu of %zu created", created, count);
+
+    start = nowMs();
+    created = 0;
+    for (size_t i = 0; i < count; i++) {
+        profileId(i, id, sizeof(id));
+        ProfileLayoutShardedPath(shardRoot, id, path, sizeof(path));
+        // createDirectoryIfNeeded: on the parent, then the directory itself.
+        char *leaf = strrchr(path, '/');
+        *leaf = '\0';
+        if (!isDirectory(path)) {
+            char *middle = strrchr(path, '/');
+            *middle = '\0';
+            mkdir(path, 0755);
+            *middle = '/';
+            mkdir(path, 0755);
+        }
+        *leaf = '/';
+        if (mkdir(path, 0755) == 0) created++;
+    }
+    double shardedCreate = nowMs() - start;
+    CHECK(created == count, "sharded: %zu of %zu created", created, count);
+
+    // Lookups in random order, each followed by the stat() its caller does.
+    size_t lookups = count < 20000 ? 20000 : count;
+    size_t found[3] = { 0 };
+    double lookup[3];
+    for (int mode = 0; mode < 3; mode++) {
+        gRandom = 7;
+        start = nowMs();
+        for (size_t i = 0; i < lookups; i++) {
+            profileId(nextRandom() % count, id, sizeof(id));
+            bool resolved = mode == 0 ? ProfileLayoutResolve(flatRoot, shardRoot, id, false, path, sizeof(path))
+                                      : ProfileLayoutResolve(emptyFlat, shardRoot, id, mode == 2, path, sizeof(path));
+            if (resolved && isDirectory(path)) found[mode]++;
+        }
+        lookup[mode] = (nowMs() - start) * 1e3 / (double)lookups;
+        CHECK(found[mode] == lookups, "lookup mode %d found %zu of %zu", mode, found[mode], lookups);
+    }
+
+    start = nowMs();
+    size_t largestFlat = 0;
+    size_t flatCount = countEntries(flatRoot, true, "17", &largestFlat);
+    double flatEnumerate = nowMs() - start;
+    start = nowMs();
+    size_t largestSharded = 0;
+    size_t shardedCount = enumerateSharded(shardRoot, &largestSharded);
+    double shardedEnumerate = nowMs() - start;
+    CHECK(flatCount == count && shardedCount == count, "enumerated %zu flat, %zu sharded of %zu", flatCount,
+          shardedCount, count);
+    // No directory grows with the profile count: at most 256 shards under a
+    // level, and leaves hold a handful of profiles.
+    CHECK(largestSharded <= 256, "largest sharded directory has %zu entries", largestSharded);
+
+    fprintf(stderr, "test_profile_layout: %6zu profiles  create  flat %8.1f ms  sharded %8.1f ms\n", count,
+            flatCreate, shardedCreate);
+    fprintf(stderr, "test_profile_layout: %6zu profiles  lookup  flat %6.2f us  sharded %6.2f us probing, "
+            "%6.2f us marked\n", count, lookup[0], lookup[1], lookup[2]);
+    fprintf(stderr, "test_profile_layout: %6zu profiles  list    flat %8.1f ms  sharded %8.1f ms  "
+            "(largest directory %zu vs %zu)\n", count, flatEnumerate, shardedEnumerate, largestFlat, largestSharded);
+    snprintf(path, sizeof(path), "%s/sharded%zu", gRoot, count);
+    removeTree(flatRoot);
+    removeTree(path);
+}
+
+int main(int argc, char *argv[]) {
+    if (!mkdtemp(gRoot)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    pathCases();
+    markerCases();
+    migrationCase(500);
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            if (atoi(argv[i]) > 0) timing((size_t)atoi(argv[i]));
+        }
+    } else {
+        timing(1000);
+        timing(10000);
+        timing(50000);
+    }
+
+    removeTree(gRoot);
+    if (gFailures) {
+        fprintf(stderr, "test_profile_layout: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_profile_layout: %d checks passed\n", gChecks);
+    return 0;
+}
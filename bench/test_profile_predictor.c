@@ -0,0 +1,199 @@
+// Checks ProfilePredictor (daemon/ProfilePredictorCore.m): the fallback order,
+// the 64-transition window and tie breaking, then its hit rate (the predicted
+// profile is the one switched to next, so ProfileStager staged the right one)
+// on simulated operators: fixed cycles, ping-pong, a changed cycle, a favourite
+// per profile, and uniformly random switching.
+//
+//   make -C bench test
+//   build/test_profile_predictor
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ProfilePredictorCore.h"
+
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_profile_predictor: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+#define kProfileCount 20
+static char gNames[kProfileCount][16];
+static const char *gIds[kProfileCount];
+
+static uint32_t gRandom = 12345;
+static uint32_t nextRandom(void) {
+    gRandom = gRandom * 1664525u + 1013904223u;
+    return gRandom >> 8;
+}
+
+// ---- Basics ----
+
+static void basics(void) {
+    ProfilePredictorHistory history = { 0 };
+    const char *three[] = { "a", "b", "c" };
+
+    // No history: the next profile in list order, wrapping.
+    CHECK(ProfilePredictorPredict(&history, "a", three, 3) == 1, "fallback after a");
+    CHECK(ProfilePredictorPredict(&history, "c", three, 3) == 0, "fallback does not wrap");
+    CHECK(ProfilePredictorPredict(&history, "x", three, 3) == SIZE_MAX, "unknown current predicted");
+    CHECK(ProfilePredictorPredict(&history, "a", three, 1) == SIZE_MAX, "single profile predicted");
+    CHECK(ProfilePredictorPredict(&history, "", three, 3) == SIZE_MAX, "empty current predicted");
+    CHECK(ProfilePredictorPredict(&history, NULL, three, 3) == SIZE_MAX, "NULL current predicted");
+
+    // Self switches and empty ids are not recorded.
+    ProfilePredictorRecord(&history, "a", "a");
+    ProfilePredictorRecord(&history, "", "b");
+    ProfilePredictorRecord(&history, NULL, "b");
+    CHECK(history.count == 0, "recorded %zu bogus transitions", history.count);
+
+    // History beats list order; a deleted successor is skipped.
+    ProfilePredictorRecord(&history, "a", "c");
+    CHECK(ProfilePredictorPredict(&history, "a", three, 3) == 2, "history ignored");
+    const char *withoutC[] = { "a", "b" };
+    CHECK(ProfilePredictorPredict(&history, "a", withoutC, 2) == 1, "deleted successor predicted");
+
+    // Most frequent wins; ties go to the most recent.
+    ProfilePredictorRecord(&history, "a", "b");
+    CHECK(ProfilePredictorPredict(&history, "a", three, 3) == 1, "tie not given to the most recent");
+    ProfilePredictorRecord(&history, "a", "c");
+    CHECK(ProfilePredictorPredict(&history, "a", three, 3) == 2, "most frequent lost");
+
+    // Only the last 64 transitions count.
+    for (int i = 0; i < kProfilePredictorMaxTransitions; i++) ProfilePredictorRecord(&history, "b", "c");
+    CHECK(history.count == kProfilePredictorMaxTransitions, "window holds %zu", history.count);
+    CHECK(ProfilePredictorPredict(&history, "a", three, 3) == 1, "transitions older than the window counted");
+    ProfilePredictorFree(&history);
+    CHECK(history.count == 0, "free left %zu", history.count);
+}
+
+// ---- Hit rate ----
+
+typedef size_t (*NextProfileFunc)(size_t current, size_t step);
+
+// Runs `switches` switches chosen by next, asking for a prediction before each
+// as ProfileStager does after every switch. Returns the hit rate over the
+// switches after `warmup`.
+static double hitRate(NextProfileFunc next, size_t switches, size_t warmup) {
+    ProfilePredictorHistory history = { 0 };
+    size_t current = 0, hits = 0, counted = 0;
+    for (size_t step = 0; step < switches; step++) {
+        size_t predicted = ProfilePredictorPredict(&history, gIds[current], gIds, kProfileCount);
+        CHECK(predicted != current, "predicted the current profile at step %zu", step);
+        size_t chosen = next(current, step);
+        if (step >= warmup) {
+            counted++;
+            hits += predicted == chosen;
+        }
+        ProfilePredictorRecord(&history, gIds[current], gIds[chosen]);
+        current = chosen;
+    }
+    ProfilePredictorFree(&history);
+    return counted ? (double)hits / counted : 0;
+}
+
+// Cycles 10 profiles in list order.
+static size_t cycleInOrder(size_t current, size_t step) {
+    (void)step;
+    return (current + 1) % 10;
+}
+
+// Cycles 10 profiles in an order unrelated to the list.
+static const size_t kShuffled[10] = { 7, 2, 15, 0, 11, 4, 19, 9, 13, 5 };
+static size_t positionIn(const size_t *cycle, size_t n, size_t profile) {
+    for (size_t i = 0; i < n; i++) {
+        if (cycle[i] == profile) return i;
+    }
+    return n - 1; // not in the cycle yet: start it
+}
+static size_t cycleShuffled(size_t current, size_t step) {
+    (void)step;
+    return kShuffled[(positionIn(kShuffled, 10, current) + 1) % 10];
+}
+
+static size_t pingPong(size_t current, size_t step) {
+    (void)step;
+    return current == 3 ? 16 : 3;
+}
+
+// Shuffled cycle for 400 switches, then a different one.
+static const size_t kSecondCycle[8] = { 1, 18, 6, 12, 3, 17, 8, 10 };
+static size_t cycleChanged(size_t current, size_t step) {
+    if (step < 400) return cycleShuffled(current, step);
+    return kSecondCycle[(positionIn(kSecondCycle, 8, current) + 1) % 8];
+}
+
+// Each profile has a favourite successor taken 70% of the time.
+static size_t favouriteOf(size_t profile) {
+    size_t f = (profile * 7 + 3) % kProfileCount;
+    return f == profile ? (profile + 1) % kProfileCount : f;
+}
+static size_t favourite(size_t current, size_t step) {
+    (void)step;
+    if (nextRandom() % 10 < 7) return favouriteOf(current);
+    size_t other;
+    do other = nextRandom() % kProfileCount; while (other == current);
+    return other;
+}
+
+static size_t uniform(size_t current, size_t step) {
+    (void)step;
+    size_t other;
+    do other = nextRandom() % 10; while (other == current);
+    return other;
+}
+
+static void hitRates(void) {
+    double rate = hitRate(cycleInOrder, 500, 0);
+    fprintf(stderr, "test_profile_predictor: hit rate cycle in list order %.2f\n", rate);
+    CHECK(rate >= 0.99, "cycle in list order: %.2f", rate);
+
+    rate = hitRate(cycleShuffled, 500, 20);
+    fprintf(stderr, "test_profile_predictor: hit rate shuffled cycle %.2f\n", rate);
+    CHECK(rate >= 0.99, "shuffled cycle after one lap: %.2f", rate);
+
+    rate = hitRate(pingPong, 200, 3);
+    fprintf(stderr, "test_profile_predictor: hit rate ping-pong %.2f\n", rate);
+    CHECK(rate >= 0.99, "ping-pong: %.2f", rate);
+
+    // Recovers from a new pattern well within one window.
+    rate = hitRate(cycleChanged, 800, 400 + kProfilePredictorMaxTransitions);
+    fprintf(stderr, "test_profile_predictor: hit rate after a changed cycle %.2f\n", rate);
+    CHECK(rate >= 0.95, "changed cycle: %.2f", rate);
+
+    // A perfect guess gets 0.7 + 0.3 / 19 = 0.72. With 20 profiles the window
+    // holds about three transitions per profile, so the estimate is noisy and
+    // lands near 0.6.
+    gRandom = 12345;
+    rate = hitRate(favourite, 5000, 200);
+    fprintf(stderr, "test_profile_predictor: hit rate favourite successor %.2f\n", rate);
+    CHECK(rate >= 0.5, "favourite successor: %.2f", rate);
+
+    // No pattern to find: about 1/9, the rate of any fixed guess.
+    gRandom = 12345;
+    rate = hitRate(uniform, 5000, 0);
+    fprintf(stderr, "test_profile_predictor: hit rate uniform %.2f\n", rate);
+    CHECK(rate >= 0.06 && rate <= 0.2, "uniform: %.2f", rate);
+}
+
+int main(void) {
+    for (size_t i = 0; i < kProfileCount; i++) {
+        snprintf(gNames[i], sizeof(gNames[i]), "profile-%02zu", i);
+        gIds[i] = gNames[i];
+    }
+    basics();
+    hitRates();
+    if (gFailures) {
+        fprintf(stderr, "test_profile_predictor: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_profile_predictor: %d checks passed\n", gChecks);
+    return 0;
+}
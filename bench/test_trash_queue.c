@@ -0,0 +1,322 @@
+// Checks TrashQueue's file system side (daemon/TrashQueueCore.m): entry names
+// sorting by age, recovery of the queue after a restart (including an entry
+// the reaper had half removed and stray entries that must not be followed),
+// failed moves leaving the path alone, and the allocated size with hard links
+// counted once. Then times what the caller waits for: deleting a tree in place
+// against moving it to the trash, with the reaper's removal timed separately
+// (informational, never fails).
+//
+//   make -C bench test
+//   build/test_trash_queue FILES    timing trees of FILES files
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FileRemoverCore.h"
+#include "TrashQueueCore.h"
+
+static char gRoot[64];
+static int gFailures;
+static int gChecks;
+
+#define CHECK(cond, ...) do { \
+    gChecks++; \
+    if (!(cond)) { \
+        if (gFailures++ < 20) { fprintf(stderr, "test_trash_queue: " __VA_ARGS__); fputc('\n', stderr); } \
+    } \
+} while (0)
+
+// ---- Tree helpers ----
+
+static void writeFile(const char *path, size_t bytes) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(path);
+        exit(2);
+    }
+    char block[4096];
+    memset(block, 'x', sizeof(block));
+    while (bytes > 0) {
+        size_t n = bytes < sizeof(block) ? bytes : sizeof(block);
+        if (write(fd, block, n) != (ssize_t)n) {
+            perror(path);
+            exit(2);
+        }
+        bytes -= n;
+    }
+    close(fd);
+}
+
+static void makeDir(const char *path) {
+    if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        perror(path);
+        exit(2);
+    }
+}
+
+// A tree of files small files spread over subdirectories of 100.
+static void buildTree(const char *root, unsigned files) {
+    char path[512];
+    makeDir(root);
+    for (unsigned f = 0; f < files; f++) {
+        if (f % 100 == 0) {
+            snprintf(path, sizeof(path), "%s/d%04u", root, f / 100);
+            makeDir(path);
+        }
+        snprintf(path, sizeof(path), "%s/d%04u/f%03u", root, f / 100, f % 100);
+        writeFile(path, f % 5 == 0 ? 2000 : 100);
+    }
+}
+
+static bool exists(const char *path) {
+    struct stat st;
+    return lstat(path, &st) == 0;
+}
+
+// Removes dir/name the way the reaper does; returns the failure count.
+static size_t removeUnder(const char *dir, const char *name) {
+    FileRemoverContext ctx = { .onError = NULL, .context = NULL, .rootPath = dir };
+    atomic_init(&ctx.failures, 0);
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        perror(dir);
+        exit(2);
+    }
+    struct stat st;
+    if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode)) {
+        FileRemoverRemoveDirectoryAt(&ctx, fd, name);
+    } else if (unlinkat(fd, name, 0) != 0 && errno != ENOENT) {
+        atomic_fetch_add(&ctx.failures, 1);
+    }
+    close(fd);
+    return atomic_load(&ctx.failures);
+}
+
+static double nowMs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e3 + (double)ts.tv_nsec / 1e6;
+}
+
+// ---- Names ----
+
+static void names(void) {
+    char trash[256], path[512];
+    snprintf(trash, sizeof(trash), "%s/names-trash", gRoot);
+    makeDir(trash);
+
+    // Within one clock tick only the sequence orders them, 9 before 10 included.
+    enum { kMoves = 40 };
+    char moved[kMoves][kTrashQueueNameSize];
+    for (int i = 0; i < kMoves; i++) {
+        snprintf(path, sizeof(path), "%s/item%02d", gRoot, i);
+        writeFile(path, 10);
+        CHECK(TrashQueueMove(path, trash, (uint64_t)i + 1, moved[i]) == 0, "moving %s failed", path);
+        CHECK(!exists(path), "%s still there after the move", path);
+        CHECK(strlen(moved[i]) == kTrashQueueNameSize - 1, "name %s has the wrong length", moved[i]);
+    }
+    char **list;
+    size_t count;
+    CHECK(TrashQueueListEntries(trash, &list, &count) == 0, "listing %s failed", trash);
+    CHECK(count == kMoves, "listed %zu of %d entries", count, kMoves);
+    for (size_t i = 0; i < count && i < kMoves; i++) {
+        CHECK(strcmp(list[i], moved[i]) == 0, "entry %zu is %s, moved %s", i, list[i], moved[i]);
+    }
+    TrashQueueFreeNames(list, count);
+
+    // A failed move leaves the path alone and the trash unchanged.
+    char name[kTrashQueueNameSize];
+    snprintf(path, sizeof(path), "%s/missing", gRoot);
+    CHECK(TrashQueueMove(path, trash, 99, name) == ENOENT, "moving a missing path did not fail with ENOENT");
+    snprintf(path, sizeof(path), "%s/kept", gRoot);
+    writeFile(path, 10);
+    char elsewhere[256];
+    snprintf(elsewhere, sizeof(elsewhere), "%s/no-such-trash", gRoot);
+    CHECK(TrashQueueMove(path, elsewhere, 100, name) == ENOENT, "moving into a missing trash did not fail");
+    CHECK(exists(path), "%s lost by a failed move", path);
+    CHECK(TrashQueueListEntries(trash, &list, &count) == 0 && count == kMoves, "failed moves changed the trash");
+    TrashQueueFreeNames(list, count);
+
+    CHECK(TrashQueueListEntries(elsewhere, &list, &count) == ENOENT && count == 0 && !list,
+          "listing a missing trash did not fail with ENOENT");
+    snprintf(path, sizeof(path), "%s/names-empty", gRoot);
+    makeDir(path);
+    CHECK(TrashQueueListEntries(path, &list, &count) == 0 && count == 0, "empty trash listed %zu entries", count);
+    TrashQueueFreeNames(list, count);
+}
+
+// ---- Restart recovery ----
+
+static void recovery(void) {
+    char trash[256], path[512], outside[256];
+    snprintf(trash, sizeof(trash), "%s/recovery-trash", gRoot);
+    makeDir(trash);
+    snprintf(outside, sizeof(outside), "%s/outside", gRoot);
+    buildTree(outside, 50);
+
+    // Three trees queued by the previous run.
+    char queued[3][kTrashQueueNameSize];
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s/tree%d", gRoot, i);
+        buildTree(path, 300);
+        CHECK(TrashQueueMove(path, trash, (uint64_t)i + 1, queued[i]) == 0, "moving %s failed", path);
+    }
+    // The reaper got half way through the oldest one before the daemon died.
+    char oldest[512];
+    snprintf(oldest, sizeof(oldest), "%s/%s", trash, queued[0]);
+    removeUnder(oldest, "d0000");
+    removeUnder(oldest, "d0001");
+    // An entry holding a symlink out of the trash, and one that is a symlink.
+    char linked[512];
+    snprintf(path, sizeof(path), "%s/links", gRoot);
+    makeDir(path);
+    snprintf(linked, sizeof(linked), "%s/links/to-outside", gRoot);
+    CHECK(symlink(outside, linked) == 0, "symlink %s failed", linked);
+    char linkDir[kTrashQueueNameSize], linkEntry[kTrashQueueNameSize];
+    CHECK(TrashQueueMove(path, trash, 4, linkDir) == 0, "moving %s failed", path);
+    snprintf(path, sizeof(path), "%s/bare-link", gRoot);
+    CHECK(symlink(outside, path) == 0, "symlink %s failed", path);
+    CHECK(TrashQueueMove(path, trash, 5, linkEntry) == 0, "moving %s failed", path);
+
+    // The restart: the trash alone is the queue.
+    char **list;
+    size_t count;
+    CHECK(TrashQueueListEntries(trash, &list, &count) == 0, "listing %s failed", trash);
+    CHECK(count == 5, "recovered %zu of 5 entries", count);
+    const char *expected[] = { queued[0], queued[1], queued[2], linkDir, linkEntry };
+    for (size_t i = 0; i < count && i < 5; i++) {
+        CHECK(strcmp(list[i], expected[i]) == 0, "recovered entry %zu is %s, expected %s", i, list[i], expected[i]);
+    }
+    uint64_t queuedBytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        snprintf(path, sizeof(path), "%s/%s", trash, list[i]);
+        queuedBytes += TrashQueueAllocatedBytes(path);
+    }
+    uint64_t outsideBytes = TrashQueueAllocatedBytes(outside);
+    CHECK(queuedBytes > 0 && outsideBytes > 0, "nothing measured");
+    // Reaping in recovered order empties the trash without following links.
+    for (size_t i = 0; i < count; i++) {
+        CHECK(removeUnder(trash, list[i]) == 0, "reaping %s failed", list[i]);
+    }
+    TrashQueueFreeNames(list, count);
+    CHECK(TrashQueueListEntries(trash, &list, &count) == 0 && count == 0, "%zu entries left after reaping", count);
+    TrashQueueFreeNames(list, count);
+    CHECK(TrashQueueAllocatedBytes(outside) == outsideBytes, "reaping a symlink removed data outside the trash");
+    snprintf(path, sizeof(path), "%s/d0000/f000", outside);
+    CHECK(exists(path), "%s removed through a symlink", path);
+
+    // A second restart with nothing left does not resurrect anything.
+    CHECK(TrashQueueListEntries(trash, &list, &count) == 0 && count == 0, "restart after reaping found %zu", count);
+    TrashQueueFreeNames(list, count);
+}
+
+// ---- Allocated size ----
+
+static void allocatedSize(void) {
+    char dir[256], path[512], second[512];
+    snprintf(dir, sizeof(dir), "%s/size", gRoot);
+    makeDir(dir);
+    uint64_t empty = TrashQueueAllocatedBytes(dir);
+    snprintf(path, sizeof(path), "%s/data", dir);
+    writeFile(path, 256 * 1024);
+    uint64_t one = TrashQueueAllocatedBytes(dir);
+    CHECK(one >= empty + 256 * 1024, "256 KB file measured as %llu bytes", (unsigned long long)(one - empty));
+    CHECK(TrashQueueAllocatedBytes(path) == one - empty, "file alone measured differently");
+
+    // A second link to the same data frees nothing more.
+    snprintf(second, sizeof(second), "%s/data-link", dir);
+    CHECK(link(path, second) == 0, "link %s failed", second);
+    CHECK(TrashQueueAllocatedBytes(dir) == one, "hard link counted twice: %llu vs %llu",
+          (unsigned long long)TrashQueueAllocatedBytes(dir), (unsigned long long)one);
+    // Linked from outside the tree it is still counted, once.
+    char sub[512];
+    snprintf(sub, sizeof(sub), "%s/sub", dir);
+    makeDir(sub);
+    snprintf(second, sizeof(second), "%s/sub/a", dir);
+    CHECK(rename(path, second) == 0, "rename %s failed", path);
+    CHECK(TrashQueueAllocatedBytes(sub) >= 256 * 1024, "linked file outside the tree not counted");
+
+    // Sparse files count allocated blocks, not their length.
+    snprintf(path, sizeof(path), "%s/sparse", dir);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    CHECK(fd >= 0 && ftruncate(fd, 1 << 30) == 0, "creating %s failed", path);
+    close(fd);
+    CHECK(TrashQueueAllocatedBytes(path) < 1 << 20, "sparse file measured as %llu bytes",
+          (unsigned long long)TrashQueueAllocatedBytes(path));
+
+    snprintf(path, sizeof(path), "%s/missing", dir);
+    CHECK(TrashQueueAllocatedBytes(path) == 0, "missing path measured as nonzero");
+}
+
+// ---- Caller latency ----
+
+static void latency(unsigned files) {
+    char trash[256], path[512];
+    snprintf(trash, sizeof(trash), "%s/bench-trash", gRoot);
+    makeDir(trash);
+
+    snprintf(path, sizeof(path), "%s/bench-inplace", gRoot);
+    buildTree(path, files);
+    sync();
+    double start = nowMs();
+    size_t failures = removeUnder(gRoot, "bench-inplace");
+    double inPlaceMs = nowMs() - start;
+    CHECK(failures == 0 && !exists(path), "in-place removal failed");
+
+    snprintf(path, sizeof(path), "%s/bench-queued", gRoot);
+    buildTree(path, files);
+    sync();
+    char name[kTrashQueueNameSize];
+    start = nowMs();
+    int err = TrashQueueMove(path, trash, 1, name);
+    double moveMs = nowMs() - start;
+    CHECK(err == 0 && !exists(path), "move to trash failed");
+    snprintf(path, sizeof(path), "%s/%s", trash, name);
+    start = nowMs();
+    uint64_t bytes = TrashQueueAllocatedBytes(path);
+    double measureMs = nowMs() - start;
+    start = nowMs();
+    failures = removeUnder(trash, name);
+    double reapMs = nowMs() - start;
+    CHECK(failures == 0 && !exists(path), "reaping failed");
+
+    fprintf(stderr,
+            "test_trash_queue: %u files (%.1f MB): in place the caller waits %.2f ms; with the queue %.3f ms "
+            "(%.0fx less), then the reaper measures in %.2f ms and removes in %.2f ms\n",
+            files, (double)bytes / (1 << 20), inPlaceMs, moveMs, moveMs > 0 ? inPlaceMs / moveMs : 0, measureMs,
+            reapMs);
+}
+
+int main(int argc, char *argv[]) {
+    snprintf(gRoot, sizeof(gRoot), "/tmp/test_trash_queue.XXXXXX");
+    if (!mkdtemp(gRoot)) {
+        perror("mkdtemp");
+        return 2;
+    }
+    names();
+    recovery();
+    allocatedSize();
+    if (argc > 1) {
+        latency((unsigned)strtoul(argv[1], NULL, 10));
+    } else {
+        latency(1000);
+        latency(20000);
+    }
+
+    char command[128];
+    snprintf(command, sizeof(command), "rm -rf %s", gRoot);
+    if (system(command) != 0) fprintf(stderr, "test_trash_queue: could not remove %s\n", gRoot);
+    if (gFailures) {
+        fprintf(stderr, "test_trash_queue: %d of %d checks failed\n", gFailures, gChecks);
+        return 1;
+    }
+    fprintf(stderr, "test_trash_queue: %d checks passed\n", gChecks);
+    return 0;
+}
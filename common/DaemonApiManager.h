@@ -11,6 +11,13 @@
 
 - (NSDictionary *)getHookOptions;
 - (void)saveHookOptions:(NSDictionary *)options;
+- (NSDictionary *)getBackupRules;
+- (BOOL)saveBackupRules:(NSDictionary *)rules;
+// @{entries, bytes} waiting in the daemon's trash
+- (NSDictionary *)getTrashStatus;
+// @{bytes, archivedBytes, profiles: {id: @{bytes, archivedBytes, apps}}} from the daemon's size index
+- (NSDictionary *)getDiskUsage;
+- (NSDictionary *)getDiskUsageForProfile:(NSString *)profileId;
 - (PhoneInfo *) requestPhoneInfo;
 - (BOOL) savePhoneInfo:(PhoneInfo *)phoneInfo;
 - (void) newPhone:(void(^)(id response, NSError *error))completion;
@@ -100,6 +100,42 @@
     [self requestWithMethod:@"POST" path:SAVE_HOOK_OPTIONS data:options];
 }
 
+- (NSDictionary *)getBackupRules {
+    id response = [self requestWithMethod:@"GET" path:GET_BACKUP_RULES data:nil];
+    if (![response isKindOfClass:[NSDictionary class]]) return @{};
+    NSDictionary *data = response[@"data"];
+    return [data isKindOfClass:[NSDictionary class]] ? data : @{};
+}
+
+- (BOOL)saveBackupRules:(NSDictionary *)rules {
+    if (![rules isKindOfClass:[NSDictionary class]]) return NO;
+    id response = [self requestWithMethod:@"POST" path:SAVE_BACKUP_RULES data:@{ @"data": rules }];
+    return [response isKindOfClass:[NSDictionary class]] && [response[@"status"] isEqualToString:@"success"];
+}
+
+- (NSDictionary *)getTrashStatus {
+    id response = [self requestWithMethod:@"GET" path:TRASH_STATUS data:nil];
+    if (![response isKindOfClass:[NSDictionary class]]) return @{};
+    NSDictionary *data = response[@"data"];
+    return [data isKindOfClass:[NSDictionary class]] ? data : @{};
+}
+
+- (NSDictionary *)getDiskUsage {
+    id response = [self requestWithMethod:@"GET" path:DISK_USAGE data:nil];
+    if (![response isKindOfClass:[NSDictionary class]]) return @{};
+    NSDictionary *data = response[@"data"];
+    return [data isKindOfClass:[NSDictionary class]] ? data : @{};
+}
+
+- (NSDictionary *)getDiskUsageForProfile:(NSString *)profileId {
+    if (!profileId) return @{};
+    NSString *query = [profileId stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet URLQueryAllowedCharacterSet]];
+    id response = [self requestWithMethod:@"GET" path:[NSString stringWithFormat:@"%@?id=%@", DISK_USAGE, query] data:nil];
+    if (![response isKindOfClass:[NSDictionary class]]) return @{};
+    NSDictionary *data = response[@"data"];
+    return [data isKindOfClass:[NSDictionary class]] ? data : @{};
+}
+
 - (PhoneInfo *) requestPhoneInfo{
     __block PhoneInfo *phoneInfo;
     dispatch_semaphore_t semaphore = dispatch_semaphore_create(0); // 创建信号量
@@ -120,12 +156,61 @@
     return YES;
 }
 
+// /jobStatus 每轮最多等待的秒数，以及该请求的超时：守护进程最多挂起
+// kJobStatusMaxWait(25s)，超时必须比它长，否则安静的步骤会被误判为失败
+static const NSTimeInterval kJobPollWait = 20;
+static const NSTimeInterval kJobPollTimeout = 35;
+// 守护进程每轮至多 kJobStatusMaxWait 就会应答；连续这么多轮请求超时说明它已无响应，
+// 不再无限重试，按失败回调
+static const NSUInteger kJobPollMaxTimeouts = 3;
+
+// 耗时接口只返回 jobId，这里长轮询 /jobStatus 直到任务结束再回调，
+// 调用方看到的仍是「请求完成即操作完成」
+- (void) waitForJob:(NSString *)jobId since:(uint64_t)since timeouts:(NSUInteger)timeouts response:(id)response comp:(void(^)(id response, NSError *error))completion{
+    NSString *path = [NSString stringWithFormat:@"%@?id=%@&since=%llu&wait=%.0f", JOB_STATUS, jobId, since, kJobPollWait];
+    daemonGETWithTimeout(path, kJobPollTimeout, ^(id statusResponse, NSError *error) {
+        // 偶尔一轮超时只说明这一轮没等到应答，任务可能仍在进行，继续轮询
+        if ([error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorTimedOut) {
+            if (timeouts + 1 >= kJobPollMaxTimeouts) {
+                if (completion) completion(response, error);
+                return;
+            }
+            [self waitForJob:jobId since:since timeouts:timeouts + 1 response:response comp:completion];
+            return;
+        }
+        NSDictionary *job = [statusResponse isKindOfClass:[NSDictionary class]] ? statusResponse[@"data"] : nil;
+        if (error || ![job isKindOfClass:[NSDictionary class]]) {
+            if (completion) completion(response, error);
+            return;
+        }
+        NSString *state = job[@"state"];
+        if ([state isEqualToString:@"queued"] || [state isEqualToString:@"running"]) {
+            [self waitForJob:jobId since:[job[@"seq"] unsignedLongLongValue] timeouts:0 response:response comp:completion];
+            return;
+        }
+        NSMutableDictionary *result = [response isKindOfClass:[NSDictionary class]] ? [response mutableCopy] : [NSMutableDictionary dictionary];
+        result[@"job"] = job;
+        if (![state isEqualToString:@"succeeded"]) {
+            result[@"status"] = @"error";
+        }
+        if (completion) completion(result, nil);
+    });
+}
+
+- (void) completeAfterJob:(id)response error:(NSError *)error comp:(void(^)(id response, NSError *error))completion{
+    NSString *jobId = [response isKindOfClass:[NSDictionary class]] ? response[@"jobId"] : nil;
+    if (error || ![jobId isKindOfClass:[NSString class]]) {
+        // 旧版守护进程同步执行，直接回调
+        if (completion) completion(response, error);
+        return;
+    }
+    [self waitForJob:jobId since:0 timeouts:0 response:response comp:completion];
+}
+
 - (void) newPhone:(void(^)(id response, NSError *error))completion{
     daemonGET(NEW_PHONE, ^(id response, NSError *error) {
         // 如果有回调，执行回调
-        if (completion) {
-            completion(response, error);
-        }
+        [self completeAfterJob:response error:error comp:completion];
     });
 }
 
@@ -150,9 +235,7 @@
 - (void) switchBackup:(Profile *)profile comp:(void(^)(id response, NSError *error))completion{
     daemonPOST(SWITCH_BACKUP,[profile toDictionary], ^(id response, NSError *error) {
         // 如果有回调，执行回调
-        if (completion) {
-            completion(response, error);
-        }
+        [self completeAfterJob:response error:error comp:completion];
     });
 }
 - (NSArray *) getAllCarrier{
@@ -2,6 +2,11 @@
 #import "PhoneInfo.h"
 
 #define CurrentPhoneInfo() [[DataManager sharedManager]getPhoneInfo]
+
+// Bumped every time freshCacheData replaces the cached PhoneInfo, so hook-side
+// caches derived from it can tell when to rebuild without ObjC messaging.
+FOUNDATION_EXPORT uint32_t PXPhoneInfoGeneration(void);
+
 @interface DataManager : NSObject 
 
 + (instancetype)sharedManager;
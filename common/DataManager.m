@@ -2,6 +2,13 @@
 #import "PXBundleIdentifier.h"
 #import "DaemonApiManager.h"
 #import "ProjectXLogging.h"
+#include <stdatomic.h>
+
+static _Atomic uint32_t gPXPhoneInfoGeneration = 0;
+
+uint32_t PXPhoneInfoGeneration(void) {
+    return atomic_load_explicit(&gPXPhoneInfoGeneration, memory_order_acquire);
+}
 
 @interface DataManager()
 @property (nonatomic, strong) PhoneInfo *phoneInfo;
@@ -31,6 +38,7 @@
 }
 - (void) freshCacheData{
     _phoneInfo = [PhoneInfo loadFromPrefs];
+    atomic_fetch_add_explicit(&gPXPhoneInfoGeneration, 1, memory_order_release);
     NSString *bundleID = PXSafeBundleIdentifier();
     if (!_phoneInfo) {
         PXLog(@"[DataManager] ⚠️ PhoneInfo is nil for bundle=%@", bundleID);
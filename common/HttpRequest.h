@@ -6,6 +6,8 @@ typedef void (^RequestCompletionHandler)(id responseData, NSError *error);
 // GET请求
 void daemonGET(NSString *urlString, RequestCompletionHandler completion);
 void sendGETRequest(NSString *urlString, RequestCompletionHandler completion);
+// 长轮询等需要比默认 10 秒更长超时的请求
+void daemonGETWithTimeout(NSString *urlString, NSTimeInterval timeout, RequestCompletionHandler completion);
 
 // POST请求 - 支持多种数据类型
 void daemonPOST(NSString *urlString, id parameters, RequestCompletionHandler completion);
@@ -7,6 +7,10 @@ NSArray* convertCollectionToJSONCompatible(id collection);
 NSDictionary* convertDictionaryToJSONCompatible(NSDictionary *dictionary);
 NSString* formEncodedStringFromDictionary(NSDictionary *dictionary);
 void sendRequestWithMethod(NSString *urlString, NSString *method, id parameters, NSDictionary *headers, RequestCompletionHandler completion);
+void sendRequestWithTimeout(NSString *urlString, NSString *method, id parameters, NSDictionary *headers, NSTimeInterval timeout, RequestCompletionHandler completion);
+
+// 普通请求的超时时间（秒）
+static const NSTimeInterval kDefaultRequestTimeout = 10;
 
 #pragma mark - GET请求函数
 void daemonGET(NSString *urlString, RequestCompletionHandler completion){
@@ -17,6 +21,10 @@ void sendGETRequest(NSString *urlString, RequestCompletionHandler completion) {
     sendRequestWithMethod(urlString, @"GET", nil, nil, completion);
 }
 
+void daemonGETWithTimeout(NSString *urlString, NSTimeInterval timeout, RequestCompletionHandler completion) {
+    sendRequestWithTimeout([kMainUrl stringByAppendingString:urlString], @"GET", nil, nil, timeout, completion);
+}
+
 #pragma mark - POST请求函数
 void daemonPOST(NSString *urlString, id parameters, RequestCompletionHandler completion) {
     sendPOSTRequest([kMainUrl stringByAppendingString:urlString], parameters, nil, completion);
@@ -41,6 +49,10 @@ void sendPATCHRequest(NSString *urlString, id parameters, NSDictionary *headers,
 
 #pragma mark - 通用请求方法
 void sendRequestWithMethod(NSString *urlString, NSString *method, id parameters, NSDictionary *headers, RequestCompletionHandler completion) {
+    sendRequestWithTimeout(urlString, method, parameters, headers, kDefaultRequestTimeout, completion);
+}
+
+void sendRequestWithTimeout(NSString *urlString, NSString *method, id parameters, NSDictionary *headers, NSTimeInterval timeout, RequestCompletionHandler completion) {
     // 检查 URL 是否有效
     NSURL *url = [NSURL URLWithString:urlString];
     if (!url) {
@@ -62,7 +74,7 @@ void sendRequestWithMethod(NSString *urlString, NSString *method, id parameters,
     // 创建请求
     NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:url];
     [request setHTTPMethod:method];
-    [request setTimeoutInterval:10];
+    [request setTimeoutInterval:timeout];
     [request setValue:@"no-proxy" forHTTPHeaderField:@"Proxy-Connection"]; // 额外声明不要代理
     [request setValue:@"application/json" forHTTPHeaderField:@"Accept"];
     
@@ -0,0 +1,41 @@
+#ifndef PROFILE_JOURNAL_CORE_H
+#define PROFILE_JOURNAL_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The on-disk side of ProfileManager's journal, plain C so bench/ can crash it
+// at every byte on any host. ProfileManager owns the records (JSON objects)
+// and the snapshot format; this only frames, scans and writes bytes.
+//
+// A journal line is "<8 hex digit checksum> <payload>\n", the checksum being
+// FNV-1a 32 of the payload, which must not contain '\n'.
+
+// Bytes a line adds around its payload.
+#define kProfileJournalLineOverhead 10
+
+uint32_t ProfileJournalChecksum(const uint8_t *bytes, size_t length);
+
+// Appends one line with a single write, then fsyncs. Returns 0 or an errno; on
+// error part of the line may be on disk, and the next scan stops before it.
+int ProfileJournalAppend(int fd, const uint8_t *payload, size_t length);
+
+// Called for each intact line in order. Returning false (an unparseable
+// payload) ends the scan there, as a torn or corrupt line does.
+typedef bool (*ProfileJournalRecordFunc)(const uint8_t *payload, size_t length, void *context);
+
+// Scans a journal image. Returns the length of its intact prefix, where the
+// next append must go, and the number of records in it.
+size_t ProfileJournalScan(const uint8_t *bytes, size_t length, ProfileJournalRecordFunc onRecord, void *context,
+                          size_t *records);
+
+// Empties the journal once a snapshot holds everything in it. Returns 0 or an errno.
+int ProfileJournalReset(int fd);
+
+// Writes path.tmp, fsyncs it, renames it over path and fsyncs the directory,
+// so after a power loss path is either the old or the new file. Returns 0 or
+// an errno; path is untouched unless the rename happened.
+int ProfileJournalWriteFileDurably(const char *path, const void *data, size_t length);
+
+#endif
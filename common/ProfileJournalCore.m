@@ -0,0 +1,130 @@
+#include "ProfileJournalCore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// ---- Lines ----
+
+uint32_t ProfileJournalChecksum(const uint8_t *bytes, size_t length) {
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+int ProfileJournalAppend(int fd, const uint8_t *payload, size_t length) {
+    size_t lineLength = length + kProfileJournalLineOverhead;
+    uint8_t *line = malloc(lineLength);
+    if (!line) return ENOMEM;
+    char header[10];
+    snprintf(header, sizeof(header), "%08x ", ProfileJournalChecksum(payload, length));
+    memcpy(line, header, 9);
+    memcpy(line + 9, payload, length);
+    line[lineLength - 1] = '\n';
+
+    // One write, so a crash tears at most this line.
+    ssize_t written;
+    do {
+        written = write(fd, line, lineLength);
+    } while (written < 0 && errno == EINTR);
+    int err = written < 0 ? errno : (size_t)written != lineLength ? EIO : 0;
+    free(line);
+    if (!err && fsync(fd) != 0) err = errno;
+    return err;
+}
+
+static int hexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+size_t ProfileJournalScan(const uint8_t *bytes, size_t length, ProfileJournalRecordFunc onRecord, void *context,
+                          size_t *records) {
+    size_t offset = 0, count = 0;
+    while (offset < length) {
+        const uint8_t *newline = memchr(bytes + offset, '\n', length - offset);
+        if (!newline) break;
+        size_t lineLength = (size_t)(newline - (bytes + offset));
+        if (lineLength < 10 || bytes[offset + 8] != ' ') break;
+        uint32_t checksum = 0;
+        bool valid = true;
+        for (size_t i = 0; i < 8 && valid; i++) {
+            int digit = hexValue(bytes[offset + i]);
+            valid = digit >= 0;
+            checksum = checksum << 4 | (uint32_t)digit;
+        }
+        const uint8_t *payload = bytes + offset + 9;
+        size_t payloadLength = lineLength - 9;
+        if (!valid || checksum != ProfileJournalChecksum(payload, payloadLength)) break;
+        if (onRecord && !onRecord(payload, payloadLength, context)) break;
+        offset += lineLength + 1;
+        count++;
+    }
+    if (records) *records = count;
+    return offset;
+}
+
+int ProfileJournalReset(int fd) {
+    if (ftruncate(fd, 0) != 0 || lseek(fd, 0, SEEK_SET) < 0 || fsync(fd) != 0) return errno;
+    return 0;
+}
+
+// ---- Snapshot ----
+
+// The rename is only durable once the directory entry is.
+static int syncParentDirectory(const char *path) {
+    const char *slash = strrchr(path, '/');
+    char *dir = slash ? strndup(path, slash == path ? 1 : (size_t)(slash - path)) : strdup(".");
+    if (!dir) return ENOMEM;
+    int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    free(dir);
+    if (fd < 0) return errno;
+    int err = fsync(fd) == 0 ? 0 : errno;
+    close(fd);
+    return err;
+}
+
+int ProfileJournalWriteFileDurably(const char *path, const void *data, size_t length) {
+    size_t pathLength = strlen(path);
+    char *tmp = malloc(pathLength + sizeof(".tmp"));
+    if (!tmp) return ENOMEM;
+    memcpy(tmp, path, pathLength);
+    memcpy(tmp + pathLength, ".tmp", sizeof(".tmp"));
+
+    int err = 0;
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        err = errno;
+        free(tmp);
+        return err;
+    }
+    const uint8_t *bytes = data;
+    size_t left = length;
+    while (left > 0 && !err) {
+        ssize_t n = write(fd, bytes, left);
+        if (n < 0) {
+            if (errno != EINTR) err = errno;
+            continue;
+        }
+        bytes += n;
+        left -= (size_t)n;
+    }
+    if (!err && fsync(fd) != 0) err = errno;
+    close(fd);
+    if (!err && rename(tmp, path) != 0) err = errno;
+    if (err) {
+        unlink(tmp);
+        free(tmp);
+        return err;
+    }
+    free(tmp);
+    return syncParentDirectory(path);
+}
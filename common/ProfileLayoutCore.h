@@ -0,0 +1,31 @@
+#ifndef PROFILE_LAYOUT_CORE_H
+#define PROFILE_LAYOUT_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// Where ProfileManager keeps each profile's backup directory, plain C so
+// bench/ can time the flat and sharded layouts on any host. ProfileManager
+// owns the profile list and the migration; this only names and probes paths.
+//
+// Backups live at <shardRoot>/ab/cd/<id>, ab and cd being the low two bytes of
+// the FNV-1a hash of the id. Older installs kept them at <flatRoot>/<id>; until
+// the migration has moved every one of those, a lookup probes the flat path
+// first. Once it has, the marker file below records it and lookups go straight
+// to the sharded path.
+
+// In shardRoot, written once no profile is left in the flat layout.
+#define kProfileLayoutMigratedMarker ".flat-migrated"
+
+// <shardRoot>/ab/cd/<id>. False if it does not fit in size.
+bool ProfileLayoutShardedPath(const char *shardRoot, const char *profileId, char *out, size_t size);
+// The flat path while the layout is not migrated and it exists, otherwise the
+// sharded one. False if it does not fit in size.
+bool ProfileLayoutResolve(const char *flatRoot, const char *shardRoot, const char *profileId, bool migrated,
+                          char *out, size_t size);
+
+bool ProfileLayoutIsMigrated(const char *shardRoot);
+// Creates shardRoot if needed and writes the marker durably. Returns 0 or an errno.
+int ProfileLayoutMarkMigrated(const char *shardRoot);
+
+#endif
@@ -0,0 +1,49 @@
+#include "ProfileLayoutCore.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ProfileJournalCore.h"
+
+// ---- Paths ----
+
+bool ProfileLayoutShardedPath(const char *shardRoot, const char *profileId, char *out, size_t size) {
+    uint32_t hash = ProfileJournalChecksum((const uint8_t *)profileId, strlen(profileId));
+    int length = snprintf(out, size, "%s/%02x/%02x/%s", shardRoot, hash & 0xff, (hash >> 8) & 0xff, profileId);
+    return length >= 0 && (size_t)length < size;
+}
+
+bool ProfileLayoutResolve(const char *flatRoot, const char *shardRoot, const char *profileId, bool migrated,
+                          char *out, size_t size) {
+    if (!migrated) {
+        int length = snprintf(out, size, "%s/%s", flatRoot, profileId);
+        if (length < 0 || (size_t)length >= size) return false;
+        if (access(out, F_OK) == 0) return true;
+    }
+    return ProfileLayoutShardedPath(shardRoot, profileId, out, size);
+}
+
+// ---- Marker ----
+
+static bool markerPath(const char *shardRoot, char *out, size_t size) {
+    int length = snprintf(out, size, "%s/%s", shardRoot, kProfileLayoutMigratedMarker);
+    return length >= 0 && (size_t)length < size;
+}
+
+bool ProfileLayoutIsMigrated(const char *shardRoot) {
+    char path[1024];
+    return markerPath(shardRoot, path, sizeof(path)) && access(path, F_OK) == 0;
+}
+
+int ProfileLayoutMarkMigrated(const char *shardRoot) {
+    char path[1024];
+    if (!markerPath(shardRoot, path, sizeof(path))) return ENAMETOOLONG;
+    if (mkdir(shardRoot, 0755) != 0 && errno != EEXIST) return errno;
+    // Empty, but through the journal's rename and directory fsync, so after a
+    // power loss the marker is only there if it is durable.
+    return ProfileJournalWriteFileDurably(path, "", 0);
+}
@@ -14,7 +14,9 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface ProfileManager : NSObject
 
-@property (nonatomic, strong) NSMutableArray<Profile *> *mutableProfiles;
+// 按创建时间排序，只由 ProfileManager 修改（会写日志）。其他线程可能同时增删，
+// 守护进程里遍历请用 profilesSnapshot
+@property (nonatomic, strong, readonly) NSMutableArray<Profile *> *mutableProfiles;
 @property (nonatomic, strong) NSString *currentId;
 + (instancetype)sharedManager;
 - (NSString *)genBackupDirectory;
@@ -25,6 +27,20 @@ NS_ASSUME_NONNULL_BEGIN
 - (NSString *)getActiveProfileId;
 - (NSString *)getActiveDataPath;
 - (Profile *) getProfileById:(NSString *) id;
+// 加锁复制的当前列表，可安全遍历
+- (NSArray<Profile *> *)profilesSnapshot;
+
+// 备份目录按 id 哈希分两级存放（ProjectX/profiles/ab/cd/<id>）。迁移完成前
+// 旧的平铺目录 ProjectX/<id> 仍然有效，所有路径都应通过这里解析
+- (nullable NSString *)pathForProfileId:(NSString *)profileId;
+// 同上，新布局下会先创建分级的父目录，用于即将创建该目录的调用方
+- (nullable NSString *)createShardForProfileId:(NSString *)profileId;
+// 把平铺目录一次 rename 到新布局；已删除或不存在的配置返回 NO
+- (BOOL)migrateProfileDirectory:(NSString *)profileId;
+// 平铺目录已全部迁走并记录在 profiles/.flat-migrated，之后的进程启动即知
+@property (atomic, assign, readonly) BOOL layoutMigrated;
+// 没有配置还留在平铺目录时写入标记并返回 YES；之后 pathForProfileId 不再探测旧路径
+- (BOOL)finishLayoutMigration;
 
 - (void)switchToProfile:(Profile *)profile;
 - (void)renameProfile:(NSString *)id to:(NSString *)newName;
@@ -32,6 +48,8 @@ NS_ASSUME_NONNULL_BEGIN
 - (BOOL)isCurrent:(Profile *)profile;
 - (BOOL) removeProfileById:(NSString *) id;
 
+// 修改以单条记录追加到 profiles.journal；saveData 把当前状态合并为
+// profiles.json 快照并清空日志，loadData 读快照后重放日志
 - (BOOL)saveData;
 - (BOOL)loadData;
 - (BOOL)clearData;
@@ -2,8 +2,28 @@
 #import <UIKit/UIKit.h>
 #import <spawn.h>
 #import <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ProfileJournalCore.h"
+#include "ProfileLayoutCore.h"
 
 #define profileDataPath @"/private/var/mobile/Media/ProjectX/profiles.json"
+#define profileJournalPath @"/private/var/mobile/Media/ProjectX/profiles.journal"
+#define profileRootPath @"/private/var/mobile/Media/ProjectX"
+// 备份目录按 id 哈希分两级：profiles/ab/cd/<id>
+#define profileShardRootPath @"/private/var/mobile/Media/ProjectX/profiles"
+
+// 日志累计到这么多条就合并进 profiles.json 快照并清空
+static const NSUInteger kJournalCompactRecords = 256;
+
+static NSString *PXShardedProfilePath(NSString *profileId) {
+    char path[PATH_MAX];
+    if (!ProfileLayoutShardedPath(profileShardRootPath.fileSystemRepresentation, profileId.fileSystemRepresentation,
+                                  path, sizeof(path))) {
+        return nil;
+    }
+    return [NSString stringWithUTF8String:path];
+}
 
 // Forward declaration for app termination
 @interface BottomButtons : NSObject
@@ -97,6 +117,15 @@
 
 @property (nonatomic, strong) NSFileManager *fileManager;
 @property (nonatomic, strong) NSString *profilesDirectory;
+// id -> Profile，与 mutableProfiles（按创建时间排序）同步维护
+@property (nonatomic, strong) NSMutableDictionary<NSString *, Profile *> *profilesById;
+// 追加写日志的文件描述符，首次写入时打开
+@property (nonatomic, assign) int journalFd;
+// 最近一次加载时日志中完整记录的长度，之后的残尾在首次追加前截掉
+@property (nonatomic, assign) off_t journalValidLength;
+@property (nonatomic, assign) NSUInteger journalRecords;
+// 平铺目录已全部迁走（标记文件存在），查找不再探测旧路径；只会从 NO 变为 YES
+@property (atomic, assign, readwrite) BOOL layoutMigrated;
 
 @end
 
@@ -111,136 +140,218 @@
     });
     return sharedManager;
 }
-#pragma mark - 保存数据（使用字典，避免归档问题）
+#pragma mark - 索引
+
+static NSDate *PXProfileSortDate(Profile *profile) {
+    return profile.createdDate ?: [NSDate distantPast];
+}
+
+// 按创建时间有序插入，同一时间的排在后面；已有同 id 的先移除
+- (void)indexProfile:(Profile *)profile {
+    if (!profile.id) return;
+    [self unindexProfileId:profile.id];
+    NSUInteger index = [_mutableProfiles indexOfObject:profile
+                                         inSortedRange:NSMakeRange(0, _mutableProfiles.count)
+                                               options:NSBinarySearchingInsertionIndex | NSBinarySearchingLastEqual
+                                       usingComparator:^NSComparisonResult(Profile *a, Profile *b) {
+        return [PXProfileSortDate(a) compare:PXProfileSortDate(b)];
+    }];
+    [_mutableProfiles insertObject:profile atIndex:index];
+    _profilesById[profile.id] = profile;
+}
+
+- (void)unindexProfileId:(NSString *)id {
+    Profile *profile = _profilesById[id];
+    if (!profile) return;
+    [_profilesById removeObjectForKey:id];
+    [_mutableProfiles removeObjectIdenticalTo:profile];
+}
+
+#pragma mark - 日志
+
+// 记录都是"设置为"语义，重放到已包含它们的快照上结果不变，
+// 所以合并时快照写完、日志还没清空就掉电也没关系
+- (void)applyRecord:(NSDictionary *)record {
+    NSString *op = record[@"op"];
+    if ([op isEqualToString:@"add"]) {
+        NSDictionary *dict = record[@"profile"];
+        if (![dict isKindOfClass:[NSDictionary class]]) return;
+        Profile *profile = [Profile fromDictionary:dict];
+        [self indexProfile:profile];
+        if ([record[@"current"] boolValue]) _currentId = profile.id;
+    } else if ([op isEqualToString:@"remove"]) {
+        if ([record[@"id"] isKindOfClass:[NSString class]]) [self unindexProfileId:record[@"id"]];
+    } else if ([op isEqualToString:@"rename"]) {
+        Profile *profile = [record[@"id"] isKindOfClass:[NSString class]] ? _profilesById[record[@"id"]] : nil;
+        if ([record[@"name"] isKindOfClass:[NSString class]]) profile.name = record[@"name"];
+    } else if ([op isEqualToString:@"current"]) {
+        NSString *id = record[@"id"];
+        _currentId = [id isKindOfClass:[NSString class]] && id.length ? id : nil;
+    }
+}
+
+static bool PXApplyJournalPayload(const uint8_t *payload, size_t length, void *context) {
+    ProfileManager *manager = (__bridge ProfileManager *)context;
+    NSDictionary *record = [NSJSONSerialization JSONObjectWithData:[NSData dataWithBytesNoCopy:(void *)payload length:length freeWhenDone:NO]
+                                                           options:kNilOptions error:nil];
+    if (![record isKindOfClass:[NSDictionary class]]) return false;
+    [manager applyRecord:record];
+    return true;
+}
+
+// 重放日志，遇到不完整或校验不符的记录（写到一半掉电）就停止
+- (void)replayJournal {
+    NSData *journal = [NSData dataWithContentsOfFile:profileJournalPath options:NSDataReadingMappedIfSafe error:nil];
+    size_t records = 0;
+    size_t valid = ProfileJournalScan(journal.bytes, journal.length, PXApplyJournalPayload, (__bridge void *)self, &records);
+    _journalValidLength = (off_t)valid;
+    _journalRecords = records;
+    if (valid < journal.length) {
+        NSLog(@"[ProfileManager] 日志尾部 %lu 字节不完整，已忽略", (unsigned long)(journal.length - valid));
+    }
+}
+
+- (BOOL)openJournal {
+    if (_journalFd >= 0) return YES;
+    int fd = open(profileJournalPath.fileSystemRepresentation, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) return NO;
+    // 截掉上次崩溃留下的残尾，新记录紧跟在最后一条完整记录之后
+    if (ftruncate(fd, _journalValidLength) != 0 || lseek(fd, 0, SEEK_END) < 0) {
+        close(fd);
+        return NO;
+    }
+    _journalFd = fd;
+    return YES;
+}
+
+// 先应用到内存，再以一次 write + fsync 追加到日志；写日志失败时退回整体写快照
+- (BOOL)commitRecord:(NSDictionary *)record {
+    @synchronized (self) {
+        [self applyRecord:record];
+        NSData *json = [NSJSONSerialization dataWithJSONObject:record options:0 error:nil];
+        if (!json || ![self openJournal]) return [self saveData];
+        int err = ProfileJournalAppend(_journalFd, json.bytes, json.length);
+        if (err) {
+            NSLog(@"[ProfileManager] 写日志失败: %s", strerror(err));
+            // 可能留下半条记录，丢弃描述符，由快照覆盖
+            close(_journalFd);
+            _journalFd = -1;
+            return [self saveData];
+        }
+        _journalValidLength += (off_t)(json.length + kProfileJournalLineOverhead);
+        _journalRecords++;
+        if (_journalRecords >= kJournalCompactRecords) {
+            [self saveData];
+        }
+        return YES;
+    }
+}
+
+#pragma mark - 保存数据（合并为快照）
 
+// 把当前内存状态写成紧凑的 profiles.json 快照，然后清空日志
 - (BOOL)saveData {
     @synchronized (self) {
         @try {
-            
-            NSMutableDictionary *dataDict = [NSMutableDictionary dictionary];
-            
-            // 1. 保存 currentId
-            if (self.currentId) {
-                dataDict[@"currentId"] = self.currentId;
-            } else {
-                dataDict[@"currentId"] = @"";
-            }
-            
-            // 2. 保存 mutableProfiles 转为字典数组
-            NSMutableArray *profilesArray = [NSMutableArray array];
+            NSMutableArray *profilesArray = [NSMutableArray arrayWithCapacity:self.mutableProfiles.count];
             for (Profile *profile in self.mutableProfiles) {
-                // 方法1: 使用自定义的toDictionary方法
-                NSDictionary *profileDict = [profile toDictionary];
-                [profilesArray addObject:profileDict];
-            }
-            
-            if (profilesArray.count > 0) {
-                dataDict[@"mutableProfiles"] = profilesArray;
-            } else {
-                dataDict[@"mutableProfiles"] = @[];
+                [profilesArray addObject:[profile toDictionary]];
             }
+            NSDictionary *dataDict = @{
+                @"currentId": self.currentId ?: @"",
+                @"mutableProfiles": profilesArray
+            };
             NSError *error = nil;
-            // 4. 将字典写入文件
-            // 使用writeToURL:atomically:方法，它自动处理序列化
-            NSData *jsonData = [NSJSONSerialization dataWithJSONObject:dataDict 
-                                                    options:NSJSONWritingPrettyPrinted 
-                                                        error:&error];
-            BOOL success = [jsonData writeToFile:profileDataPath
-                                 options:NSDataWritingAtomic 
-                                   error:&error];
-            if (success) {
-                NSLog(@"save success %lu profile", (unsigned long)self.mutableProfiles.count);
-            } else {
-                NSLog(@"error");
+            NSData *jsonData = [NSJSONSerialization dataWithJSONObject:dataDict options:0 error:&error];
+            int err = jsonData ? ProfileJournalWriteFileDurably(profileDataPath.fileSystemRepresentation, jsonData.bytes, jsonData.length) : 0;
+            if (!jsonData || err) {
+                NSLog(@"[ProfileManager] 写快照失败: %@", error ?: @(strerror(err)));
+                return NO;
             }
-            
-            return success;
-            
+            // 快照已包含日志中的全部记录；在这里掉电的话日志会重放到快照上，结果不变
+            if ([self openJournal] && ProfileJournalReset(_journalFd) == 0) {
+                _journalValidLength = 0;
+                _journalRecords = 0;
+            }
+            NSLog(@"save success %lu profile", (unsigned long)self.mutableProfiles.count);
+            return YES;
         } @catch (NSException *exception) {
             NSLog(@"exception: %@", exception.reason);
             return NO;
-        } 
+        }
     }
 }
 
 #pragma mark - 加载数据
 
+// 读取快照再重放日志
 - (BOOL)loadData {
-    @try {
-        if(![[NSFileManager defaultManager] fileExistsAtPath:profileDataPath]){
-            return NO;
-        }
-        NSError *readError = nil;
-        // 1. 从plist文件读取字典
-        NSData *jsonData = [NSData dataWithContentsOfFile:profileDataPath  options:NSDataReadingMappedIfSafe 
-                                                error:&readError];
-        NSError *jsonError = nil;
-        NSDictionary *dataDict = (NSDictionary *)[NSJSONSerialization JSONObjectWithData:jsonData 
-                                                options:kNilOptions 
-                                                    error:&jsonError];    
-
-        if (!dataDict) {
-            return NO;
-        }
-            
-        // 3. 恢复 mutableProfiles
-        NSArray *profilesArray = dataDict[@"mutableProfiles"];        
-        if (profilesArray && [profilesArray isKindOfClass:[NSArray class]]) {
+    @synchronized (self) {
+        @try {
+            NSFileManager *fm = [NSFileManager defaultManager];
+            BOOL hasSnapshot = [fm fileExistsAtPath:profileDataPath];
+            if (!hasSnapshot && ![fm fileExistsAtPath:profileJournalPath]) {
+                return NO;
+            }
             [self.mutableProfiles removeAllObjects];
-            
-            for (id profileItem in profilesArray) {
-                if ([profileItem isKindOfClass:[NSDictionary class]]) {
-                    // 方法1: 从字典创建Profile对象
-                    Profile *profile = [Profile fromDictionary:(NSDictionary *)profileItem];
-                    [self.mutableProfiles addObject:profile];
-                    
+            [self.profilesById removeAllObjects];
+            _currentId = nil;
+
+            if (hasSnapshot) {
+                NSData *jsonData = [NSData dataWithContentsOfFile:profileDataPath options:NSDataReadingMappedIfSafe error:nil];
+                NSDictionary *dataDict = jsonData ? [NSJSONSerialization JSONObjectWithData:jsonData options:kNilOptions error:nil] : nil;
+                if (![dataDict isKindOfClass:[NSDictionary class]]) {
+                    NSLog(@"[ProfileManager] profiles.json 无法解析，仅重放日志");
+                    dataDict = @{};
+                }
+                NSArray *profilesArray = dataDict[@"mutableProfiles"];
+                if ([profilesArray isKindOfClass:[NSArray class]]) {
+                    for (id profileItem in profilesArray) {
+                        if ([profileItem isKindOfClass:[NSDictionary class]]) {
+                            [self indexProfile:[Profile fromDictionary:(NSDictionary *)profileItem]];
+                        }
+                    }
+                }
+                NSString *savedCurrentId = dataDict[@"currentId"];
+                if ([savedCurrentId isKindOfClass:[NSString class]] && savedCurrentId.length) {
+                    _currentId = savedCurrentId;
                 }
             }
-                        
-        } else {
-            self.mutableProfiles = [NSMutableArray array];
-        }
+            [self replayJournal];
 
-        // 2. 恢复 currentId
-        NSString *savedCurrentId = dataDict[@"currentId"];
-        if (savedCurrentId && ![savedCurrentId isEqualToString:@""]) {
-            self.currentId = savedCurrentId;
-        } else if(_mutableProfiles.count > 0){
-            self.currentId = _mutableProfiles[0].id;
+            if (!_currentId && _mutableProfiles.count > 0) {
+                _currentId = _mutableProfiles[0].id;
+            }
+            return YES;
+        } @catch (NSException *exception) {
+            NSLog(@"error: %@", exception.reason);
+            NSLog(@"异常调用栈: %@", exception.callStackSymbols);
+            return NO;
         }
-        
-        
-        return YES;
-        
-    } @catch (NSException *exception) {
-        NSLog(@"error: %@", exception.reason);
-        NSLog(@"异常调用栈: %@", exception.callStackSymbols);
-        return NO;
     }
-    
 }
 #pragma mark - 清空数据
 
 - (BOOL)clearData {
-    @try {
+    @synchronized (self) {
         self.currentId = nil;
         [self.mutableProfiles removeAllObjects];
-        
-        // 删除文件
-        NSError *error = nil;
-        if ([[NSFileManager defaultManager] fileExistsAtPath:profileDataPath]) {
-            [[NSFileManager defaultManager] removeItemAtURL:profileDataPath error:&error];
+        [self.profilesById removeAllObjects];
+        if (_journalFd >= 0) {
+            close(_journalFd);
+            _journalFd = -1;
         }
-        
-        if (error) {
-            NSLog(@"删除数据文件失败: %@", error.localizedDescription);
-            return NO;
+        _journalValidLength = 0;
+        _journalRecords = 0;
+
+        BOOL ok = YES;
+        for (NSString *path in @[profileDataPath, profileJournalPath]) {
+            if (unlink(path.fileSystemRepresentation) != 0 && errno != ENOENT) {
+                NSLog(@"删除数据文件失败: %@ %s", path, strerror(errno));
+                ok = NO;
+            }
         }
-        
-        return YES;
-    } @catch (NSException *exception) {
-        NSLog(@"清空数据异常: %@", exception.reason);
-        return NO;
+        return ok;
     }
 }
 
@@ -248,10 +359,13 @@
     self = [super init];
     if (self) {
         _mutableProfiles = [NSMutableArray array];
+        _profilesById = [NSMutableDictionary dictionary];
+        _journalFd = -1;
         _fileManager = [NSFileManager defaultManager];
+        _layoutMigrated = ProfileLayoutIsMigrated(profileShardRootPath.fileSystemRepresentation);
         
         // Create main WeaponX directory if it doesn't exist
-        NSString *projectXDirectory = @"/private/var/mobile/Media/ProjectX";
+        NSString *projectXDirectory = profileRootPath;
         [self createDirectoryIfNeeded:projectXDirectory];
         
         // 可选：启动时自动加载数据
@@ -295,12 +409,9 @@
 #pragma mark - Public Methods
 - (NSString *)genBackupDirectory{
     
-    // 目标父目录路径
-    NSString *basePath = @"/private/var/mobile/Media/ProjectX";
-    
     // 创建目录名
     NSString *directoryName = [self generateProfileID];
-    NSString *fullPath = [basePath stringByAppendingPathComponent:directoryName];
+    NSString *fullPath = [self createShardForProfileId:directoryName];
     
     // 创建时间戳目录
     BOOL success = [self createDirectoryIfNeeded:fullPath];
@@ -311,9 +422,7 @@
         profile.id = directoryName;
         profile.name = directoryName;
         profile.createdDate = [NSDate date];
-        [_mutableProfiles addObject:profile];
-        _currentId = profile.id;
-        [self saveData];
+        [self commitRecord:@{@"op": @"add", @"profile": [profile toDictionary], @"current": @YES}];
         return fullPath;
     } else {
         return nil;
@@ -323,11 +432,8 @@
 - (void)switchToProfile:(Profile *)profile {
     NSLog(@"[WeaponX] 🔄 Switching to profile: %@", profile.name);
     
-    // Set as current profile
-    self.currentId = profile.id;
-    
-    // Save to disk
-    BOOL success = [self saveData];
+    // Set as current profile and append to the journal
+    [self commitRecord:@{@"op": @"current", @"id": profile.id ?: @""}];
 }
 
 
@@ -364,8 +470,69 @@
     if(!profileId){
         return nil;
     }
-    // Build the path to this profile's identity directory
-    return [NSString stringWithFormat:@"/private/var/mobile/Media/ProjectX/%@", profileId];
+    return [self pathForProfileId:profileId];
+}
+
+#pragma mark - 目录布局
+
+- (NSString *)pathForProfileId:(NSString *)profileId {
+    if (!profileId.length) return nil;
+    // 迁移完成前旧的平铺目录仍然有效，完成后直接用新布局，不再多一次 access()
+    char path[PATH_MAX];
+    if (!ProfileLayoutResolve(profileRootPath.fileSystemRepresentation, profileShardRootPath.fileSystemRepresentation,
+                              profileId.fileSystemRepresentation, self.layoutMigrated, path, sizeof(path))) {
+        return nil;
+    }
+    return [NSString stringWithUTF8String:path];
+}
+
+- (NSString *)createShardForProfileId:(NSString *)profileId {
+    NSString *path = [self pathForProfileId:profileId];
+    if (!path || ![path hasPrefix:profileShardRootPath]) return path;
+    [self createDirectoryIfNeeded:[path stringByDeletingLastPathComponent]];
+    return path;
+}
+
+- (BOOL)migrateProfileDirectory:(NSString *)profileId {
+    if (!profileId.length || self.layoutMigrated) return NO;
+    @synchronized (self) {
+        // 已删除的配置不动，删除流程按删除时解析的路径处理
+        if (!_profilesById[profileId]) return NO;
+        NSString *flat = [profileRootPath stringByAppendingPathComponent:profileId];
+        BOOL isDir = NO;
+        if (![_fileManager fileExistsAtPath:flat isDirectory:&isDir] || !isDir) return NO;
+        NSString *sharded = PXShardedProfilePath(profileId);
+        if (!sharded) return NO;
+        if (access(sharded.fileSystemRepresentation, F_OK) == 0) {
+            NSLog(@"[ProfileManager] %@ 新旧布局下都存在，保留平铺目录", profileId);
+            return NO;
+        }
+        [self createDirectoryIfNeeded:[sharded stringByDeletingLastPathComponent]];
+        // 同一卷内 rename，原子完成，查找方随时只会看到其中一个位置
+        if (rename(flat.fileSystemRepresentation, sharded.fileSystemRepresentation) != 0) {
+            NSLog(@"[ProfileManager] 迁移 %@ 失败: %s", profileId, strerror(errno));
+            return NO;
+        }
+        return YES;
+    }
+}
+
+- (BOOL)finishLayoutMigration {
+    if (self.layoutMigrated) return YES;
+    @synchronized (self) {
+        // 加锁检查，期间不会有新配置以平铺目录出现（新建的都在新布局下）
+        for (NSString *profileId in _profilesById) {
+            NSString *flat = [profileRootPath stringByAppendingPathComponent:profileId];
+            if (access(flat.fileSystemRepresentation, F_OK) == 0) return NO;
+        }
+        int err = ProfileLayoutMarkMigrated(profileShardRootPath.fileSystemRepresentation);
+        if (err != 0) {
+            NSLog(@"[ProfileManager] 写入迁移完成标记失败: %s", strerror(err));
+            return NO;
+        }
+        self.layoutMigrated = YES;
+        return YES;
+    }
 }
 
 - (NSString *)profileIdentityPath {
@@ -377,7 +544,7 @@
     }
     
     // Build the path to this profile's identity directory
-    NSString *profileDir = [NSString stringWithFormat:@"/private/var/mobile/Media/ProjectX/%@", profileId];
+    NSString *profileDir = [self pathForProfileId:profileId];
     NSString *identityDir = [profileDir stringByAppendingPathComponent:@"identity"];
     
     // Create the directory if it doesn't exist
@@ -398,29 +565,25 @@
     
     return identityDir;
 }
+- (NSArray<Profile *> *)profilesSnapshot {
+    @synchronized (self) {
+        return [_mutableProfiles copy];
+    }
+}
 - (Profile *) getProfileById:(NSString *) id{
-    for(Profile * profile in _mutableProfiles){
-        if([profile.id isEqualToString:id]){
-            return profile;
-        }
+    if (!id) return nil;
+    @synchronized (self) {
+        return _profilesById[id];
     }
-    return nil;
 }
 - (BOOL) removeProfileById:(NSString *) id{
-    for(Profile * profile in _mutableProfiles){
-        if([profile.id isEqualToString:id]){
-            if([self isCurrent:profile]) return NO;
-            [_mutableProfiles removeObject: profile];
-            [self saveData];
-            return YES;
-        }
-    }
-    return NO;
+    Profile * profile = [self getProfileById:id];
+    if (!profile || [self isCurrent:profile]) return NO;
+    return [self commitRecord:@{@"op": @"remove", @"id": id}];
 }
 
 - (void)renameProfile:(NSString *)id to:(NSString *)newName {
-    Profile * profile = [self getProfileById:id];
-    profile.name = newName;
-    [self saveData];
+    if (![self getProfileById:id] || !newName) return;
+    [self commitRecord:@{@"op": @"rename", @"id": id, @"name": newName}];
 }
 @end 
\ No newline at end of file
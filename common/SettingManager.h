@@ -1,5 +1,8 @@
 #import <Foundation/Foundation.h>
 
+// saveToPrefs 之后发出，守护进程据此丢弃按旧设置预生成的参数
+#define kSettingChangedNotification CFSTR("com.projectx.settingChanged")
+
 @interface SettingManager : NSObject
 + (instancetype)sharedManager;
 @property (nonatomic, strong) NSString *carrierCountryCode;
@@ -7,4 +10,6 @@
 @property (nonatomic, strong) NSString *maxVersion;
 - (BOOL)saveToPrefs;
 - (void)loadFromPrefs;
+// 已保存的设置（含 loadFromPrefs 的默认值），不改动共享实例
++ (NSDictionary<NSString *, NSString *> *)savedSettings;
 @end
\ No newline at end of file
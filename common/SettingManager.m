@@ -32,10 +32,12 @@
         kCFPreferencesAnyHost
     );
 
+    CFNotificationCenterPostNotification(CFNotificationCenterGetDarwinNotifyCenter(),
+                                         kSettingChangedNotification, NULL, NULL, YES);
     return YES;
 }
 
-- (void)loadFromPrefs {
++ (NSDictionary<NSString *, NSString *> *)savedSettings {
     CFPropertyListRef value =
         CFPreferencesCopyValue(
             CFSTR("setting"),
@@ -44,19 +46,24 @@
             kCFPreferencesAnyHost
         );
 
-
-    if (!value || CFGetTypeID(value) != CFDictionaryGetTypeID()) {
-        if (value) CFRelease(value);
-        self.carrierCountryCode = @"US";
-        self.minVersion = @"14.0";
-        self.maxVersion = @"18.6";
-        return;
+    NSDictionary *dict = nil;
+    if (value && CFGetTypeID(value) == CFDictionaryGetTypeID()) {
+        dict = CFBridgingRelease(value);
+    } else if (value) {
+        CFRelease(value);
     }
+    return @{
+        @"carrierCountryCode": dict[@"carrierCountryCode"] ?: @"US",
+        @"minVersion": dict[@"minVersion"] ?: @"14.0",
+        @"maxVersion": dict[@"maxVersion"] ?: @"18.6"
+    };
+}
 
-    NSDictionary *dict = CFBridgingRelease(value);
-    self.carrierCountryCode = dict[@"carrierCountryCode"] ?: @"US";
-    self.minVersion = dict[@"minVersion"] ?: @"14.0";
-    self.maxVersion = dict[@"maxVersion"] ?: @"18.6";
+- (void)loadFromPrefs {
+    NSDictionary<NSString *, NSString *> *settings = [SettingManager savedSettings];
+    self.carrierCountryCode = settings[@"carrierCountryCode"];
+    self.minVersion = settings[@"minVersion"];
+    self.maxVersion = settings[@"maxVersion"];
 }
 
 @end
\ No newline at end of file
@@ -2,12 +2,19 @@
 #import <MobileCoreServices/LSApplicationWorkspace.h>
 #import <MobileCoreServices/LSApplicationProxy.h>
 
+@class DaemonJob;
+
 @interface ActionManager : NSObject
 + (instancetype)sharedManager;
 
-- (void) newPhone;
+// job may be nil; when set, progress is reported to it and cancellation is
+// honoured until the first container is touched.
+- (BOOL) newPhone:(DaemonJob *)job;
 - (void) removeBackup:(NSString *)id;
--(void) switchBackup:(NSString *) id;
+-(BOOL) switchBackup:(NSString *) id job:(DaemonJob *)job;
+// Moves profiles still in the flat ProjectX/<id> layout into their shard, as
+// idle work between jobs; lookups handle both layouts meanwhile.
+- (void) scheduleLayoutMigration;
 @end
 
 @interface LSApplicationProxy(Private)
@@ -2,13 +2,38 @@
 #import "AppScopeManager.h"
 #import "PhoneInfo.h"
 #import "ProfileManager.h"
-#import "DataGenManager.h"
+#import "PhoneInfoPool.h"
 #import "SysExecutor.h"
 #import "ProjectXLogging.h"
-#import <sqlite3.h>
+#import "JobManager.h"
+#import "FileRemover.h"
+#import "FileCloner.h"
+#import "TreeWalker.h"
+#import "ProfileStager.h"
+#import "ContentStore.h"
+#import "BackupRules.h"
+#import "ProfileArchiver.h"
+#import "KeychainStore.h"
+#import "TrashQueue.h"
+#import "DiskUsageIndex.h"
+#include <sys/stat.h>
+
+// 同时处理的 bundle 数与同时进行的目录 IO 数上限。闪存在 2~4 路并发时吞吐最好，
+// 再多只会拖慢前台；可用 ProjectXBundleConcurrency / ProjectXIOBudget 覆盖
+static const NSUInteger kMaxBundleWorkers = 4;
+static const NSUInteger kMaxIOBudget = 6;
+
+static NSUInteger PXConcurrencySetting(NSString *key, NSUInteger fallback, NSUInteger limit) {
+    NSInteger value = [[NSUserDefaults standardUserDefaults] integerForKey:key];
+    if (value <= 0) value = (NSInteger)fallback;
+    return MAX(1, MIN((NSUInteger)value, limit));
+}
 
 @interface ActionManager()
     @property(nonatomic, strong) ProfileManager *profileManager;
+    @property(nonatomic, strong) dispatch_queue_t ioQueue;
+    @property(nonatomic, strong) dispatch_semaphore_t ioBudget;
+    @property(nonatomic, assign) NSUInteger bundleWorkers;
 @end
 @implementation ActionManager
 
@@ -23,9 +48,104 @@
 - (instancetype) init{
     self = [super init];
     _profileManager = [ProfileManager sharedManager];
+    NSUInteger cores = [NSProcessInfo processInfo].activeProcessorCount;
+    _bundleWorkers = PXConcurrencySetting(@"ProjectXBundleConcurrency", MIN(cores, kMaxBundleWorkers), kMaxBundleWorkers);
+    NSUInteger ioBudget = PXConcurrencySetting(@"ProjectXIOBudget", _bundleWorkers + 2, kMaxIOBudget);
+    _ioBudget = dispatch_semaphore_create(ioBudget);
+    _ioQueue = dispatch_queue_create("com.projectx.daemon.io",
+                                     dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_CONCURRENT, QOS_CLASS_UTILITY, 0));
+    PXLog(@"[ActionManager] bundle workers=%lu io budget=%lu", (unsigned long)_bundleWorkers, (unsigned long)ioBudget);
     return self;
 }
-- (void) newPhone{
+
+// 并发处理每个 bundle，最多 bundleWorkers 个同时进行；全部完成后才返回
+- (void)runBundles:(NSSet<NSString *> *)bundles job:(DaemonJob *)job work:(void (^)(NSString *bundleId))work {
+    NSUInteger total = bundles.count;
+    __block NSUInteger done = 0;
+    dispatch_semaphore_t slots = dispatch_semaphore_create(_bundleWorkers);
+    dispatch_group_t group = dispatch_group_create();
+    [job reportCompleted:0 total:total];
+    for (NSString *bundleId in bundles) {
+        dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+        dispatch_group_async(group, _ioQueue, ^{
+            @try {
+                @autoreleasepool {
+                    work(bundleId);
+                }
+            } @catch (NSException *exception) {
+                PXLog(@"[ActionManager] Bundle %@ failed: %@", bundleId, exception);
+            } @finally {
+                @synchronized (group) {
+                    [job reportCompleted:++done total:total];
+                }
+                dispatch_semaphore_signal(slots);
+            }
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+}
+
+// bundle 内每个目录一次迭代，共享全局 IO 预算；全部完成后才返回。
+// dispatch_apply 让调用的 bundle 线程自己也执行迭代，而不是停下来等排在同一队列上的
+// 兄弟任务；持有预算的迭代都在做 IO，不等待别的任务，因此无需 GCD 扩充线程也总能推进
+- (void)runFolders:(NSArray<NSString *> *)folders work:(void (^)(NSString *folder))work {
+    dispatch_apply(folders.count, _ioQueue, ^(size_t index) {
+        NSString *folder = folders[index];
+        dispatch_semaphore_wait(self.ioBudget, DISPATCH_TIME_FOREVER);
+        @try {
+            @autoreleasepool {
+                work(folder);
+            }
+        } @catch (NSException *exception) {
+            PXLog(@"[ActionManager] Folder %@ failed: %@", folder, exception);
+        } @finally {
+            dispatch_semaphore_signal(self.ioBudget);
+        }
+    });
+}
+// 配置变为非活动后空闲处理：先按备份规则裁剪各 bundle，再做内容去重；长期未用的配置随后归档
+- (void)scheduleColdProfileWork:(NSString *)profileId {
+    if (!profileId) return;
+    [[JobManager sharedManager] runWhenIdle:^{
+        NSString *profilePath = [[ProfileManager sharedManager] pathForProfileId:profileId];
+        // 该配置可能已被预测为下一个并预置到 staging，那份副本里还有被裁掉的文件
+        [[ProfileStager sharedManager] invalidateProfile:profileId];
+        for (NSString *bundleId in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:profilePath error:nil]) {
+            if ([[JobManager sharedManager] hasPendingJobs]) return;
+            NSString *bundlePath = [profilePath stringByAppendingPathComponent:bundleId];
+            BOOL isDir = NO;
+            if (![[NSFileManager defaultManager] fileExistsAtPath:bundlePath isDirectory:&isDir] || !isDir) continue;
+            @autoreleasepool {
+                [[BackupRules sharedManager] pruneBundleTree:bundlePath bundle:bundleId];
+            }
+        }
+        [[ContentStore sharedManager] ingestProfile:profileId];
+    }];
+    [[ProfileArchiver sharedManager] profileWasUsed:profileId];
+    [[ProfileArchiver sharedManager] scheduleAging];
+    [[DiskUsageIndex sharedManager] scheduleReconcile];
+}
+
+// 旧版本的平铺备份目录逐个移入分级目录；每次只是一次 rename，有任务等待时让出，稍后继续
+- (void)scheduleLayoutMigration {
+    if (self.profileManager.layoutMigrated) return;
+    [[JobManager sharedManager] runWhenIdle:^{
+        NSArray<Profile *> *profiles = [self.profileManager profilesSnapshot];
+        NSUInteger moved = 0;
+        for (Profile *profile in profiles) {
+            if ([[JobManager sharedManager] hasPendingJobs]) {
+                PXLog(@"[ActionManager] Layout migration paused after %lu profiles", (unsigned long)moved);
+                [self scheduleLayoutMigration];
+                return;
+            }
+            if ([self.profileManager migrateProfileDirectory:profile.id]) moved++;
+        }
+        if (moved > 0) PXLog(@"[ActionManager] Moved %lu profiles into the sharded layout", (unsigned long)moved);
+        if ([self.profileManager finishLayoutMigration]) PXLog(@"[ActionManager] Layout migration complete");
+    }];
+}
+
+- (BOOL) newPhone:(DaemonJob *)job{
     PXLog(@"[newPhone] cwd=%@", [[NSFileManager defaultManager] currentDirectoryPath]);
     PXLog(@"[newPhone] Starting newPhone flow");
     // // 加载所有被选中应用
@@ -33,10 +153,17 @@
     PXLog(@"[newPhone] Scoped apps: %@", loadApps);
     if (!loadApps || loadApps.count == 0) {
         PXLog(@"[newPhone] No scoped apps; skipping data operations to avoid unintended deletes");
-        return;
+        return YES;
     }
-    // 获取当前生效备份
+    // 之后开始修改容器数据，不再允许取消
+    if (job && ![job enterCommitPhase]) {
+        PXLog(@"[newPhone] Cancelled before touching containers");
+        return NO;
+    }
+    // 获取当前生效备份，其预置副本即将过期
     NSString * activeBackupPath = [_profileManager getActiveDataPath];
+    NSString * oldProfileId = [_profileManager getActiveProfileId];
+    [[ProfileStager sharedManager] invalidateProfile:oldProfileId];
     if(!activeBackupPath){
         // 首次新机
         activeBackupPath = [_profileManager genBackupDirectory];
@@ -48,12 +175,14 @@
     if(!backupPath){
         NSLog(@"create Backup directory error");
         PXLog(@"[newPhone] Failed to create backup directory");
-        return;
+        return NO;
     }
     PXLog(@"[newPhone] New backup path: %@", backupPath);
-    for (NSString * bundleId in loadApps){
+    NSString * newProfileId = [_profileManager getActiveProfileId];
+    [self runBundles:loadApps job:job work:^(NSString *bundleId) {
         PXLog(@"[newPhone] Processing bundle: %@", bundleId);
         // 强制关停应用
+        [job reportStep:@"kill" bundle:bundleId];
         [self killApp:bundleId];
          // 判断应用中是否存在 safari 额外清理 /var/mobile/Library/Safari 
         if([bundleId isEqualToString:@"com.apple.mobilesafari"]){
@@ -66,14 +195,19 @@
        
         // 清理or备份沙盒数据到activeBackUp中
         PXLog(@"[newPhone] Backup data to active path for %@", bundleId);
+        [job reportStep:@"backup" bundle:bundleId];
         [self backupFileToPath:bundleId toPath:activeBackupPath];
-    }
+    }];
     // 清理keychain内容
     if ([[NSUserDefaults standardUserDefaults] boolForKey:@"ProjectXDisableKeychainWipe"]) {
         PXLog(@"[newPhone] Keychain wipe disabled by ProjectXDisableKeychainWipe");
     } else {
+        // 旧配置的应用 keychain 条目随备份保存，切换回来时恢复
         PXLog(@"[newPhone] Clearing keychain");
-        [self clearKeyChain];
+        [job reportStep:@"keychain" bundle:nil];
+        [[KeychainStore sharedManager] saveSnapshotTo:[activeBackupPath stringByAppendingPathComponent:@"keychain.db"]];
+        [[KeychainStore sharedManager] resetRestoringSnapshot:nil];
+        [[KeychainStore sharedManager] scheduleVacuum];
     }
     // 保存旧参数
     PhoneInfo *phoneInfo = [PhoneInfo loadFromPrefs];
@@ -84,51 +218,101 @@
         PXLog(@"[ProjectXDaemon] No existing PhoneInfo to backup.");
     }
     // 生成新参数
-    PhoneInfo * newPhoneInfo = [[DataGenManager sharedManager] generatePhoneInfo];
-    PXLog(@"[newPhone] Generated new PhoneInfo");
+    [job reportStep:@"generate" bundle:nil];
+    PhoneInfo * newPhoneInfo = [[PhoneInfoPool sharedManager] takePhoneInfo];
+    if (newPhoneInfo) {
+        PXLog(@"[newPhone] Using pre-generated PhoneInfo");
+    } else {
+        newPhoneInfo = [[PhoneInfoPool sharedManager] generatePhoneInfo];
+        PXLog(@"[newPhone] Generated new PhoneInfo");
+    }
     [PhoneInfo saveDictionaryToFile:[newPhoneInfo toDictionary] toFile:[backupPath stringByAppendingPathComponent:@"phoneInfo.json"]];
     [newPhoneInfo saveToPrefs];
+    // 新配置目录此时只有 phoneInfo.json，扫描很快
+    [[DiskUsageIndex sharedManager] scanBundles:nil ofProfile:newProfileId];
     // 通知页面刷新显示
     CFNotificationCenterRef darwinCenter = CFNotificationCenterGetDarwinNotifyCenter();
     CFNotificationCenterPostNotification(darwinCenter, CFSTR("projectx.newPhoneFinish"), NULL, NULL, YES);
     PXLog(@"[newPhone] Finished newPhone flow");
-
+    // 空闲时为下一次新机预生成参数，并对刚备份的旧配置裁剪、去重
+    [[PhoneInfoPool sharedManager] scheduleRefill];
+    [self scheduleColdProfileWork:oldProfileId];
+    return YES;
 }
 
--(void) switchBackup:(NSString *) id{
+-(BOOL) switchBackup:(NSString *) id job:(DaemonJob *)job{
     PXLog(@"[switchBackup] cwd=%@", [[NSFileManager defaultManager] currentDirectoryPath]);
     PXLog(@"[switchBackup] Requested profile: %@", id);
     Profile *profile = [_profileManager getProfileById:id];
     // 不存在该备份直接返回
-    if(!profile || [[ProfileManager sharedManager]isCurrent:profile]) return;
+    if(!profile || [[ProfileManager sharedManager]isCurrent:profile]) return YES;
     // 加载所有被选中应用
     NSMutableSet * loadApps = [[AppScopeManager sharedManager] loadPreferences];
     PXLog(@"[switchBackup] Scoped apps: %@", loadApps);
     // 获取当前生效备份
     NSString * activeBackupPath = [_profileManager getActiveDataPath];
+    NSString * fromProfileId = [_profileManager getActiveProfileId];
+    // 长期未用的配置已压缩归档，切换前先并行解包（仍可取消）
+    if ([[ProfileArchiver sharedManager] isArchived:id]) {
+        [job reportStep:@"unpack" bundle:nil];
+        BOOL unpacked = [[ProfileArchiver sharedManager] unpackProfile:id parallelism:_bundleWorkers shouldStop:^BOOL {
+            return job.isCancelled;
+        }];
+        if (!unpacked) {
+            PXLog(@"[switchBackup] Failed to unpack archived profile %@", id);
+            return NO;
+        }
+    }
+    // 之后开始修改容器数据，不再允许取消
+    if (job && ![job enterCommitPhase]) {
+        PXLog(@"[switchBackup] Cancelled before touching containers");
+        return NO;
+    }
     [_profileManager switchToProfile:profile];
     NSString * waitActiveBackupPath = [_profileManager getActiveDataPath];
     PXLog(@"[switchBackup] Active backup path: %@", activeBackupPath);
     PXLog(@"[switchBackup] Target backup path: %@", waitActiveBackupPath);
 
-    for (NSString * bundleId in loadApps){
+    [self runBundles:loadApps job:job work:^(NSString *bundleId) {
         PXLog(@"[switchBackup] Processing bundle: %@", bundleId);
         // 强制关停应用
+        [job reportStep:@"kill" bundle:bundleId];
         [self killApp:bundleId];
        
+        if (activeBackupPath) {
+            // 目标数据在备份目录中准备好后与沙盒原子交换，旧数据直接留在备份位置
+            PXLog(@"[switchBackup] Swapping data for %@", bundleId);
+            [job reportStep:@"swap" bundle:bundleId];
+            [self swapBundle:bundleId fromBackup:waitActiveBackupPath saveTo:activeBackupPath];
+            return;
+        }
         // 清理or备份沙盒数据到activeBackUp中
         PXLog(@"[switchBackup] Backup current data for %@", bundleId);
+        [job reportStep:@"backup" bundle:bundleId];
         [self backupFileToPath:bundleId toPath:activeBackupPath];
 
         PXLog(@"[switchBackup] Restoring data for %@", bundleId);
+        [job reportStep:@"restore" bundle:bundleId];
         [self restoreBackupFromPath:waitActiveBackupPath toBundle:bundleId];
+    }];
+    // 目标配置的备份副本交换后仍留在原处，用量不变；原配置刚存入这些 bundle，空闲时重新计量
+    if (activeBackupPath && fromProfileId) {
+        NSSet *savedApps = [loadApps copy];
+        [[JobManager sharedManager] runWhenIdle:^{
+            [[DiskUsageIndex sharedManager] scanBundles:savedApps ofProfile:fromProfileId];
+        }];
     }
     
     if ([[NSUserDefaults standardUserDefaults] boolForKey:@"ProjectXDisableKeychainWipe"]) {
         PXLog(@"[switchBackup] Keychain wipe disabled by ProjectXDisableKeychainWipe");
     } else {
-        PXLog(@"[switchBackup] Clearing keychain");
-        [self clearKeyChain];
+        PXLog(@"[switchBackup] Swapping keychain");
+        [job reportStep:@"keychain" bundle:nil];
+        if (activeBackupPath) {
+            [[KeychainStore sharedManager] saveSnapshotTo:[activeBackupPath stringByAppendingPathComponent:@"keychain.db"]];
+        }
+        [[KeychainStore sharedManager] resetRestoringSnapshot:[waitActiveBackupPath stringByAppendingPathComponent:@"keychain.db"]];
+        [[KeychainStore sharedManager] scheduleVacuum];
     }
 
     // 加载备份下PhoneInfo
@@ -142,29 +326,13 @@
                                             NULL, 
                                             YES);
     PXLog(@"[switchBackup] Finished switchBackup");
-                
+    // 记录切换顺序并在空闲时预置下一个可能的配置
+    [[ProfileStager sharedManager] profileDidChangeFrom:fromProfileId to:profile.id];
+    [[PhoneInfoPool sharedManager] scheduleRefill];
+    [self scheduleColdProfileWork:fromProfileId];
+    return YES;
 }
 
-- (void) clearKeyChain{
-	sqlite3 *database;
-	int openResult = sqlite3_open("/private/var/Keychains/keychain-2.db", &database);
-	if (openResult == SQLITE_OK)
-	{
-		sqlite3_exec(database, "DELETE FROM genp WHERE agrp <> 'apple';", NULL, NULL, NULL);
-
-		sqlite3_exec(database, "DELETE FROM cert WHERE agrp <> 'lockdown-identities';", NULL, NULL, NULL);
-
-		sqlite3_exec(database, "DELETE FROM keys WHERE agrp <> 'lockdown-identities';", NULL, NULL, NULL);
-
-		sqlite3_exec(database, "DELETE FROM inet;", NULL, NULL, NULL);
-
-		sqlite3_exec(database, "DELETE FROM sqlite_sequence;", NULL, NULL, NULL);
-		
-        sqlite3_exec(database, "VACUUM;", NULL, NULL, NULL);
-		
-        sqlite3_close(database);
-	}
-}
 - (void) killApp:(NSString *) bundleId{
     LSApplicationProxy* appProxy = [LSApplicationProxy applicationProxyForIdentifier:bundleId];
     
@@ -184,31 +352,17 @@
     }
 
     NSFileManager *fm = [NSFileManager defaultManager];
-    if(![fm fileExistsAtPath:savePath]){
-        NSMutableDictionary *attributes = [NSMutableDictionary dictionary];
-        attributes[NSFilePosixPermissions] = @0755;
-        if (NSFileOwnerAccountName) {
-            attributes[NSFileOwnerAccountName] = @"mobile";
-        }
-        if (NSFileGroupOwnerAccountName) {
-            attributes[NSFileGroupOwnerAccountName] = @"mobile";
-        }
-        
-        [fm createDirectoryAtPath:savePath
-               withIntermediateDirectories:YES
-                                attributes:attributes
-                                     error:nil];
-    }
+    [self ensureBackupDirectory:savePath];
     NSArray *folders = @[@"Documents", @"tmp", @"Library", @"SystemData"];
 
     //
     // 1️⃣ 先把整个目录直接移动到备份目录
     //
-    for (NSString *folder in folders) {
+    [self runFolders:folders work:^(NSString *folder) {
         NSString *src = [appDataPath stringByAppendingPathComponent:folder];
         NSString *dst = [savePath stringByAppendingPathComponent:folder];
 
-        if (![fm fileExistsAtPath:src]) continue;
+        if (![fm fileExistsAtPath:src]) return;
         PXLog(@"[backupFile] Moving %@ -> %@", src, dst);
         [self delFile:dst];
 
@@ -217,7 +371,7 @@
             NSLog(@"[ERROR] move %@ -> %@ failed: %@", src, dst, moveErr);
             PXLog(@"[backupFile] Move failed %@ -> %@ (%@)", src, dst, moveErr);
         }
-    }
+    }];
 
     //
     // 2️⃣ 重新创建必须存在的目录
@@ -257,37 +411,126 @@
     NSArray *folders = @[@"Documents", @"tmp", @"Library", @"SystemData"];
 
     //
-    // 1️⃣ 逐个把备份目录拷贝回去（整个目录）
+    // 1️⃣ 逐个把备份目录克隆回去（整个目录，APFS 上只复制元数据）
     //
-    for (NSString *folder in folders) {
+    [self runFolders:folders work:^(NSString *folder) {
         NSString *src = [savePath stringByAppendingPathComponent:folder];
         NSString *dst = [appDataPath stringByAppendingPathComponent:folder];
 
         BOOL isDir = NO;
         if (![fm fileExistsAtPath:src isDirectory:&isDir] || !isDir) {
-            continue;   // 备份中没有该目录就跳过
+            return;   // 备份中没有该目录就跳过
         }
 
         // 目标存在，先删除
         PXLog(@"[restoreBackup] Removing existing %@", dst);
         [self delFile:dst];
 
+        // 克隆/拷贝时同一遍统一权限
         NSError *copyErr = nil;
-        if (![fm copyItemAtPath:src toPath:dst error:&copyErr]) {
+        FileCloneResult result = cloneItemTree(src, dst, MobileOwnership(), &copyErr);
+        if (result == FileCloneFailed) {
             NSLog(@"[ERROR] copy %@ -> %@ failed: %@", src, dst, copyErr);
             PXLog(@"[restoreBackup] Copy failed %@ -> %@ (%@)", src, dst, copyErr);
         } else {
             NSLog(@"[DEBUG] Restored %@ -> %@", src, dst);
-            PXLog(@"[restoreBackup] Restored %@ -> %@", src, dst);
+            PXLog(@"[restoreBackup] Restored %@ -> %@ (%@)", src, dst, result == FileCloneCloned ? @"clone" : @"copy");
         }
-
-        // 统一权限（递归）
-        [self applyMobile755Recursive:dst];
-    }
+    }];
 
     //
     // 2️⃣ 确保关键目录存在（有些应用启动必须要有）
     //
+    [self ensureContainerDirectories:appDataPath];
+}
+
+// 切换时按目录原子交换：先把目标备份克隆到当前备份的位置，再用 RENAME_SWAP
+// 与沙盒目录互换。应用看到的切换只有一次系统调用，旧数据正好落在备份位置；
+// 中途崩溃时沙盒目录要么是旧数据要么是新数据，不会半恢复
+- (void)swapBundle:(NSString *)bundleId fromBackup:(NSString *)backupPath saveTo:(NSString *)activeBackupPath {
+    NSString *appDataPath = [self getAppDataPath:bundleId];
+    NSString *targetPath = [backupPath stringByAppendingPathComponent:bundleId];
+    NSString *savePath = [activeBackupPath stringByAppendingPathComponent:bundleId];
+    PXLog(@"[swapBundle] bundle=%@ appData=%@ target=%@ savePath=%@", bundleId, appDataPath, targetPath, savePath);
+    if (appDataPath.length == 0) {
+        PXLog(@"[swapBundle] Missing appDataPath for %@; skipping switch to avoid relative deletes", bundleId);
+        return;
+    }
+
+    NSFileManager *fm = [NSFileManager defaultManager];
+    [self ensureBackupDirectory:savePath];
+    NSArray *folders = @[@"Documents", @"tmp", @"Library", @"SystemData"];
+
+    [self runFolders:folders work:^(NSString *folder) {
+        NSString *live = [appDataPath stringByAppendingPathComponent:folder];
+        NSString *target = [targetPath stringByAppendingPathComponent:folder];
+        NSString *saved = [savePath stringByAppendingPathComponent:folder];
+        BOOL targetIsDir = NO;
+        BOOL hasTarget = [fm fileExistsAtPath:target isDirectory:&targetIsDir] && targetIsDir;
+
+        if (![fm fileExistsAtPath:live]) {
+            // 沙盒中没有该目录，无需交换
+            if (hasTarget && cloneItemTree(target, live, MobileOwnership(), nil) == FileCloneFailed) {
+                PXLog(@"[swapBundle] Restore failed %@ -> %@", target, live);
+            }
+            return;
+        }
+
+        // 1️⃣ 在备份位置准备好目标数据（备份中没有该目录则为空目录），权限在交换前统一好
+        [self delFile:saved];
+        NSError *stageErr = nil;
+        BOOL staged = hasTarget
+            ? ([[ProfileStager sharedManager] takeStagedFolder:folder bundle:bundleId profile:[backupPath lastPathComponent] toPath:saved] ||
+               cloneItemTree(target, saved, MobileOwnership(), &stageErr) != FileCloneFailed)
+            : ([fm createDirectoryAtPath:saved withIntermediateDirectories:NO attributes:nil error:&stageErr] &&
+               fixupItemOwnership(saved, MobileOwnership()));
+        if (!staged) {
+            PXLog(@"[swapBundle] Staging failed %@ -> %@ (%@)", target, saved, stageErr);
+            return;
+        }
+
+        // 2️⃣ 原子交换
+        if (renamex_np(saved.fileSystemRepresentation, live.fileSystemRepresentation, RENAME_SWAP) == 0) {
+            PXLog(@"[swapBundle] Swapped %@ <-> %@", live, saved);
+        } else {
+            // 文件系统不支持交换：退回先移出再拷入
+            PXLog(@"[swapBundle] RENAME_SWAP failed for %@ (%s); falling back to move+copy", live, strerror(errno));
+            [self delFile:saved];
+            NSError *moveErr = nil;
+            if (![fm moveItemAtPath:live toPath:saved error:&moveErr]) {
+                PXLog(@"[swapBundle] Move failed %@ -> %@ (%@)", live, saved, moveErr);
+                return;
+            }
+            if (hasTarget && cloneItemTree(target, live, MobileOwnership(), nil) == FileCloneFailed) {
+                PXLog(@"[swapBundle] Restore failed %@ -> %@", target, live);
+            }
+        }
+    }];
+
+    [self ensureContainerDirectories:appDataPath];
+}
+
+- (void)ensureBackupDirectory:(NSString *)savePath {
+    NSFileManager *fm = [NSFileManager defaultManager];
+    if(![fm fileExistsAtPath:savePath]){
+        NSMutableDictionary *attributes = [NSMutableDictionary dictionary];
+        attributes[NSFilePosixPermissions] = @0755;
+        if (NSFileOwnerAccountName) {
+            attributes[NSFileOwnerAccountName] = @"mobile";
+        }
+        if (NSFileGroupOwnerAccountName) {
+            attributes[NSFileGroupOwnerAccountName] = @"mobile";
+        }
+        
+        [fm createDirectoryAtPath:savePath
+               withIntermediateDirectories:YES
+                                attributes:attributes
+                                     error:nil];
+    }
+}
+
+- (void)ensureContainerDirectories:(NSString *)appDataPath {
+    NSFileManager *fm = [NSFileManager defaultManager];
     NSArray *mustExist = @[
         @"Documents",
         @"tmp",
@@ -301,41 +544,33 @@
         NSString *dst = [appDataPath stringByAppendingPathComponent:folder];
 
         if (![fm fileExistsAtPath:dst]) {
-            PXLog(@"[restoreBackup] Creating missing directory %@", dst);
+            PXLog(@"[ensureContainer] Creating missing directory %@", dst);
             [fm createDirectoryAtPath:dst
           withIntermediateDirectories:YES
                            attributes:nil
                                 error:nil];
         }
 
-        [self applyMobile755Recursive:dst];
+        // 目录内容已在克隆/拷贝时统一过权限，这里只处理目录本身
+        fixupItemOwnership(dst, MobileOwnership());
     }
 }
 
+// 单遍 fts 流式遍历，已是 mobile:mobile 0755 的条目不再写入
 - (void)applyMobile755Recursive:(NSString *)path {
-    NSFileManager *fm = [NSFileManager defaultManager];
-
-    NSMutableDictionary *attrs = [NSMutableDictionary dictionary];
-    attrs[NSFilePosixPermissions] = @(0755);
-    if (NSFileOwnerAccountName) {
-        attrs[NSFileOwnerAccountName] = @"mobile";
-    }
-    if (NSFileGroupOwnerAccountName) {
-        attrs[NSFileGroupOwnerAccountName] = @"mobile";
-    }
-
-    [fm setAttributes:attrs ofItemAtPath:path error:nil];
-
-    NSArray *contents = [fm subpathsAtPath:path];
-    for (NSString *sub in contents) {
-        NSString *full = [path stringByAppendingPathComponent:sub];
-        [fm setAttributes:attrs ofItemAtPath:full error:nil];
+    NSUInteger failures = fixupTreeOwnership(path, MobileOwnership());
+    if (failures > 0) {
+        PXLog(@"[applyMobile755] %lu entries under %@ could not be fixed", (unsigned long)failures, path);
     }
 }
 
 
 -(void) delFile:(NSString *) path{
-    NSFileManager *fm = [NSFileManager defaultManager];
+    [self delFile:path parallelism:1];
+}
+
+// parallelism > 1 删除顶层子目录时并发进行，只用于不在 IO 预算内的整目录删除
+-(void) delFile:(NSString *) path parallelism:(NSUInteger)parallelism{
     // 判断文件是否存在 存在就删除
     if (!path.length) {
         return;
@@ -367,16 +602,29 @@
         PXLog(@"[ProjectXDaemon] Refusing to delete protected path: %@", path);
         return;
     }
-    if([fm fileExistsAtPath:path]){
-        NSString *res = runCommand([NSString stringWithFormat:@"rm -rf %@",path]);
-        PXLog(@"delFile res:%@",res);
+    // 目录先整体改名进回收站，请求无需等待递归删除；不能改名时（如只读卷）原地删除
+    struct stat st;
+    if (lstat(path.fileSystemRepresentation, &st) == 0 && S_ISDIR(st.st_mode) &&
+        [[TrashQueue sharedManager] moveToTrash:path]) {
+        return;
+    }
+    // 进程内递归删除，不再为每个路径 spawn sh + rm
+    NSUInteger failures = removeItemTree(path, parallelism, ^(NSString *failedPath, int err) {
+        PXLog(@"delFile failed %@: %s", failedPath, strerror(err));
+    });
+    if (failures > 0) {
+        PXLog(@"delFile %@ left %lu entries", path, (unsigned long)failures);
     }
 }
 
 -(void) removeBackup:(NSString *)id{
     if([_profileManager removeProfileById:id]){
-        NSString * removePath = [NSString stringWithFormat:@"/private/var/mobile/Media/ProjectX/%@", id];
-        [self delFile:removePath];
+        [[ProfileStager sharedManager] invalidateProfile:id];
+        NSString * removePath = [_profileManager pathForProfileId:id];
+        [self delFile:removePath parallelism:_bundleWorkers];
+        [[ProfileArchiver sharedManager] removeArchive:id];
+        [[DiskUsageIndex sharedManager] removeProfile:id];
+        [[ContentStore sharedManager] scheduleGarbageCollection];
     }
 }
 
@@ -0,0 +1,29 @@
+#import <Foundation/Foundation.h>
+
+// Include/exclude rules deciding what of an app container is kept in a backup.
+//
+// Stored as
+//   {
+//     "UseDefaults": YES,
+//     "GlobalRules": [ {"pattern": "Library/Caches/**", "action": "exclude"}, ... ],
+//     "PerAppRules": { "<bundleId>": [ {"pattern": "**/*.mp4", "action": "exclude", "minSize": 1048576} ] }
+//   }
+// Patterns are relative to the container root and matched per path segment:
+// `*`, `?` and `[...]` within a segment, `**` for any number of segments.
+// Rules are evaluated defaults -> global -> per-app and the last match wins, so
+// an "include" can re-admit something a default excludes. minSize restricts a
+// rule to regular files at least that large.
+@interface BackupRules : NSObject
+
++ (instancetype)sharedManager;
+
+// Stored rules plus the read-only "DefaultRules".
+- (NSDictionary *)loadRules;
+// Validates and stores; returns NO with a message for malformed rules.
+- (BOOL)saveRules:(NSDictionary *)rules error:(NSString **)error;
+
+// Removes excluded entries from a backed-up container tree in one walk.
+// Excluded directories are kept, empty, so a restore recreates them empty.
+- (void)pruneBundleTree:(NSString *)root bundle:(NSString *)bundleId;
+
+@end
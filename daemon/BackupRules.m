@@ -0,0 +1,216 @@
+#import "BackupRules.h"
+#import "FileRemover.h"
+#import "ProjectXLogging.h"
+#import "BackupRulesCore.h"
+#include <fts.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if __has_include(<roothide.h>)
+#import <roothide.h>
+#else
+#ifndef jbroot
+#define jbroot(path) (path)
+#endif
+#endif
+
+typedef struct {
+    BackupRule *rules;
+    int count;
+} RuleProgram;
+
+static BOOL compileRule(NSDictionary *spec, BackupRule *out, NSString **error) {
+    NSString *pattern = [spec isKindOfClass:[NSDictionary class]] ? spec[@"pattern"] : nil;
+    NSString *action = [spec isKindOfClass:[NSDictionary class]] ? spec[@"action"] : nil;
+    if (![pattern isKindOfClass:[NSString class]] || pattern.length == 0) {
+        if (error) *error = @"rule without pattern";
+        return NO;
+    }
+    if (![action isKindOfClass:[NSString class]] ||
+        !([action isEqualToString:@"exclude"] || [action isEqualToString:@"include"])) {
+        if (error) *error = [NSString stringWithFormat:@"rule %@: action must be include or exclude", pattern];
+        return NO;
+    }
+    int64_t minSize = [spec[@"minSize"] respondsToSelector:@selector(longLongValue)] ? [spec[@"minSize"] longLongValue] : 0;
+    switch (BackupRuleCompile(pattern.fileSystemRepresentation, [action isEqualToString:@"exclude"], minSize, out)) {
+        case BackupRuleOK:
+            return YES;
+        case BackupRuleNoMemory:
+            if (error) *error = [NSString stringWithFormat:@"rule %@: out of memory", pattern];
+            return NO;
+        default:
+            if (error) *error = [NSString stringWithFormat:@"rule %@: bad segment count", pattern];
+            return NO;
+    }
+}
+
+static void freeProgram(RuleProgram *program) {
+    for (int i = 0; i < program->count; i++) BackupRuleFree(&program->rules[i]);
+    free(program->rules);
+}
+
+@implementation BackupRules
+
++ (instancetype)sharedManager {
+    static BackupRules *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (NSString *)rulesFilePath {
+    return jbroot(@"/var/mobile/Library/Preferences/com.projectx.backuprules.plist");
+}
+
+// Regenerable data apps rebuild on launch; the patterns live in BackupRulesCore.
+- (NSArray<NSDictionary *> *)defaultRules {
+    NSMutableArray<NSDictionary *> *rules = [NSMutableArray arrayWithCapacity:kBackupDefaultExcludeCount];
+    for (int i = 0; i < kBackupDefaultExcludeCount; i++) {
+        [rules addObject:@{ @"pattern": @(kBackupDefaultExcludes[i]), @"action": @"exclude" }];
+    }
+    return rules;
+}
+
+- (NSDictionary *)loadRules {
+    NSDictionary *stored = [NSDictionary dictionaryWithContentsOfFile:[self rulesFilePath]];
+    if (![stored isKindOfClass:[NSDictionary class]]) stored = @{};
+    NSArray *global = stored[@"GlobalRules"];
+    NSDictionary *perApp = stored[@"PerAppRules"];
+    return @{
+        @"UseDefaults": stored[@"UseDefaults"] ?: @YES,
+        @"GlobalRules": [global isKindOfClass:[NSArray class]] ? global : @[],
+        @"PerAppRules": [perApp isKindOfClass:[NSDictionary class]] ? perApp : @{},
+        @"DefaultRules": [self defaultRules]
+    };
+}
+
+- (BOOL)saveRules:(NSDictionary *)rules error:(NSString **)error {
+    if (![rules isKindOfClass:[NSDictionary class]]) {
+        if (error) *error = @"rules must be an object";
+        return NO;
+    }
+    NSArray *global = rules[@"GlobalRules"] ?: @[];
+    NSDictionary *perApp = rules[@"PerAppRules"] ?: @{};
+    NSNumber *useDefaults = rules[@"UseDefaults"] ?: @YES;
+    if (![global isKindOfClass:[NSArray class]] || ![perApp isKindOfClass:[NSDictionary class]]) {
+        if (error) *error = @"GlobalRules must be an array and PerAppRules an object";
+        return NO;
+    }
+    if (![useDefaults isKindOfClass:[NSNumber class]]) {
+        if (error) *error = @"UseDefaults must be a boolean";
+        return NO;
+    }
+    NSMutableArray *all = [global mutableCopy];
+    for (id list in perApp.allValues) {
+        if (![list isKindOfClass:[NSArray class]]) {
+            if (error) *error = @"PerAppRules values must be arrays";
+            return NO;
+        }
+        [all addObjectsFromArray:list];
+    }
+    for (NSDictionary *spec in all) {
+        BackupRule rule = {0};
+        if (!compileRule(spec, &rule, error)) return NO;
+        BackupRuleFree(&rule);
+    }
+
+    NSDictionary *stored = @{
+        @"UseDefaults": @(useDefaults.boolValue),
+        @"GlobalRules": global,
+        @"PerAppRules": perApp
+    };
+    if (![stored writeToFile:[self rulesFilePath] atomically:YES]) {
+        if (error) *error = @"failed to write rules";
+        return NO;
+    }
+    return YES;
+}
+
+- (RuleProgram)programForBundle:(NSString *)bundleId {
+    NSDictionary *rules = [self loadRules];
+    NSMutableArray<NSDictionary *> *specs = [NSMutableArray array];
+    if ([rules[@"UseDefaults"] boolValue]) [specs addObjectsFromArray:rules[@"DefaultRules"]];
+    [specs addObjectsFromArray:rules[@"GlobalRules"]];
+    NSArray *perApp = bundleId ? rules[@"PerAppRules"][bundleId] : nil;
+    if ([perApp isKindOfClass:[NSArray class]]) [specs addObjectsFromArray:perApp];
+
+    RuleProgram program = { calloc(specs.count ?: 1, sizeof(BackupRule)), 0 };
+    for (NSDictionary *spec in specs) {
+        NSString *error = nil;
+        if (compileRule(spec, &program.rules[program.count], &error)) {
+            program.count++;
+        } else {
+            PXLog(@"[BackupRules] Ignoring rule for %@: %@", bundleId, error);
+        }
+    }
+    return program;
+}
+
+- (void)pruneBundleTree:(NSString *)root bundle:(NSString *)bundleId {
+    RuleProgram program = [self programForBundle:bundleId];
+    if (program.count == 0) {
+        freeProgram(&program);
+        return;
+    }
+    size_t stateSize = program.count * sizeof(uint64_t);
+
+    char *roots[] = { (char *)root.fileSystemRepresentation, NULL };
+    FTS *fts = fts_open(roots, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL);
+    if (!fts) {
+        freeProgram(&program);
+        return;
+    }
+
+    NSUInteger removedFiles = 0, emptiedDirs = 0;
+    FTSENT *entry;
+    while ((entry = fts_read(fts))) {
+        if (entry->fts_info == FTS_DP) {
+            free(entry->fts_pointer);
+            entry->fts_pointer = NULL;
+            continue;
+        }
+        if (entry->fts_level == 0) {
+            if (entry->fts_info != FTS_D) break;
+            uint64_t *initial = malloc(stateSize);
+            for (int i = 0; i < program.count; i++) initial[i] = BackupRuleInitialState(&program.rules[i]);
+            entry->fts_pointer = initial;
+            continue;
+        }
+        if (entry->fts_info == FTS_DNR || entry->fts_info == FTS_ERR || entry->fts_info == FTS_NS) continue;
+
+        const uint64_t *parent = entry->fts_parent->fts_pointer;
+        uint64_t *state = malloc(stateSize);
+        BOOL isDir = entry->fts_info == FTS_D;
+        BackupDecision decision = BackupRulesStep(program.rules, program.count, parent, entry->fts_name, isDir,
+                                                  entry->fts_statp->st_size, state);
+        BOOL exclude = decision.exclude, rescuable = decision.rescuable;
+
+        if (!isDir) {
+            free(state);
+            if (exclude && unlink(entry->fts_accpath) == 0) removedFiles++;
+            continue;
+        }
+        if (exclude && !rescuable) {
+            // Nothing below can be included again: empty the directory without walking it.
+            free(state);
+            fts_set(fts, entry, FTS_SKIP);
+            mode_t mode = entry->fts_statp->st_mode & 07777;
+            removeItemTree([NSString stringWithUTF8String:entry->fts_accpath], 1, nil);
+            if (mkdir(entry->fts_accpath, mode) == 0) {
+                lchown(entry->fts_accpath, entry->fts_statp->st_uid, entry->fts_statp->st_gid);
+            }
+            emptiedDirs++;
+            continue;
+        }
+        entry->fts_pointer = state;
+    }
+    fts_close(fts);
+    freeProgram(&program);
+    if (removedFiles || emptiedDirs) {
+        PXLog(@"[BackupRules] Pruned %@ (%@): %lu files, %lu directories emptied",
+              root, bundleId, (unsigned long)removedFiles, (unsigned long)emptiedDirs);
+    }
+}
+
+@end
@@ -0,0 +1,74 @@
+#ifndef BACKUP_RULES_CORE_H
+#define BACKUP_RULES_CORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// BackupRules' pattern matcher, plain C so bench/ can check and time it on any
+// host. BackupRules validates the stored rules and walks the tree; this only
+// sees patterns and path segments.
+//
+// Patterns are compiled to per-segment matchers and run as an NFA over path
+// segments: each rule's state is a bitmask of pattern positions still alive.
+// The walk carries the state of every directory down to its children, so each
+// entry costs one transition per rule regardless of depth.
+
+// One bit per position plus the accepting one, in a uint64_t.
+#define kBackupRuleMaxSegments 62
+
+typedef enum {
+    BackupSegmentLiteral,
+    BackupSegmentGlob,    // *, ? or [...] within the segment (fnmatch)
+    BackupSegmentAnyDepth // **
+} BackupSegmentKind;
+
+typedef struct {
+    BackupSegmentKind kind;
+    char *text; // NULL for **
+} BackupSegment;
+
+typedef struct {
+    BackupSegment *segments;
+    int count;
+    bool exclude;
+    int64_t minSize; // 0, or only regular files at least this large match
+} BackupRule;
+
+// Patterns of the default rules, all "exclude": regenerable data apps rebuild
+// on launch.
+extern const char *const kBackupDefaultExcludes[];
+extern const int kBackupDefaultExcludeCount;
+
+typedef enum {
+    BackupRuleOK = 0,
+    BackupRuleNoSegments, // empty, or only slashes
+    BackupRuleTooDeep,    // more than kBackupRuleMaxSegments segments
+    BackupRuleNoMemory,
+} BackupRuleError;
+
+// Splits pattern on '/', dropping empty segments ("a//b", "/a", "a/" are "a/b",
+// "a", "a"). out is untouched on error.
+BackupRuleError BackupRuleCompile(const char *pattern, bool exclude, int64_t minSize, BackupRule *out);
+void BackupRuleFree(BackupRule *rule);
+
+// State of the container root.
+uint64_t BackupRuleInitialState(const BackupRule *rule);
+// State of the entry called name inside a directory in state.
+uint64_t BackupRuleAdvance(const BackupRule *rule, uint64_t state, const char *name);
+// The path up to here matches the whole pattern.
+bool BackupRuleAccepts(const BackupRule *rule, uint64_t state);
+// Something below this entry could still match.
+bool BackupRuleAlive(const BackupRule *rule, uint64_t state);
+
+typedef struct {
+    bool exclude;   // the last matching rule excludes it
+    bool rescuable; // an include rule could still match something below it
+} BackupDecision;
+
+// Advances every rule from the parent's states into states (count entries) and
+// decides the entry. Rules apply in order and the last match wins; a rule with
+// minSize only matches regular files of at least that size.
+BackupDecision BackupRulesStep(const BackupRule *rules, int count, const uint64_t *parentStates, const char *name,
+                               bool isDirectory, int64_t size, uint64_t *states);
+
+#endif
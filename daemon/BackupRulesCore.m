@@ -0,0 +1,118 @@
+#include "BackupRulesCore.h"
+
+#include <fnmatch.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char *const kBackupDefaultExcludes[] = {
+    "Library/Caches/**",
+    "tmp/**",
+    "Library/WebKit/**/NetworkCache/**",
+    "Library/Saved Application State/**",
+};
+const int kBackupDefaultExcludeCount = sizeof(kBackupDefaultExcludes) / sizeof(kBackupDefaultExcludes[0]);
+
+// ---- Compilation ----
+
+static void freeSegments(BackupSegment *segments, int count) {
+    for (int i = 0; i < count; i++) free(segments[i].text);
+    free(segments);
+}
+
+BackupRuleError BackupRuleCompile(const char *pattern, bool exclude, int64_t minSize, BackupRule *out) {
+    int count = 0;
+    for (const char *p = pattern; *p;) {
+        size_t length = strcspn(p, "/");
+        if (length) count++;
+        p += length;
+        if (*p == '/') p++;
+    }
+    if (count == 0) return BackupRuleNoSegments;
+    if (count > kBackupRuleMaxSegments) return BackupRuleTooDeep;
+
+    BackupSegment *segments = calloc((size_t)count, sizeof(BackupSegment));
+    if (!segments) return BackupRuleNoMemory;
+    int i = 0;
+    for (const char *p = pattern; *p;) {
+        size_t length = strcspn(p, "/");
+        if (length) {
+            BackupSegment *segment = &segments[i++];
+            if (length == 2 && p[0] == '*' && p[1] == '*') {
+                segment->kind = BackupSegmentAnyDepth;
+            } else {
+                segment->text = strndup(p, length);
+                if (!segment->text) {
+                    freeSegments(segments, count);
+                    return BackupRuleNoMemory;
+                }
+                segment->kind = strpbrk(segment->text, "*?[") ? BackupSegmentGlob : BackupSegmentLiteral;
+            }
+        }
+        p += length;
+        if (*p == '/') p++;
+    }
+    *out = (BackupRule){ .segments = segments, .count = count, .exclude = exclude, .minSize = minSize };
+    return BackupRuleOK;
+}
+
+void BackupRuleFree(BackupRule *rule) {
+    freeSegments(rule->segments, rule->count);
+    rule->segments = NULL;
+    rule->count = 0;
+}
+
+// ---- Matching ----
+
+static uint64_t closeOver(const BackupRule *rule, uint64_t mask) {
+    // `**` also matches zero segments: position i alive implies i+1 alive.
+    for (int i = 0; i < rule->count; i++) {
+        if ((mask & (1ULL << i)) && rule->segments[i].kind == BackupSegmentAnyDepth) mask |= 1ULL << (i + 1);
+    }
+    return mask;
+}
+
+uint64_t BackupRuleInitialState(const BackupRule *rule) {
+    return closeOver(rule, 1);
+}
+
+uint64_t BackupRuleAdvance(const BackupRule *rule, uint64_t state, const char *name) {
+    uint64_t next = 0;
+    for (int i = 0; i < rule->count; i++) {
+        if (!(state & (1ULL << i))) continue;
+        const BackupSegment *segment = &rule->segments[i];
+        switch (segment->kind) {
+            case BackupSegmentAnyDepth:
+                next |= 1ULL << i;
+                break;
+            case BackupSegmentLiteral:
+                if (strcmp(segment->text, name) == 0) next |= 1ULL << (i + 1);
+                break;
+            case BackupSegmentGlob:
+                if (fnmatch(segment->text, name, 0) == 0) next |= 1ULL << (i + 1);
+                break;
+        }
+    }
+    return closeOver(rule, next);
+}
+
+bool BackupRuleAccepts(const BackupRule *rule, uint64_t state) {
+    return (state & (1ULL << rule->count)) != 0;
+}
+
+bool BackupRuleAlive(const BackupRule *rule, uint64_t state) {
+    return (state & ((1ULL << rule->count) - 1)) != 0;
+}
+
+BackupDecision BackupRulesStep(const BackupRule *rules, int count, const uint64_t *parentStates, const char *name,
+                               bool isDirectory, int64_t size, uint64_t *states) {
+    BackupDecision decision = { false, false };
+    for (int i = 0; i < count; i++) {
+        const BackupRule *rule = &rules[i];
+        states[i] = BackupRuleAdvance(rule, parentStates[i], name);
+        if (BackupRuleAccepts(rule, states[i]) && (rule->minSize == 0 || (!isDirectory && size >= rule->minSize))) {
+            decision.exclude = rule->exclude;
+        }
+        if (!rule->exclude && BackupRuleAlive(rule, states[i])) decision.rescuable = true;
+    }
+    return decision;
+}
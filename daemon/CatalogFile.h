@@ -0,0 +1,27 @@
+#import <Foundation/Foundation.h>
+
+// Read-only view of IOS.catalog, the flat file scripts/compile_catalog.py
+// builds from IOS.db at package time. The file is mapped, not read; rows are
+// decoded on request into the same dictionaries DBManager returns (NSNumber,
+// NSString, NSNull), keyed by column name.
+@interface CatalogFile : NSObject
+
+// nil if the file is missing, truncated, of another format version or fails
+// its checksum; callers fall back to IOS.db.
++ (instancetype)catalogAtPath:(NSString *)path;
+
+// Tables compiled into the file, in file order.
+- (NSArray<NSString *> *)tableNames;
+// All rows of a table in database order, or nil if the table is not compiled in.
+- (NSArray<NSDictionary *> *)rowsOfTable:(NSString *)table;
+// Rows ordered by a column (NULLs first, then byte order), using the index
+// stored in the file; nil if that column has no index.
+- (NSArray<NSDictionary *> *)rowsOfTable:(NSString *)table orderedBy:(NSString *)column;
+
+@end
+
+// left LEFT JOIN right ON left.leftColumn = right.rightColumn over decoded rows,
+// in left order and then right order, right's columns winning on name clashes
+// as in the dictionaries built from the SQL result. nil if either side is nil.
+NSArray<NSDictionary *> *CatalogLeftJoin(NSArray<NSDictionary *> *left, NSArray<NSDictionary *> *right,
+                                         NSString *leftColumn, NSString *rightColumn);
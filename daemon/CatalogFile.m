@@ -0,0 +1,254 @@
+#import "CatalogFile.h"
+#import "ProjectXLogging.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Layout is documented in scripts/compile_catalog.py; all fields little-endian.
+static const char kCatalogMagic[8] = "PXCATLG";
+static const uint32_t kCatalogFormatVersion = 1;
+
+enum { kCellNull = 0, kCellInteger = 1, kCellReal = 2, kCellText = 3 };
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t tableCount;
+    uint32_t poolOffset;
+    uint32_t poolLength;
+    uint64_t payloadLength;
+    uint64_t checksum;
+} CatalogHeader;
+
+typedef struct {
+    uint32_t nameOffset, nameLength;
+    uint32_t columnCount, rowCount;
+    uint32_t columnsOffset;
+    uint32_t cellsOffset;
+    uint32_t indexCount, indexesOffset;
+} CatalogTable;
+
+typedef struct {
+    uint8_t type;
+    uint8_t pad[7];
+    uint64_t value;
+} CatalogCell;
+
+typedef struct {
+    uint32_t first, second;
+} CatalogPair;
+
+static uint64_t fnv1a64(const uint8_t *bytes, uint64_t length) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint64_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static BOOL inRange(uint64_t offset, uint64_t length, uint64_t limit) {
+    return offset <= limit && length <= limit - offset;
+}
+
+@implementation CatalogFile {
+    const uint8_t *_map;
+    size_t _mapLength;
+    const uint8_t *_payload;
+    uint64_t _payloadLength;
+    const uint8_t *_pool;
+    uint32_t _poolLength;
+    const CatalogTable *_tables;
+    // table name -> index into _tables, and each table's column names
+    NSDictionary<NSString *, NSNumber *> *_tableIndex;
+    NSArray<NSArray<NSString *> *> *_columns;
+}
+
++ (instancetype)catalogAtPath:(NSString *)path {
+    int fd = open(path.fileSystemRepresentation, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nil;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CatalogHeader)) {
+        close(fd);
+        PXLog(@"[CatalogFile] %@ is not a catalog", path);
+        return nil;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        PXLog(@"[CatalogFile] Cannot map %@: %s", path, strerror(errno));
+        return nil;
+    }
+    CatalogFile *catalog = [[self alloc] initWithMap:map length:(size_t)st.st_size];
+    if (!catalog) PXLog(@"[CatalogFile] %@ failed validation", path);
+    return catalog;
+}
+
+// Takes ownership of the mapping; unmaps it on failure.
+- (instancetype)initWithMap:(const uint8_t *)map length:(size_t)length {
+    self = [super init];
+    if (!self) {
+        munmap((void *)map, length);
+        return nil;
+    }
+    _map = map;
+    _mapLength = length;
+
+    const CatalogHeader *header = (const CatalogHeader *)map;
+    if (memcmp(header->magic, kCatalogMagic, sizeof(kCatalogMagic)) != 0 ||
+        header->version != kCatalogFormatVersion ||
+        header->payloadLength != length - sizeof(CatalogHeader)) {
+        return nil;
+    }
+    _payload = map + sizeof(CatalogHeader);
+    _payloadLength = header->payloadLength;
+    if (fnv1a64(_payload, _payloadLength) != header->checksum ||
+        !inRange(header->poolOffset, header->poolLength, _payloadLength) ||
+        !inRange(0, (uint64_t)header->tableCount * sizeof(CatalogTable), _payloadLength)) {
+        return nil;
+    }
+    _pool = _payload + header->poolOffset;
+    _poolLength = header->poolLength;
+    _tables = (const CatalogTable *)_payload;
+
+    NSMutableDictionary<NSString *, NSNumber *> *tableIndex = [NSMutableDictionary dictionary];
+    NSMutableArray<NSArray<NSString *> *> *columns = [NSMutableArray arrayWithCapacity:header->tableCount];
+    for (uint32_t t = 0; t < header->tableCount; t++) {
+        const CatalogTable *table = &_tables[t];
+        uint64_t cellCount = (uint64_t)table->rowCount * table->columnCount;
+        if (!inRange(table->columnsOffset, (uint64_t)table->columnCount * sizeof(CatalogPair), _payloadLength) ||
+            !inRange(table->cellsOffset, cellCount * sizeof(CatalogCell), _payloadLength) ||
+            !inRange(table->indexesOffset, (uint64_t)table->indexCount * sizeof(CatalogPair), _payloadLength)) {
+            return nil;
+        }
+        const CatalogPair *indexes = (const CatalogPair *)(_payload + table->indexesOffset);
+        for (uint32_t i = 0; i < table->indexCount; i++) {
+            if (indexes[i].first >= table->columnCount ||
+                !inRange(indexes[i].second, (uint64_t)table->rowCount * sizeof(uint32_t), _payloadLength)) {
+                return nil;
+            }
+        }
+
+        NSString *name = [self stringAt:table->nameOffset length:table->nameLength];
+        NSMutableArray<NSString *> *names = [NSMutableArray arrayWithCapacity:table->columnCount];
+        const CatalogPair *refs = (const CatalogPair *)(_payload + table->columnsOffset);
+        for (uint32_t c = 0; c < table->columnCount; c++) {
+            NSString *column = [self stringAt:refs[c].first length:refs[c].second];
+            if (!column) return nil;
+            [names addObject:column];
+        }
+        if (!name) return nil;
+        tableIndex[name] = @(t);
+        [columns addObject:names];
+    }
+    _tableIndex = tableIndex;
+    _columns = columns;
+    return self;
+}
+
+- (void)dealloc {
+    if (_map) munmap((void *)_map, _mapLength);
+}
+
+- (NSString *)stringAt:(uint32_t)offset length:(uint32_t)length {
+    if (!inRange(offset, length, _poolLength)) return nil;
+    return [[NSString alloc] initWithBytes:_pool + offset length:length encoding:NSUTF8StringEncoding];
+}
+
+- (NSDictionary *)row:(uint32_t)row ofTable:(uint32_t)t {
+    const CatalogTable *table = &_tables[t];
+    NSArray<NSString *> *columns = _columns[t];
+    const CatalogCell *cells = (const CatalogCell *)(_payload + table->cellsOffset) + (uint64_t)row * table->columnCount;
+    NSMutableDictionary *result = [NSMutableDictionary dictionaryWithCapacity:table->columnCount];
+    for (uint32_t c = 0; c < table->columnCount; c++) {
+        id value = nil;
+        switch (cells[c].type) {
+            case kCellInteger:
+                value = @((int64_t)cells[c].value);
+                break;
+            case kCellReal: {
+                double real;
+                memcpy(&real, &cells[c].value, sizeof(real));
+                value = @(real);
+                break;
+            }
+            case kCellText:
+                value = [self stringAt:(uint32_t)cells[c].value length:(uint32_t)(cells[c].value >> 32)];
+                break;
+        }
+        result[columns[c]] = value ?: [NSNull null];
+    }
+    return result;
+}
+
+- (NSArray<NSString *> *)tableNames {
+    return [_tableIndex keysSortedByValueUsingSelector:@selector(compare:)];
+}
+
+- (NSArray<NSDictionary *> *)rowsOfTable:(NSString *)name {
+    NSNumber *index = _tableIndex[name];
+    if (!index) return nil;
+    uint32_t t = index.unsignedIntValue;
+    uint32_t rowCount = _tables[t].rowCount;
+    NSMutableArray<NSDictionary *> *rows = [NSMutableArray arrayWithCapacity:rowCount];
+    for (uint32_t r = 0; r < rowCount; r++) {
+        [rows addObject:[self row:r ofTable:t]];
+    }
+    return rows;
+}
+
+- (NSArray<NSDictionary *> *)rowsOfTable:(NSString *)name orderedBy:(NSString *)column {
+    NSNumber *index = _tableIndex[name];
+    if (!index) return nil;
+    uint32_t t = index.unsignedIntValue;
+    const CatalogTable *table = &_tables[t];
+    NSUInteger columnIndex = [_columns[t] indexOfObject:column];
+    const CatalogPair *indexes = (const CatalogPair *)(_payload + table->indexesOffset);
+    for (uint32_t i = 0; i < table->indexCount; i++) {
+        if (indexes[i].first != columnIndex) continue;
+        const uint32_t *order = (const uint32_t *)(_payload + indexes[i].second);
+        NSMutableArray<NSDictionary *> *rows = [NSMutableArray arrayWithCapacity:table->rowCount];
+        for (uint32_t r = 0; r < table->rowCount; r++) {
+            if (order[r] >= table->rowCount) return nil;
+            [rows addObject:[self row:order[r] ofTable:t]];
+        }
+        return rows;
+    }
+    return nil;
+}
+
+@end
+
+NSArray<NSDictionary *> *CatalogLeftJoin(NSArray<NSDictionary *> *left, NSArray<NSDictionary *> *right,
+                                         NSString *leftColumn, NSString *rightColumn) {
+    if (!left || !right) return nil;
+    NSMutableDictionary<id, NSMutableArray *> *rightByKey = [NSMutableDictionary dictionary];
+    NSMutableSet<NSString *> *rightColumns = [NSMutableSet set];
+    for (NSDictionary *row in right) {
+        [rightColumns addObjectsFromArray:row.allKeys];
+        id key = row[rightColumn];
+        if (!key || key == [NSNull null]) continue;
+        NSMutableArray *rows = rightByKey[key];
+        if (!rows) rightByKey[key] = rows = [NSMutableArray array];
+        [rows addObject:row];
+    }
+    NSMutableArray<NSDictionary *> *joined = [NSMutableArray arrayWithCapacity:left.count];
+    for (NSDictionary *row in left) {
+        id key = row[leftColumn];
+        NSArray *matches = key ? rightByKey[key] : nil;
+        if (matches.count == 0) {
+            NSMutableDictionary *unmatched = [row mutableCopy];
+            for (NSString *column in rightColumns) unmatched[column] = [NSNull null];
+            [joined addObject:unmatched];
+            continue;
+        }
+        for (NSDictionary *match in matches) {
+            NSMutableDictionary *combined = [row mutableCopy];
+            [combined addEntriesFromDictionary:match];
+            [joined addObject:combined];
+        }
+    }
+    return joined;
+}
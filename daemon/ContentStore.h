@@ -0,0 +1,29 @@
+#import <Foundation/Foundation.h>
+
+// Content-addressed deduplication of profile backups.
+//
+// Profile directories stay plain trees (switching clones/swaps them as-is), but
+// once a profile is cold every large file is hashed (SHA-256) and replaced by an
+// APFS clone of a single canonical object in .store/objects, so identical files
+// across profiles share their blocks. Each profile gets a manifest
+// (.store/manifests/<id>.json) of path -> hash; a mark-and-sweep pass removes
+// objects no manifest of an existing profile references.
+@interface ContentStore : NSObject
+
++ (instancetype)sharedManager;
+
+// Queue a mark-and-sweep, e.g. after a profile was removed.
+- (void)scheduleGarbageCollection;
+// Drops the profile's manifest (its tree is gone or no longer shares blocks);
+// the next collection frees objects only it referenced.
+- (void)forgetProfile:(NSString *)profileId;
+
+// Synchronous; must run on the job queue. Ingest stops early (keeping the work
+// done so far) when a job is waiting.
+- (void)ingestProfile:(NSString *)profileId;
+- (void)collectGarbage;
+
+// Manifest entries of a profile: relative path -> @{size, mtime, ino[, hash]}.
+- (NSDictionary<NSString *, NSDictionary *> *)manifestForProfile:(NSString *)profileId;
+
+@end
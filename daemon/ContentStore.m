@@ -0,0 +1,308 @@
+#import "ContentStore.h"
+#import "ManifestDiff.h"
+#import "ProfileManager.h"
+#import "JobManager.h"
+#import "DiskUsageIndex.h"
+#import "ProjectXLogging.h"
+#import <CommonCrypto/CommonDigest.h>
+#include <copyfile.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/clonefile.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <time.h>
+#include <unistd.h>
+
+#define kStoreRoot @"/private/var/mobile/Media/ProjectX/.store"
+
+// Smaller files cost more in hashing and clone metadata than they save.
+static const off_t kMinDedupSize = 64 * 1024;
+static const size_t kHashBufferSize = 1 << 20;
+
+// Streams the file through SHA-256 without filling the page cache.
+static NSString *sha256OfFile(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nil;
+    fcntl(fd, F_NOCACHE, 1);
+    uint8_t *buffer = malloc(kHashBufferSize);
+    if (!buffer) {
+        close(fd);
+        return nil;
+    }
+    CC_SHA256_CTX ctx;
+    CC_SHA256_Init(&ctx);
+    ssize_t n;
+    while ((n = read(fd, buffer, kHashBufferSize)) > 0) {
+        CC_SHA256_Update(&ctx, buffer, (CC_LONG)n);
+    }
+    free(buffer);
+    close(fd);
+    if (n < 0) return nil;
+
+    unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+    CC_SHA256_Final(digest, &ctx);
+    NSMutableString *hex = [NSMutableString stringWithCapacity:CC_SHA256_DIGEST_LENGTH * 2];
+    for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+        [hex appendFormat:@"%02x", digest[i]];
+    }
+    return hex;
+}
+
+// Removes every extended attribute of fd, so copying the original's in
+// afterwards leaves exactly its set rather than a union with the object's.
+static BOOL removeAllXattrs(int fd) {
+    ssize_t size = flistxattr(fd, NULL, 0, 0);
+    if (size <= 0) return size == 0;
+    char *names = malloc((size_t)size);
+    if (!names) return NO;
+    size = flistxattr(fd, names, (size_t)size, 0);
+    BOOL ok = size >= 0;
+    for (char *name = names; ok && name < names + size; name += strlen(name) + 1) {
+        if (fremovexattr(fd, name, 0) != 0) ok = NO;
+    }
+    free(names);
+    return ok;
+}
+
+// Gives the clone dst the metadata of the file it replaces (src): xattrs, data
+// protection class, owner, mode and BSD flags. A clone starts with those of the
+// object, i.e. of whichever file was first ingested with that content.
+static BOOL copyFileMetadata(int src, int dst, const struct stat *st) {
+    if (!removeAllXattrs(dst) || fcopyfile(src, dst, NULL, COPYFILE_XATTR) != 0) return NO;
+    int protection = fcntl(src, F_GETPROTECTIONCLASS);
+    if (protection != fcntl(dst, F_GETPROTECTIONCLASS) &&
+        (protection < 0 || fcntl(dst, F_SETPROTECTIONCLASS, protection) != 0)) {
+        return NO;
+    }
+    return fchown(dst, st->st_uid, st->st_gid) == 0 &&
+           fchmod(dst, st->st_mode & 07777) == 0 &&
+           fchflags(dst, st->st_flags) == 0;
+}
+
+// Replaces path by a clone of object that keeps all of path's own metadata (see
+// copyFileMetadata) and times. The swap-in is a rename, so a crash leaves either
+// the old or the new file. Files whose metadata cannot be carried over are left
+// alone.
+static BOOL replaceWithClone(NSString *object, NSString *path, const struct stat *st) {
+    // Immutable and append-only files cannot be replaced by a rename.
+    if (st->st_flags & (UF_IMMUTABLE | SF_IMMUTABLE | UF_APPEND | SF_APPEND)) {
+        errno = EPERM;
+        return NO;
+    }
+    NSString *tmp = [[path stringByDeletingLastPathComponent]
+                     stringByAppendingPathComponent:[@".px-dedup-" stringByAppendingString:path.lastPathComponent]];
+    const char *tmpPath = tmp.fileSystemRepresentation;
+    unlink(tmpPath);
+    if (clonefile(object.fileSystemRepresentation, tmpPath, CLONE_NOFOLLOW) != 0) return NO;
+
+    int src = open(path.fileSystemRepresentation, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    int dst = open(tmpPath, O_RDWR | O_NOFOLLOW | O_CLOEXEC);
+    BOOL copied = src >= 0 && dst >= 0 && copyFileMetadata(src, dst, st);
+    int err = errno;
+    if (src >= 0) close(src);
+    if (dst >= 0) close(dst);
+
+    struct timespec times[2] = { st->st_atimespec, st->st_mtimespec };
+    if (!copied ||
+        utimensat(AT_FDCWD, tmpPath, times, AT_SYMLINK_NOFOLLOW) != 0 ||
+        rename(tmpPath, path.fileSystemRepresentation) != 0) {
+        if (copied) err = errno;
+        // Flags copied from the original may include ones that block unlink.
+        lchflags(tmpPath, 0);
+        unlink(tmpPath);
+        errno = err;
+        return NO;
+    }
+    return YES;
+}
+
+@implementation ContentStore
+
++ (instancetype)sharedManager {
+    static ContentStore *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (NSString *)objectPathForHash:(NSString *)hash {
+    return [NSString stringWithFormat:@"%@/objects/%@/%@", kStoreRoot, [hash substringToIndex:2], hash];
+}
+
+- (NSString *)manifestPathForProfile:(NSString *)profileId {
+    return [NSString stringWithFormat:@"%@/manifests/%@.json", kStoreRoot, profileId];
+}
+
+- (NSDictionary *)loadManifest:(NSString *)profileId {
+    NSData *data = [NSData dataWithContentsOfFile:[self manifestPathForProfile:profileId]];
+    if (!data) return nil;
+    NSDictionary *manifest = [NSJSONSerialization JSONObjectWithData:data options:0 error:nil];
+    return [manifest isKindOfClass:[NSDictionary class]] ? manifest : nil;
+}
+
+- (NSDictionary<NSString *, NSDictionary *> *)manifestForProfile:(NSString *)profileId {
+    NSDictionary *files = [self loadManifest:profileId][@"files"];
+    return [files isKindOfClass:[NSDictionary class]] ? files : @{};
+}
+
+// snapshot: when the scan that produced `files` started, see ManifestDiff.
+- (void)saveManifest:(NSDictionary *)files snapshot:(uint64_t)snapshot forProfile:(NSString *)profileId {
+    NSString *path = [self manifestPathForProfile:profileId];
+    [[NSFileManager defaultManager] createDirectoryAtPath:[path stringByDeletingLastPathComponent]
+                              withIntermediateDirectories:YES attributes:nil error:nil];
+    NSData *data = [NSJSONSerialization dataWithJSONObject:@{ @"version": @2, @"snapshot": @(snapshot), @"files": files }
+                                                   options:0 error:nil];
+    if (![data writeToFile:path atomically:YES]) {
+        PXLog(@"[ContentStore] Failed to write manifest %@", path);
+    }
+}
+
+- (void)scheduleGarbageCollection {
+    [[JobManager sharedManager] runWhenIdle:^{
+        [self collectGarbage];
+    }];
+}
+
+- (void)forgetProfile:(NSString *)profileId {
+    if (!profileId) return;
+    unlink([self manifestPathForProfile:profileId].fileSystemRepresentation);
+}
+
+// Hashes a file once even when it is reachable through several hard links.
+- (NSString *)hashOfFile:(NSString *)path stat:(const struct stat *)st cache:(NSMutableDictionary<NSNumber *, NSString *> *)cache {
+    NSString *hash = st->st_nlink > 1 ? cache[@(st->st_ino)] : nil;
+    if (hash) return hash;
+    hash = sha256OfFile(path.fileSystemRepresentation);
+    if (hash && st->st_nlink > 1) cache[@(st->st_ino)] = hash;
+    return hash;
+}
+
+- (void)ingestProfile:(NSString *)profileId {
+    NSString *profilePath = [[ProfileManager sharedManager] pathForProfileId:profileId];
+    NSFileManager *fm = [NSFileManager defaultManager];
+    BOOL isDir = NO;
+    if (![fm fileExistsAtPath:profilePath isDirectory:&isDir] || !isDir) return;
+
+    BOOL (^shouldStop)(void) = ^BOOL {
+        return [[JobManager sharedManager] hasPendingJobs];
+    };
+    NSDictionary *previous = [self loadManifest:profileId];
+    NSDictionary *previousFiles = [previous[@"files"] isKindOfClass:[NSDictionary class]] ? previous[@"files"] : @{};
+    uint64_t snapshot = clock_gettime_nsec_np(CLOCK_REALTIME);
+
+    int oldPolicy = getiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD);
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+
+    // Only files the diff reports as changed are hashed; everything else keeps
+    // its previous entry (and already shares blocks with its object).
+    ManifestDiff *diff = [ManifestDiff diffTree:profilePath
+                                       manifest:previousFiles
+                                   snapshotTime:[previous[@"snapshot"] unsignedLongLongValue]
+                                     shouldStop:shouldStop];
+    NSMutableDictionary<NSString *, NSDictionary *> *files = [diff.unchanged mutableCopy];
+    NSMutableDictionary<NSNumber *, NSString *> *linkHashes = [NSMutableDictionary dictionary];
+    uint64_t savedBytes = 0;
+    NSUInteger hashed = 0;
+    BOOL interrupted = !diff.complete;
+
+    for (NSString *relative in diff.changed) {
+        if (shouldStop()) {
+            interrupted = YES;
+            break;
+        }
+        @autoreleasepool {
+            NSString *path = [profilePath stringByAppendingPathComponent:relative];
+            struct stat st;
+            if (lstat(path.fileSystemRepresentation, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+            if (st.st_size < kMinDedupSize) {
+                files[relative] = ManifestEntryFromStat(&st, nil);
+                continue;
+            }
+
+            NSString *hash = [self hashOfFile:path stat:&st cache:linkHashes];
+            if (!hash) continue;
+            hashed++;
+
+            NSString *object = [self objectPathForHash:hash];
+            struct stat objectStat;
+            if (lstat(object.fileSystemRepresentation, &objectStat) == 0 && objectStat.st_size == st.st_size) {
+                // Hard-linked files keep their link; replacing one name would split them.
+                if (st.st_nlink == 1 && replaceWithClone(object, path, &st)) {
+                    savedBytes += st.st_size;
+                    lstat(path.fileSystemRepresentation, &st);
+                } else if (st.st_nlink == 1) {
+                    PXLog(@"[ContentStore] Failed to share %@: %s", relative, strerror(errno));
+                }
+            } else {
+                [fm createDirectoryAtPath:[object stringByDeletingLastPathComponent]
+              withIntermediateDirectories:YES attributes:nil error:nil];
+                unlink(object.fileSystemRepresentation);
+                if (clonefile(path.fileSystemRepresentation, object.fileSystemRepresentation, CLONE_NOFOLLOW) != 0) {
+                    int err = errno;
+                    PXLog(@"[ContentStore] Cannot create object for %@: %s", relative, strerror(err));
+                    if (err == ENOTSUP || err == EXDEV) {
+                        interrupted = YES;
+                        break;
+                    }
+                    continue;
+                }
+            }
+            files[relative] = ManifestEntryFromStat(&st, hash);
+        }
+    }
+
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, oldPolicy);
+    // Also saved when interrupted: everything recorded so far is valid, and
+    // files not recorded are simply treated as new next time.
+    [self saveManifest:files snapshot:snapshot forProfile:profileId];
+    // A complete manifest lists every regular file, so it also gives the sizes.
+    if (!interrupted) [[DiskUsageIndex sharedManager] setUsageFromManifest:files forProfile:profileId];
+    PXLog(@"[ContentStore] Ingested %@: %lu unchanged, %lu renamed, %lu changed, %lu deleted, %lu hashed, %llu bytes shared%@",
+          profileId, (unsigned long)diff.unchanged.count, (unsigned long)diff.renamed.count,
+          (unsigned long)diff.changed.count, (unsigned long)diff.deleted.count, (unsigned long)hashed,
+          savedBytes, interrupted ? @" (interrupted)" : @"");
+}
+
+- (void)collectGarbage {
+    NSFileManager *fm = [NSFileManager defaultManager];
+    ProfileManager *profileManager = [ProfileManager sharedManager];
+    NSArray<Profile *> *profiles = [profileManager profilesSnapshot];
+    NSMutableSet<NSString *> *profileIds = [NSMutableSet set];
+    for (Profile *profile in profiles) {
+        if (profile.id) [profileIds addObject:profile.id];
+    }
+
+    // Mark: every hash referenced by a manifest of an existing profile.
+    NSMutableSet<NSString *> *live = [NSMutableSet set];
+    NSString *manifestDir = [kStoreRoot stringByAppendingPathComponent:@"manifests"];
+    for (NSString *name in [fm contentsOfDirectoryAtPath:manifestDir error:nil]) {
+        NSString *profileId = [name stringByDeletingPathExtension];
+        if (![profileIds containsObject:profileId]) {
+            [fm removeItemAtPath:[manifestDir stringByAppendingPathComponent:name] error:nil];
+            continue;
+        }
+        for (NSDictionary *entry in [[self manifestForProfile:profileId] allValues]) {
+            NSString *hash = entry[@"hash"];
+            if ([hash isKindOfClass:[NSString class]]) [live addObject:hash];
+        }
+    }
+
+    // Sweep. Objects are only clone sources, never the sole copy of profile
+    // data, so removing one can at worst cost a future dedup opportunity.
+    NSString *objectDir = [kStoreRoot stringByAppendingPathComponent:@"objects"];
+    NSUInteger removed = 0;
+    for (NSString *prefix in [fm contentsOfDirectoryAtPath:objectDir error:nil]) {
+        NSString *bucket = [objectDir stringByAppendingPathComponent:prefix];
+        for (NSString *hash in [fm contentsOfDirectoryAtPath:bucket error:nil]) {
+            if ([live containsObject:hash]) continue;
+            if (unlink([bucket stringByAppendingPathComponent:hash].fileSystemRepresentation) == 0) removed++;
+        }
+    }
+    PXLog(@"[ContentStore] GC kept %lu objects, removed %lu", (unsigned long)live.count, (unsigned long)removed);
+}
+
+@end
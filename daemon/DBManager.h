@@ -1,9 +1,7 @@
 #import <Foundation/Foundation.h>
 #import <sqlite3.h>
 
-@interface DBManager : NSObject {
-    sqlite3 *_db;
-}
+@interface DBManager : NSObject
 + (instancetype)sharedManager;
 
 - (NSDictionary *)queryOne:(NSString *)sql;
@@ -12,4 +10,12 @@
 /// SELECT 语句，返回数组（字典）
 - (NSArray<NSDictionary *> *)query:(NSString *)sql;
 
-@end
\ No newline at end of file
+/// 带参数的查询，args 依次绑定到 ?1、?2…（NSString / NSNumber / NSData / NSNull）
+- (NSDictionary *)queryOne:(NSString *)sql args:(NSArray *)args;
+- (NSArray<NSDictionary *> *)query:(NSString *)sql args:(NSArray *)args;
+
+/// 逐行回调，直接用 sqlite3_column_* 读取到调用方的结构体中，不生成字典；
+/// 回调返回 NO 时停止。返回处理的行数，出错时返回 -1
+- (NSInteger)query:(NSString *)sql args:(NSArray *)args each:(BOOL (^)(sqlite3_stmt *stmt))row;
+
+@end
@@ -1,4 +1,5 @@
 #import "DBManager.h"
+#include "DBManagerCore.h"
 #if __has_include(<roothide.h>)
 #import <roothide.h>
 #else
@@ -7,7 +8,13 @@
 #endif
 #endif
 
-@implementation DBManager
+// IOS.db 只读且很小，整库映射进内存即可
+static const sqlite3_int64 kMmapSize = 64 << 20;
+
+@implementation DBManager {
+    // 只读连接和按 SQL 文本缓存的预处理语句 (DBManagerCore.m)，由 @synchronized(self) 保护
+    DBCore *_core;
+}
 
 static NSString *PXNullableStringFromCString(const char *value) {
     if (!value) {
@@ -16,6 +23,74 @@ static NSString *PXNullableStringFromCString(const char *value) {
     return [NSString stringWithUTF8String:value];
 }
 
+static BOOL PXBindArgs(sqlite3 *db, sqlite3_stmt *stmt, NSArray *args) {
+    for (NSUInteger i = 0; i < args.count; i++) {
+        id arg = args[i];
+        int index = (int)i + 1;
+        int rc;
+        if ([arg isKindOfClass:[NSString class]]) {
+            rc = sqlite3_bind_text(stmt, index, [arg UTF8String], -1, SQLITE_TRANSIENT);
+        } else if ([arg isKindOfClass:[NSNumber class]]) {
+            const char *type = [arg objCType];
+            if (strcmp(type, @encode(double)) == 0 || strcmp(type, @encode(float)) == 0) {
+                rc = sqlite3_bind_double(stmt, index, [arg doubleValue]);
+            } else {
+                rc = sqlite3_bind_int64(stmt, index, [arg longLongValue]);
+            }
+        } else if ([arg isKindOfClass:[NSData class]]) {
+            rc = sqlite3_bind_blob(stmt, index, [arg bytes], (int)[arg length], SQLITE_TRANSIENT);
+        } else {
+            rc = sqlite3_bind_null(stmt, index);
+        }
+        if (rc != SQLITE_OK) {
+            NSLog(@"[DB] 参数 %d 绑定失败: %s", index, sqlite3_errmsg(db));
+            return NO;
+        }
+    }
+    return YES;
+}
+
+static bool PXRowBlock(sqlite3_stmt *stmt, void *context) {
+    BOOL (^row)(sqlite3_stmt *) = (__bridge BOOL (^)(sqlite3_stmt *))context;
+    return row(stmt);
+}
+
+static NSDictionary *PXRowDictionary(sqlite3_stmt *stmt) {
+    int columnCount = sqlite3_column_count(stmt);
+    NSMutableDictionary *row = [NSMutableDictionary dictionary];
+
+    for (int i = 0; i < columnCount; i++) {
+        const char *colNameC = sqlite3_column_name(stmt, i);
+        if (!colNameC) continue;
+
+        NSString *colName = PXNullableStringFromCString(colNameC);
+        if (!colName) {
+            continue;
+        }
+        id value = [NSNull null];
+
+        switch (sqlite3_column_type(stmt, i)) {
+            case SQLITE_INTEGER:
+                value = @(sqlite3_column_int64(stmt, i));
+                break;
+            case SQLITE_FLOAT:
+                value = @(sqlite3_column_double(stmt, i));
+                break;
+            case SQLITE_TEXT:
+                value = PXNullableStringFromCString((const char *)sqlite3_column_text(stmt, i)) ?: [NSNull null];
+                break;
+            case SQLITE_NULL:
+                value = [NSNull null];
+                break;
+            default:
+                value = [NSNull null];
+        }
+
+        row[colName] = value;
+    }
+    return row;
+}
+
 + (instancetype)sharedManager {
     static DBManager *sharedManager = nil;
     static dispatch_once_t onceToken;
@@ -28,9 +103,9 @@ static NSString *PXNullableStringFromCString(const char *value) {
     self = [super init];
     NSString * path = jbroot(@"/Library/IOS.db");
     if(self){
-        if (sqlite3_open(path.UTF8String, &_db) != SQLITE_OK) {
-            NSLog(@"[DB] 打开数据库失败: %s", sqlite3_errmsg(_db));
-            _db = NULL;
+        int rc = DBCoreOpen(path.fileSystemRepresentation, kMmapSize, &_core);
+        if (rc != SQLITE_OK) {
+            NSLog(@"[DB] 打开数据库失败: %s", sqlite3_errstr(rc));
         } else {
             NSLog(@"[DB] 数据库打开成功: %@", path);
         }
@@ -38,122 +113,58 @@ static NSString *PXNullableStringFromCString(const char *value) {
     }
     return self;
 }
-- (NSDictionary *)queryOne:(NSString *)sql {
-    if (!_db || sql.length == 0) return nil;
 
+- (NSInteger)query:(NSString *)sql args:(NSArray *)args each:(BOOL (^)(sqlite3_stmt *stmt))row {
+    if (!_core || sql.length == 0) return -1;
+    // 缓存的语句同一时间只能有一个使用者；回调内不要再次查询
+    @synchronized (self) {
+        sqlite3 *db = DBCoreHandle(_core);
+        sqlite3_stmt *stmt = DBCoreStatement(_core, sql.UTF8String);
+        if (!stmt) {
+            NSLog(@"[DB] SQL 预处理失败: %s", sqlite3_errmsg(db));
+            return -1;
+        }
+        if (!PXBindArgs(db, stmt, args)) return -1;
+        int64_t count = DBCoreRun(stmt, PXRowBlock, (__bridge void *)row);
+        if (count < 0) NSLog(@"[DB] 查询失败: %s", sqlite3_errmsg(db));
+        return (NSInteger)count;
+    }
+}
+
+- (NSDictionary *)queryOne:(NSString *)sql args:(NSArray *)args {
     // 如果外部没写 LIMIT，自动补上
     if (![sql.lowercaseString containsString:@"limit"]) {
         sql = [sql stringByAppendingString:@" LIMIT 1"];
     }
-
-    sqlite3_stmt *stmt = NULL;
-
-    if (sqlite3_prepare_v2(_db, sql.UTF8String, -1, &stmt, NULL) != SQLITE_OK) {
-        NSLog(@"[DB] SQL 预处理失败: %s", sqlite3_errmsg(_db));
-        return nil;
-    }
-
-    NSDictionary *rowDict = nil;
-
-    if (sqlite3_step(stmt) == SQLITE_ROW) {
-
-        int columnCount = sqlite3_column_count(stmt);
-        NSMutableDictionary *row = [NSMutableDictionary dictionary];
-
-        for (int i = 0; i < columnCount; i++) {
-            const char *colNameC = sqlite3_column_name(stmt, i);
-            if (!colNameC) continue;
-
-            NSString *colName = PXNullableStringFromCString(colNameC);
-            if (!colName) {
-                continue;
-            }
-            id value = [NSNull null];
-
-            switch (sqlite3_column_type(stmt, i)) {
-                case SQLITE_INTEGER:
-                    value = @(sqlite3_column_int64(stmt, i));
-                    break;
-                case SQLITE_FLOAT:
-                    value = @(sqlite3_column_double(stmt, i));
-                    break;
-                case SQLITE_TEXT:
-                    value = PXNullableStringFromCString((const char *)sqlite3_column_text(stmt, i)) ?: [NSNull null];
-                    break;
-                case SQLITE_NULL:
-                    value = [NSNull null];
-                    break;
-                default:
-                    value = [NSNull null];
-            }
-
-            row[colName] = value;
-        }
-
-        rowDict = row;
-    }
-
-    sqlite3_finalize(stmt);
+    __block NSDictionary *rowDict = nil;
+    [self query:sql args:args each:^BOOL(sqlite3_stmt *stmt) {
+        rowDict = PXRowDictionary(stmt);
+        return NO;
+    }];
     return rowDict;
 }
 
-- (NSArray<NSDictionary *> *)query:(NSString *)sql {
+- (NSArray<NSDictionary *> *)query:(NSString *)sql args:(NSArray *)args {
     NSMutableArray *result = [NSMutableArray array];
-    if (!_db || sql.length == 0) return result;
-
-    sqlite3_stmt *stmt = NULL;
-
-    if (sqlite3_prepare_v2(_db, sql.UTF8String, -1, &stmt, NULL) != SQLITE_OK) {
-        NSLog(@"[DB] SQL 预处理失败: %s", sqlite3_errmsg(_db));
-        return result;
-    }
-
-    int columnCount = sqlite3_column_count(stmt);
-
-    while (sqlite3_step(stmt) == SQLITE_ROW) {
-        NSMutableDictionary *row = [NSMutableDictionary dictionary];
-
-        for (int i = 0; i < columnCount; i++) {
-            const char *colNameC = sqlite3_column_name(stmt, i);
-            if (!colNameC) continue;
-
-            NSString *colName = PXNullableStringFromCString(colNameC);
-            if (!colName) {
-                continue;
-            }
-            id value = [NSNull null];
-
-            switch (sqlite3_column_type(stmt, i)) {
-                case SQLITE_INTEGER:
-                    value = @(sqlite3_column_int64(stmt, i));
-                    break;
-                case SQLITE_FLOAT:
-                    value = @(sqlite3_column_double(stmt, i));
-                    break;
-                case SQLITE_TEXT:
-                    value = PXNullableStringFromCString((const char *)sqlite3_column_text(stmt, i)) ?: [NSNull null];
-                    break;
-                case SQLITE_NULL:
-                    value = [NSNull null];
-                    break;
-                default:
-                    value = [NSNull null];
-            }
-
-            row[colName] = value;
-        }
+    [self query:sql args:args each:^BOOL(sqlite3_stmt *stmt) {
+        [result addObject:PXRowDictionary(stmt)];
+        return YES;
+    }];
+    return result;
+}
 
-        [result addObject:row];
-    }
+- (NSDictionary *)queryOne:(NSString *)sql {
+    return [self queryOne:sql args:nil];
+}
 
-    sqlite3_finalize(stmt);
-    return result;
+- (NSArray<NSDictionary *> *)query:(NSString *)sql {
+    return [self query:sql args:nil];
 }
 
 - (void)dealloc {
-    if (_db) {
-        sqlite3_close(_db);
-        _db = NULL;
+    if (_core) {
+        DBCoreClose(_core);
+        _core = NULL;
         NSLog(@"[DB] 数据库已关闭");
     }
 }
@@ -0,0 +1,34 @@
+#ifndef DB_MANAGER_CORE_H
+#define DB_MANAGER_CORE_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// DBManager's connection and statement cache, plain C so bench/ can time it
+// against IOS.db on any host. DBManager binds arguments and serializes use of
+// the cache under its lock; nothing here locks.
+
+typedef struct DBCore DBCore;
+
+// Opens path read-only and maps up to mmapSize bytes of it. Returns an SQLite
+// result code; on failure *out is NULL.
+int DBCoreOpen(const char *path, int64_t mmapSize, DBCore **out);
+void DBCoreClose(DBCore *core);
+sqlite3 *DBCoreHandle(const DBCore *core);
+
+// The statement prepared for exactly this SQL text, kept for the life of the
+// connection: reset, with bindings cleared. NULL (not cached) if it does not
+// prepare; sqlite3_errmsg has why.
+sqlite3_stmt *DBCoreStatement(DBCore *core, const char *sql);
+size_t DBCoreCachedCount(const DBCore *core);
+
+// Called per row; return false to stop early.
+typedef bool (*DBRowFunc)(sqlite3_stmt *stmt, void *context);
+
+// Steps a bound statement, handing each row to row, then resets it. Returns
+// the rows handed over, or -1 on an error.
+int64_t DBCoreRun(sqlite3_stmt *stmt, DBRowFunc row, void *context);
+
+#endif
@@ -0,0 +1,144 @@
+#include "DBManagerCore.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Open addressing over SQL texts; a few dozen distinct queries at most.
+typedef struct {
+    char *sql;
+    uint32_t hash;
+    sqlite3_stmt *stmt;
+} DBCacheSlot;
+
+struct DBCore {
+    sqlite3 *db;
+    DBCacheSlot *slots;
+    size_t capacity; // power of two
+    size_t count;
+};
+
+static uint32_t hashSQL(const char *sql) {
+    uint32_t hash = 0x811c9dc5;
+    for (const unsigned char *p = (const unsigned char *)sql; *p; p++) {
+        hash ^= *p;
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// ---- Connection ----
+
+int DBCoreOpen(const char *path, int64_t mmapSize, DBCore **out) {
+    *out = NULL;
+    DBCore *core = calloc(1, sizeof(DBCore));
+    if (!core) return SQLITE_NOMEM;
+    core->capacity = 16;
+    core->slots = calloc(core->capacity, sizeof(DBCacheSlot));
+    if (!core->slots) {
+        free(core);
+        return SQLITE_NOMEM;
+    }
+    int rc = sqlite3_open_v2(path, &core->db, SQLITE_OPEN_READONLY, NULL);
+    if (rc != SQLITE_OK) {
+        DBCoreClose(core);
+        return rc;
+    }
+    char pragma[64];
+    snprintf(pragma, sizeof(pragma), "PRAGMA mmap_size = %lld", (long long)mmapSize);
+    sqlite3_exec(core->db, pragma, NULL, NULL, NULL);
+    *out = core;
+    return SQLITE_OK;
+}
+
+void DBCoreClose(DBCore *core) {
+    if (!core) return;
+    for (size_t i = 0; i < core->capacity; i++) {
+        if (!core->slots[i].sql) continue;
+        sqlite3_finalize(core->slots[i].stmt);
+        free(core->slots[i].sql);
+    }
+    free(core->slots);
+    sqlite3_close(core->db);
+    free(core);
+}
+
+sqlite3 *DBCoreHandle(const DBCore *core) {
+    return core->db;
+}
+
+size_t DBCoreCachedCount(const DBCore *core) {
+    return core->count;
+}
+
+// ---- Statement cache ----
+
+static DBCacheSlot *findSlot(DBCacheSlot *slots, size_t capacity, const char *sql, uint32_t hash) {
+    size_t mask = capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        DBCacheSlot *slot = &slots[i];
+        if (!slot->sql || (slot->hash == hash && strcmp(slot->sql, sql) == 0)) return slot;
+    }
+}
+
+static bool grow(DBCore *core) {
+    size_t capacity = core->capacity * 2;
+    DBCacheSlot *slots = calloc(capacity, sizeof(DBCacheSlot));
+    if (!slots) return false;
+    for (size_t i = 0; i < core->capacity; i++) {
+        DBCacheSlot *old = &core->slots[i];
+        if (old->sql) *findSlot(slots, capacity, old->sql, old->hash) = *old;
+    }
+    free(core->slots);
+    core->slots = slots;
+    core->capacity = capacity;
+    return true;
+}
+
+sqlite3_stmt *DBCoreStatement(DBCore *core, const char *sql) {
+    uint32_t hash = hashSQL(sql);
+    DBCacheSlot *slot = findSlot(core->slots, core->capacity, sql, hash);
+    if (slot->sql) {
+        sqlite3_reset(slot->stmt);
+        sqlite3_clear_bindings(slot->stmt);
+        return slot->stmt;
+    }
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v3(core->db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, NULL) != SQLITE_OK || !stmt) {
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+    // Kept at most three quarters full, so probes stay short and end.
+    if ((core->count + 1) * 4 > core->capacity * 3) {
+        if (!grow(core)) {
+            sqlite3_finalize(stmt);
+            return NULL;
+        }
+        slot = findSlot(core->slots, core->capacity, sql, hash);
+    }
+    char *copy = strdup(sql);
+    if (!copy) {
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+    *slot = (DBCacheSlot){ copy, hash, stmt };
+    core->count++;
+    return stmt;
+}
+
+// ---- Running ----
+
+int64_t DBCoreRun(sqlite3_stmt *stmt, DBRowFunc row, void *context) {
+    int64_t count = 0;
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        count++;
+        if (!row(stmt, context)) {
+            rc = SQLITE_DONE;
+            break;
+        }
+    }
+    // sqlite3_errmsg still describes a failed step after the reset.
+    sqlite3_reset(stmt);
+    return rc == SQLITE_DONE ? count : -1;
+}
@@ -4,5 +4,6 @@
 @interface DataGenManager : NSObject
 + (instancetype)sharedManager;
 - (PhoneInfo *) generatePhoneInfo;
+-(UpTimeInfo *)generateUpTimeInfo;
 // - (IosVersion *) generateIOSVersion;
 @end
\ No newline at end of file
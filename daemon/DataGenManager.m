@@ -2,7 +2,7 @@
 #import <sys/sysctl.h> 
 #import <ifaddrs.h>
 #import <arpa/inet.h>
-#import "DBManager.h"
+#import "DeviceCatalog.h"
 #import "SettingManager.h"
 #import <UIKit/UIKit.h>
 
@@ -692,11 +692,7 @@ static NSString *ProjectXSysctlString(const char *name) {
     SettingManager * manager = [SettingManager sharedManager];
     [manager loadFromPrefs];
     NSString * carrierCountryCode = manager.carrierCountryCode;
-    NSString *sql = [NSString stringWithFormat:
-        @"SELECT * FROM operator where code = '%@' ORDER BY RANDOM() limit 1"
-    ,carrierCountryCode];
-    NSLog(@"[DEBUG] query sql: %@",sql);
-    NSDictionary * carrier = [[DBManager sharedManager] queryOne:sql];
+    NSDictionary * carrier = [[DeviceCatalog sharedManager] randomOperatorForCode:carrierCountryCode];
 
     NetworkInfo *networkInfo = [[NetworkInfo alloc] init];
     networkInfo.carrierName = carrier[@"name"];
@@ -901,27 +897,9 @@ NSString *NormalizeVersion(NSString *version)
     NSString * minVersion = manager.minVersion;
     NSString * maxVersion = manager.maxVersion;
     
-    NSMutableString *queryVersionSql =
-        [NSMutableString stringWithString:@"SELECT * FROM KMOS"];
-
-    NSMutableArray *conditions = [NSMutableArray array];
-    if (minVersion.length > 0) {
-        [conditions addObject:[NSString stringWithFormat:@"sortVersion >= '%@'",NormalizeVersion(minVersion)]];
-    }
-
-    if (maxVersion.length > 0) {
-        [conditions addObject:[NSString stringWithFormat:@"sortVersion <= '%@'",NormalizeVersion(maxVersion)]];
-    }
-
-    if (conditions.count > 0) {
-        [queryVersionSql appendFormat:@" WHERE %@", [conditions componentsJoinedByString:@" AND "]];
-    }
-
-    [queryVersionSql appendString:@" ORDER BY RANDOM() LIMIT 1"];
-
-    NSLog(@"[DEBUG] query verion %@",queryVersionSql);
-    // 先随机一个版本号 再根据版本号找可选的设备 TODO 根据sortVersion筛选
-    NSDictionary * versionInfo = [[DBManager sharedManager] queryOne:queryVersionSql];
+    // 先随机一个版本号 再根据版本号找可选的设备
+    NSDictionary * versionInfo = [[DeviceCatalog sharedManager] randomVersionFrom:minVersion.length > 0 ? NormalizeVersion(minVersion) : nil
+                                                                               to:maxVersion.length > 0 ? NormalizeVersion(maxVersion) : nil];
     if (!versionInfo) {
         IosVersion *fallbackVersion = [[IosVersion alloc] init];
         fallbackVersion.version = [[UIDevice currentDevice] systemVersion] ?: @"";
@@ -960,11 +938,7 @@ NSString *NormalizeVersion(NSString *version)
     iosVersion.build = versionInfo[@"OSBuild"];
 
 
-    NSString *sql = [NSString stringWithFormat:
-        @"SELECT * FROM KMDevices d left join CPU c on d.CPU = c.name WHERE defaultOSV <= '%@' AND '%@' <= maxOSV ORDER BY RANDOM() limit 1"
-    ,versionInfo[@"sortVersion"],versionInfo[@"sortVersion"]];
-
-    NSDictionary * device = [[DBManager sharedManager] queryOne:sql];
+    NSDictionary * device = [[DeviceCatalog sharedManager] randomDeviceForVersion:versionInfo];
 
     if (device) {
         iosVersion.kernelVersion = [NSString stringWithFormat:@"Darwin Kernel Version %@: %@/RELEASE_ARM64_%@",versionInfo[@"kernelversion"],versionInfo[@"kernelversiontime"],device[@"mode"]];
@@ -0,0 +1,23 @@
+#import <Foundation/Foundation.h>
+
+// KMOS, KMDevices ⋈ CPU and operator, loaded once from IOS.catalog (or IOS.db
+// when the compiled file is absent) and kept in memory. Rows are the same dictionaries the SQL queries returned; sampling is
+// a uniform index draw (DeviceCatalogCore) instead of ORDER BY RANDOM() over the whole table. The tables carry no
+// weights, so uniform is what the SQL drew too.
+@interface DeviceCatalog : NSObject
+
++ (instancetype)sharedManager;
+
+// KMOS.version values and distinct operator codes, in table order.
+@property (nonatomic, strong, readonly) NSArray<NSString *> *versionNames;
+@property (nonatomic, strong, readonly) NSArray<NSString *> *operatorCodes;
+
+// A KMOS row with minSortVersion <= sortVersion <= maxSortVersion (nil bounds
+// are open), or nil if none.
+- (NSDictionary *)randomVersionFrom:(NSString *)minSortVersion to:(NSString *)maxSortVersion;
+// A device row whose defaultOSV..maxOSV covers the given KMOS row, or nil.
+- (NSDictionary *)randomDeviceForVersion:(NSDictionary *)version;
+// An operator row with this code, or nil.
+- (NSDictionary *)randomOperatorForCode:(NSString *)code;
+
+@end
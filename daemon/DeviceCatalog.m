@@ -0,0 +1,141 @@
+#import "DeviceCatalog.h"
+#import "CatalogFile.h"
+#import "DBManager.h"
+#import "DeviceCatalogCore.h"
+#import "ProjectXLogging.h"
+#if __has_include(<roothide.h>)
+#import <roothide.h>
+#else
+#ifndef jbroot
+#define jbroot(path) (path)
+#endif
+#endif
+
+static uint32_t uniformDraw(uint32_t bound) {
+    return arc4random_uniform(bound);
+}
+
+// Row keys as C strings for DeviceCatalogCore; NULL where the value is not a
+// string. The buffer is autoreleased, the strings live as long as the rows.
+static const char **copyKeys(NSArray<NSDictionary *> *rows, NSString *field) {
+    NSMutableData *buffer = [NSMutableData dataWithLength:MAX(rows.count, 1) * sizeof(const char *)];
+    const char **keys = buffer.mutableBytes;
+    [rows enumerateObjectsUsingBlock:^(NSDictionary *row, NSUInteger i, BOOL *stop) {
+        NSString *value = row[field];
+        keys[i] = [value isKindOfClass:[NSString class]] ? value.UTF8String : NULL;
+    }];
+    return keys;
+}
+
+@interface DeviceCatalog () {
+    DeviceCatalogIndex *_index;
+}
+// Rows in the order DeviceCatalogCore numbers them.
+@property (nonatomic, strong) NSArray<NSDictionary *> *versions;
+@property (nonatomic, strong) NSArray<NSDictionary *> *devices;
+@property (nonatomic, strong) NSArray<NSDictionary *> *operators;
+@end
+
+@implementation DeviceCatalog
+
++ (instancetype)sharedManager {
+    static DeviceCatalog *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        [self load];
+    }
+    return self;
+}
+
+- (void)load {
+    // The compiled IOS.catalog when it is installed and valid, so the daemon
+    // starts without opening SQLite; otherwise the same rows from IOS.db.
+    CatalogFile *file = [CatalogFile catalogAtPath:jbroot(@"/Library/IOS.catalog")];
+    NSArray<NSDictionary *> *kmos = [file rowsOfTable:@"KMOS"];
+    NSArray<NSDictionary *> *sortedKmos = [file rowsOfTable:@"KMOS" orderedBy:@"sortVersion"];
+    // KMDevices d LEFT JOIN CPU c ON d.CPU = c.name, as in the SQL fallback below.
+    NSArray<NSDictionary *> *devices = CatalogLeftJoin([file rowsOfTable:@"KMDevices"], [file rowsOfTable:@"CPU"], @"CPU", @"name");
+    NSArray<NSDictionary *> *operators = [file rowsOfTable:@"operator"];
+    BOOL compiled = kmos && sortedKmos && devices && operators;
+    if (!compiled) {
+        DBManager *db = [DBManager sharedManager];
+        kmos = [db query:@"SELECT * FROM KMOS"];
+        sortedKmos = nil;
+        devices = [db query:@"SELECT * FROM KMDevices d left join CPU c on d.CPU = c.name"];
+        operators = [db query:@"SELECT * FROM operator"];
+    }
+
+    NSMutableArray<NSString *> *versionNames = [NSMutableArray arrayWithCapacity:kmos.count];
+    for (NSDictionary *row in kmos) {
+        if ([row[@"version"] isKindOfClass:[NSString class]]) [versionNames addObject:row[@"version"]];
+    }
+
+    NSMutableArray<NSString *> *operatorCodes = [NSMutableArray array];
+    NSMutableSet<NSString *> *seenCodes = [NSMutableSet set];
+    for (NSDictionary *row in operators) {
+        NSString *code = row[@"code"];
+        if (![code isKindOfClass:[NSString class]] || [seenCodes containsObject:code]) continue;
+        [seenCodes addObject:code];
+        [operatorCodes addObject:code];
+    }
+
+    NSArray<NSDictionary *> *versions = sortedKmos ?: kmos;
+    @autoreleasepool {
+        _index = DeviceCatalogIndexBuild(copyKeys(versions, @"sortVersion"), versions.count,
+                                         copyKeys(devices, @"defaultOSV"), copyKeys(devices, @"maxOSV"), devices.count,
+                                         copyKeys(operators, @"code"), operators.count);
+    }
+    if (!_index) PXLog(@"[DeviceCatalog] Out of memory indexing the catalog");
+
+    _versions = versions;
+    _devices = devices;
+    _operators = operators;
+    _versionNames = versionNames;
+    _operatorCodes = operatorCodes;
+    PXLog(@"[DeviceCatalog] Loaded %lu versions, %lu devices, %lu operator codes from %@",
+          (unsigned long)versions.count, (unsigned long)devices.count, (unsigned long)operatorCodes.count,
+          compiled ? @"IOS.catalog" : @"IOS.db");
+}
+
+- (void)dealloc {
+    DeviceCatalogIndexFree(_index);
+}
+
+- (NSDictionary *)randomVersionFrom:(NSString *)minSortVersion to:(NSString *)maxSortVersion {
+    size_t row;
+    if (!_index || !DeviceCatalogRandomVersion(_index, minSortVersion.length ? minSortVersion.UTF8String : NULL,
+                                               maxSortVersion.length ? maxSortVersion.UTF8String : NULL, uniformDraw,
+                                               &row)) {
+        return nil;
+    }
+    return _versions[row];
+}
+
+- (NSDictionary *)randomDeviceForVersion:(NSDictionary *)version {
+    NSString *key = version[@"sortVersion"];
+    size_t row;
+    if (!_index || ![key isKindOfClass:[NSString class]] ||
+        !DeviceCatalogRandomDevice(_index, key.UTF8String, uniformDraw, &row)) {
+        return nil;
+    }
+    return _devices[row];
+}
+
+- (NSDictionary *)randomOperatorForCode:(NSString *)code {
+    size_t row;
+    if (!_index || ![code isKindOfClass:[NSString class]] ||
+        !DeviceCatalogRandomOperator(_index, code.UTF8String, uniformDraw, &row)) {
+        return nil;
+    }
+    return _operators[row];
+}
+
+@end
@@ -0,0 +1,50 @@
+#ifndef DEVICE_CATALOG_CORE_H
+#define DEVICE_CATALOG_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// DeviceCatalog's indexes and draws, plain C so bench/ can check them and
+// time them against the ORDER BY RANDOM() queries on IOS.db on any host.
+// DeviceCatalog keeps the rows; this only sees their keys and hands back row
+// numbers (positions in the arrays given to DeviceCatalogIndexBuild).
+//
+// Draws are uniform: IOS.db has no weight or popularity column in KMOS,
+// KMDevices or operator, so every candidate row is as likely as in the SQL
+// it replaces, and a uniform index into a precomputed candidate list is
+// already the O(1) case of weighted sampling.
+//
+// sortVersion/defaultOSV/maxOSV are zero-padded ("014.000.001"), so byte
+// order (strcmp) is version order, as in the SQL comparisons.
+
+// Uniform in [0, bound), bound > 0: arc4random_uniform on the device.
+typedef uint32_t (*DeviceCatalogUniform)(uint32_t bound);
+
+typedef struct DeviceCatalogIndex DeviceCatalogIndex;
+
+// Copies what it needs. NULL keys leave a row out (a version without
+// sortVersion, a device without both bounds, an operator without a code).
+// NULL when out of memory.
+DeviceCatalogIndex *DeviceCatalogIndexBuild(const char *const *versionKeys, size_t versionCount,
+                                            const char *const *deviceFrom, const char *const *deviceTo,
+                                            size_t deviceCount, const char *const *operatorCodes,
+                                            size_t operatorCount);
+void DeviceCatalogIndexFree(DeviceCatalogIndex *index);
+
+// Versions with a key, and their rows ascending by key (ties in row order).
+size_t DeviceCatalogVersionCount(const DeviceCatalogIndex *index);
+size_t DeviceCatalogVersionRow(const DeviceCatalogIndex *index, size_t position);
+
+// A version row with minKey <= key <= maxKey (NULL bounds are open).
+bool DeviceCatalogRandomVersion(const DeviceCatalogIndex *index, const char *minKey, const char *maxKey,
+                                DeviceCatalogUniform uniform, size_t *row);
+// A device row with from <= versionKey <= to, drawn from the list built for
+// that version; versionKey must be a version's key.
+bool DeviceCatalogRandomDevice(const DeviceCatalogIndex *index, const char *versionKey,
+                               DeviceCatalogUniform uniform, size_t *row);
+// An operator row with this code.
+bool DeviceCatalogRandomOperator(const DeviceCatalogIndex *index, const char *code, DeviceCatalogUniform uniform,
+                                 size_t *row);
+
+#endif
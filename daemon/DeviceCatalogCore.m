@@ -0,0 +1,200 @@
+#include "DeviceCatalogCore.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Keys with the rows that share them, sorted by key: versions (one row per
+// key unless KMOS repeats a sortVersion) and operator codes.
+typedef struct {
+    char *key;
+    uint32_t first, count; // into the group's rows
+} KeyGroup;
+
+struct DeviceCatalogIndex {
+    // Versions ascending by key; versionGroups[i] covers
+    // versionRows[first..first+count).
+    uint32_t *versionRows;
+    size_t versionCount;
+    KeyGroup *versionGroups;
+    size_t versionGroupCount;
+    // Per version group, the compatible device rows.
+    uint32_t *deviceOffsets; // versionGroupCount + 1
+    uint32_t *deviceRows;
+    KeyGroup *operatorGroups;
+    size_t operatorGroupCount;
+    uint32_t *operatorRows;
+};
+
+// ---- Building ----
+
+typedef struct {
+    const char *key;
+    uint32_t row;
+} KeyedRow;
+
+static int compareKeyedRows(const void *a, const void *b) {
+    const KeyedRow *x = a, *y = b;
+    int order = strcmp(x->key, y->key);
+    if (order) return order;
+    return x->row < y->row ? -1 : x->row > y->row;
+}
+
+// Sorts the rows with keys and groups equal keys. Returns false when out of memory.
+static bool groupRows(const char *const *keys, size_t count, uint32_t **rowsOut, size_t *rowCount,
+                      KeyGroup **groupsOut, size_t *groupCount) {
+    KeyedRow *keyed = malloc((count ? count : 1) * sizeof(KeyedRow));
+    uint32_t *rows = malloc((count ? count : 1) * sizeof(uint32_t));
+    KeyGroup *groups = calloc(count ? count : 1, sizeof(KeyGroup));
+    if (!keyed || !rows || !groups) {
+        free(keyed);
+        free(rows);
+        free(groups);
+        return false;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (keys[i]) keyed[n++] = (KeyedRow){ keys[i], (uint32_t)i };
+    }
+    if (n > 1) qsort(keyed, n, sizeof(KeyedRow), compareKeyedRows);
+    size_t g = 0;
+    bool ok = true;
+    for (size_t i = 0; i < n; i++) {
+        rows[i] = keyed[i].row;
+        if (i == 0 || strcmp(keyed[i - 1].key, keyed[i].key) != 0) {
+            groups[g].key = strdup(keyed[i].key);
+            groups[g].first = (uint32_t)i;
+            if (!groups[g].key) ok = false;
+            g++;
+        }
+        groups[g - 1].count++;
+    }
+    free(keyed);
+    *rowsOut = rows;
+    *rowCount = n;
+    *groupsOut = groups;
+    *groupCount = g;
+    return ok;
+}
+
+DeviceCatalogIndex *DeviceCatalogIndexBuild(const char *const *versionKeys, size_t versionCount,
+                                            const char *const *deviceFrom, const char *const *deviceTo,
+                                            size_t deviceCount, const char *const *operatorCodes,
+                                            size_t operatorCount) {
+    DeviceCatalogIndex *index = calloc(1, sizeof(DeviceCatalogIndex));
+    if (!index) return NULL;
+    size_t operatorRowCount;
+    if (!groupRows(versionKeys, versionCount, &index->versionRows, &index->versionCount, &index->versionGroups,
+                   &index->versionGroupCount) ||
+        !groupRows(operatorCodes, operatorCount, &index->operatorRows, &operatorRowCount, &index->operatorGroups,
+                   &index->operatorGroupCount)) {
+        DeviceCatalogIndexFree(index);
+        return NULL;
+    }
+
+    // Compatible devices per version: counted, then filled.
+    size_t groups = index->versionGroupCount;
+    index->deviceOffsets = calloc(groups + 1, sizeof(uint32_t));
+    if (!index->deviceOffsets) {
+        DeviceCatalogIndexFree(index);
+        return NULL;
+    }
+    size_t total = 0;
+    for (size_t pass = 0; pass < 2; pass++) {
+        total = 0;
+        for (size_t g = 0; g < groups; g++) {
+            const char *key = index->versionGroups[g].key;
+            if (pass == 1) index->deviceOffsets[g] = (uint32_t)total;
+            for (size_t d = 0; d < deviceCount; d++) {
+                if (!deviceFrom[d] || !deviceTo[d]) continue;
+                if (strcmp(deviceFrom[d], key) > 0 || strcmp(key, deviceTo[d]) > 0) continue;
+                if (pass == 1) index->deviceRows[total] = (uint32_t)d;
+                total++;
+            }
+        }
+        if (pass == 0) {
+            index->deviceRows = malloc((total ? total : 1) * sizeof(uint32_t));
+            if (!index->deviceRows) {
+                DeviceCatalogIndexFree(index);
+                return NULL;
+            }
+        }
+    }
+    index->deviceOffsets[groups] = (uint32_t)total;
+    return index;
+}
+
+void DeviceCatalogIndexFree(DeviceCatalogIndex *index) {
+    if (!index) return;
+    for (size_t g = 0; g < index->versionGroupCount; g++) free(index->versionGroups[g].key);
+    for (size_t g = 0; g < index->operatorGroupCount; g++) free(index->operatorGroups[g].key);
+    free(index->versionRows);
+    free(index->versionGroups);
+    free(index->deviceOffsets);
+    free(index->deviceRows);
+    free(index->operatorGroups);
+    free(index->operatorRows);
+    free(index);
+}
+
+size_t DeviceCatalogVersionCount(const DeviceCatalogIndex *index) {
+    return index->versionCount;
+}
+
+size_t DeviceCatalogVersionRow(const DeviceCatalogIndex *index, size_t position) {
+    return index->versionRows[position];
+}
+
+// ---- Drawing ----
+
+// First group whose key is >= key (orEqual) or > key (!orEqual).
+static size_t lowerBound(const KeyGroup *groups, size_t count, const char *key, bool orEqual) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int order = strcmp(groups[mid].key, key);
+        if (order < 0 || (!orEqual && order == 0)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static const KeyGroup *findGroup(const KeyGroup *groups, size_t count, const char *key) {
+    if (!key) return NULL;
+    size_t at = lowerBound(groups, count, key, true);
+    return at < count && strcmp(groups[at].key, key) == 0 ? &groups[at] : NULL;
+}
+
+bool DeviceCatalogRandomVersion(const DeviceCatalogIndex *index, const char *minKey, const char *maxKey,
+                                DeviceCatalogUniform uniform, size_t *row) {
+    size_t groups = index->versionGroupCount;
+    size_t lo = minKey ? lowerBound(index->versionGroups, groups, minKey, true) : 0;
+    size_t hi = maxKey ? lowerBound(index->versionGroups, groups, maxKey, false) : groups;
+    if (hi <= lo) return false;
+    // Versions are contiguous across groups, so the rows in range are too.
+    uint32_t first = index->versionGroups[lo].first;
+    uint32_t end = index->versionGroups[hi - 1].first + index->versionGroups[hi - 1].count;
+    *row = index->versionRows[first + uniform(end - first)];
+    return true;
+}
+
+bool DeviceCatalogRandomDevice(const DeviceCatalogIndex *index, const char *versionKey,
+                               DeviceCatalogUniform uniform, size_t *row) {
+    const KeyGroup *group = findGroup(index->versionGroups, index->versionGroupCount, versionKey);
+    if (!group) return false;
+    size_t g = (size_t)(group - index->versionGroups);
+    uint32_t first = index->deviceOffsets[g], count = index->deviceOffsets[g + 1] - first;
+    if (count == 0) return false;
+    *row = index->deviceRows[first + uniform(count)];
+    return true;
+}
+
+bool DeviceCatalogRandomOperator(const DeviceCatalogIndex *index, const char *code, DeviceCatalogUniform uniform,
+                                 size_t *row) {
+    const KeyGroup *group = findGroup(index->operatorGroups, index->operatorGroupCount, code);
+    if (!group) return false;
+    *row = index->operatorRows[group->first + uniform(group->count)];
+    return true;
+}
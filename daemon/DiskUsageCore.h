@@ -0,0 +1,71 @@
+#ifndef DISK_USAGE_CORE_H
+#define DISK_USAGE_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bookkeeping behind DiskUsageIndex, plain C so bench/ can check it against du
+// on any host. Sizes are the apparent size of regular files, each hard-linked
+// inode counted once per tally, bucketed by the first path component under the
+// profile directory: the bundle id, or "." for files at the top.
+
+#define kDiskUsageTopLevelBucket "."
+
+// Bucket of a path relative to the profile directory; *length is set to the
+// bucket's length. Returns a pointer into relative, or kDiskUsageTopLevelBucket.
+const char *DiskUsageBucket(const char *relative, size_t *length);
+
+// Bucket -> bytes collected from one source (a tree scan, a manifest, an
+// archive directory) before it is stored.
+typedef struct DiskUsageTally DiskUsageTally;
+
+DiskUsageTally *DiskUsageTallyCreate(void);
+void DiskUsageTallyFree(DiskUsageTally *tally);
+// Adds bytes to bucket. Returns false on allocation failure.
+bool DiskUsageTallyAdd(DiskUsageTally *tally, const char *bucket, size_t bucketLength, uint64_t bytes);
+// Adds a file under its relative path's bucket; a non-zero inode already seen
+// by this tally is skipped (hard links).
+bool DiskUsageTallyAddFile(DiskUsageTally *tally, const char *relative, uint64_t inode, uint64_t bytes);
+
+// Regular files under root (a profile directory), without following symlinks
+// or crossing devices. With only set, just those top-level entries are walked.
+// shouldStop is polled every few hundred entries; returns false if it stopped
+// the scan or root could not be opened.
+bool DiskUsageScanTree(const char *root, const char *const *only, size_t onlyCount,
+                       DiskUsageTally *tally, bool (*shouldStop)(void *context), void *context);
+
+// profile id -> {buckets, bytes, archivedBytes}, with running totals.
+typedef struct DiskUsageLedger DiskUsageLedger;
+
+typedef struct {
+    const char *bucket;
+    uint64_t bytes;
+} DiskUsageEntry;
+
+DiskUsageLedger *DiskUsageLedgerCreate(void);
+void DiskUsageLedgerFree(DiskUsageLedger *ledger);
+
+// Replaces the profile's buckets with the tally's (empty buckets dropped) and
+// sets its archived size. Returns 1 if the record changed, 0 if it already
+// matched, -1 on allocation failure (the old record is kept).
+int DiskUsageLedgerStoreTally(DiskUsageLedger *ledger, const char *profileId,
+                              const DiskUsageTally *tally, uint64_t archivedBytes);
+// Replaces only the named buckets with the tally's values; a named bucket the
+// tally has no bytes for is removed. Creates the profile if needed. Same return.
+int DiskUsageLedgerStoreBuckets(DiskUsageLedger *ledger, const char *profileId, const DiskUsageTally *tally,
+                                const char *const *buckets, size_t bucketCount);
+// Creates the profile with no buckets if needed. Returns false on allocation failure.
+bool DiskUsageLedgerSetArchivedBytes(DiskUsageLedger *ledger, const char *profileId, uint64_t archivedBytes);
+void DiskUsageLedgerDrop(DiskUsageLedger *ledger, const char *profileId);
+
+uint64_t DiskUsageLedgerTotalBytes(const DiskUsageLedger *ledger);
+uint64_t DiskUsageLedgerTotalArchivedBytes(const DiskUsageLedger *ledger);
+// Profiles in id order; the pointers stay valid until the next change.
+size_t DiskUsageLedgerCount(const DiskUsageLedger *ledger);
+const char *DiskUsageLedgerProfileAt(const DiskUsageLedger *ledger, size_t index);
+// false if the profile has no record. entries may be NULL.
+bool DiskUsageLedgerGet(const DiskUsageLedger *ledger, const char *profileId, uint64_t *bytes,
+                        uint64_t *archivedBytes, const DiskUsageEntry **entries, size_t *entryCount);
+
+#endif
@@ -0,0 +1,371 @@
+#include "DiskUsageCore.h"
+#include <fts.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Entries between shouldStop polls.
+#define kYieldEvery 256
+
+const char *DiskUsageBucket(const char *relative, size_t *length) {
+    const char *slash = strchr(relative, '/');
+    if (!slash) {
+        *length = strlen(kDiskUsageTopLevelBucket);
+        return kDiskUsageTopLevelBucket;
+    }
+    *length = (size_t)(slash - relative);
+    return relative;
+}
+
+static char *copyString(const char *string, size_t length) {
+    char *copy = malloc(length + 1);
+    if (!copy) return NULL;
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static int compareEntries(const void *a, const void *b) {
+    return strcmp(((const DiskUsageEntry *)a)->bucket, ((const DiskUsageEntry *)b)->bucket);
+}
+
+static void freeEntries(DiskUsageEntry *entries, size_t count) {
+    for (size_t i = 0; i < count; i++) free((char *)entries[i].bucket);
+    free(entries);
+}
+
+// ---- Tally ----
+
+struct DiskUsageTally {
+    DiskUsageEntry *entries;
+    size_t count, capacity;
+    // Open-addressed set of inodes already counted; 0 marks an empty slot.
+    uint64_t *inodes;
+    size_t inodeCount, inodeCapacity;
+};
+
+DiskUsageTally *DiskUsageTallyCreate(void) {
+    return calloc(1, sizeof(DiskUsageTally));
+}
+
+void DiskUsageTallyFree(DiskUsageTally *tally) {
+    if (!tally) return;
+    freeEntries(tally->entries, tally->count);
+    free(tally->inodes);
+    free(tally);
+}
+
+bool DiskUsageTallyAdd(DiskUsageTally *tally, const char *bucket, size_t bucketLength, uint64_t bytes) {
+    for (size_t i = 0; i < tally->count; i++) {
+        const char *name = tally->entries[i].bucket;
+        if (strncmp(name, bucket, bucketLength) == 0 && name[bucketLength] == '\0') {
+            tally->entries[i].bytes += bytes;
+            return true;
+        }
+    }
+    if (tally->count == tally->capacity) {
+        size_t capacity = tally->capacity ? tally->capacity * 2 : 16;
+        DiskUsageEntry *entries = realloc(tally->entries, capacity * sizeof(DiskUsageEntry));
+        if (!entries) return false;
+        tally->entries = entries;
+        tally->capacity = capacity;
+    }
+    char *name = copyString(bucket, bucketLength);
+    if (!name) return false;
+    tally->entries[tally->count++] = (DiskUsageEntry){ name, bytes };
+    return true;
+}
+
+static bool insertInode(uint64_t *slots, size_t capacity, uint64_t inode) {
+    size_t i = (size_t)(inode * 0x9E3779B97F4A7C15ULL) & (capacity - 1);
+    while (slots[i]) {
+        if (slots[i] == inode) return false;
+        i = (i + 1) & (capacity - 1);
+    }
+    slots[i] = inode;
+    return true;
+}
+
+// true if inode had not been seen; false if seen or out of memory.
+static bool addInode(DiskUsageTally *tally, uint64_t inode, bool *failed) {
+    if ((tally->inodeCount + 1) * 2 > tally->inodeCapacity) {
+        size_t capacity = tally->inodeCapacity ? tally->inodeCapacity * 2 : 64;
+        uint64_t *slots = calloc(capacity, sizeof(uint64_t));
+        if (!slots) {
+            *failed = true;
+            return false;
+        }
+        for (size_t i = 0; i < tally->inodeCapacity; i++) {
+            if (tally->inodes[i]) insertInode(slots, capacity, tally->inodes[i]);
+        }
+        free(tally->inodes);
+        tally->inodes = slots;
+        tally->inodeCapacity = capacity;
+    }
+    if (!insertInode(tally->inodes, tally->inodeCapacity, inode)) return false;
+    tally->inodeCount++;
+    return true;
+}
+
+bool DiskUsageTallyAddFile(DiskUsageTally *tally, const char *relative, uint64_t inode, uint64_t bytes) {
+    bool failed = false;
+    if (inode && !addInode(tally, inode, &failed)) return !failed;
+    size_t length = 0;
+    const char *bucket = DiskUsageBucket(relative, &length);
+    return DiskUsageTallyAdd(tally, bucket, length, bytes);
+}
+
+bool DiskUsageScanTree(const char *root, const char *const *only, size_t onlyCount,
+                       DiskUsageTally *tally, bool (*shouldStop)(void *context), void *context) {
+    size_t rootLength = strlen(root);
+    size_t pathCount = only ? onlyCount : 1;
+    if (pathCount == 0) return true;
+    char **paths = calloc(pathCount + 1, sizeof(char *));
+    if (!paths) return false;
+    bool complete = true;
+    for (size_t i = 0; i < pathCount && complete; i++) {
+        if (!only) {
+            paths[i] = copyString(root, rootLength);
+        } else {
+            size_t length = strlen(only[i]);
+            paths[i] = malloc(rootLength + 1 + length + 1);
+            if (paths[i]) {
+                memcpy(paths[i], root, rootLength);
+                paths[i][rootLength] = '/';
+                memcpy(paths[i] + rootLength + 1, only[i], length + 1);
+            }
+        }
+        if (!paths[i]) complete = false;
+    }
+
+    FTS *fts = complete ? fts_open(paths, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL) : NULL;
+    if (!fts) complete = false;
+    FTSENT *entry;
+    size_t seen = 0;
+    while (complete && (entry = fts_read(fts))) {
+        if (++seen % kYieldEvery == 0 && shouldStop && shouldStop(context)) {
+            complete = false;
+            break;
+        }
+        if (entry->fts_info != FTS_F) continue;
+        // Relative to root; a whole-profile scan's root itself is never a file.
+        if (entry->fts_pathlen <= rootLength + 1) continue;
+        const char *relative = entry->fts_path + rootLength + 1;
+        if (only && entry->fts_level == 0) continue;
+        const struct stat *st = entry->fts_statp;
+        uint64_t inode = st->st_nlink > 1 ? (uint64_t)st->st_ino : 0;
+        if (!DiskUsageTallyAddFile(tally, relative, inode, (uint64_t)st->st_size)) complete = false;
+    }
+    if (fts) fts_close(fts);
+    for (size_t i = 0; i < pathCount; i++) free(paths[i]);
+    free(paths);
+    return complete;
+}
+
+// ---- Ledger ----
+
+typedef struct {
+    char *profileId;
+    DiskUsageEntry *entries;
+    size_t count;
+    uint64_t bytes;
+    uint64_t archivedBytes;
+} DiskUsageRecord;
+
+struct DiskUsageLedger {
+    DiskUsageRecord *records; // sorted by profileId
+    size_t count, capacity;
+    uint64_t totalBytes;
+    uint64_t totalArchivedBytes;
+};
+
+DiskUsageLedger *DiskUsageLedgerCreate(void) {
+    return calloc(1, sizeof(DiskUsageLedger));
+}
+
+void DiskUsageLedgerFree(DiskUsageLedger *ledger) {
+    if (!ledger) return;
+    for (size_t i = 0; i < ledger->count; i++) {
+        free(ledger->records[i].profileId);
+        freeEntries(ledger->records[i].entries, ledger->records[i].count);
+    }
+    free(ledger->records);
+    free(ledger);
+}
+
+// Index of profileId, or where it would be inserted (*found false).
+static size_t findRecord(const DiskUsageLedger *ledger, const char *profileId, bool *found) {
+    size_t low = 0, high = ledger->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        int order = strcmp(ledger->records[mid].profileId, profileId);
+        if (order == 0) {
+            *found = true;
+            return mid;
+        }
+        if (order < 0) low = mid + 1;
+        else high = mid;
+    }
+    *found = false;
+    return low;
+}
+
+static DiskUsageRecord *recordFor(DiskUsageLedger *ledger, const char *profileId, bool create, bool *created) {
+    bool found = false;
+    size_t index = findRecord(ledger, profileId, &found);
+    if (created) *created = !found;
+    if (found) return &ledger->records[index];
+    if (!create) return NULL;
+    if (ledger->count == ledger->capacity) {
+        size_t capacity = ledger->capacity ? ledger->capacity * 2 : 32;
+        DiskUsageRecord *records = realloc(ledger->records, capacity * sizeof(DiskUsageRecord));
+        if (!records) return NULL;
+        ledger->records = records;
+        ledger->capacity = capacity;
+    }
+    char *copy = copyString(profileId, strlen(profileId));
+    if (!copy) return NULL;
+    memmove(&ledger->records[index + 1], &ledger->records[index], (ledger->count - index) * sizeof(DiskUsageRecord));
+    ledger->records[index] = (DiskUsageRecord){ .profileId = copy };
+    ledger->count++;
+    return &ledger->records[index];
+}
+
+static bool sameEntries(const DiskUsageEntry *a, size_t aCount, const DiskUsageEntry *b, size_t bCount) {
+    if (aCount != bCount) return false;
+    for (size_t i = 0; i < aCount; i++) {
+        if (a[i].bytes != b[i].bytes || strcmp(a[i].bucket, b[i].bucket) != 0) return false;
+    }
+    return true;
+}
+
+// Takes ownership of entries (sorted, no empty buckets).
+static int replaceRecord(DiskUsageLedger *ledger, const char *profileId, DiskUsageEntry *entries, size_t count,
+                         uint64_t archivedBytes) {
+    bool created = false;
+    DiskUsageRecord *record = recordFor(ledger, profileId, true, &created);
+    if (!record) {
+        freeEntries(entries, count);
+        return -1;
+    }
+    if (!created && record->archivedBytes == archivedBytes &&
+        sameEntries(record->entries, record->count, entries, count)) {
+        freeEntries(entries, count);
+        return 0;
+    }
+    uint64_t bytes = 0;
+    for (size_t i = 0; i < count; i++) bytes += entries[i].bytes;
+    ledger->totalBytes = ledger->totalBytes - record->bytes + bytes;
+    ledger->totalArchivedBytes = ledger->totalArchivedBytes - record->archivedBytes + archivedBytes;
+    freeEntries(record->entries, record->count);
+    record->entries = entries;
+    record->count = count;
+    record->bytes = bytes;
+    record->archivedBytes = archivedBytes;
+    return 1;
+}
+
+// Appends a copy of entry unless it is empty. false on allocation failure.
+static bool appendEntry(DiskUsageEntry *entries, size_t *count, const char *bucket, uint64_t bytes) {
+    if (bytes == 0) return true;
+    char *name = copyString(bucket, strlen(bucket));
+    if (!name) return false;
+    entries[(*count)++] = (DiskUsageEntry){ name, bytes };
+    return true;
+}
+
+int DiskUsageLedgerStoreTally(DiskUsageLedger *ledger, const char *profileId,
+                              const DiskUsageTally *tally, uint64_t archivedBytes) {
+    DiskUsageEntry *entries = malloc((tally->count + 1) * sizeof(DiskUsageEntry));
+    if (!entries) return -1;
+    size_t count = 0;
+    for (size_t i = 0; i < tally->count; i++) {
+        if (!appendEntry(entries, &count, tally->entries[i].bucket, tally->entries[i].bytes)) {
+            freeEntries(entries, count);
+            return -1;
+        }
+    }
+    qsort(entries, count, sizeof(DiskUsageEntry), compareEntries);
+    return replaceRecord(ledger, profileId, entries, count, archivedBytes);
+}
+
+static bool isNamed(const char *bucket, const char *const *buckets, size_t bucketCount) {
+    for (size_t i = 0; i < bucketCount; i++) {
+        if (strcmp(bucket, buckets[i]) == 0) return true;
+    }
+    return false;
+}
+
+int DiskUsageLedgerStoreBuckets(DiskUsageLedger *ledger, const char *profileId, const DiskUsageTally *tally,
+                                const char *const *buckets, size_t bucketCount) {
+    DiskUsageRecord *record = recordFor(ledger, profileId, false, NULL);
+    size_t oldCount = record ? record->count : 0;
+    DiskUsageEntry *entries = malloc((oldCount + tally->count + 1) * sizeof(DiskUsageEntry));
+    if (!entries) return -1;
+    size_t count = 0;
+    bool ok = true;
+    for (size_t i = 0; i < oldCount && ok; i++) {
+        if (isNamed(record->entries[i].bucket, buckets, bucketCount)) continue;
+        ok = appendEntry(entries, &count, record->entries[i].bucket, record->entries[i].bytes);
+    }
+    for (size_t i = 0; i < tally->count && ok; i++) {
+        if (!isNamed(tally->entries[i].bucket, buckets, bucketCount)) continue;
+        ok = appendEntry(entries, &count, tally->entries[i].bucket, tally->entries[i].bytes);
+    }
+    if (!ok) {
+        freeEntries(entries, count);
+        return -1;
+    }
+    qsort(entries, count, sizeof(DiskUsageEntry), compareEntries);
+    return replaceRecord(ledger, profileId, entries, count, record ? record->archivedBytes : 0);
+}
+
+bool DiskUsageLedgerSetArchivedBytes(DiskUsageLedger *ledger, const char *profileId, uint64_t archivedBytes) {
+    DiskUsageRecord *record = recordFor(ledger, profileId, true, NULL);
+    if (!record) return false;
+    ledger->totalArchivedBytes = ledger->totalArchivedBytes - record->archivedBytes + archivedBytes;
+    record->archivedBytes = archivedBytes;
+    return true;
+}
+
+void DiskUsageLedgerDrop(DiskUsageLedger *ledger, const char *profileId) {
+    bool found = false;
+    size_t index = findRecord(ledger, profileId, &found);
+    if (!found) return;
+    DiskUsageRecord *record = &ledger->records[index];
+    ledger->totalBytes -= record->bytes;
+    ledger->totalArchivedBytes -= record->archivedBytes;
+    free(record->profileId);
+    freeEntries(record->entries, record->count);
+    memmove(record, record + 1, (ledger->count - index - 1) * sizeof(DiskUsageRecord));
+    ledger->count--;
+}
+
+uint64_t DiskUsageLedgerTotalBytes(const DiskUsageLedger *ledger) {
+    return ledger->totalBytes;
+}
+
+uint64_t DiskUsageLedgerTotalArchivedBytes(const DiskUsageLedger *ledger) {
+    return ledger->totalArchivedBytes;
+}
+
+size_t DiskUsageLedgerCount(const DiskUsageLedger *ledger) {
+    return ledger->count;
+}
+
+const char *DiskUsageLedgerProfileAt(const DiskUsageLedger *ledger, size_t index) {
+    return index < ledger->count ? ledger->records[index].profileId : NULL;
+}
+
+bool DiskUsageLedgerGet(const DiskUsageLedger *ledger, const char *profileId, uint64_t *bytes,
+                        uint64_t *archivedBytes, const DiskUsageEntry **entries, size_t *entryCount) {
+    bool found = false;
+    size_t index = findRecord(ledger, profileId, &found);
+    if (!found) return false;
+    const DiskUsageRecord *record = &ledger->records[index];
+    if (bytes) *bytes = record->bytes;
+    if (archivedBytes) *archivedBytes = record->archivedBytes;
+    if (entries) *entries = record->entries;
+    if (entryCount) *entryCount = record->count;
+    return true;
+}
@@ -0,0 +1,37 @@
+#import <Foundation/Foundation.h>
+
+// Persistent per-profile, per-app size index, so sizes are served without
+// walking any tree. Sizes are the apparent size of regular files (st_size,
+// hard-linked files counted once per profile), bucketed by the first path
+// component under the profile directory: the bundle id, or "." for files at the
+// top (phoneInfo.json, keychain.db).
+//
+// The paths that already see a profile's files keep it current: ContentStore
+// after a complete ingest, the archiver when it packs or unpacks, newPhone and
+// switchBackup for the bundles they save, removeBackup. An occasional scan at
+// idle time (at most daily) corrects any drift. The bookkeeping itself is the
+// plain C in DiskUsageCore.
+@interface DiskUsageIndex : NSObject
+
++ (instancetype)sharedManager;
+
+// From ContentStore manifest entries (relative path -> @{size, ino, ...}).
+- (void)setUsageFromManifest:(NSDictionary<NSString *, NSDictionary *> *)files forProfile:(NSString *)profileId;
+// Size of the profile's .pxar; 0 when it is not archived.
+- (void)setArchivedBytes:(uint64_t)bytes forProfile:(NSString *)profileId;
+// Measures the profile directory: only those bundles' buckets when bundleIds is
+// set, otherwise the whole profile. Skipped if a job gets queued meanwhile.
+- (void)scanBundles:(NSSet<NSString *> *)bundleIds ofProfile:(NSString *)profileId;
+- (void)removeProfile:(NSString *)profileId;
+
+// @{bytes, archivedBytes, apps: {bundle: bytes}} for one profile, or nil.
+// bytes is the content size, also while the profile is packed; archivedBytes is
+// the size of its .pxar.
+- (NSDictionary *)usageForProfile:(NSString *)profileId;
+// @{bytes, archivedBytes, profiles: {id: <as above>}}.
+- (NSDictionary *)usage;
+
+// Queue a reconciling scan as idle work unless one ran in the last day.
+- (void)scheduleReconcile;
+
+@end
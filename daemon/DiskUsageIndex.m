@@ -0,0 +1,306 @@
+#import "DiskUsageIndex.h"
+#import "ProfileManager.h"
+#import "ProfileArchiver.h"
+#import "ProfileArchive.h"
+#import "ManifestDiff.h"
+#import "JobManager.h"
+#import "ProjectXLogging.h"
+#include "DiskUsageCore.h"
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define kIndexPath @"/private/var/mobile/Media/ProjectX/.usage.plist"
+
+#define kUsageBytes         @"bytes"
+#define kUsageArchivedBytes @"archivedBytes"
+#define kUsageApps          @"apps"
+#define kUsageProfiles      @"profiles"
+#define kUsageReconciled    @"reconciled"
+
+static const NSTimeInterval kReconcileInterval = 24 * 3600;
+
+static bool shouldStopForJobs(void *context) {
+    return [[JobManager sharedManager] hasPendingJobs];
+}
+
+static void addBytes(DiskUsageTally *tally, NSString *bucket, uint64_t bytes) {
+    const char *name = bucket.UTF8String;
+    if (name) DiskUsageTallyAdd(tally, name, strlen(name), bytes);
+}
+
+static void addFile(DiskUsageTally *tally, NSString *relative, uint64_t inode, uint64_t bytes) {
+    const char *path = relative.fileSystemRepresentation;
+    if (path) DiskUsageTallyAddFile(tally, path, inode, bytes);
+}
+
+@interface DiskUsageIndex ()
+@property (nonatomic, strong) NSDate *reconciled;
+// Built on first request after a change; served as is until the next one.
+@property (nonatomic, strong) NSDictionary *snapshot;
+// Profiles already scanned by the pass in progress, so a paused pass resumes.
+@property (nonatomic, strong) NSMutableSet<NSString *> *reconciledIds;
+@property (nonatomic, assign) BOOL reconcileQueued;
+@end
+
+@implementation DiskUsageIndex {
+    // profileId -> buckets, persisted in ProjectX/.usage.plist.
+    DiskUsageLedger *_ledger;
+}
+
++ (instancetype)sharedManager {
+    static DiskUsageIndex *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _ledger = DiskUsageLedgerCreate();
+        _reconciledIds = [NSMutableSet set];
+        NSDictionary *stored = [NSDictionary dictionaryWithContentsOfFile:kIndexPath];
+        if ([stored isKindOfClass:[NSDictionary class]]) {
+            NSDictionary *profiles = stored[kUsageProfiles];
+            if ([profiles isKindOfClass:[NSDictionary class]]) {
+                [profiles enumerateKeysAndObjectsUsingBlock:^(NSString *profileId, NSDictionary *record, BOOL *stop) {
+                    if (![record isKindOfClass:[NSDictionary class]]) return;
+                    NSDictionary *apps = [record[kUsageApps] isKindOfClass:[NSDictionary class]] ? record[kUsageApps] : @{};
+                    DiskUsageTally *tally = DiskUsageTallyCreate();
+                    [apps enumerateKeysAndObjectsUsingBlock:^(NSString *bucket, NSNumber *bytes, BOOL *stop) {
+                        if ([bytes isKindOfClass:[NSNumber class]]) addBytes(tally, bucket, bytes.unsignedLongLongValue);
+                    }];
+                    DiskUsageLedgerStoreTally(_ledger, profileId.UTF8String, tally, [record[kUsageArchivedBytes] unsignedLongLongValue]);
+                    DiskUsageTallyFree(tally);
+                }];
+            }
+            if ([stored[kUsageReconciled] isKindOfClass:[NSDate class]]) _reconciled = stored[kUsageReconciled];
+        }
+    }
+    return self;
+}
+
+// Callers hold @synchronized(self).
+- (NSDictionary *)recordForProfile:(NSString *)profileId {
+    uint64_t bytes = 0, archivedBytes = 0;
+    const DiskUsageEntry *entries = NULL;
+    size_t count = 0;
+    if (!DiskUsageLedgerGet(_ledger, profileId.UTF8String, &bytes, &archivedBytes, &entries, &count)) return nil;
+    NSMutableDictionary<NSString *, NSNumber *> *apps = [NSMutableDictionary dictionaryWithCapacity:count];
+    for (size_t i = 0; i < count; i++) {
+        NSString *bucket = @(entries[i].bucket);
+        if (bucket) apps[bucket] = @(entries[i].bytes);
+    }
+    return @{ kUsageBytes: @(bytes), kUsageArchivedBytes: @(archivedBytes), kUsageApps: apps };
+}
+
+// Callers hold @synchronized(self).
+- (NSDictionary<NSString *, NSDictionary *> *)allRecords {
+    size_t count = DiskUsageLedgerCount(_ledger);
+    NSMutableDictionary<NSString *, NSDictionary *> *profiles = [NSMutableDictionary dictionaryWithCapacity:count];
+    for (size_t i = 0; i < count; i++) {
+        NSString *profileId = @(DiskUsageLedgerProfileAt(_ledger, i));
+        profiles[profileId] = [self recordForProfile:profileId];
+    }
+    return profiles;
+}
+
+// Callers hold @synchronized(self).
+- (void)save {
+    NSDictionary *profiles = [self allRecords];
+    NSDictionary *stored = _reconciled ? @{ kUsageProfiles: profiles, kUsageReconciled: _reconciled } : @{ kUsageProfiles: profiles };
+    if (![stored writeToFile:kIndexPath atomically:YES]) PXLog(@"[DiskUsageIndex] Cannot save %@", kIndexPath);
+}
+
+// Updates for a profile removed meanwhile are dropped. Checked under the same
+// lock as removeProfile:, which runs after the profile leaves ProfileManager.
+- (BOOL)isKnownProfile:(NSString *)profileId {
+    return profileId && [[ProfileManager sharedManager] getProfileById:profileId] != nil;
+}
+
+- (void)setUsageFromManifest:(NSDictionary<NSString *, NSDictionary *> *)files forProfile:(NSString *)profileId {
+    DiskUsageTally *tally = DiskUsageTallyCreate();
+    // Hard links appear once per name with the same inode; the tally counts them once.
+    [files enumerateKeysAndObjectsUsingBlock:^(NSString *relative, NSDictionary *entry, BOOL *stop) {
+        addFile(tally, relative, [entry[kManifestIno] unsignedLongLongValue], [entry[kManifestSize] unsignedLongLongValue]);
+    }];
+    @synchronized (self) {
+        if ([self isKnownProfile:profileId]) {
+            uint64_t archivedBytes = 0;
+            DiskUsageLedgerGet(_ledger, profileId.UTF8String, NULL, &archivedBytes, NULL, NULL);
+            if (DiskUsageLedgerStoreTally(_ledger, profileId.UTF8String, tally, archivedBytes) > 0) {
+                _snapshot = nil;
+                [self save];
+            }
+        }
+    }
+    DiskUsageTallyFree(tally);
+}
+
+- (void)setArchivedBytes:(uint64_t)bytes forProfile:(NSString *)profileId {
+    @synchronized (self) {
+        if (![self isKnownProfile:profileId]) return;
+        DiskUsageLedgerSetArchivedBytes(_ledger, profileId.UTF8String, bytes);
+        _snapshot = nil;
+        [self save];
+    }
+}
+
+- (void)scanBundles:(NSSet<NSString *> *)bundleIds ofProfile:(NSString *)profileId {
+    if (!profileId) return;
+    NSString *profilePath = [[ProfileManager sharedManager] pathForProfileId:profileId];
+    NSArray<NSString *> *names = bundleIds.allObjects;
+    const char **only = NULL;
+    if (bundleIds) {
+        only = calloc(names.count + 1, sizeof(char *));
+        for (NSUInteger i = 0; i < names.count; i++) only[i] = names[i].fileSystemRepresentation;
+    }
+    DiskUsageTally *tally = DiskUsageTallyCreate();
+    if (DiskUsageScanTree(profilePath.fileSystemRepresentation, only, names.count, tally, shouldStopForJobs, NULL)) {
+        @synchronized (self) {
+            if ([self isKnownProfile:profileId]) {
+                int changed = only ? DiskUsageLedgerStoreBuckets(_ledger, profileId.UTF8String, tally, only, names.count)
+                                   : DiskUsageLedgerStoreTally(_ledger, profileId.UTF8String, tally, 0);
+                if (changed > 0) {
+                    _snapshot = nil;
+                    [self save];
+                }
+            }
+        }
+    } else {
+        // Left to the next reconcile.
+        PXLog(@"[DiskUsageIndex] Scan of %@ interrupted", profileId);
+    }
+    DiskUsageTallyFree(tally);
+    free(only);
+}
+
+- (void)removeProfile:(NSString *)profileId {
+    if (!profileId) return;
+    @synchronized (self) {
+        if (!DiskUsageLedgerGet(_ledger, profileId.UTF8String, NULL, NULL, NULL, NULL)) return;
+        DiskUsageLedgerDrop(_ledger, profileId.UTF8String);
+        _snapshot = nil;
+        [self save];
+    }
+}
+
+- (NSDictionary *)usageForProfile:(NSString *)profileId {
+    if (!profileId) return nil;
+    @synchronized (self) {
+        return [self recordForProfile:profileId];
+    }
+}
+
+- (NSDictionary *)usage {
+    @synchronized (self) {
+        if (!_snapshot) {
+            _snapshot = @{
+                kUsageBytes: @(DiskUsageLedgerTotalBytes(_ledger)),
+                kUsageArchivedBytes: @(DiskUsageLedgerTotalArchivedBytes(_ledger)),
+                kUsageProfiles: [self allRecords]
+            };
+        }
+        return _snapshot;
+    }
+}
+
+- (void)scheduleReconcile {
+    @synchronized (self) {
+        if (_reconcileQueued) return;
+        if (_reconciled && -[_reconciled timeIntervalSinceNow] < kReconcileInterval) return;
+        _reconcileQueued = YES;
+    }
+    [[JobManager sharedManager] runWhenIdle:^{
+        @synchronized (self) {
+            self.reconcileQueued = NO;
+        }
+        [self reconcile];
+    }];
+}
+
+// Runs on the job queue between jobs, at background QoS with throttled disk I/O.
+// Pauses when a job is queued and picks up where it stopped on the next idle turn.
+- (void)reconcile {
+    ProfileManager *profileManager = [ProfileManager sharedManager];
+    NSArray<Profile *> *profiles = [profileManager profilesSnapshot];
+
+    int oldPolicy = getiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD);
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+    NSUInteger corrected = 0;
+    BOOL complete = YES;
+    for (Profile *profile in profiles) {
+        if (!profile.id || [_reconciledIds containsObject:profile.id]) continue;
+        if (shouldStopForJobs(NULL)) {
+            complete = NO;
+            break;
+        }
+        @autoreleasepool {
+            DiskUsageTally *tally = DiskUsageTallyCreate();
+            uint64_t archivedBytes = 0;
+            NSString *profilePath = [profileManager pathForProfileId:profile.id];
+            ProfileArchiver *archiver = [ProfileArchiver sharedManager];
+            BOOL isDir = NO;
+            if ([[NSFileManager defaultManager] fileExistsAtPath:profilePath isDirectory:&isDir] && isDir) {
+                if (!DiskUsageScanTree(profilePath.fileSystemRepresentation, NULL, 0, tally, shouldStopForJobs, NULL)) {
+                    DiskUsageTallyFree(tally);
+                    complete = NO;
+                    break;
+                }
+            } else if ([archiver isArchived:profile.id]) {
+                // Packed profiles are sized from the archive's directory, not by unpacking.
+                NSString *archive = [archiver archivePathForProfile:profile.id];
+                for (NSDictionary *entry in readArchiveDirectory(archive, nil)) {
+                    if (![entry[kArchiveType] isEqualToString:kArchiveTypeFile]) continue;
+                    addFile(tally, entry[kArchivePath], 0, [entry[kArchiveSize] unsignedLongLongValue]);
+                }
+                struct stat st;
+                if (stat(archive.fileSystemRepresentation, &st) == 0) archivedBytes = (uint64_t)st.st_size;
+            }
+
+            @synchronized (self) {
+                const char *profileId = profile.id.UTF8String;
+                uint64_t oldBytes = 0, newBytes = 0;
+                BOOL known = DiskUsageLedgerGet(_ledger, profileId, &oldBytes, NULL, NULL, NULL);
+                if ([self isKnownProfile:profile.id] && DiskUsageLedgerStoreTally(_ledger, profileId, tally, archivedBytes) > 0) {
+                    DiskUsageLedgerGet(_ledger, profileId, &newBytes, NULL, NULL, NULL);
+                    if (known) PXLog(@"[DiskUsageIndex] Corrected %@: %llu -> %llu bytes", profile.id, oldBytes, newBytes);
+                    _snapshot = nil;
+                    corrected++;
+                }
+            }
+            DiskUsageTallyFree(tally);
+            [_reconciledIds addObject:profile.id];
+        }
+    }
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, oldPolicy);
+
+    @synchronized (self) {
+        if (complete) {
+            // Entries for profiles that no longer exist.
+            NSMutableArray<NSString *> *stale = [NSMutableArray array];
+            for (size_t i = 0; i < DiskUsageLedgerCount(_ledger); i++) {
+                NSString *profileId = @(DiskUsageLedgerProfileAt(_ledger, i));
+                if (![self isKnownProfile:profileId]) [stale addObject:profileId];
+            }
+            for (NSString *profileId in stale) {
+                DiskUsageLedgerDrop(_ledger, profileId.UTF8String);
+                _snapshot = nil;
+                corrected++;
+            }
+            _reconciled = [NSDate date];
+        }
+        if (corrected > 0 || complete) [self save];
+    }
+    if (complete) {
+        PXLog(@"[DiskUsageIndex] Reconciled %lu profiles, %lu corrected", (unsigned long)_reconciledIds.count, (unsigned long)corrected);
+        [_reconciledIds removeAllObjects];
+    } else {
+        PXLog(@"[DiskUsageIndex] Reconcile paused after %lu profiles", (unsigned long)_reconciledIds.count);
+        [self scheduleReconcile];
+    }
+}
+
+@end
@@ -0,0 +1,14 @@
+#import <Foundation/Foundation.h>
+#import "TreeWalker.h"
+
+typedef NS_ENUM(NSInteger, FileCloneResult) {
+    FileCloneFailed = 0,
+    FileCloneCloned,    // copy-on-write clone, no data blocks written
+    FileCloneCopied     // filesystem cannot clone, fell back to a byte copy
+};
+
+// Copies src to dst (which must not exist) by cloning the whole tree with
+// clonefile(2). Only when the volume does not support clones (ENOTSUP/EXDEV)
+// does it fall back to a streaming copy. With owner set, the result is fixed up
+// in the same pass as the fallback copy, or in one walk after a clone.
+FileCloneResult cloneItemTree(NSString *src, NSString *dst, const TreeOwnership *owner, NSError **error);
@@ -0,0 +1,28 @@
+#import "FileCloner.h"
+#import "FileRemover.h"
+#import "ProjectXLogging.h"
+#include <errno.h>
+#include <sys/clonefile.h>
+
+FileCloneResult cloneItemTree(NSString *src, NSString *dst, const TreeOwnership *owner, NSError **error) {
+    if (clonefile(src.fileSystemRepresentation, dst.fileSystemRepresentation, CLONE_NOFOLLOW) == 0) {
+        if (owner) {
+            NSUInteger failures = fixupTreeOwnership(dst, owner);
+            if (failures) PXLog(@"[FileCloner] %lu entries under %@ kept their owner/mode", (unsigned long)failures, dst);
+        }
+        return FileCloneCloned;
+    }
+    int err = errno;
+    if (err != ENOTSUP && err != EXDEV) {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:err userInfo:nil];
+        return FileCloneFailed;
+    }
+
+    PXLog(@"[FileCloner] clonefile unsupported for %@ (%s), copying", src, strerror(err));
+    // clonefile never leaves a partial tree behind, but be safe before copying.
+    removeItemTree(dst, 1, nil);
+    if (!copyTreeWithOwnership(src, dst, owner, error)) {
+        return FileCloneFailed;
+    }
+    return FileCloneCopied;
+}
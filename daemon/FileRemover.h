@@ -0,0 +1,11 @@
+#import <Foundation/Foundation.h>
+
+// Called once per entry that could not be removed. path is rebuilt only here,
+// err is the errno of the failing openat/unlinkat.
+typedef void (^FileRemoverErrorBlock)(NSString *path, int err);
+
+// In-process `rm -rf`: walks the tree with openat/fdopendir/unlinkat and an
+// explicit stack, never following symlinks. With parallelism > 1 the top-level
+// subdirectories are removed concurrently. Returns the number of entries that
+// could not be removed (0 means the path is gone or never existed).
+NSUInteger removeItemTree(NSString *path, NSUInteger parallelism, FileRemoverErrorBlock onError);
@@ -0,0 +1,94 @@
+#import "FileRemover.h"
+#import "FileRemoverCore.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void reportToBlock(const char *path, int err, void *context) {
+    FileRemoverErrorBlock onError = (__bridge FileRemoverErrorBlock)context;
+    onError([NSString stringWithUTF8String:path] ?: @"", err);
+}
+
+static void initContext(FileRemoverContext *ctx, FileRemoverErrorBlock onError, const char *rootPath) {
+    ctx->onError = onError ? reportToBlock : NULL;
+    ctx->context = (__bridge void *)onError;
+    ctx->rootPath = rootPath;
+    atomic_init(&ctx->failures, 0);
+}
+
+// Splits the top level of `rootFd` across a concurrent queue. The root is
+// listed in full first, so it is not read while files go and workers modify it.
+static void removeChildrenInParallel(FileRemoverContext *ctx, int rootFd, NSUInteger parallelism) {
+    FileRemoverListing listing;
+    int err = FileRemoverReadListing(rootFd, &listing);
+    if (err) {
+        FileRemoverReportFailure(ctx, NULL, 0, err);
+        return;
+    }
+    NSMutableArray<NSString *> *directories = [NSMutableArray array];
+    const char *cursor = NULL, *name;
+    bool isDirectory;
+    while (FileRemoverListingNext(&listing, &cursor, &name, &isDirectory)) {
+        if (isDirectory) {
+            [directories addObject:[NSString stringWithUTF8String:name]];
+        } else if (unlinkat(rootFd, name, 0) != 0 && errno != ENOENT) {
+            FileRemoverReportFailure(ctx, &name, 1, errno);
+        }
+    }
+    FileRemoverListingFree(&listing);
+
+    dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+    dispatch_semaphore_t slots = dispatch_semaphore_create(parallelism);
+    dispatch_group_t group = dispatch_group_create();
+    for (NSString *name in directories) {
+        dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+        dispatch_group_async(group, queue, ^{
+            FileRemoverRemoveDirectoryAt(ctx, rootFd, name.fileSystemRepresentation);
+            dispatch_semaphore_signal(slots);
+        });
+    }
+    dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+}
+
+NSUInteger removeItemTree(NSString *path, NSUInteger parallelism, FileRemoverErrorBlock onError) {
+    if (path.length == 0) return 0;
+    NSString *parent = [path stringByDeletingLastPathComponent];
+    NSString *name = [path lastPathComponent];
+    if (parent.length == 0) parent = @".";
+
+    FileRemoverContext ctx;
+    initContext(&ctx, onError, parent.fileSystemRepresentation);
+    const char *leaf = name.fileSystemRepresentation;
+    int parentFd = open(parent.fileSystemRepresentation, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (parentFd < 0) {
+        if (errno != ENOENT) FileRemoverReportFailure(&ctx, &leaf, 1, errno);
+        return atomic_load(&ctx.failures);
+    }
+
+    struct stat st;
+    if (fstatat(parentFd, leaf, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+        if (errno != ENOENT) FileRemoverReportFailure(&ctx, &leaf, 1, errno);
+    } else if (!S_ISDIR(st.st_mode)) {
+        if (unlinkat(parentFd, leaf, 0) != 0 && errno != ENOENT) {
+            FileRemoverReportFailure(&ctx, &leaf, 1, errno);
+        }
+    } else if (parallelism > 1) {
+        int rootFd = FileRemoverOpenDirectoryAt(parentFd, leaf);
+        if (rootFd < 0) {
+            FileRemoverReportFailure(&ctx, &leaf, 1, errno);
+        } else {
+            ctx.rootPath = path.fileSystemRepresentation;
+            removeChildrenInParallel(&ctx, rootFd, parallelism);
+            close(rootFd);
+            ctx.rootPath = parent.fileSystemRepresentation;
+            if (unlinkat(parentFd, leaf, AT_REMOVEDIR) != 0 && errno != ENOENT) {
+                FileRemoverReportFailure(&ctx, &leaf, 1, errno);
+            }
+        }
+    } else {
+        FileRemoverRemoveDirectoryAt(&ctx, parentFd, leaf);
+    }
+    close(parentFd);
+    return atomic_load(&ctx.failures);
+}
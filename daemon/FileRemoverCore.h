@@ -0,0 +1,52 @@
+#ifndef FILE_REMOVER_CORE_H
+#define FILE_REMOVER_CORE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// The walk behind removeItemTree, plain C so bench/ can run it against `rm -rf`
+// on any host. Symlinks are never followed; the link itself is removed.
+//
+// Every directory is listed in full before anything in it is unlinked:
+// removing entries while readdir() is still walking the same stream can make
+// it skip others (APFS and HFS+ both do), which left directories that failed
+// with ENOTEMPTY and a half-deleted tree.
+
+// Called once per entry that could not be removed, with its full path and the
+// errno of the failing call.
+typedef void (*FileRemoverErrorFunc)(const char *path, int err, void *context);
+
+typedef struct {
+    FileRemoverErrorFunc onError; // may be NULL
+    void *context;
+    const char *rootPath; // prefix of reported paths: the directory parentFd refers to
+    _Atomic(size_t) failures;
+} FileRemoverContext;
+
+// The entries of a directory other than "." and "..", read in one go.
+typedef struct {
+    char *buffer; // per entry: a flag byte, then the NUL-terminated name
+    size_t length;
+} FileRemoverListing;
+
+// Opens name (relative to parentFd) as a directory without following symlinks.
+// A directory we may not search gets u+rwx first, like `rm -rf` running as root.
+int FileRemoverOpenDirectoryAt(int parentFd, const char *name);
+
+// Lists the directory fd refers to through a separate open of ".", so fd's own
+// offset is untouched. Returns 0 or an errno.
+int FileRemoverReadListing(int fd, FileRemoverListing *listing);
+void FileRemoverListingFree(FileRemoverListing *listing);
+// Iterates a listing: start with *cursor = NULL. Returns false at the end.
+bool FileRemoverListingNext(const FileRemoverListing *listing, const char **cursor, const char **name,
+                            bool *isDirectory);
+
+// Counts a failure and reports rootPath/names[0]/.../names[count - 1].
+void FileRemoverReportFailure(FileRemoverContext *ctx, const char *const *names, size_t count, int err);
+
+// Removes the directory name inside parentFd and everything below it. One fd
+// and one listing are held per level of depth.
+void FileRemoverRemoveDirectoryAt(FileRemoverContext *ctx, int parentFd, const char *name);
+
+#endif
@@ -0,0 +1,204 @@
+#include "FileRemoverCore.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// ---- Listing ----
+
+int FileRemoverOpenDirectoryAt(int parentFd, const char *name) {
+    int fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0 && errno == EACCES && fchmodat(parentFd, name, S_IRWXU, 0) == 0) {
+        fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    }
+    return fd;
+}
+
+static bool isDirectoryEntry(int dirFd, struct dirent *entry) {
+    if (entry->d_type == DT_DIR) return true;
+    if (entry->d_type != DT_UNKNOWN) return false;
+    struct stat st;
+    return fstatat(dirFd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+}
+
+static bool isDotEntry(const char *name) {
+    return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+int FileRemoverReadListing(int fd, FileRemoverListing *listing) {
+    listing->buffer = NULL;
+    listing->length = 0;
+    int readFd = openat(fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = readFd >= 0 ? fdopendir(readFd) : NULL;
+    if (!dir) {
+        int err = errno;
+        if (readFd >= 0) close(readFd);
+        return err;
+    }
+
+    size_t capacity = 0;
+    int err = 0;
+    struct dirent *entry;
+    errno = 0;
+    while ((entry = readdir(dir))) {
+        if (isDotEntry(entry->d_name)) continue;
+        size_t needed = 1 + strlen(entry->d_name) + 1;
+        if (listing->length + needed > capacity) {
+            size_t grown = capacity ? capacity * 2 : 1024;
+            while (grown < listing->length + needed) grown *= 2;
+            char *buffer = realloc(listing->buffer, grown);
+            if (!buffer) {
+                err = ENOMEM;
+                break;
+            }
+            listing->buffer = buffer;
+            capacity = grown;
+        }
+        listing->buffer[listing->length] = isDirectoryEntry(fd, entry) ? 'd' : '-';
+        memcpy(listing->buffer + listing->length + 1, entry->d_name, needed - 1);
+        listing->length += needed;
+        errno = 0;
+    }
+    if (!err && errno) err = errno;
+    closedir(dir);
+    if (err) FileRemoverListingFree(listing);
+    return err;
+}
+
+void FileRemoverListingFree(FileRemoverListing *listing) {
+    free(listing->buffer);
+    listing->buffer = NULL;
+    listing->length = 0;
+}
+
+bool FileRemoverListingNext(const FileRemoverListing *listing, const char **cursor, const char **name,
+                            bool *isDirectory) {
+    const char *p = *cursor ? *cursor : listing->buffer;
+    if (!p || p >= listing->buffer + listing->length) return false;
+    *isDirectory = p[0] == 'd';
+    *name = p + 1;
+    *cursor = p + 1 + strlen(p + 1) + 1;
+    return true;
+}
+
+// ---- Removal ----
+
+void FileRemoverReportFailure(FileRemoverContext *ctx, const char *const *names, size_t count, int err) {
+    atomic_fetch_add_explicit(&ctx->failures, 1, memory_order_relaxed);
+    if (!ctx->onError) return;
+    size_t length = strlen(ctx->rootPath) + 1;
+    for (size_t i = 0; i < count; i++) length += 1 + strlen(names[i]);
+    char *path = malloc(length);
+    if (!path) {
+        ctx->onError(ctx->rootPath, err, ctx->context);
+        return;
+    }
+    char *p = stpcpy(path, ctx->rootPath);
+    for (size_t i = 0; i < count; i++) {
+        *p++ = '/';
+        p = stpcpy(p, names[i]);
+    }
+    ctx->onError(path, err, ctx->context);
+    free(path);
+}
+
+// One directory on the walk stack. name is the entry name inside the parent
+// frame (it points into the parent's listing), kept to rmdir the directory and
+// to report errors.
+typedef struct {
+    int fd;
+    const char *name;
+    FileRemoverListing listing;
+    const char *cursor;
+} RemoveFrame;
+
+// Reports stack[0..depth)/name; depth is at least 1.
+static void reportAt(FileRemoverContext *ctx, const RemoveFrame *stack, size_t depth, const char *name, int err) {
+    size_t count = depth + 1;
+    const char **names = malloc(count * sizeof(*names));
+    if (!names) {
+        FileRemoverReportFailure(ctx, NULL, 0, err);
+        return;
+    }
+    for (size_t i = 0; i < depth; i++) names[i] = stack[i].name;
+    names[depth] = name;
+    FileRemoverReportFailure(ctx, names, count, err);
+    free(names);
+}
+
+// Opens and lists name inside parentFd as a new frame. Returns 0 or an errno.
+static int pushFrame(RemoveFrame *frame, int parentFd, const char *name) {
+    *frame = (RemoveFrame){ .fd = -1, .name = name };
+    int fd = FileRemoverOpenDirectoryAt(parentFd, name);
+    if (fd < 0) return errno;
+    int err = FileRemoverReadListing(fd, &frame->listing);
+    if (err) {
+        close(fd);
+        return err;
+    }
+    frame->fd = fd;
+    return 0;
+}
+
+void FileRemoverRemoveDirectoryAt(FileRemoverContext *ctx, int parentFd, const char *name) {
+    size_t capacity = 16, depth = 0;
+    RemoveFrame *stack = malloc(capacity * sizeof(RemoveFrame));
+    if (!stack) {
+        FileRemoverReportFailure(ctx, &name, 1, ENOMEM);
+        return;
+    }
+    int err = pushFrame(&stack[0], parentFd, name);
+    if (err) {
+        if (err != ENOENT) FileRemoverReportFailure(ctx, &name, 1, err);
+        free(stack);
+        return;
+    }
+    depth = 1;
+
+    while (depth > 0) {
+        RemoveFrame *top = &stack[depth - 1];
+        const char *entryName;
+        bool isDirectory;
+        if (FileRemoverListingNext(&top->listing, &top->cursor, &entryName, &isDirectory)) {
+            if (!isDirectory) {
+                // Files, symlinks, sockets...: the link itself is removed, never its target.
+                if (unlinkat(top->fd, entryName, 0) != 0 && errno != ENOENT) {
+                    reportAt(ctx, stack, depth, entryName, errno);
+                }
+                continue;
+            }
+            if (depth == capacity) {
+                RemoveFrame *grown = realloc(stack, capacity * 2 * sizeof(RemoveFrame));
+                if (!grown) {
+                    reportAt(ctx, stack, depth, entryName, ENOMEM);
+                    continue;
+                }
+                stack = grown;
+                capacity *= 2;
+                top = &stack[depth - 1];
+            }
+            err = pushFrame(&stack[depth], top->fd, entryName);
+            if (err) {
+                if (err != ENOENT) reportAt(ctx, stack, depth, entryName, err);
+                continue;
+            }
+            depth++;
+            continue;
+        }
+
+        // Directory exhausted: close it and remove it from its parent. Its
+        // name lives in the parent's listing, so that is freed afterwards.
+        close(top->fd);
+        depth--;
+        int ownerFd = depth > 0 ? stack[depth - 1].fd : parentFd;
+        if (unlinkat(ownerFd, top->name, AT_REMOVEDIR) != 0 && errno != ENOENT) {
+            reportAt(ctx, stack, depth, top->name, errno);
+        }
+        FileRemoverListingFree(&top->listing);
+    }
+    free(stack);
+}
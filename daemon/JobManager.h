@@ -0,0 +1,56 @@
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSInteger, DaemonJobState) {
+    DaemonJobStateQueued = 0,
+    DaemonJobStateRunning,
+    DaemonJobStateSucceeded,
+    DaemonJobStateFailed,
+    DaemonJobStateCancelled
+};
+
+// A long-running daemon operation (newPhone, switchBackup, ...).
+// Work runs on JobManager's queue; HTTP handlers only return the job id and
+// clients follow progress through /jobStatus long-polling.
+@interface DaemonJob : NSObject
+
+@property (nonatomic, readonly) NSString *jobId;
+@property (nonatomic, readonly) NSString *type;
+@property (readonly) DaemonJobState state;
+@property (readonly, getter=isCancelled) BOOL cancelled;
+// Bumped on every state/progress change; long-poll clients wait for it to move.
+@property (readonly) uint64_t seq;
+
+// Progress reporting from the work block.
+- (void)reportStep:(NSString *)step bundle:(NSString *)bundleId;
+- (void)reportCompleted:(NSUInteger)completed total:(NSUInteger)total;
+- (void)reportBytes:(uint64_t)bytes;
+
+// Cancellation is cooperative. The work block calls this right before it starts
+// modifying containers; it returns NO if the job was cancelled, otherwise the job
+// stops being cancellable so a half-applied switch can never be abandoned.
+- (BOOL)enterCommitPhase;
+
+// Calls handler on a global queue once seq > since, the job finishes, or the
+// timeout elapses, without holding a thread while it waits.
+- (void)notifyWhenChangedSince:(uint64_t)since timeout:(NSTimeInterval)timeout handler:(dispatch_block_t)handler;
+- (BOOL)isFinished;
+- (NSDictionary *)toDictionary;
+
+@end
+
+@interface JobManager : NSObject
+
++ (instancetype)sharedManager;
+
+// Queues work on the serial job queue and returns immediately. The block returns
+// NO (optionally setting *error) to mark the job failed.
+- (DaemonJob *)submitJobWithType:(NSString *)type work:(BOOL (^)(DaemonJob *job, NSString **error))work;
+- (DaemonJob *)jobWithId:(NSString *)jobId;
+- (BOOL)cancelJob:(NSString *)jobId;
+
+// Background-QoS work on the same serial queue, so it never overlaps a job.
+// Long-running idle work should poll hasPendingJobs and bail out early.
+- (void)runWhenIdle:(dispatch_block_t)block;
+- (BOOL)hasPendingJobs;
+
+@end
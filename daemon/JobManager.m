@@ -0,0 +1,349 @@
+#import "JobManager.h"
+#import "JobStateCore.h"
+#import "ProjectXLogging.h"
+#include <stdatomic.h>
+
+// Number of finished jobs kept around for /jobStatus lookups.
+static const NSUInteger kMaxFinishedJobs = 32;
+
+_Static_assert((int)DaemonJobStateQueued == JobStateQueued && (int)DaemonJobStateRunning == JobStateRunning &&
+               (int)DaemonJobStateSucceeded == JobStateSucceeded && (int)DaemonJobStateFailed == JobStateFailed &&
+               (int)DaemonJobStateCancelled == JobStateCancelled,
+               "DaemonJobState mirrors JobState");
+
+static NSString *DaemonJobStateName(DaemonJobState state) {
+    switch (state) {
+        case DaemonJobStateQueued:    return @"queued";
+        case DaemonJobStateRunning:   return @"running";
+        case DaemonJobStateSucceeded: return @"succeeded";
+        case DaemonJobStateFailed:    return @"failed";
+        case DaemonJobStateCancelled: return @"cancelled";
+    }
+    return @"unknown";
+}
+
+@interface DaemonJob ()
+@property (nonatomic, strong) NSLock *lock;
+@property (nonatomic, copy) NSString *step;
+@property (nonatomic, copy) NSString *bundleId;
+@property (nonatomic, copy) NSString *errorMessage;
+@property (nonatomic, assign) NSUInteger completed;
+@property (nonatomic, assign) NSUInteger total;
+@property (nonatomic, assign) uint64_t bytes;
+@property (nonatomic, strong) NSDate *createdDate;
+@property (nonatomic, strong) NSDate *finishedDate;
+@end
+
+@implementation DaemonJob {
+    JobStatus _status;
+    JobWaiterList _waiters;
+    // token -> handler of each parked long-poll
+    NSMutableDictionary<NSNumber *, dispatch_block_t> *_waiterHandlers;
+    uint64_t _nextWaiterToken;
+}
+
+- (instancetype)initWithType:(NSString *)type {
+    self = [super init];
+    if (self) {
+        _jobId = [[NSUUID UUID] UUIDString];
+        _type = [type copy];
+        _lock = [NSLock new];
+        _createdDate = [NSDate date];
+        _status.state = JobStateQueued;
+        _waiterHandlers = [NSMutableDictionary dictionary];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    JobWaitersFree(&_waiters);
+}
+
+// Hands the parked long-polls the core says are ready to their queue. Called
+// with the lock held; the handlers run after it is released.
+- (NSArray<dispatch_block_t> *)takeReadyWaitersLocked {
+    if (_waiters.count == 0) return nil;
+    uint64_t tokens[_waiters.count];
+    size_t taken = JobWaitersTakeReady(&_waiters, &_status, tokens);
+    if (taken == 0) return nil;
+    NSMutableArray<dispatch_block_t> *handlers = [NSMutableArray arrayWithCapacity:taken];
+    for (size_t i = 0; i < taken; i++) {
+        NSNumber *key = @(tokens[i]);
+        dispatch_block_t handler = _waiterHandlers[key];
+        [_waiterHandlers removeObjectForKey:key];
+        if (handler) [handlers addObject:handler];
+    }
+    return handlers;
+}
+
+static void DaemonJobRunHandlers(NSArray<dispatch_block_t> *handlers) {
+    for (dispatch_block_t handler in handlers) {
+        dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), handler);
+    }
+}
+
+// Runs `change` under the job lock (it bumps seq through the core) and answers
+// the long-polls waiting for that.
+- (void)mutate:(void (^)(void))change {
+    [_lock lock];
+    change();
+    NSArray<dispatch_block_t> *handlers = [self takeReadyWaitersLocked];
+    [_lock unlock];
+    DaemonJobRunHandlers(handlers);
+}
+
+- (BOOL)transitionTo:(DaemonJobState)state error:(NSString *)error {
+    __block BOOL ok = NO;
+    [self mutate:^{
+        if (!JobStatusTransition(&self->_status, (JobState)state)) return;
+        if (error) self.errorMessage = error;
+        if (state != DaemonJobStateRunning) self.finishedDate = [NSDate date];
+        ok = YES;
+    }];
+    return ok;
+}
+
+- (DaemonJobState)state {
+    [_lock lock];
+    DaemonJobState s = (DaemonJobState)_status.state;
+    [_lock unlock];
+    return s;
+}
+
+- (BOOL)isCancelled {
+    [_lock lock];
+    BOOL c = _status.cancelled;
+    [_lock unlock];
+    return c;
+}
+
+- (uint64_t)seq {
+    [_lock lock];
+    uint64_t s = _status.seq;
+    [_lock unlock];
+    return s;
+}
+
+- (BOOL)isFinished {
+    return JobStateIsFinished((JobState)self.state);
+}
+
+- (void)reportStep:(NSString *)step bundle:(NSString *)bundleId {
+    [self mutate:^{
+        self.step = step;
+        self.bundleId = bundleId;
+        JobStatusTouch(&self->_status);
+    }];
+}
+
+- (void)reportCompleted:(NSUInteger)completed total:(NSUInteger)total {
+    [self mutate:^{
+        self.completed = completed;
+        self.total = total;
+        JobStatusTouch(&self->_status);
+    }];
+}
+
+- (void)reportBytes:(uint64_t)bytes {
+    [self mutate:^{
+        self.bytes += bytes;
+        JobStatusTouch(&self->_status);
+    }];
+}
+
+- (BOOL)enterCommitPhase {
+    __block BOOL ok = NO;
+    [self mutate:^{
+        ok = JobStatusEnterCommit(&self->_status);
+    }];
+    return ok;
+}
+
+- (DaemonJobState)finalStateForWorkResult:(BOOL)ok {
+    [_lock lock];
+    DaemonJobState final = (DaemonJobState)JobFinalState(&_status, ok);
+    [_lock unlock];
+    return final;
+}
+
+// Returns NO once the job is past its commit point or already finished.
+- (BOOL)requestCancel {
+    __block BOOL ok = NO;
+    [self mutate:^{
+        ok = JobStatusRequestCancel(&self->_status);
+        if (ok && self->_status.state == JobStateCancelled) self.finishedDate = [NSDate date];
+    }];
+    return ok;
+}
+
+- (void)notifyWhenChangedSince:(uint64_t)since timeout:(NSTimeInterval)timeout handler:(dispatch_block_t)handler {
+    [_lock lock];
+    JobWaiter probe = { since, 0 };
+    if (JobWaiterReady(&probe, &_status)) {
+        [_lock unlock];
+        DaemonJobRunHandlers(@[ handler ]);
+        return;
+    }
+    uint64_t token = ++_nextWaiterToken;
+    if (!JobWaitersAdd(&_waiters, since, token)) {
+        [_lock unlock];
+        DaemonJobRunHandlers(@[ handler ]);
+        return;
+    }
+    _waiterHandlers[@(token)] = [handler copy];
+    [_lock unlock];
+
+    // The timeout answers with whatever the job looks like by then, unless a
+    // change got there first and already took the waiter. It keeps the job
+    // alive so a job pruned from JobManager meanwhile still answers.
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC)),
+                   dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        [self.lock lock];
+        dispatch_block_t expired = nil;
+        if (JobWaitersRemove(&self->_waiters, token)) {
+            expired = self->_waiterHandlers[@(token)];
+            [self->_waiterHandlers removeObjectForKey:@(token)];
+        }
+        [self.lock unlock];
+        if (expired) expired();
+    });
+}
+
+- (NSDictionary *)toDictionary {
+    [_lock lock];
+    NSMutableDictionary *dict = [NSMutableDictionary dictionary];
+    dict[@"id"] = _jobId;
+    dict[@"type"] = _type ?: @"";
+    dict[@"state"] = DaemonJobStateName((DaemonJobState)_status.state);
+    dict[@"seq"] = @(_status.seq);
+    dict[@"cancelled"] = @(_status.cancelled);
+    dict[@"step"] = _step ?: @"";
+    dict[@"bundle"] = _bundleId ?: @"";
+    dict[@"completed"] = @(_completed);
+    dict[@"total"] = @(_total);
+    dict[@"bytes"] = @(_bytes);
+    dict[@"createdDate"] = @([_createdDate timeIntervalSince1970]);
+    if (_finishedDate) dict[@"finishedDate"] = @([_finishedDate timeIntervalSince1970]);
+    if (_errorMessage) dict[@"error"] = _errorMessage;
+    [_lock unlock];
+    return dict;
+}
+
+@end
+
+@interface JobManager ()
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, DaemonJob *> *jobs;
+@property (nonatomic, strong) NSMutableArray<NSString *> *jobOrder;
+@end
+
+@implementation JobManager {
+    _Atomic(NSUInteger) _pendingJobs;
+}
+
++ (instancetype)sharedManager {
+    static JobManager *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        // Serial: container operations must never overlap each other.
+        dispatch_queue_attr_t attr = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_USER_INITIATED, 0);
+        _queue = dispatch_queue_create("com.projectx.daemon.jobs", attr);
+        _jobs = [NSMutableDictionary dictionary];
+        _jobOrder = [NSMutableArray array];
+    }
+    return self;
+}
+
+- (void)trackJob:(DaemonJob *)job {
+    @synchronized (self) {
+        _jobs[job.jobId] = job;
+        [_jobOrder addObject:job.jobId];
+        // Drop the oldest finished jobs beyond the limit; active ones are always kept.
+        NSUInteger finished = 0;
+        for (NSString *jobId in _jobOrder) {
+            if ([_jobs[jobId] isFinished]) finished++;
+        }
+        for (NSUInteger i = 0; i < _jobOrder.count && finished > kMaxFinishedJobs;) {
+            NSString *jobId = _jobOrder[i];
+            if ([_jobs[jobId] isFinished]) {
+                [_jobs removeObjectForKey:jobId];
+                [_jobOrder removeObjectAtIndex:i];
+                finished--;
+            } else {
+                i++;
+            }
+        }
+    }
+}
+
+- (DaemonJob *)submitJobWithType:(NSString *)type work:(BOOL (^)(DaemonJob *job, NSString **error))work {
+    DaemonJob *job = [[DaemonJob alloc] initWithType:type];
+    [self trackJob:job];
+    PXLog(@"[JobManager] Queued %@ job %@", type, job.jobId);
+
+    atomic_fetch_add(&_pendingJobs, 1);
+    dispatch_async(_queue, ^{
+        if (![job transitionTo:DaemonJobStateRunning error:nil]) {
+            PXLog(@"[JobManager] Job %@ cancelled before start", job.jobId);
+            atomic_fetch_sub(&self->_pendingJobs, 1);
+            return;
+        }
+        PXLog(@"[JobManager] Running %@ job %@", type, job.jobId);
+        NSString *error = nil;
+        BOOL ok = NO;
+        @try {
+            @autoreleasepool {
+                ok = work(job, &error);
+            }
+        } @catch (NSException *exception) {
+            error = exception.reason ?: exception.name;
+            PXLog(@"[JobManager] Job %@ threw: %@", job.jobId, exception);
+        }
+        DaemonJobState final = [job finalStateForWorkResult:ok];
+        [job transitionTo:final error:error];
+        atomic_fetch_sub(&self->_pendingJobs, 1);
+        PXLog(@"[JobManager] Job %@ finished: %@", job.jobId, DaemonJobStateName(final));
+    });
+    return job;
+}
+
+- (void)runWhenIdle:(dispatch_block_t)block {
+    dispatch_block_t idle = dispatch_block_create_with_qos_class(DISPATCH_BLOCK_ENFORCE_QOS_CLASS, QOS_CLASS_BACKGROUND, 0, ^{
+        @try {
+            @autoreleasepool {
+                block();
+            }
+        } @catch (NSException *exception) {
+            PXLog(@"[JobManager] Idle work threw: %@", exception);
+        }
+    });
+    dispatch_async(_queue, idle);
+}
+
+- (BOOL)hasPendingJobs {
+    return atomic_load(&_pendingJobs) > 0;
+}
+
+- (DaemonJob *)jobWithId:(NSString *)jobId {
+    if (![jobId isKindOfClass:[NSString class]]) return nil;
+    @synchronized (self) {
+        return _jobs[jobId];
+    }
+}
+
+- (BOOL)cancelJob:(NSString *)jobId {
+    DaemonJob *job = [self jobWithId:jobId];
+    if (!job || ![job requestCancel]) return NO;
+    PXLog(@"[JobManager] Cancel requested for job %@", jobId);
+    return YES;
+}
+
+@end
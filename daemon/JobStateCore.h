@@ -0,0 +1,68 @@
+#ifndef JOB_STATE_CORE_H
+#define JOB_STATE_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// DaemonJob's state machine and its long-poll waiters, plain C so bench/ can
+// drive them on any host. DaemonJob holds a JobStatus and a JobWaiterList
+// under its lock; nothing here locks.
+//
+// queued -> running | cancelled
+// running -> succeeded | failed | cancelled
+// finished states are terminal
+
+// Same values as DaemonJobState.
+typedef enum {
+    JobStateQueued = 0,
+    JobStateRunning,
+    JobStateSucceeded,
+    JobStateFailed,
+    JobStateCancelled,
+} JobState;
+
+typedef struct {
+    JobState state;
+    bool cancelled; // requested; a running job stops at its next checkpoint
+    bool committed; // past enterCommitPhase, no longer cancellable
+    uint64_t seq;   // bumped by every call below and by progress reports
+} JobStatus;
+
+bool JobStateIsFinished(JobState state);
+bool JobCanTransition(JobState from, JobState to);
+
+// Each returns whether it took effect; seq moves either way.
+bool JobStatusTransition(JobStatus *status, JobState to);
+// Refused once committed or finished. A queued job is cancelled on the spot.
+bool JobStatusRequestCancel(JobStatus *status);
+// Refused if a cancel came first.
+bool JobStatusEnterCommit(JobStatus *status);
+void JobStatusTouch(JobStatus *status);
+// What a job ends as once its work block returns.
+JobState JobFinalState(const JobStatus *status, bool workSucceeded);
+
+// A parked /jobStatus request: answered once seq > since or the job finishes.
+// Its timeout is the caller's, which removes it by token.
+typedef struct {
+    uint64_t since;
+    uint64_t token;
+} JobWaiter;
+
+typedef struct {
+    JobWaiter *items;
+    size_t count;
+    size_t capacity;
+} JobWaiterList;
+
+bool JobWaiterReady(const JobWaiter *waiter, const JobStatus *status);
+// Returns false on allocation failure.
+bool JobWaitersAdd(JobWaiterList *list, uint64_t since, uint64_t token);
+// Removes the ready waiters, writing their tokens to tokens (room for
+// list->count), oldest first. Returns how many were removed.
+size_t JobWaitersTakeReady(JobWaiterList *list, const JobStatus *status, uint64_t *tokens);
+// Removes one waiter; false if it was already taken.
+bool JobWaitersRemove(JobWaiterList *list, uint64_t token);
+void JobWaitersFree(JobWaiterList *list);
+
+#endif
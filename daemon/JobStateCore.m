@@ -0,0 +1,101 @@
+#include "JobStateCore.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ---- State machine ----
+
+bool JobStateIsFinished(JobState state) {
+    return state == JobStateSucceeded || state == JobStateFailed || state == JobStateCancelled;
+}
+
+bool JobCanTransition(JobState from, JobState to) {
+    switch (from) {
+        case JobStateQueued:
+            return to == JobStateRunning || to == JobStateCancelled;
+        case JobStateRunning:
+            return to == JobStateSucceeded || to == JobStateFailed || to == JobStateCancelled;
+        default:
+            return false;
+    }
+}
+
+bool JobStatusTransition(JobStatus *status, JobState to) {
+    status->seq++;
+    if (!JobCanTransition(status->state, to)) return false;
+    status->state = to;
+    return true;
+}
+
+bool JobStatusRequestCancel(JobStatus *status) {
+    status->seq++;
+    if (status->committed) return false;
+    if (status->state != JobStateQueued && status->state != JobStateRunning) return false;
+    status->cancelled = true;
+    // A queued job is finished right away; a running one stops at its next checkpoint.
+    if (status->state == JobStateQueued) status->state = JobStateCancelled;
+    return true;
+}
+
+bool JobStatusEnterCommit(JobStatus *status) {
+    status->seq++;
+    if (status->cancelled) return false;
+    status->committed = true;
+    return true;
+}
+
+void JobStatusTouch(JobStatus *status) {
+    status->seq++;
+}
+
+JobState JobFinalState(const JobStatus *status, bool workSucceeded) {
+    if (workSucceeded) return JobStateSucceeded;
+    return status->cancelled ? JobStateCancelled : JobStateFailed;
+}
+
+// ---- Waiters ----
+
+bool JobWaiterReady(const JobWaiter *waiter, const JobStatus *status) {
+    return status->seq > waiter->since || JobStateIsFinished(status->state);
+}
+
+bool JobWaitersAdd(JobWaiterList *list, uint64_t since, uint64_t token) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 4;
+        JobWaiter *items = realloc(list->items, capacity * sizeof(JobWaiter));
+        if (!items) return false;
+        list->items = items;
+        list->capacity = capacity;
+    }
+    list->items[list->count++] = (JobWaiter){ since, token };
+    return true;
+}
+
+size_t JobWaitersTakeReady(JobWaiterList *list, const JobStatus *status, uint64_t *tokens) {
+    size_t taken = 0, kept = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        if (JobWaiterReady(&list->items[i], status)) {
+            tokens[taken++] = list->items[i].token;
+        } else {
+            list->items[kept++] = list->items[i];
+        }
+    }
+    list->count = kept;
+    return taken;
+}
+
+bool JobWaitersRemove(JobWaiterList *list, uint64_t token) {
+    for (size_t i = 0; i < list->count; i++) {
+        if (list->items[i].token != token) continue;
+        memmove(&list->items[i], &list->items[i + 1], (list->count - i - 1) * sizeof(JobWaiter));
+        list->count--;
+        return true;
+    }
+    return false;
+}
+
+void JobWaitersFree(JobWaiterList *list) {
+    free(list->items);
+    list->items = NULL;
+    list->count = list->capacity = 0;
+}
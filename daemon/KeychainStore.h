@@ -0,0 +1,22 @@
+#import <Foundation/Foundation.h>
+
+// The app-owned part of keychain-2.db: genp items outside the "apple" group,
+// cert/keys outside "lockdown-identities", and all inet items. That subset is
+// what a new phone wipes; it is saved per profile and put back on switch.
+@interface KeychainStore : NSObject
+
++ (instancetype)sharedManager;
+
+// Copies the app-owned rows into a standalone SQLite file at path (replaced
+// atomically). Returns NO if the keychain could not be read.
+- (BOOL)saveSnapshotTo:(NSString *)path;
+
+// Deletes the app-owned rows and, if snapshotPath names an existing snapshot,
+// inserts its rows, all in one transaction. If the snapshot cannot be applied
+// the keychain is still wiped.
+- (BOOL)resetRestoringSnapshot:(NSString *)snapshotPath;
+
+// Queue reclaiming of free pages left by resets as idle work.
+- (void)scheduleVacuum;
+
+@end
@@ -0,0 +1,102 @@
+#import "KeychainStore.h"
+#import "JobManager.h"
+#import "ProjectXLogging.h"
+#include "KeychainStoreCore.h"
+
+#define kKeychainPath "/private/var/Keychains/keychain-2.db"
+
+// securityd holds the database open; wait for its locks rather than failing.
+static const int kBusyTimeoutMs = 5000;
+// Pages reclaimed per incremental_vacuum step, between checks for waiting jobs.
+static const int kVacuumStepPages = 256;
+
+static sqlite3 *openKeychain(void) {
+    sqlite3 *db = NULL;
+    if (sqlite3_open_v2(kKeychainPath, &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+        PXLog(@"[KeychainStore] Cannot open keychain: %s", db ? sqlite3_errmsg(db) : "out of memory");
+        sqlite3_close(db);
+        return NULL;
+    }
+    sqlite3_busy_timeout(db, kBusyTimeoutMs);
+    return db;
+}
+
+@implementation KeychainStore
+
++ (instancetype)sharedManager {
+    static KeychainStore *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (BOOL)saveSnapshotTo:(NSString *)path {
+    if (!path) return NO;
+    sqlite3 *db = openKeychain();
+    if (!db) return NO;
+    int rc = KeychainStoreSaveSnapshot(db, path.fileSystemRepresentation);
+    if (rc != SQLITE_OK) {
+        PXLog(@"[KeychainStore] Snapshot to %@ failed: %s", path,
+              rc == SQLITE_CANTOPEN ? strerror(errno) : sqlite3_errmsg(db));
+    } else {
+        PXLog(@"[KeychainStore] Saved keychain snapshot %@", path);
+    }
+    sqlite3_close(db);
+    return rc == SQLITE_OK;
+}
+
+- (BOOL)resetRestoringSnapshot:(NSString *)snapshotPath {
+    sqlite3 *db = openKeychain();
+    if (!db) return NO;
+    bool restored = false;
+    int rc = KeychainStoreReset(db, snapshotPath.fileSystemRepresentation, &restored);
+    if (rc == SQLITE_OK && snapshotPath && !restored) {
+        PXLog(@"[KeychainStore] Snapshot %@ not applied; wiping only", snapshotPath);
+    } else if (rc != SQLITE_OK) {
+        PXLog(@"[KeychainStore] Keychain reset failed: %s", sqlite3_errmsg(db));
+    }
+    sqlite3_close(db);
+    PXLog(@"[KeychainStore] Keychain reset %@%@", rc == SQLITE_OK ? @"done" : @"failed", restored ? @" (snapshot restored)" : @"");
+    return rc == SQLITE_OK;
+}
+
+- (void)scheduleVacuum {
+    [[JobManager sharedManager] runWhenIdle:^{
+        [self vacuum];
+    }];
+}
+
+// Runs on the job queue between jobs. With auto_vacuum=INCREMENTAL free pages
+// are returned in small steps that each hold the write lock only briefly. A
+// database in another mode is left as it is: converting it takes a full VACUUM
+// of securityd's live database, which only happens when the
+// ProjectXKeychainVacuumConvert default is set (once, at idle, when enough of
+// it is free to be worth a rebuild).
+- (void)vacuum {
+    sqlite3 *db = openKeychain();
+    if (!db) return;
+    int64_t mode = KeychainStorePragma(db, "PRAGMA auto_vacuum");
+    int64_t freePages = KeychainStorePragma(db, "PRAGMA freelist_count");
+    int64_t pages = KeychainStorePragma(db, "PRAGMA page_count");
+    if (mode == 2) {
+        while (freePages > 0 && ![[JobManager sharedManager] hasPendingJobs]) {
+            int rc = KeychainStoreVacuumStep(db, kVacuumStepPages, &freePages);
+            if (rc == SQLITE_DONE) break;
+            if (rc != SQLITE_OK) {
+                PXLog(@"[KeychainStore] incremental_vacuum failed: %s", sqlite3_errmsg(db));
+                break;
+            }
+        }
+    } else if ([[NSUserDefaults standardUserDefaults] boolForKey:@"ProjectXKeychainVacuumConvert"] &&
+               pages > 0 && freePages * 4 > pages && ![[JobManager sharedManager] hasPendingJobs]) {
+        PXLog(@"[KeychainStore] Converting keychain to incremental vacuum (%lld of %lld pages free)", freePages, pages);
+        if (sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM", NULL, NULL, NULL) != SQLITE_OK) {
+            PXLog(@"[KeychainStore] Conversion failed: %s", sqlite3_errmsg(db));
+        }
+    }
+    sqlite3_close(db);
+}
+
+@end
@@ -0,0 +1,44 @@
+#ifndef KEYCHAIN_STORE_CORE_H
+#define KEYCHAIN_STORE_CORE_H
+
+#include <sqlite3.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// KeychainStore's SQL, plain C so bench/ can check and time it on a synthetic
+// keychain-shaped database on any host. KeychainStore opens keychain-2.db,
+// logs and decides when to vacuum; this only runs statements on the handle.
+// Functions return an SQLite result code; sqlite3_errmsg(db) has the detail.
+
+typedef struct {
+    const char *table;
+    const char *filter;
+} KeychainSubset;
+
+// The app-owned part of keychain-2.db: genp items outside the "apple" group,
+// cert/keys outside "lockdown-identities", and all inet items.
+extern const KeychainSubset kKeychainAppSubsets[];
+extern const size_t kKeychainAppSubsetCount;
+
+// Copies the app-owned rows into a standalone SQLite file at path, replaced
+// atomically and created owner-only. Every table is copied inside one read
+// transaction, so they come from the same state. SQLITE_CANTOPEN (errno set)
+// when the file cannot be created or renamed.
+int KeychainStoreSaveSnapshot(sqlite3 *db, const char *path);
+
+// Deletes the app-owned rows and, if snapshotPath names a readable snapshot,
+// inserts its rows, all in one BEGIN IMMEDIATE transaction. Snapshot columns
+// are matched to the live ones by name and rowids are reassigned. If the
+// snapshot cannot be applied the keychain is still wiped; *restored (may be
+// NULL) says whether it was.
+int KeychainStoreReset(sqlite3 *db, const char *snapshotPath, bool *restored);
+
+// The first column of the first row of a PRAGMA, or -1.
+int64_t KeychainStorePragma(sqlite3 *db, const char *sql);
+
+// One incremental_vacuum step of at most pages pages; *freePages is updated to
+// what is left. SQLITE_DONE once a step no longer shrinks the freelist.
+int KeychainStoreVacuumStep(sqlite3 *db, int pages, int64_t *freePages);
+
+#endif
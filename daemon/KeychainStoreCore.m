@@ -0,0 +1,204 @@
+#include "KeychainStoreCore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const KeychainSubset kKeychainAppSubsets[] = {
+    { "genp", "agrp <> 'apple'" },
+    { "cert", "agrp <> 'lockdown-identities'" },
+    { "keys", "agrp <> 'lockdown-identities'" },
+    { "inet", "1" },
+};
+const size_t kKeychainAppSubsetCount = sizeof(kKeychainAppSubsets) / sizeof(kKeychainAppSubsets[0]);
+
+// ---- Statements ----
+
+// Prepares, runs to completion and finalizes one statement.
+static int execute(sqlite3 *db, const char *sql) {
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+    if (rc != SQLITE_OK) return rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {}
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_DONE ? SQLITE_OK : rc;
+}
+
+static int attach(sqlite3 *db, const char *path) {
+    sqlite3_stmt *stmt = NULL;
+    int rc = sqlite3_prepare_v2(db, "ATTACH DATABASE ?1 AS snap", -1, &stmt, NULL);
+    if (rc == SQLITE_OK) rc = sqlite3_bind_text(stmt, 1, path, -1, SQLITE_TRANSIENT);
+    if (rc == SQLITE_OK) rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : sqlite3_errcode(db);
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+// Rolls back, keeping the error that made it necessary in sqlite3_errmsg.
+static int rollback(sqlite3 *db, int rc) {
+    if (!sqlite3_get_autocommit(db)) execute(db, "ROLLBACK");
+    return rc;
+}
+
+int64_t KeychainStorePragma(sqlite3 *db, const char *sql) {
+    sqlite3_stmt *stmt = NULL;
+    int64_t value = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return value;
+}
+
+// ---- Snapshot ----
+
+int KeychainStoreSaveSnapshot(sqlite3 *db, const char *path) {
+    size_t pathLength = strlen(path);
+    char *tmp = malloc(pathLength + sizeof(".tmp"));
+    if (!tmp) return SQLITE_NOMEM;
+    memcpy(tmp, path, pathLength);
+    memcpy(tmp + pathLength, ".tmp", sizeof(".tmp"));
+    unlink(tmp);
+
+    // Profiles live under Media, which is readable over AFC. The snapshot holds
+    // app secrets, so it is created owner-only before SQLite writes to it (and
+    // SQLite gives its journal the same mode).
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (fd < 0 || fchmod(fd, 0600) != 0) {
+        int err = errno;
+        if (fd >= 0) close(fd);
+        unlink(tmp);
+        free(tmp);
+        errno = err;
+        return SQLITE_CANTOPEN;
+    }
+    close(fd);
+    int rc = attach(db, tmp);
+    if (rc != SQLITE_OK) {
+        unlink(tmp);
+        free(tmp);
+        return rc;
+    }
+
+    // A read transaction on main, so every table is copied from the same state.
+    rc = execute(db, "BEGIN");
+    for (size_t i = 0; rc == SQLITE_OK && i < kKeychainAppSubsetCount; i++) {
+        char *sql = sqlite3_mprintf("CREATE TABLE snap.%s AS SELECT * FROM main.%s WHERE %s",
+                                    kKeychainAppSubsets[i].table, kKeychainAppSubsets[i].table,
+                                    kKeychainAppSubsets[i].filter);
+        rc = sql ? execute(db, sql) : SQLITE_NOMEM;
+        sqlite3_free(sql);
+    }
+    if (rc == SQLITE_OK) rc = execute(db, "COMMIT");
+    rollback(db, rc);
+    execute(db, "DETACH DATABASE snap");
+
+    if (rc == SQLITE_OK && rename(tmp, path) != 0) rc = SQLITE_CANTOPEN;
+    if (rc != SQLITE_OK) {
+        int err = errno;
+        unlink(tmp);
+        errno = err;
+    }
+    free(tmp);
+    return rc;
+}
+
+// ---- Reset ----
+
+// Deletes the app-owned rows; must run inside a transaction.
+static int deleteAppRows(sqlite3 *db) {
+    for (size_t i = 0; i < kKeychainAppSubsetCount; i++) {
+        char *sql = sqlite3_mprintf("DELETE FROM main.%s WHERE %s", kKeychainAppSubsets[i].table,
+                                    kKeychainAppSubsets[i].filter);
+        int rc = sql ? execute(db, sql) : SQLITE_NOMEM;
+        sqlite3_free(sql);
+        if (rc != SQLITE_OK) return rc;
+    }
+    return execute(db, "DELETE FROM main.sqlite_sequence");
+}
+
+static bool hasColumn(sqlite3 *db, const char *schema, const char *table, const char *column) {
+    char *sql = sqlite3_mprintf("SELECT 1 FROM pragma_table_info(%Q, %Q) WHERE name = %Q", table, schema, column);
+    bool found = KeychainStorePragma(db, sql) == 1;
+    sqlite3_free(sql);
+    return found;
+}
+
+// Inserts the rows of the attached snapshot; must run inside a transaction.
+// Columns are matched by name so a snapshot from before an OS update still
+// applies; rowids are left to the database so they cannot clash with the
+// rows that were kept.
+static int insertSnapshotRows(sqlite3 *db) {
+    for (size_t i = 0; i < kKeychainAppSubsetCount; i++) {
+        const char *table = kKeychainAppSubsets[i].table;
+        char *sql = sqlite3_mprintf("SELECT name FROM pragma_table_info(%Q, 'snap')", table);
+        sqlite3_stmt *stmt = NULL;
+        int rc = sql ? sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) : SQLITE_NOMEM;
+        sqlite3_free(sql);
+        if (rc != SQLITE_OK) return rc;
+        char *columns = NULL;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const char *column = (const char *)sqlite3_column_text(stmt, 0);
+            if (!column || strcmp(column, "rowid") == 0 || !hasColumn(db, "main", table, column)) continue;
+            columns = columns ? sqlite3_mprintf("%z,\"%w\"", columns, column) : sqlite3_mprintf("\"%w\"", column);
+            if (!columns) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+        }
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE) {
+            sqlite3_free(columns);
+            return rc;
+        }
+        if (!columns) continue;
+        sql = sqlite3_mprintf("INSERT OR REPLACE INTO main.%s (%s) SELECT %s FROM snap.%s", table, columns, columns,
+                              table);
+        sqlite3_free(columns);
+        rc = sql ? execute(db, sql) : SQLITE_NOMEM;
+        sqlite3_free(sql);
+        if (rc != SQLITE_OK) return rc;
+    }
+    return SQLITE_OK;
+}
+
+int KeychainStoreReset(sqlite3 *db, const char *snapshotPath, bool *restored) {
+    bool attached = snapshotPath && access(snapshotPath, R_OK) == 0 && attach(db, snapshotPath) == SQLITE_OK;
+    bool restore = attached;
+
+    // IMMEDIATE takes the write lock up front, so securityd sees either the old
+    // or the new contents, never a half-reset keychain.
+    int rc = execute(db, "BEGIN IMMEDIATE");
+    if (rc == SQLITE_OK) rc = deleteAppRows(db);
+    if (rc == SQLITE_OK && restore) rc = insertSnapshotRows(db);
+    if (rc == SQLITE_OK) rc = execute(db, "COMMIT");
+    if (rc != SQLITE_OK && restore) {
+        // A snapshot that does not apply must not leave the previous profile's items behind.
+        rollback(db, rc);
+        restore = false;
+        rc = execute(db, "BEGIN IMMEDIATE");
+        if (rc == SQLITE_OK) rc = deleteAppRows(db);
+        if (rc == SQLITE_OK) rc = execute(db, "COMMIT");
+    }
+    rollback(db, rc);
+    if (attached) execute(db, "DETACH DATABASE snap");
+    if (restored) *restored = rc == SQLITE_OK && restore;
+    return rc;
+}
+
+// ---- Vacuum ----
+
+int KeychainStoreVacuumStep(sqlite3 *db, int pages, int64_t *freePages) {
+    char sql[48];
+    snprintf(sql, sizeof(sql), "PRAGMA incremental_vacuum(%d)", pages);
+    int rc = execute(db, sql);
+    if (rc != SQLITE_OK) return rc;
+    int64_t left = KeychainStorePragma(db, "PRAGMA freelist_count");
+    if (left < 0) return sqlite3_errcode(db);
+    bool shrank = left < *freePages;
+    *freePages = left;
+    return shrank && left > 0 ? SQLITE_OK : SQLITE_DONE;
+}
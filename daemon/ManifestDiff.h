@@ -0,0 +1,37 @@
+#import <Foundation/Foundation.h>
+#include <sys/stat.h>
+
+// Manifest entry keys. size/mtime(ns)/ino are always present, hash only for
+// files large enough to be deduplicated.
+#define kManifestHash  @"hash"
+#define kManifestSize  @"size"
+#define kManifestMTime @"mtime"
+#define kManifestIno   @"ino"
+
+NSDictionary *ManifestEntryFromStat(const struct stat *st, NSString *hash);
+uint64_t ManifestMTime(const struct stat *st);
+
+// Compares the regular files under root against the manifest written at
+// snapshotTime (ns since 1970). A file is unchanged when size and mtime match and
+// its mtime is not too close to the snapshot to trust (it may have been written
+// during the previous scan, or the clock jumped). Renames are recognised by an
+// identical inode, size and mtime under a new path.
+@interface ManifestDiff : NSObject
+
+// Previous entries that are still valid, under their current path, with the
+// current inode. Includes renamed files.
+@property (nonatomic, readonly) NSDictionary<NSString *, NSDictionary *> *unchanged;
+// New path -> old path.
+@property (nonatomic, readonly) NSDictionary<NSString *, NSString *> *renamed;
+// New files and files whose content may differ (size, mtime, truncation...).
+@property (nonatomic, readonly) NSArray<NSString *> *changed;
+@property (nonatomic, readonly) NSArray<NSString *> *deleted;
+// NO if shouldStop interrupted the scan; unscanned files are simply missing.
+@property (nonatomic, readonly, getter=isComplete) BOOL complete;
+
++ (instancetype)diffTree:(NSString *)root
+                manifest:(NSDictionary<NSString *, NSDictionary *> *)manifest
+            snapshotTime:(uint64_t)snapshotTime
+              shouldStop:(BOOL (^)(void))shouldStop;
+
+@end
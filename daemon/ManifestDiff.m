@@ -0,0 +1,121 @@
+#import "ManifestDiff.h"
+#import "ManifestDiffCore.h"
+#include <time.h>
+
+uint64_t ManifestMTime(const struct stat *st) {
+    return (uint64_t)st->st_mtimespec.tv_sec * NSEC_PER_SEC + (uint64_t)st->st_mtimespec.tv_nsec;
+}
+
+NSDictionary *ManifestEntryFromStat(const struct stat *st, NSString *hash) {
+    NSMutableDictionary *entry = [NSMutableDictionary dictionaryWithCapacity:4];
+    entry[kManifestSize] = @(st->st_size);
+    entry[kManifestMTime] = @(ManifestMTime(st));
+    entry[kManifestIno] = @(st->st_ino);
+    if (hash) entry[kManifestHash] = hash;
+    return entry;
+}
+
+static ManifestRecord recordFromEntry(NSDictionary *entry) {
+    return (ManifestRecord){
+        .size = [entry[kManifestSize] unsignedLongLongValue],
+        .mtime = [entry[kManifestMTime] unsignedLongLongValue],
+        .ino = [entry[kManifestIno] unsignedLongLongValue],
+    };
+}
+
+static ManifestRecord recordFromStat(const struct stat *st) {
+    return (ManifestRecord){ .size = (uint64_t)st->st_size, .mtime = ManifestMTime(st), .ino = st->st_ino };
+}
+
+static NSDictionary *refreshedEntry(NSDictionary *entry, const struct stat *st) {
+    NSMutableDictionary *copy = [entry mutableCopy];
+    copy[kManifestIno] = @(st->st_ino);
+    return copy;
+}
+
+@interface ManifestDiff ()
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSDictionary *> *unchanged;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSString *> *renamed;
+@property (nonatomic, strong) NSMutableArray<NSString *> *changed;
+@property (nonatomic, strong) NSMutableArray<NSString *> *deleted;
+@property (nonatomic, assign, getter=isComplete) BOOL complete;
+@end
+
+@implementation ManifestDiff
+
++ (instancetype)diffTree:(NSString *)root
+                manifest:(NSDictionary<NSString *, NSDictionary *> *)manifest
+            snapshotTime:(uint64_t)snapshotTime
+              shouldStop:(BOOL (^)(void))shouldStop {
+    ManifestDiff *diff = [ManifestDiff new];
+    diff.unchanged = [NSMutableDictionary dictionary];
+    diff.renamed = [NSMutableDictionary dictionary];
+    diff.changed = [NSMutableArray array];
+    diff.deleted = [NSMutableArray array];
+    diff.complete = YES;
+
+    uint64_t now = clock_gettime_nsec_np(CLOCK_REALTIME);
+    NSMutableSet<NSString *> *seen = [NSMutableSet set];
+    // Added paths with their stat, resolved against deletions once the scan is done.
+    NSMutableDictionary<NSString *, NSData *> *added = [NSMutableDictionary dictionary];
+
+    NSDirectoryEnumerator *enumerator = [[NSFileManager defaultManager] enumeratorAtPath:root];
+    for (NSString *relative in enumerator) {
+        if (shouldStop && shouldStop()) {
+            diff.complete = NO;
+            break;
+        }
+        @autoreleasepool {
+            struct stat st;
+            NSString *path = [root stringByAppendingPathComponent:relative];
+            if (lstat(path.fileSystemRepresentation, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+            [seen addObject:relative];
+
+            NSDictionary *entry = manifest[relative];
+            if (!entry) {
+                added[relative] = [NSData dataWithBytes:&st length:sizeof(st)];
+                continue;
+            }
+            ManifestRecord old = recordFromEntry(entry), cur = recordFromStat(&st);
+            if (ManifestRecordUnchanged(&old, &cur, snapshotTime, now)) {
+                diff.unchanged[relative] = refreshedEntry(entry, &st);
+            } else {
+                [diff.changed addObject:relative];
+            }
+        }
+    }
+
+    // Old paths that disappeared, matched against the added ones for renames.
+    // An interrupted scan cannot tell deleted from unscanned, so it reports neither.
+    if (diff.complete) {
+        for (NSString *relative in manifest) {
+            if (![seen containsObject:relative]) [diff.deleted addObject:relative];
+        }
+    }
+    NSArray<NSString *> *addedPaths = added.allKeys;
+    NSMutableData *deletedRecords = [NSMutableData dataWithLength:diff.deleted.count * sizeof(ManifestRecord)];
+    NSMutableData *addedRecords = [NSMutableData dataWithLength:addedPaths.count * sizeof(ManifestRecord)];
+    NSMutableData *renamedFrom = [NSMutableData dataWithLength:addedPaths.count * sizeof(size_t)];
+    ManifestRecord *deletedRecord = deletedRecords.mutableBytes, *addedRecord = addedRecords.mutableBytes;
+    for (NSUInteger i = 0; i < diff.deleted.count; i++) deletedRecord[i] = recordFromEntry(manifest[diff.deleted[i]]);
+    for (NSUInteger i = 0; i < addedPaths.count; i++) addedRecord[i] = recordFromStat(added[addedPaths[i]].bytes);
+    size_t *from = renamedFrom.mutableBytes;
+    if (!ManifestMatchRenames(deletedRecord, diff.deleted.count, addedRecord, addedPaths.count, snapshotTime, now, from)) {
+        // Out of memory: every added file is rehashed, which is always safe.
+        for (NSUInteger i = 0; i < addedPaths.count; i++) from[i] = SIZE_MAX;
+    }
+    for (NSUInteger i = 0; i < addedPaths.count; i++) {
+        NSString *relative = addedPaths[i];
+        if (from[i] == SIZE_MAX) {
+            [diff.changed addObject:relative];
+            continue;
+        }
+        NSString *oldPath = diff.deleted[from[i]];
+        diff.unchanged[relative] = refreshedEntry(manifest[oldPath], added[relative].bytes);
+        diff.renamed[relative] = oldPath;
+    }
+    [diff.deleted removeObjectsInArray:diff.renamed.allValues];
+    return diff;
+}
+
+@end
@@ -0,0 +1,41 @@
+#ifndef MANIFEST_DIFF_CORE_H
+#define MANIFEST_DIFF_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The decisions behind ManifestDiff, plain C so bench/ can check them against
+// real files on any host. ManifestDiff walks the tree and keeps the paths;
+// this only sees size, mtime and inode.
+
+// mtimes this close to the snapshot (or ahead of the current clock) are not
+// trusted; such files are rehashed.
+#define kManifestRacyWindowNs (2ULL * 1000000000ULL)
+
+typedef struct {
+    uint64_t size;
+    uint64_t mtime; // ns since 1970
+    uint64_t ino;
+} ManifestRecord;
+
+// NO when the file may have been written during the scan that produced the
+// snapshot taken at snapshotTime, or its mtime is ahead of now (clock skew,
+// or a restored file).
+bool ManifestMTimeTrusted(uint64_t mtime, uint64_t snapshotTime, uint64_t now);
+
+// The previous entry still describes cur: same size and mtime, and that mtime
+// can be trusted.
+bool ManifestRecordUnchanged(const ManifestRecord *old, const ManifestRecord *cur, uint64_t snapshotTime,
+                             uint64_t now);
+
+// Pairs files that appeared under a new path with files that disappeared: a
+// rename keeps the inode, size and mtime, and the mtime must be trusted as on
+// the main path. Each deleted record is paired at most once, so of several hard
+// links showing up under new paths only one inherits the old entry.
+// renamedFrom[i] receives the index into deleted that added[i] was renamed
+// from, or SIZE_MAX. Returns false if it ran out of memory (nothing paired).
+bool ManifestMatchRenames(const ManifestRecord *deleted, size_t deletedCount, const ManifestRecord *added,
+                          size_t addedCount, uint64_t snapshotTime, uint64_t now, size_t *renamedFrom);
+
+#endif
@@ -0,0 +1,65 @@
+#include "ManifestDiffCore.h"
+
+#include <stdlib.h>
+
+// ---- Trust ----
+
+bool ManifestMTimeTrusted(uint64_t mtime, uint64_t snapshotTime, uint64_t now) {
+    return mtime + kManifestRacyWindowNs < snapshotTime && mtime <= now;
+}
+
+bool ManifestRecordUnchanged(const ManifestRecord *old, const ManifestRecord *cur, uint64_t snapshotTime,
+                             uint64_t now) {
+    return old->size == cur->size && old->mtime == cur->mtime && ManifestMTimeTrusted(cur->mtime, snapshotTime, now);
+}
+
+// ---- Renames ----
+
+typedef struct {
+    uint64_t ino;
+    size_t index;
+} InoIndex;
+
+static int compareInoIndex(const void *a, const void *b) {
+    const InoIndex *x = a, *y = b;
+    if (x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+    // Equal inodes keep manifest order, so the pairing does not depend on qsort.
+    return x->index < y->index ? -1 : x->index > y->index;
+}
+
+bool ManifestMatchRenames(const ManifestRecord *deleted, size_t deletedCount, const ManifestRecord *added,
+                          size_t addedCount, uint64_t snapshotTime, uint64_t now, size_t *renamedFrom) {
+    for (size_t i = 0; i < addedCount; i++) renamedFrom[i] = SIZE_MAX;
+    if (deletedCount == 0 || addedCount == 0) return true;
+
+    InoIndex *order = malloc(deletedCount * sizeof(InoIndex));
+    bool *used = calloc(deletedCount, sizeof(bool));
+    if (!order || !used) {
+        free(order);
+        free(used);
+        return false;
+    }
+    for (size_t i = 0; i < deletedCount; i++) order[i] = (InoIndex){ deleted[i].ino, i };
+    qsort(order, deletedCount, sizeof(InoIndex), compareInoIndex);
+
+    for (size_t a = 0; a < addedCount; a++) {
+        const ManifestRecord *cur = &added[a];
+        if (!ManifestMTimeTrusted(cur->mtime, snapshotTime, now)) continue;
+        size_t lo = 0, hi = deletedCount;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (order[mid].ino < cur->ino) lo = mid + 1;
+            else hi = mid;
+        }
+        for (size_t k = lo; k < deletedCount && order[k].ino == cur->ino; k++) {
+            size_t d = order[k].index;
+            if (used[d] || !ManifestRecordUnchanged(&deleted[d], cur, snapshotTime, now)) continue;
+            used[d] = true;
+            renamedFrom[a] = d;
+            break;
+        }
+    }
+    free(order);
+    free(used);
+    return true;
+}
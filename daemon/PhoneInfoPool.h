@@ -0,0 +1,28 @@
+#import <Foundation/Foundation.h>
+
+@class PhoneInfo;
+
+// PhoneInfo objects generated ahead of time against the current settings, so
+// newPhone does not run the DataGenManager pipeline inline. The pool is emptied
+// when the settings change (SettingManager posts kSettingChangedNotification)
+// and refilled in the background.
+//
+// ProjectXPhoneInfoPoolSize (default 3, 0 disables) sets how many are kept.
+// ProjectXPhoneInfoPoolPriority is "idle" (default: refill as idle work on the
+// job queue, giving way to jobs) or "eager" (refill on a utility-QoS queue of
+// its own, even while a job runs).
+@interface PhoneInfoPool : NSObject
+
++ (instancetype)sharedManager;
+
+// A pooled PhoneInfo with a fresh upTimeInfo, or nil if the pool is empty or
+// was generated for other settings. Schedules a refill either way.
+- (PhoneInfo *)takePhoneInfo;
+// Generates one inline; serialized with the background refill.
+- (PhoneInfo *)generatePhoneInfo;
+
+// Drops every pooled PhoneInfo; refills already running discard their result.
+- (void)invalidate;
+- (void)scheduleRefill;
+
+@end
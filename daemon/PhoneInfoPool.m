@@ -0,0 +1,153 @@
+#import "PhoneInfoPool.h"
+#import "SettingManager.h"
+#import "DataGenManager.h"
+#import "JobManager.h"
+#import "PhoneInfo.h"
+#import "PhoneInfoPoolCore.h"
+#import "ProjectXLogging.h"
+
+static const NSInteger kDefaultPoolSize = 3;
+static const NSInteger kMaxPoolSize = 16;
+
+// Pooled entries are PhoneInfo retained with CFBridgingRetain.
+static void releaseEntry(void *entry) {
+    CFRelease(entry);
+}
+
+@interface PhoneInfoPool () {
+    // Under @synchronized (self).
+    PhoneInfoPoolState _state;
+}
+@property (nonatomic, strong) dispatch_queue_t eagerQueue;
+// SettingManager and DataGenManager keep state in shared instances, so
+// generation never runs on two threads at once.
+@property (nonatomic, strong) NSLock *generateLock;
+@end
+
+static void settingChanged(CFNotificationCenterRef center, void *observer, CFStringRef name,
+                           const void *object, CFDictionaryRef userInfo) {
+    PhoneInfoPool *pool = [PhoneInfoPool sharedManager];
+    [pool invalidate];
+    [pool scheduleRefill];
+}
+
+@implementation PhoneInfoPool
+
++ (instancetype)sharedManager {
+    static PhoneInfoPool *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _generateLock = [NSLock new];
+        _eagerQueue = dispatch_queue_create("com.projectx.phoneinfopool",
+                                            dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+        CFNotificationCenterAddObserver(CFNotificationCenterGetDarwinNotifyCenter(), NULL, settingChanged,
+                                        kSettingChangedNotification, NULL, CFNotificationSuspensionBehaviorDeliverImmediately);
+    }
+    return self;
+}
+
+- (NSUInteger)targetSize {
+    NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+    if (![defaults objectForKey:@"ProjectXPhoneInfoPoolSize"]) return kDefaultPoolSize;
+    return (NSUInteger)MAX(0, MIN([defaults integerForKey:@"ProjectXPhoneInfoPoolSize"], kMaxPoolSize));
+}
+
+- (BOOL)isEager {
+    return [[[NSUserDefaults standardUserDefaults] stringForKey:@"ProjectXPhoneInfoPoolPriority"] isEqualToString:@"eager"];
+}
+
+// Generated values depend on these settings; pooled entries are only handed
+// out while they are unchanged. Read from the saved preferences rather than
+// the shared SettingManager, so taking never waits for a generation to finish.
+- (NSString *)settingsFingerprint {
+    NSDictionary<NSString *, NSString *> *settings = [SettingManager savedSettings];
+    return [NSString stringWithFormat:@"%@|%@|%@", settings[@"carrierCountryCode"], settings[@"minVersion"],
+                                      settings[@"maxVersion"]];
+}
+
+- (PhoneInfo *)generatePhoneInfo {
+    [_generateLock lock];
+    PhoneInfo *phoneInfo = [[DataGenManager sharedManager] generatePhoneInfo];
+    [_generateLock unlock];
+    return phoneInfo;
+}
+
+- (PhoneInfo *)takePhoneInfo {
+    NSString *fingerprint = [self settingsFingerprint];
+    void *entry;
+    @synchronized (self) {
+        entry = PhoneInfoPoolTake(&_state, fingerprint.UTF8String, releaseEntry);
+    }
+    [self scheduleRefill];
+    if (!entry) return nil;
+    PhoneInfo *phoneInfo = CFBridgingRelease(entry);
+    // 开机时间相对于当前时间，必须在使用时重新生成
+    phoneInfo.upTimeInfo = [[DataGenManager sharedManager] generateUpTimeInfo];
+    return phoneInfo;
+}
+
+- (void)invalidate {
+    @synchronized (self) {
+        size_t dropped = PhoneInfoPoolInvalidate(&_state, releaseEntry);
+        if (dropped > 0) PXLog(@"[PhoneInfoPool] Settings changed; dropping %zu pooled PhoneInfo", dropped);
+    }
+}
+
+- (void)scheduleRefill {
+    BOOL eager = [self isEager];
+    NSUInteger target = [self targetSize];
+    @synchronized (self) {
+        if (!PhoneInfoPoolClaimRefill(&_state, target)) return;
+    }
+    if (eager) {
+        dispatch_async(_eagerQueue, ^{
+            @autoreleasepool {
+                [self refillYieldingToJobs:NO];
+            }
+        });
+    } else {
+        [[JobManager sharedManager] runWhenIdle:^{
+            [self refillYieldingToJobs:YES];
+        }];
+    }
+}
+
+- (void)refillYieldingToJobs:(BOOL)yield {
+    NSUInteger added = 0, pooled = 0;
+    NSUInteger target = [self targetSize];
+    for (;;) {
+        uint64_t generation;
+        BOOL pending = yield && [[JobManager sharedManager] hasPendingJobs];
+        @synchronized (self) {
+            if (!PhoneInfoPoolRefillNext(&_state, target, pending, &generation)) {
+                pooled = _state.count;
+                break;
+            }
+        }
+        [_generateLock lock];
+        NSString *fingerprint = [self settingsFingerprint];
+        PhoneInfo *phoneInfo = [[DataGenManager sharedManager] generatePhoneInfo];
+        [_generateLock unlock];
+        @synchronized (self) {
+            void *entry = phoneInfo ? (void *)CFBridgingRetain(phoneInfo) : NULL;
+            PhoneInfoPoolOfferResult result = PhoneInfoPoolOffer(&_state, generation, fingerprint.UTF8String, entry,
+                                                                 releaseEntry);
+            if (result == PhoneInfoPoolFailed) {
+                pooled = _state.count;
+                break;
+            }
+            if (result != PhoneInfoPoolStale) added++;
+        }
+    }
+    if (added > 0) PXLog(@"[PhoneInfoPool] Pre-generated %lu PhoneInfo, %lu pooled", (unsigned long)added, (unsigned long)pooled);
+}
+
+@end
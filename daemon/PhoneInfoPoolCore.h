@@ -0,0 +1,61 @@
+#ifndef PHONE_INFO_POOL_CORE_H
+#define PHONE_INFO_POOL_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// PhoneInfoPool's bookkeeping, plain C so bench/ can race it against
+// invalidations and time it on any host. PhoneInfoPool generates the entries
+// and holds a PhoneInfoPoolState under its lock; nothing here locks.
+//
+// A refill reads the generation (PhoneInfoPoolRefillNext), then the settings
+// fingerprint and generates without the lock, then offers the result
+// (PhoneInfoPoolOffer). An invalidation in between bumps the generation and
+// the entry is dropped; settings that changed without one show up as a
+// fingerprint that differs from the pool's.
+
+// Entries are opaque; the pool owns those it holds and gives them back
+// through this when it drops them.
+typedef void (*PhoneInfoPoolRelease)(void *entry);
+
+typedef struct {
+    void **entries; // oldest first
+    size_t count;
+    size_t capacity;
+    char *settings; // fingerprint the entries were generated for, NULL while unknown
+    uint64_t generation;
+    bool refillScheduled;
+} PhoneInfoPoolState;
+
+// The oldest entry, now the caller's, or NULL if the pool is empty. Entries
+// generated for settings other than fingerprint are all dropped first.
+void *PhoneInfoPoolTake(PhoneInfoPoolState *pool, const char *fingerprint, PhoneInfoPoolRelease release);
+// Drops every entry and forgets the settings; refills under the old
+// generation discard their result. Returns how many were dropped.
+size_t PhoneInfoPoolInvalidate(PhoneInfoPoolState *pool, PhoneInfoPoolRelease release);
+
+// Whether the caller should start a refill: false while one is scheduled or
+// the pool already holds target entries.
+bool PhoneInfoPoolClaimRefill(PhoneInfoPoolState *pool, size_t target);
+// Whether a claimed refill generates another entry, with the generation to
+// offer it under. false (full, or yield for pending jobs) ends the refill and
+// clears the claim in the same step, so an invalidation right after it can
+// claim a new one.
+bool PhoneInfoPoolRefillNext(PhoneInfoPoolState *pool, size_t target, bool yield, uint64_t *generation);
+
+typedef enum {
+    PhoneInfoPoolAdded,
+    PhoneInfoPoolRestarted, // added after dropping entries for other settings
+    PhoneInfoPoolStale,     // invalidated while generating; entry released
+    PhoneInfoPoolFailed,    // no entry, or no memory for it; the refill ends
+} PhoneInfoPoolOfferResult;
+
+// Offers an entry generated for fingerprint under generation; the pool takes
+// ownership either way.
+PhoneInfoPoolOfferResult PhoneInfoPoolOffer(PhoneInfoPoolState *pool, uint64_t generation, const char *fingerprint,
+                                            void *entry, PhoneInfoPoolRelease release);
+
+void PhoneInfoPoolFree(PhoneInfoPoolState *pool, PhoneInfoPoolRelease release);
+
+#endif
@@ -0,0 +1,93 @@
+#include "PhoneInfoPoolCore.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// ---- Entries ----
+
+static void dropEntries(PhoneInfoPoolState *pool, PhoneInfoPoolRelease release) {
+    for (size_t i = 0; i < pool->count; i++) release(pool->entries[i]);
+    pool->count = 0;
+}
+
+void *PhoneInfoPoolTake(PhoneInfoPoolState *pool, const char *fingerprint, PhoneInfoPoolRelease release) {
+    if (pool->settings && (!fingerprint || strcmp(pool->settings, fingerprint) != 0)) {
+        // Settings changed without an invalidation reaching the pool.
+        PhoneInfoPoolInvalidate(pool, release);
+        return NULL;
+    }
+    if (pool->count == 0) return NULL;
+    void *entry = pool->entries[0];
+    pool->count--;
+    memmove(pool->entries, pool->entries + 1, pool->count * sizeof(void *));
+    return entry;
+}
+
+size_t PhoneInfoPoolInvalidate(PhoneInfoPoolState *pool, PhoneInfoPoolRelease release) {
+    size_t dropped = pool->count;
+    pool->generation++;
+    dropEntries(pool, release);
+    free(pool->settings);
+    pool->settings = NULL;
+    return dropped;
+}
+
+void PhoneInfoPoolFree(PhoneInfoPoolState *pool, PhoneInfoPoolRelease release) {
+    dropEntries(pool, release);
+    free(pool->entries);
+    free(pool->settings);
+    memset(pool, 0, sizeof(*pool));
+}
+
+// ---- Refill ----
+
+bool PhoneInfoPoolClaimRefill(PhoneInfoPoolState *pool, size_t target) {
+    if (pool->refillScheduled || pool->count >= target) return false;
+    pool->refillScheduled = true;
+    return true;
+}
+
+bool PhoneInfoPoolRefillNext(PhoneInfoPoolState *pool, size_t target, bool yield, uint64_t *generation) {
+    if (pool->count >= target || yield) {
+        pool->refillScheduled = false;
+        return false;
+    }
+    *generation = pool->generation;
+    return true;
+}
+
+PhoneInfoPoolOfferResult PhoneInfoPoolOffer(PhoneInfoPoolState *pool, uint64_t generation, const char *fingerprint,
+                                            void *entry, PhoneInfoPoolRelease release) {
+    if (!entry || !fingerprint) {
+        if (entry) release(entry);
+        pool->refillScheduled = false;
+        return PhoneInfoPoolFailed;
+    }
+    // The fingerprint may have been read before the invalidation landed.
+    if (pool->generation != generation) {
+        release(entry);
+        return PhoneInfoPoolStale;
+    }
+    PhoneInfoPoolOfferResult result = PhoneInfoPoolAdded;
+    if (pool->settings && strcmp(pool->settings, fingerprint) != 0) {
+        // The entry matches settings read after the pooled ones were made.
+        PhoneInfoPoolInvalidate(pool, release);
+        result = PhoneInfoPoolRestarted;
+    }
+    if (!pool->settings) pool->settings = strdup(fingerprint);
+    if (pool->count == pool->capacity) {
+        size_t capacity = pool->capacity ? pool->capacity * 2 : 4;
+        void **entries = realloc(pool->entries, capacity * sizeof(void *));
+        if (entries) {
+            pool->entries = entries;
+            pool->capacity = capacity;
+        }
+    }
+    if (!pool->settings || pool->count == pool->capacity) {
+        release(entry);
+        pool->refillScheduled = false;
+        return PhoneInfoPoolFailed;
+    }
+    pool->entries[pool->count++] = entry;
+    return result;
+}
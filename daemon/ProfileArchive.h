@@ -0,0 +1,51 @@
+#import <Foundation/Foundation.h>
+
+// Single-file compressed archive of a profile tree (".pxar"):
+//
+//   "PXARCH1\0"
+//   file data     every regular file compressed on its own (LZFSE)
+//   directory     binary plist array of entries, parents before children
+//   trailer       u64 directory offset, u64 directory length (LE), "PXAREND\0"
+//
+// Because files are compressed independently, any subset can be extracted, in
+// parallel, and listing or reading one file only touches the directory and that
+// file's bytes. The walking, packing and extracting is plain C in
+// ProfileArchiveCore; this file owns the directory's plist encoding.
+
+// Directory entry keys. mode/uid/gid/mtime(ns) are always present.
+#define kArchivePath   @"path"   // relative to the archived root, "." for the root
+#define kArchiveType   @"type"   // kArchiveTypeDir/File/Link/HardLink
+#define kArchiveMode   @"mode"
+#define kArchiveUid    @"uid"
+#define kArchiveGid    @"gid"
+#define kArchiveMTime  @"mtime"
+#define kArchiveSize   @"size"   // files: uncompressed length
+#define kArchiveOffset @"offset" // files: start of the compressed data
+#define kArchiveCSize  @"csize"  // files: compressed length, 0 for empty files
+#define kArchiveTarget @"target" // symlinks: link text; hard links: first path
+#define kArchiveXattrs @"xattrs" // optional name -> data
+#define kArchiveFlags  @"flags"  // optional st_flags, reapplied with chflags
+#define kArchiveProtectionClass @"protection" // optional data-protection class of files and directories
+
+#define kArchiveTypeDir      @"dir"
+#define kArchiveTypeFile     @"file"
+#define kArchiveTypeLink     @"link"
+#define kArchiveTypeHardLink @"hardlink"
+
+// Packs root into archivePath. The archive is written next to its final name and
+// renamed into place, so archivePath is either complete or absent. shouldStop
+// (may be nil) abandons the archive with ECANCELED.
+BOOL writeProfileArchive(NSString *root, NSString *archivePath, BOOL (^shouldStop)(void), NSError **error);
+
+// Only the directory; no file data is read.
+NSArray<NSDictionary *> *readArchiveDirectory(NSString *archivePath, NSError **error);
+
+// Recreates the tree at dst (which must not exist) with modes, owners, times,
+// xattrs, protection classes and flags, decompressing files on up to
+// `parallelism` workers. On failure dst may hold a partial tree for the caller
+// to remove.
+BOOL extractProfileArchive(NSString *archivePath, NSString *dst, NSUInteger parallelism,
+                           BOOL (^shouldStop)(void), NSError **error);
+
+// Contents of a single regular file, without extracting anything else.
+NSData *readArchiveEntry(NSString *archivePath, NSString *relativePath, NSError **error);
@@ -0,0 +1,315 @@
+#import "ProfileArchive.h"
+#import "ProjectXLogging.h"
+#include "ProfileArchiveCore.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+static NSError *posixError(int err, NSString *path) {
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:err
+                           userInfo:path ? @{ NSFilePathErrorKey: path } : nil];
+}
+
+static bool callShouldStop(void *context) {
+    return ((__bridge BOOL (^)(void))context)();
+}
+
+#pragma mark - Directory encoding
+
+static NSString *const kTypeNames[] = {
+    [PXArchiveEntryDir] = kArchiveTypeDir,
+    [PXArchiveEntryFile] = kArchiveTypeFile,
+    [PXArchiveEntryLink] = kArchiveTypeLink,
+    [PXArchiveEntryHardLink] = kArchiveTypeHardLink,
+};
+
+static NSDictionary *dictionaryFromEntry(const PXArchiveEntry *entry) {
+    NSMutableDictionary *record = [@{
+        kArchivePath: @(entry->path),
+        kArchiveType: kTypeNames[entry->type],
+        kArchiveMode: @(entry->mode),
+        kArchiveUid: @(entry->uid),
+        kArchiveGid: @(entry->gid),
+        kArchiveMTime: @(entry->mtime)
+    } mutableCopy];
+    if (entry->type == PXArchiveEntryFile) {
+        record[kArchiveSize] = @(entry->size);
+        record[kArchiveOffset] = @(entry->offset);
+        record[kArchiveCSize] = @(entry->csize);
+    }
+    if (entry->target) record[kArchiveTarget] = @(entry->target);
+    if (entry->flags) record[kArchiveFlags] = @(entry->flags);
+    if (entry->protectionClass != kPXArchiveNoProtectionClass) record[kArchiveProtectionClass] = @(entry->protectionClass);
+    if (entry->xattrCount) {
+        NSMutableDictionary<NSString *, NSData *> *xattrs = [NSMutableDictionary dictionaryWithCapacity:entry->xattrCount];
+        for (size_t i = 0; i < entry->xattrCount; i++) {
+            NSString *name = @(entry->xattrs[i].name);
+            if (name) xattrs[name] = [NSData dataWithBytes:entry->xattrs[i].value length:entry->xattrs[i].length];
+        }
+        record[kArchiveXattrs] = xattrs;
+    }
+    return record;
+}
+
+static char *copyString(id value) {
+    if (![value isKindOfClass:[NSString class]]) return NULL;
+    const char *string = [value fileSystemRepresentation];
+    return string ? strdup(string) : NULL;
+}
+
+// NO for entries that are not well formed; entry is then partly filled and
+// still freed by PXArchiveEntriesFree.
+static BOOL entryFromDictionary(NSDictionary *record, PXArchiveEntry *entry) {
+    *entry = (PXArchiveEntry){ .protectionClass = kPXArchiveNoProtectionClass };
+    if (![record isKindOfClass:[NSDictionary class]]) return NO;
+    NSString *type = record[kArchiveType];
+    if ([type isEqual:kArchiveTypeDir]) entry->type = PXArchiveEntryDir;
+    else if ([type isEqual:kArchiveTypeFile]) entry->type = PXArchiveEntryFile;
+    else if ([type isEqual:kArchiveTypeLink]) entry->type = PXArchiveEntryLink;
+    else if ([type isEqual:kArchiveTypeHardLink]) entry->type = PXArchiveEntryHardLink;
+    else return NO;
+    entry->path = copyString(record[kArchivePath]);
+    entry->mode = [record[kArchiveMode] unsignedIntValue];
+    entry->uid = [record[kArchiveUid] unsignedIntValue];
+    entry->gid = [record[kArchiveGid] unsignedIntValue];
+    entry->mtime = [record[kArchiveMTime] unsignedLongLongValue];
+    entry->size = [record[kArchiveSize] unsignedLongLongValue];
+    entry->offset = [record[kArchiveOffset] unsignedLongLongValue];
+    entry->csize = [record[kArchiveCSize] unsignedLongLongValue];
+    entry->flags = [record[kArchiveFlags] unsignedIntValue];
+    if (record[kArchiveProtectionClass]) entry->protectionClass = [record[kArchiveProtectionClass] intValue];
+    if (record[kArchiveTarget]) {
+        entry->target = copyString(record[kArchiveTarget]);
+        if (!entry->target) return NO;
+    }
+    NSDictionary *xattrs = record[kArchiveXattrs];
+    if ([xattrs isKindOfClass:[NSDictionary class]] && xattrs.count) {
+        entry->xattrs = calloc(xattrs.count, sizeof(PXArchiveXattr));
+        if (!entry->xattrs) return NO;
+        for (NSString *name in xattrs) {
+            NSData *value = xattrs[name];
+            if (![name isKindOfClass:[NSString class]] || ![value isKindOfClass:[NSData class]]) continue;
+            PXArchiveXattr *xattr = &entry->xattrs[entry->xattrCount++];
+            xattr->name = strdup(name.UTF8String);
+            xattr->value = malloc(value.length ?: 1);
+            xattr->length = value.length;
+            if (!xattr->name || !xattr->value) return NO;
+            memcpy(xattr->value, value.bytes, value.length);
+        }
+    }
+    return entry->path != NULL;
+}
+
+// The whole directory as entries, or NULL if any entry is malformed.
+static PXArchiveEntry *entriesFromDirectory(NSArray<NSDictionary *> *directory, size_t *count) {
+    PXArchiveEntry *entries = calloc(directory.count ?: 1, sizeof(PXArchiveEntry));
+    if (!entries) return NULL;
+    for (NSDictionary *record in directory) {
+        if (!entryFromDictionary(record, &entries[*count])) {
+            PXArchiveEntriesFree(entries, *count + 1);
+            *count = 0;
+            return NULL;
+        }
+        (*count)++;
+    }
+    return entries;
+}
+
+#pragma mark - Writing
+
+BOOL writeProfileArchive(NSString *root, NSString *archivePath, BOOL (^shouldStop)(void), NSError **error) {
+    NSString *partial = [archivePath stringByAppendingString:@".partial"];
+    unlink(partial.fileSystemRepresentation);
+    int out = open(partial.fileSystemRepresentation, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (out < 0) {
+        if (error) *error = posixError(errno, partial);
+        return NO;
+    }
+    PXArchiveEntry *entries = NULL;
+    size_t count = 0;
+    uint64_t directoryOffset = 0;
+    char *failed = NULL;
+    int err = PXArchiveWriteData(root.fileSystemRepresentation, out, shouldStop ? callShouldStop : NULL,
+                                 (__bridge void *)shouldStop, &entries, &count, &directoryOffset, &failed);
+    NSString *failedPath = failed ? @(failed) : root;
+    free(failed);
+
+    if (!err) {
+        NSMutableArray<NSDictionary *> *directory = [NSMutableArray arrayWithCapacity:count];
+        for (size_t i = 0; i < count; i++) {
+            @autoreleasepool {
+                [directory addObject:dictionaryFromEntry(&entries[i])];
+            }
+        }
+        PXArchiveEntriesFree(entries, count);
+        NSData *plist = [NSPropertyListSerialization dataWithPropertyList:directory
+                                                                   format:NSPropertyListBinaryFormat_v1_0
+                                                                  options:0 error:nil];
+        err = plist ? PXArchiveWriteTrailer(out, directoryOffset, plist.bytes, plist.length) : EINVAL;
+        failedPath = partial;
+    }
+    close(out);
+    if (!err && rename(partial.fileSystemRepresentation, archivePath.fileSystemRepresentation) != 0) {
+        err = errno;
+        failedPath = archivePath;
+    }
+    if (err) {
+        unlink(partial.fileSystemRepresentation);
+        if (error) *error = posixError(err, failedPath);
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark - Reading
+
+static NSArray<NSDictionary *> *loadDirectory(int fd, NSString *archivePath, NSError **error) {
+    void *bytes = NULL;
+    size_t length = 0;
+    int err = PXArchiveReadDirectory(fd, &bytes, &length);
+    if (err) {
+        if (error) *error = posixError(err, archivePath);
+        return nil;
+    }
+    NSData *plist = [NSData dataWithBytesNoCopy:bytes length:length freeWhenDone:YES];
+    NSArray *directory = [NSPropertyListSerialization propertyListWithData:plist options:0 format:NULL error:nil];
+    if (![directory isKindOfClass:[NSArray class]]) {
+        if (error) *error = posixError(EFTYPE, archivePath);
+        return nil;
+    }
+    return directory;
+}
+
+NSArray<NSDictionary *> *readArchiveDirectory(NSString *archivePath, NSError **error) {
+    int fd = open(archivePath.fileSystemRepresentation, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (error) *error = posixError(errno, archivePath);
+        return nil;
+    }
+    NSArray *directory = loadDirectory(fd, archivePath, error);
+    close(fd);
+    return directory;
+}
+
+static NSString *entryPath(NSString *dst, const PXArchiveEntry *entry) {
+    return strcmp(entry->path, ".") == 0 ? dst : [dst stringByAppendingPathComponent:@(entry->path)];
+}
+
+BOOL extractProfileArchive(NSString *archivePath, NSString *dst, NSUInteger parallelism,
+                           BOOL (^shouldStop)(void), NSError **error) {
+    int fd = open(archivePath.fileSystemRepresentation, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (error) *error = posixError(errno, archivePath);
+        return NO;
+    }
+    fcntl(fd, F_NOCACHE, 1);
+    NSArray<NSDictionary *> *directory = loadDirectory(fd, archivePath, error);
+    size_t count = 0;
+    PXArchiveEntry *entries = directory ? entriesFromDirectory(directory, &count) : NULL;
+    if (!entries) {
+        close(fd);
+        if (directory && error) *error = posixError(EFTYPE, archivePath);
+        return NO;
+    }
+    const char *root = dst.fileSystemRepresentation;
+
+    // Directories first (parents precede children), writable until the end.
+    size_t failedIndex = count;
+    int err = PXArchiveExtractDirectories(root, entries, count, &failedIndex);
+
+    // Files are striped over the workers, each with its own stream buffers.
+    if (!err) {
+        size_t files = 0;
+        for (size_t i = 0; i < count; i++) files += entries[i].type == PXArchiveEntryFile;
+        size_t workers = MAX((size_t)1, MIN((size_t)parallelism, files));
+        // dispatch_apply is synchronous, so the workers can share these through pointers.
+        _Atomic(int) failureStorage = 0;
+        _Atomic(int) *failure = &failureStorage;
+        __block size_t failedFile = count;
+        dispatch_apply(workers, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^(size_t worker) {
+            uint8_t *src = malloc(kPXArchiveStreamBufferSize);
+            uint8_t *out = malloc(kPXArchiveStreamBufferSize);
+            size_t failedAt = count;
+            int workerErr = src && out
+                ? PXArchiveExtractFiles(fd, root, entries, count, worker, workers, src, out,
+                                        shouldStop ? callShouldStop : NULL, (__bridge void *)shouldStop, &failedAt)
+                : ENOMEM;
+            int expected = 0;
+            if (workerErr && atomic_compare_exchange_strong(failure, &expected, workerErr)) failedFile = failedAt;
+            free(src);
+            free(out);
+        });
+        err = atomic_load(failure);
+        failedIndex = failedFile;
+    }
+    close(fd);
+
+    // Links once their targets exist, then file flags and directory metadata.
+    if (!err) {
+        size_t metadataFailures = 0;
+        err = PXArchiveExtractLinks(root, entries, count, &failedIndex, &metadataFailures);
+        if (metadataFailures) {
+            PXLog(@"[ProfileArchive] Could not restore metadata of %zu entries under %@", metadataFailures, dst);
+        }
+    }
+    if (err && error) *error = posixError(err, failedIndex < count ? entryPath(dst, &entries[failedIndex]) : dst);
+    PXArchiveEntriesFree(entries, count);
+    return err == 0;
+}
+
+static bool appendSink(const uint8_t *bytes, size_t length, void *context) {
+    [(__bridge NSMutableData *)context appendBytes:bytes length:length];
+    return true;
+}
+
+NSData *readArchiveEntry(NSString *archivePath, NSString *relativePath, NSError **error) {
+    int fd = open(archivePath.fileSystemRepresentation, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (error) *error = posixError(errno, archivePath);
+        return nil;
+    }
+    NSArray<NSDictionary *> *directory = loadDirectory(fd, archivePath, error);
+    NSDictionary *found = nil;
+    for (NSDictionary *entry in directory) {
+        if ([entry isKindOfClass:[NSDictionary class]] && [entry[kArchivePath] isEqual:relativePath]) {
+            found = entry;
+            break;
+        }
+    }
+    // A hard link reads through to the entry holding the data.
+    if ([found[kArchiveType] isEqualToString:kArchiveTypeHardLink]) {
+        NSString *target = found[kArchiveTarget];
+        found = nil;
+        for (NSDictionary *entry in directory) {
+            if ([entry isKindOfClass:[NSDictionary class]] && [entry[kArchivePath] isEqual:target]) {
+                found = entry;
+                break;
+            }
+        }
+    }
+    PXArchiveEntry *entry = calloc(1, sizeof(PXArchiveEntry));
+    BOOL parsed = entry && [found[kArchiveType] isEqualToString:kArchiveTypeFile] && entryFromDictionary(found, entry);
+    if (!parsed) {
+        PXArchiveEntriesFree(entry, entry ? 1 : 0);
+        close(fd);
+        if (directory && error) *error = posixError(ENOENT, relativePath);
+        return nil;
+    }
+
+    NSMutableData *data = [NSMutableData dataWithCapacity:(NSUInteger)entry->size];
+    uint8_t *src = malloc(kPXArchiveStreamBufferSize);
+    uint8_t *dst = malloc(kPXArchiveStreamBufferSize);
+    BOOL ok = src && dst && PXArchiveDecompress(fd, entry, src, dst, appendSink, (__bridge void *)data);
+    ok = ok && data.length == entry->size;
+    free(src);
+    free(dst);
+    close(fd);
+    PXArchiveEntriesFree(entry, 1);
+    if (!ok) {
+        if (error) *error = posixError(EIO, relativePath);
+        return nil;
+    }
+    return data;
+}
@@ -0,0 +1,92 @@
+#ifndef PROFILE_ARCHIVE_CORE_H
+#define PROFILE_ARCHIVE_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// The POSIX and libcompression half of ProfileArchive: walking and packing the
+// tree, decompressing entries and recreating files, links and metadata. The
+// directory's encoding (a binary plist) stays in ProfileArchive.m; here it is
+// an array of PXArchiveEntry. Plain C so bench/ can round-trip it on any host.
+//
+// Functions returning int give 0 or an errno value.
+
+#define kPXArchiveStreamBufferSize (1 << 20)
+#define kPXArchiveHeaderSize 8
+#define kPXArchiveTrailerSize 24
+
+// Recorded where the platform has no data protection (or the entry is a link).
+#define kPXArchiveNoProtectionClass (-1)
+
+typedef enum {
+    PXArchiveEntryDir,
+    PXArchiveEntryFile,
+    PXArchiveEntryLink,
+    PXArchiveEntryHardLink,
+} PXArchiveEntryType;
+
+typedef struct {
+    char *name;
+    uint8_t *value;
+    size_t length;
+} PXArchiveXattr;
+
+typedef struct {
+    char *path; // relative to the archived root, "." for the root
+    PXArchiveEntryType type;
+    uint32_t mode; // permission bits only
+    uint32_t uid;
+    uint32_t gid;
+    uint64_t mtime; // ns
+    uint64_t size; // files: uncompressed length
+    uint64_t offset; // files: start of the compressed data
+    uint64_t csize; // files: compressed length, 0 for empty files
+    char *target; // symlinks: link text; hard links: first path
+    uint32_t flags; // st_flags (chflags), 0 where the platform has none
+    int32_t protectionClass; // F_GETPROTECTIONCLASS of files and directories
+    PXArchiveXattr *xattrs;
+    size_t xattrCount;
+} PXArchiveEntry;
+
+void PXArchiveEntriesFree(PXArchiveEntry *entries, size_t count);
+
+// Archive paths come from disk; never let one escape the destination.
+bool PXArchiveIsSafeRelativePath(const char *path);
+
+// Writes the header and every regular file's compressed data to out and
+// returns the entries, parents before children, with *dataEnd the offset the
+// directory goes at. shouldStop (may be NULL) is polled per entry and abandons
+// the walk with ECANCELED. On failure *failedPath (may be NULL) gets a
+// malloc'd path relative to root.
+int PXArchiveWriteData(const char *root, int out, bool (*shouldStop)(void *context), void *context,
+                       PXArchiveEntry **entries, size_t *count, uint64_t *dataEnd, char **failedPath);
+// Appends the encoded directory and the trailer, then fsyncs.
+int PXArchiveWriteTrailer(int out, uint64_t directoryOffset, const void *directory, size_t length);
+// Checks both magics and the trailer; *directory is malloc'd.
+int PXArchiveReadDirectory(int fd, void **directory, size_t *length);
+
+// Decompresses a file entry's data into sink, which returns false to abort.
+bool PXArchiveDecompress(int archiveFd, const PXArchiveEntry *entry, uint8_t *src, uint8_t *dst,
+                         bool (*sink)(const uint8_t *bytes, size_t length, void *context), void *context);
+
+// Extraction in three phases so the middle one can run on several workers:
+// directories (created writable, protection class set so files inherit it),
+// then files, then links and the remaining metadata, directories deepest first.
+// dst must not exist. *failedIndex is the entry that failed, or count.
+int PXArchiveExtractDirectories(const char *dst, const PXArchiveEntry *entries, size_t count, size_t *failedIndex);
+// Files whose index among the file entries is worker modulo workers, using the
+// worker's own buffers (kPXArchiveStreamBufferSize each).
+int PXArchiveExtractFiles(int archiveFd, const char *dst, const PXArchiveEntry *entries, size_t count,
+                          size_t worker, size_t workers, uint8_t *src, uint8_t *buffer,
+                          bool (*shouldStop)(void *context), void *context, size_t *failedIndex);
+// Directory metadata failures are only reported through *metadataFailures.
+int PXArchiveExtractLinks(const char *dst, const PXArchiveEntry *entries, size_t count, size_t *failedIndex,
+                          size_t *metadataFailures);
+
+// xattrs, owner, mode, times and flags of an extracted entry; the protection
+// class is set when files and directories are created.
+bool PXArchiveApplyMetadata(const char *path, const PXArchiveEntry *entry);
+
+#endif
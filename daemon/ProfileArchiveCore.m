@@ -0,0 +1,651 @@
+#include "ProfileArchiveCore.h"
+#include <compression.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fts.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/xattr.h>
+#include <unistd.h>
+
+static const char kHeaderMagic[kPXArchiveHeaderSize] = "PXARCH1";
+static const char kTrailerMagic[8] = "PXAREND";
+static const uint64_t kNanosecondsPerSecond = 1000000000ULL;
+
+#ifndef EFTYPE
+#define EFTYPE EINVAL
+#endif
+
+// ---- Platform ----
+
+#ifdef __APPLE__
+#define MTIME(st) ((st)->st_mtimespec)
+#define HAVE_FILE_FLAGS 1
+static ssize_t listXattrs(const char *path, char *names, size_t size) {
+    return listxattr(path, names, size, XATTR_NOFOLLOW);
+}
+static ssize_t getXattr(const char *path, const char *name, void *value, size_t size) {
+    return getxattr(path, name, value, size, 0, XATTR_NOFOLLOW);
+}
+static int setXattr(const char *path, const char *name, const void *value, size_t size) {
+    return setxattr(path, name, value, size, 0, XATTR_NOFOLLOW);
+}
+#else
+#define MTIME(st) ((st)->st_mtim)
+#define HAVE_FILE_FLAGS 0
+static ssize_t listXattrs(const char *path, char *names, size_t size) {
+    return llistxattr(path, names, size);
+}
+static ssize_t getXattr(const char *path, const char *name, void *value, size_t size) {
+    return lgetxattr(path, name, value, size);
+}
+static int setXattr(const char *path, const char *name, const void *value, size_t size) {
+    return lsetxattr(path, name, value, size, 0);
+}
+#endif
+
+static void noCache(int fd) {
+#ifdef F_NOCACHE
+    fcntl(fd, F_NOCACHE, 1);
+#else
+    (void)fd;
+#endif
+}
+
+static int32_t protectionClassOf(int fd) {
+#ifdef F_GETPROTECTIONCLASS
+    int value = fcntl(fd, F_GETPROTECTIONCLASS);
+    return value < 0 ? kPXArchiveNoProtectionClass : value;
+#else
+    (void)fd;
+    return kPXArchiveNoProtectionClass;
+#endif
+}
+
+static bool setProtectionClass(int fd, int32_t value) {
+#ifdef F_SETPROTECTIONCLASS
+    return value == kPXArchiveNoProtectionClass || fcntl(fd, F_SETPROTECTIONCLASS, value) == 0;
+#else
+    (void)fd;
+    (void)value;
+    return true;
+#endif
+}
+
+static uint32_t flagsOf(const struct stat *st) {
+#if HAVE_FILE_FLAGS
+    return st->st_flags;
+#else
+    (void)st;
+    return 0;
+#endif
+}
+
+static bool applyFlags(const char *path, const PXArchiveEntry *entry) {
+#if HAVE_FILE_FLAGS
+    // Compression is a property of how the data was written, not something to assert.
+    uint32_t flags = entry->flags & ~(uint32_t)UF_COMPRESSED;
+    return flags == 0 || lchflags(path, flags) == 0;
+#else
+    (void)path;
+    (void)entry;
+    return true;
+#endif
+}
+
+// ---- Helpers ----
+
+static bool writeAll(int fd, const void *bytes, size_t length) {
+    const uint8_t *p = bytes;
+    while (length > 0) {
+        ssize_t n = write(fd, p, length);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static void putLE64(uint8_t *out, uint64_t value) {
+    for (int i = 0; i < 8; i++) out[i] = (uint8_t)(value >> (8 * i));
+}
+
+static uint64_t getLE64(const uint8_t *in) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) value = value << 8 | in[i];
+    return value;
+}
+
+static char *joinPath(const char *dst, const char *relative) {
+    if (strcmp(relative, ".") == 0) return strdup(dst);
+    size_t dstLength = strlen(dst), length = strlen(relative);
+    char *path = malloc(dstLength + 1 + length + 1);
+    if (!path) return NULL;
+    memcpy(path, dst, dstLength);
+    path[dstLength] = '/';
+    memcpy(path + dstLength + 1, relative, length + 1);
+    return path;
+}
+
+static void freeEntry(PXArchiveEntry *entry) {
+    free(entry->path);
+    free(entry->target);
+    for (size_t i = 0; i < entry->xattrCount; i++) {
+        free(entry->xattrs[i].name);
+        free(entry->xattrs[i].value);
+    }
+    free(entry->xattrs);
+}
+
+void PXArchiveEntriesFree(PXArchiveEntry *entries, size_t count) {
+    for (size_t i = 0; i < count; i++) freeEntry(&entries[i]);
+    free(entries);
+}
+
+bool PXArchiveIsSafeRelativePath(const char *path) {
+    if (!path || !*path || *path == '/') return false;
+    for (const char *component = path; component;) {
+        const char *slash = strchr(component, '/');
+        size_t length = slash ? (size_t)(slash - component) : strlen(component);
+        if (length == 2 && component[0] == '.' && component[1] == '.') return false;
+        component = slash ? slash + 1 : NULL;
+    }
+    return true;
+}
+
+static int readXattrs(const char *path, PXArchiveEntry *entry) {
+    ssize_t size = listXattrs(path, NULL, 0);
+    if (size <= 0) return 0;
+    char *names = malloc((size_t)size);
+    if (!names) return ENOMEM;
+    size = listXattrs(path, names, (size_t)size);
+    size_t capacity = 0;
+    int err = 0;
+    for (char *name = names; size > 0 && name < names + size && !err; name += strlen(name) + 1) {
+        ssize_t length = getXattr(path, name, NULL, 0);
+        if (length < 0) continue;
+        uint8_t *value = malloc(length ? (size_t)length : 1);
+        if (!value) {
+            err = ENOMEM;
+            break;
+        }
+        if (getXattr(path, name, value, (size_t)length) != length) {
+            free(value);
+            continue;
+        }
+        if (entry->xattrCount == capacity) {
+            capacity = capacity ? capacity * 2 : 4;
+            PXArchiveXattr *xattrs = realloc(entry->xattrs, capacity * sizeof(PXArchiveXattr));
+            if (!xattrs) {
+                free(value);
+                err = ENOMEM;
+                break;
+            }
+            entry->xattrs = xattrs;
+        }
+        char *copy = strdup(name);
+        if (!copy) {
+            free(value);
+            err = ENOMEM;
+            break;
+        }
+        entry->xattrs[entry->xattrCount++] = (PXArchiveXattr){ copy, value, (size_t)length };
+    }
+    free(names);
+    return err;
+}
+
+// ---- Compression ----
+
+// Appends the compressed stream of `in` to `out`; returns its length, or -1.
+static off_t compressFile(int in, int out, uint8_t *src, uint8_t *dst) {
+    compression_stream stream;
+    if (compression_stream_init(&stream, COMPRESSION_STREAM_ENCODE, COMPRESSION_LZFSE) != COMPRESSION_STATUS_OK) {
+        return -1;
+    }
+    stream.src_ptr = src;
+    stream.src_size = 0;
+    stream.dst_ptr = dst;
+    stream.dst_size = kPXArchiveStreamBufferSize;
+    off_t written = 0;
+    bool eof = false;
+    compression_status status = COMPRESSION_STATUS_OK;
+    do {
+        if (stream.src_size == 0 && !eof) {
+            ssize_t n = read(in, src, kPXArchiveStreamBufferSize);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                written = -1;
+                break;
+            }
+            eof = n == 0;
+            stream.src_ptr = src;
+            stream.src_size = (size_t)n;
+        }
+        status = compression_stream_process(&stream, eof ? COMPRESSION_STREAM_FINALIZE : 0);
+        if (status == COMPRESSION_STATUS_ERROR) {
+            written = -1;
+            break;
+        }
+        if (stream.dst_size == 0 || status == COMPRESSION_STATUS_END) {
+            size_t produced = kPXArchiveStreamBufferSize - stream.dst_size;
+            if (!writeAll(out, dst, produced)) {
+                written = -1;
+                break;
+            }
+            written += (off_t)produced;
+            stream.dst_ptr = dst;
+            stream.dst_size = kPXArchiveStreamBufferSize;
+        }
+    } while (status != COMPRESSION_STATUS_END);
+    compression_stream_destroy(&stream);
+    return written;
+}
+
+bool PXArchiveDecompress(int archiveFd, const PXArchiveEntry *entry, uint8_t *src, uint8_t *dst,
+                         bool (*sink)(const uint8_t *bytes, size_t length, void *context), void *context) {
+    if (entry->csize == 0) return true;
+    compression_stream stream;
+    if (compression_stream_init(&stream, COMPRESSION_STREAM_DECODE, COMPRESSION_LZFSE) != COMPRESSION_STATUS_OK) {
+        return false;
+    }
+    stream.src_ptr = src;
+    stream.src_size = 0;
+    stream.dst_ptr = dst;
+    stream.dst_size = kPXArchiveStreamBufferSize;
+    off_t position = (off_t)entry->offset, remaining = (off_t)entry->csize;
+    bool ok = false;
+    for (;;) {
+        if (stream.src_size == 0 && remaining > 0) {
+            size_t want = remaining < (off_t)kPXArchiveStreamBufferSize ? (size_t)remaining : kPXArchiveStreamBufferSize;
+            ssize_t n = pread(archiveFd, src, want, position);
+            if (n <= 0) break;
+            position += n;
+            remaining -= n;
+            stream.src_ptr = src;
+            stream.src_size = (size_t)n;
+        }
+        size_t srcBefore = stream.src_size, dstBefore = stream.dst_size;
+        compression_status status = compression_stream_process(&stream, remaining == 0 ? COMPRESSION_STREAM_FINALIZE : 0);
+        if (status == COMPRESSION_STATUS_ERROR) break;
+        if (stream.dst_size == 0 || status == COMPRESSION_STATUS_END) {
+            if (!sink(dst, kPXArchiveStreamBufferSize - stream.dst_size, context)) break;
+            stream.dst_ptr = dst;
+            stream.dst_size = kPXArchiveStreamBufferSize;
+        }
+        if (status == COMPRESSION_STATUS_END) {
+            ok = true;
+            break;
+        }
+        // Truncated stream: all input consumed and nothing more comes out.
+        if (remaining == 0 && stream.src_size == srcBefore && stream.dst_size == dstBefore) break;
+    }
+    compression_stream_destroy(&stream);
+    return ok;
+}
+
+// ---- Writing ----
+
+// First path of each multiply-linked inode, open addressing on st_ino.
+typedef struct {
+    uint64_t *inodes;
+    size_t *indexes;
+    size_t capacity, count;
+} LinkTable;
+
+static size_t *findLink(LinkTable *table, uint64_t inode) {
+    if (!table->capacity) return NULL;
+    size_t i = (size_t)(inode * 0x9E3779B97F4A7C15ULL) & (table->capacity - 1);
+    while (table->indexes[i]) {
+        if (table->inodes[i] == inode) return &table->indexes[i];
+        i = (i + 1) & (table->capacity - 1);
+    }
+    return NULL;
+}
+
+static bool addLink(LinkTable *table, uint64_t inode, size_t index) {
+    if ((table->count + 1) * 2 > table->capacity) {
+        size_t capacity = table->capacity ? table->capacity * 2 : 64;
+        uint64_t *inodes = calloc(capacity, sizeof(uint64_t));
+        size_t *indexes = calloc(capacity, sizeof(size_t));
+        if (!inodes || !indexes) {
+            free(inodes);
+            free(indexes);
+            return false;
+        }
+        for (size_t i = 0; i < table->capacity; i++) {
+            if (!table->indexes[i]) continue;
+            size_t j = (size_t)(table->inodes[i] * 0x9E3779B97F4A7C15ULL) & (capacity - 1);
+            while (indexes[j]) j = (j + 1) & (capacity - 1);
+            inodes[j] = table->inodes[i];
+            indexes[j] = table->indexes[i];
+        }
+        free(table->inodes);
+        free(table->indexes);
+        table->inodes = inodes;
+        table->indexes = indexes;
+        table->capacity = capacity;
+    }
+    size_t i = (size_t)(inode * 0x9E3779B97F4A7C15ULL) & (table->capacity - 1);
+    while (table->indexes[i]) i = (i + 1) & (table->capacity - 1);
+    table->inodes[i] = inode;
+    table->indexes[i] = index + 1;
+    table->count++;
+    return true;
+}
+
+int PXArchiveWriteData(const char *root, int out, bool (*shouldStop)(void *context), void *context,
+                       PXArchiveEntry **outEntries, size_t *outCount, uint64_t *dataEnd, char **failedPath) {
+    char *roots[] = { (char *)root, NULL };
+    FTS *fts = fts_open(roots, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL);
+    int err = fts ? 0 : errno;
+    uint8_t *src = malloc(kPXArchiveStreamBufferSize);
+    uint8_t *dst = malloc(kPXArchiveStreamBufferSize);
+    if (!err && (!src || !dst)) err = ENOMEM;
+    const char *failed = ".";
+
+    PXArchiveEntry *entries = NULL;
+    size_t count = 0, capacity = 0;
+    LinkTable links = { 0 };
+    uint64_t position = kPXArchiveHeaderSize;
+    if (!err && !writeAll(out, kHeaderMagic, sizeof(kHeaderMagic))) err = errno;
+
+    size_t rootLength = strlen(root);
+    FTSENT *ftsEntry;
+    while (!err && (ftsEntry = fts_read(fts))) {
+        if (ftsEntry->fts_info == FTS_DP) continue;
+        if (shouldStop && shouldStop(context)) {
+            err = ECANCELED;
+            break;
+        }
+        const char *relative = ftsEntry->fts_level == 0 ? "." : ftsEntry->fts_path + rootLength + 1;
+        failed = relative;
+        if (ftsEntry->fts_info == FTS_NS || ftsEntry->fts_info == FTS_ERR || ftsEntry->fts_info == FTS_DNR) {
+            err = ftsEntry->fts_errno;
+            break;
+        }
+        const struct stat *st = ftsEntry->fts_statp;
+        if (!S_ISDIR(st->st_mode) && !S_ISLNK(st->st_mode) && !S_ISREG(st->st_mode)) {
+            // Sockets, fifos and devices have no place in a container backup.
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            PXArchiveEntry *grown = realloc(entries, capacity * sizeof(PXArchiveEntry));
+            if (!grown) {
+                err = ENOMEM;
+                break;
+            }
+            entries = grown;
+        }
+        PXArchiveEntry *entry = &entries[count++];
+        *entry = (PXArchiveEntry){
+            .path = strdup(relative),
+            .mode = st->st_mode & 07777,
+            .uid = st->st_uid,
+            .gid = st->st_gid,
+            .mtime = (uint64_t)MTIME(st).tv_sec * kNanosecondsPerSecond + (uint64_t)MTIME(st).tv_nsec,
+            .flags = flagsOf(st),
+            .protectionClass = kPXArchiveNoProtectionClass,
+        };
+        if (!entry->path || (err = readXattrs(ftsEntry->fts_accpath, entry))) {
+            if (!err) err = ENOMEM;
+            break;
+        }
+
+        if (S_ISDIR(st->st_mode)) {
+            entry->type = PXArchiveEntryDir;
+            int fd = open(ftsEntry->fts_accpath, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd >= 0) {
+                entry->protectionClass = protectionClassOf(fd);
+                close(fd);
+            }
+        } else if (S_ISLNK(st->st_mode)) {
+            char target[PATH_MAX];
+            ssize_t n = readlink(ftsEntry->fts_accpath, target, sizeof(target) - 1);
+            if (n < 0) {
+                err = errno;
+                break;
+            }
+            target[n] = '\0';
+            entry->type = PXArchiveEntryLink;
+            if (!(entry->target = strdup(target))) {
+                err = ENOMEM;
+                break;
+            }
+        } else {
+            size_t *first = st->st_nlink > 1 ? findLink(&links, (uint64_t)st->st_ino) : NULL;
+            if (first) {
+                entry->type = PXArchiveEntryHardLink;
+                if (!(entry->target = strdup(entries[*first - 1].path))) {
+                    err = ENOMEM;
+                    break;
+                }
+                continue;
+            }
+            if (st->st_nlink > 1 && !addLink(&links, (uint64_t)st->st_ino, count - 1)) {
+                err = ENOMEM;
+                break;
+            }
+            off_t csize = 0;
+            int in = open(ftsEntry->fts_accpath, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+            if (in < 0) {
+                err = errno;
+                break;
+            }
+            noCache(in);
+            entry->protectionClass = protectionClassOf(in);
+            if (st->st_size > 0) {
+                errno = 0;
+                csize = compressFile(in, out, src, dst);
+                if (csize < 0) err = errno ? errno : EIO;
+            }
+            close(in);
+            if (err) break;
+            entry->type = PXArchiveEntryFile;
+            entry->size = (uint64_t)st->st_size;
+            entry->offset = position;
+            entry->csize = (uint64_t)csize;
+            position += (uint64_t)csize;
+        }
+    }
+    if (err && failedPath) *failedPath = strdup(failed);
+    if (fts) fts_close(fts);
+    free(src);
+    free(dst);
+    free(links.inodes);
+    free(links.indexes);
+    if (err) {
+        PXArchiveEntriesFree(entries, count);
+        return err;
+    }
+    *outEntries = entries;
+    *outCount = count;
+    *dataEnd = position;
+    return 0;
+}
+
+int PXArchiveWriteTrailer(int out, uint64_t directoryOffset, const void *directory, size_t length) {
+    uint8_t trailer[kPXArchiveTrailerSize];
+    putLE64(trailer, directoryOffset);
+    putLE64(trailer + 8, (uint64_t)length);
+    memcpy(trailer + 16, kTrailerMagic, sizeof(kTrailerMagic));
+    if (!writeAll(out, directory, length) || !writeAll(out, trailer, sizeof(trailer)) || fsync(out) != 0) {
+        return errno ? errno : EIO;
+    }
+    return 0;
+}
+
+// ---- Reading ----
+
+int PXArchiveReadDirectory(int fd, void **outDirectory, size_t *outLength) {
+    struct stat st;
+    char magic[8];
+    uint8_t trailer[kPXArchiveTrailerSize];
+    if (fstat(fd, &st) != 0) return errno;
+    if (st.st_size < (off_t)(kPXArchiveHeaderSize + kPXArchiveTrailerSize) ||
+        pread(fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic) || memcmp(magic, kHeaderMagic, sizeof(magic)) != 0 ||
+        pread(fd, trailer, sizeof(trailer), st.st_size - (off_t)kPXArchiveTrailerSize) != (ssize_t)sizeof(trailer) ||
+        memcmp(trailer + 16, kTrailerMagic, sizeof(kTrailerMagic)) != 0) {
+        return EFTYPE;
+    }
+    uint64_t offset = getLE64(trailer);
+    uint64_t length = getLE64(trailer + 8);
+    if (offset < kPXArchiveHeaderSize || offset > (uint64_t)st.st_size ||
+        offset + length != (uint64_t)st.st_size - kPXArchiveTrailerSize) {
+        return EFTYPE;
+    }
+    void *directory = malloc(length ? (size_t)length : 1);
+    if (!directory) return ENOMEM;
+    if (pread(fd, directory, (size_t)length, (off_t)offset) != (ssize_t)length) {
+        int err = errno ? errno : EIO;
+        free(directory);
+        return err;
+    }
+    *outDirectory = directory;
+    *outLength = (size_t)length;
+    return 0;
+}
+
+// ---- Extracting ----
+
+static bool applyMetadata(const char *path, const PXArchiveEntry *entry, bool withFlags) {
+    bool ok = true;
+    for (size_t i = 0; i < entry->xattrCount; i++) {
+        const PXArchiveXattr *xattr = &entry->xattrs[i];
+        if (setXattr(path, xattr->name, xattr->value, xattr->length) != 0) ok = false;
+    }
+    if (fchownat(AT_FDCWD, path, (uid_t)entry->uid, (gid_t)entry->gid, AT_SYMLINK_NOFOLLOW) != 0) ok = false;
+    if (entry->type != PXArchiveEntryLink && chmod(path, (mode_t)(entry->mode & 07777)) != 0) ok = false;
+    struct timespec times[2] = {
+        { (time_t)(entry->mtime / kNanosecondsPerSecond), (long)(entry->mtime % kNanosecondsPerSecond) },
+        { (time_t)(entry->mtime / kNanosecondsPerSecond), (long)(entry->mtime % kNanosecondsPerSecond) }
+    };
+    if (utimensat(AT_FDCWD, path, times, AT_SYMLINK_NOFOLLOW) != 0) ok = false;
+    // Last: an immutable or append-only flag would refuse the changes above.
+    if (withFlags && !applyFlags(path, entry)) ok = false;
+    return ok;
+}
+
+bool PXArchiveApplyMetadata(const char *path, const PXArchiveEntry *entry) {
+    return applyMetadata(path, entry, true);
+}
+
+int PXArchiveExtractDirectories(const char *dst, const PXArchiveEntry *entries, size_t count, size_t *failedIndex) {
+    *failedIndex = count;
+    for (size_t i = 0; i < count; i++) {
+        if (!PXArchiveIsSafeRelativePath(entries[i].path) ||
+            (entries[i].type == PXArchiveEntryHardLink && !PXArchiveIsSafeRelativePath(entries[i].target))) {
+            *failedIndex = i;
+            return EFTYPE;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].type != PXArchiveEntryDir) continue;
+        char *path = joinPath(dst, entries[i].path);
+        int err = !path ? ENOMEM : mkdir(path, 0700) != 0 ? errno : 0;
+        if (!err) {
+            // New files take their directory's class; set it before any are created.
+            int fd = open(path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+            if (fd < 0 || !setProtectionClass(fd, entries[i].protectionClass)) err = errno ? errno : EIO;
+            if (fd >= 0) close(fd);
+        }
+        free(path);
+        if (err) {
+            *failedIndex = i;
+            return err;
+        }
+    }
+    return 0;
+}
+
+static bool writeSink(const uint8_t *bytes, size_t length, void *context) {
+    return writeAll(*(int *)context, bytes, length);
+}
+
+static int extractFile(int archiveFd, const PXArchiveEntry *entry, const char *path, uint8_t *src, uint8_t *buffer) {
+    int out = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+    if (out < 0) return errno;
+    noCache(out);
+    int err = 0;
+    struct stat st;
+    // Before any data is written, so no plaintext lands under the wrong class.
+    if (!setProtectionClass(out, entry->protectionClass)) err = errno ? errno : EIO;
+    else if (!PXArchiveDecompress(archiveFd, entry, src, buffer, writeSink, &out)) err = errno ? errno : EIO;
+    else if (fstat(out, &st) != 0) err = errno;
+    else if ((uint64_t)st.st_size != entry->size) err = EIO;
+    close(out);
+    // Flags wait until the hard links to this file exist.
+    if (!err && !applyMetadata(path, entry, false)) err = errno ? errno : EIO;
+    return err;
+}
+
+int PXArchiveExtractFiles(int archiveFd, const char *dst, const PXArchiveEntry *entries, size_t count,
+                          size_t worker, size_t workers, uint8_t *src, uint8_t *buffer,
+                          bool (*shouldStop)(void *context), void *context, size_t *failedIndex) {
+    *failedIndex = count;
+    size_t fileIndex = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].type != PXArchiveEntryFile) continue;
+        if (fileIndex++ % workers != worker) continue;
+        if (shouldStop && shouldStop(context)) return ECANCELED;
+        char *path = joinPath(dst, entries[i].path);
+        errno = 0;
+        int err = path ? extractFile(archiveFd, &entries[i], path, src, buffer) : ENOMEM;
+        free(path);
+        if (err) {
+            *failedIndex = i;
+            return err;
+        }
+    }
+    return 0;
+}
+
+int PXArchiveExtractLinks(const char *dst, const PXArchiveEntry *entries, size_t count, size_t *failedIndex,
+                          size_t *metadataFailures) {
+    *failedIndex = count;
+    *metadataFailures = 0;
+    // Links once their targets exist.
+    for (size_t i = 0; i < count; i++) {
+        const PXArchiveEntry *entry = &entries[i];
+        if (entry->type != PXArchiveEntryLink && entry->type != PXArchiveEntryHardLink) continue;
+        char *path = joinPath(dst, entry->path);
+        char *target = entry->type == PXArchiveEntryHardLink ? joinPath(dst, entry->target) : NULL;
+        int rc = -1;
+        errno = 0;
+        if (path && entry->type == PXArchiveEntryHardLink && target) {
+            rc = link(target, path);
+        } else if (path && entry->type == PXArchiveEntryLink && entry->target) {
+            rc = symlink(entry->target, path);
+            if (rc == 0) applyMetadata(path, entry, true);
+        }
+        int err = rc == 0 ? 0 : errno ? errno : EFTYPE;
+        free(path);
+        free(target);
+        if (err) {
+            *failedIndex = i;
+            return err;
+        }
+    }
+    // File flags, now that nothing more is linked to them.
+    for (size_t i = 0; i < count; i++) {
+        if (entries[i].type != PXArchiveEntryFile || entries[i].flags == 0) continue;
+        char *path = joinPath(dst, entries[i].path);
+        if (!path || !applyFlags(path, &entries[i])) (*metadataFailures)++;
+        free(path);
+    }
+    // Directories deepest first, so restoring a directory's mtime is not undone
+    // by creating its children.
+    for (size_t i = count; i > 0; i--) {
+        if (entries[i - 1].type != PXArchiveEntryDir) continue;
+        char *path = joinPath(dst, entries[i - 1].path);
+        if (!path || !applyMetadata(path, &entries[i - 1], true)) (*metadataFailures)++;
+        free(path);
+    }
+    return 0;
+}
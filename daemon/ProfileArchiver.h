@@ -0,0 +1,26 @@
+#import <Foundation/Foundation.h>
+
+// Aging policy for profile backups. A profile not used for
+// ProjectXArchiveAfterDays (default 14) is packed into
+// .archive/<id>.pxar (see ProfileArchive.h) and its directory removed; it is
+// unpacked again, in parallel, the next time it is needed.
+@interface ProfileArchiver : NSObject
+
++ (instancetype)sharedManager;
+
+// Records that the profile was active (or about to be) now.
+- (void)profileWasUsed:(NSString *)profileId;
+
+- (BOOL)isArchived:(NSString *)profileId;
+- (NSString *)archivePathForProfile:(NSString *)profileId;
+// Restores the profile directory from its archive. YES if the directory exists
+// afterwards (also when the profile was never archived).
+- (BOOL)unpackProfile:(NSString *)profileId
+          parallelism:(NSUInteger)parallelism
+           shouldStop:(BOOL (^)(void))shouldStop;
+- (void)removeArchive:(NSString *)profileId;
+
+// Queue packing of cold profiles as idle work.
+- (void)scheduleAging;
+
+@end
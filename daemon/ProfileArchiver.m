@@ -0,0 +1,188 @@
+#import "ProfileArchiver.h"
+#import "ProfileArchive.h"
+#import "ProfileManager.h"
+#import "ProfileStager.h"
+#import "ContentStore.h"
+#import "JobManager.h"
+#import "DiskUsageIndex.h"
+#import "FileRemover.h"
+#import "ProjectXLogging.h"
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define kArchiveRoot @"/private/var/mobile/Media/ProjectX/.archive"
+
+static const NSInteger kDefaultArchiveAfterDays = 14;
+
+@interface ProfileArchiver ()
+// profileId -> NSDate of last use, persisted in .archive/usage.plist.
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSDate *> *lastUsed;
+@end
+
+@implementation ProfileArchiver
+
++ (instancetype)sharedManager {
+    static ProfileArchiver *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        [[NSFileManager defaultManager] createDirectoryAtPath:kArchiveRoot withIntermediateDirectories:YES attributes:nil error:nil];
+        NSDictionary *stored = [NSDictionary dictionaryWithContentsOfFile:[self usagePath]];
+        _lastUsed = [stored isKindOfClass:[NSDictionary class]] ? [stored mutableCopy] : [NSMutableDictionary dictionary];
+        // Half-written archives and half-extracted trees from a previous run.
+        for (NSString *name in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:kArchiveRoot error:nil]) {
+            if ([name hasSuffix:@".partial"] || [name hasSuffix:@".unpack"] || [name hasSuffix:@".packed"]) {
+                removeItemTree([kArchiveRoot stringByAppendingPathComponent:name], 1, nil);
+            }
+        }
+    }
+    return self;
+}
+
+- (NSString *)usagePath {
+    return [kArchiveRoot stringByAppendingPathComponent:@"usage.plist"];
+}
+
+- (NSString *)archivePathForProfile:(NSString *)profileId {
+    return [kArchiveRoot stringByAppendingPathComponent:[profileId stringByAppendingPathExtension:@"pxar"]];
+}
+
+- (void)profileWasUsed:(NSString *)profileId {
+    if (!profileId) return;
+    @synchronized (self) {
+        _lastUsed[profileId] = [NSDate date];
+        [_lastUsed writeToFile:[self usagePath] atomically:YES];
+    }
+}
+
+- (BOOL)isArchived:(NSString *)profileId {
+    if (!profileId) return NO;
+    return access([self archivePathForProfile:profileId].fileSystemRepresentation, F_OK) == 0;
+}
+
+- (BOOL)unpackProfile:(NSString *)profileId parallelism:(NSUInteger)parallelism shouldStop:(BOOL (^)(void))shouldStop {
+    if (!profileId) return NO;
+    NSString *archive = [self archivePathForProfile:profileId];
+    NSString *profilePath = [[ProfileManager sharedManager] createShardForProfileId:profileId];
+    BOOL haveArchive = access(archive.fileSystemRepresentation, F_OK) == 0;
+    BOOL haveDirectory = access(profilePath.fileSystemRepresentation, F_OK) == 0;
+    if (haveDirectory) {
+        // The directory is only moved away after the archive is complete, so if
+        // both exist the move failed and the tree is current.
+        if (haveArchive) {
+            unlink(archive.fileSystemRepresentation);
+            [[DiskUsageIndex sharedManager] setArchivedBytes:0 forProfile:profileId];
+        }
+        return YES;
+    }
+    if (!haveArchive) return NO;
+
+    NSDate *start = [NSDate date];
+    NSString *unpack = [[kArchiveRoot stringByAppendingPathComponent:profileId] stringByAppendingPathExtension:@"unpack"];
+    removeItemTree(unpack, 1, nil);
+    NSError *error = nil;
+    if (!extractProfileArchive(archive, unpack, parallelism, shouldStop, &error)) {
+        PXLog(@"[ProfileArchiver] Unpacking %@ failed: %@", profileId, error);
+        removeItemTree(unpack, 1, nil);
+        return NO;
+    }
+    if (rename(unpack.fileSystemRepresentation, profilePath.fileSystemRepresentation) != 0) {
+        PXLog(@"[ProfileArchiver] Cannot move %@ into place: %s", profileId, strerror(errno));
+        removeItemTree(unpack, 1, nil);
+        return NO;
+    }
+    unlink(archive.fileSystemRepresentation);
+    [[DiskUsageIndex sharedManager] setArchivedBytes:0 forProfile:profileId];
+    // Unpacked for a reason; don't let the next aging pass pack it again.
+    [self profileWasUsed:profileId];
+    PXLog(@"[ProfileArchiver] Unpacked %@ in %.2fs", profileId, -[start timeIntervalSinceNow]);
+    return YES;
+}
+
+- (void)removeArchive:(NSString *)profileId {
+    if (!profileId) return;
+    unlink([self archivePathForProfile:profileId].fileSystemRepresentation);
+    @synchronized (self) {
+        [_lastUsed removeObjectForKey:profileId];
+        [_lastUsed writeToFile:[self usagePath] atomically:YES];
+    }
+}
+
+- (void)scheduleAging {
+    [[JobManager sharedManager] runWhenIdle:^{
+        [self packColdProfiles];
+    }];
+}
+
+// Runs on the job queue between jobs, at background QoS with throttled disk I/O.
+- (void)packColdProfiles {
+    NSInteger days = [[NSUserDefaults standardUserDefaults] integerForKey:@"ProjectXArchiveAfterDays"];
+    if (days <= 0) days = kDefaultArchiveAfterDays;
+    NSDate *cutoff = [NSDate dateWithTimeIntervalSinceNow:-days * 86400.0];
+    ProfileManager *profileManager = [ProfileManager sharedManager];
+    NSString *activeId = [profileManager getActiveProfileId];
+    NSArray<Profile *> *profiles = [profileManager profilesSnapshot];
+
+    NSMutableArray<NSString *> *cold = [NSMutableArray array];
+    @synchronized (self) {
+        BOOL changed = NO;
+        for (Profile *profile in profiles) {
+            if (!profile.id || [profile.id isEqualToString:activeId]) continue;
+            NSDate *used = _lastUsed[profile.id];
+            if (!used) {
+                // Unknown history (e.g. profiles from before aging existed): start the clock now.
+                _lastUsed[profile.id] = [NSDate date];
+                changed = YES;
+                continue;
+            }
+            if ([used compare:cutoff] == NSOrderedAscending) [cold addObject:profile.id];
+        }
+        if (changed) [_lastUsed writeToFile:[self usagePath] atomically:YES];
+    }
+
+    BOOL (^shouldStop)(void) = ^BOOL {
+        return [[JobManager sharedManager] hasPendingJobs];
+    };
+    int oldPolicy = getiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD);
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+    for (NSString *profileId in cold) {
+        if (shouldStop()) break;
+        NSString *profilePath = [profileManager pathForProfileId:profileId];
+        BOOL isDir = NO;
+        if (![[NSFileManager defaultManager] fileExistsAtPath:profilePath isDirectory:&isDir] || !isDir) continue;
+
+        NSDate *start = [NSDate date];
+        NSError *error = nil;
+        if (!writeProfileArchive(profilePath, [self archivePathForProfile:profileId], shouldStop, &error)) {
+            if (error.code != ECANCELED) PXLog(@"[ProfileArchiver] Packing %@ failed: %@", profileId, error);
+            continue;
+        }
+        // Moved aside in one step, so a profile directory is never partially removed.
+        NSString *packed = [[kArchiveRoot stringByAppendingPathComponent:profileId] stringByAppendingPathExtension:@"packed"];
+        if (rename(profilePath.fileSystemRepresentation, packed.fileSystemRepresentation) != 0) {
+            PXLog(@"[ProfileArchiver] Cannot retire %@: %s", profileId, strerror(errno));
+            unlink([self archivePathForProfile:profileId].fileSystemRepresentation);
+            continue;
+        }
+        [[ProfileStager sharedManager] invalidateProfile:profileId];
+        // The archive holds its own copy; the profile no longer shares blocks with the store.
+        [[ContentStore sharedManager] forgetProfile:profileId];
+        removeItemTree(packed, 1, ^(NSString *path, int err) {
+            PXLog(@"[ProfileArchiver] Failed to remove %@: %s", path, strerror(err));
+        });
+        struct stat st = {0};
+        stat([self archivePathForProfile:profileId].fileSystemRepresentation, &st);
+        [[DiskUsageIndex sharedManager] setArchivedBytes:(uint64_t)st.st_size forProfile:profileId];
+        PXLog(@"[ProfileArchiver] Packed %@ into %lld bytes in %.2fs", profileId, (long long)st.st_size, -[start timeIntervalSinceNow]);
+    }
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, oldPolicy);
+}
+
+@end
@@ -0,0 +1,14 @@
+#import <Foundation/Foundation.h>
+
+// Guesses which profile the operator will switch to next. Pure Foundation, no
+// filesystem access: it only sees the sequence of profile ids it is told about.
+@interface ProfilePredictor : NSObject
+
+// Records that the active profile changed from `from` (may be nil) to `to`.
+- (void)recordSwitchFrom:(NSString *)from to:(NSString *)to;
+
+// Most frequent successor of `current` in the recent history; without history
+// the profile after `current` in `orderedIds` (wrapping). Never returns current.
+- (NSString *)predictNextAfter:(NSString *)current candidates:(NSArray<NSString *> *)orderedIds;
+
+@end
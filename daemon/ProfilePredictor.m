@@ -0,0 +1,34 @@
+#import "ProfilePredictor.h"
+#import "ProfilePredictorCore.h"
+
+@implementation ProfilePredictor {
+    ProfilePredictorHistory _history;
+}
+
+- (void)dealloc {
+    ProfilePredictorFree(&_history);
+}
+
+- (void)recordSwitchFrom:(NSString *)from to:(NSString *)to {
+    if (!from.length || !to.length) return;
+    @synchronized (self) {
+        ProfilePredictorRecord(&_history, from.UTF8String, to.UTF8String);
+    }
+}
+
+- (NSString *)predictNextAfter:(NSString *)current candidates:(NSArray<NSString *> *)orderedIds {
+    if (!current.length) return nil;
+    NSUInteger count = orderedIds.count;
+    const char **candidates = count ? malloc(count * sizeof(char *)) : NULL;
+    if (count && !candidates) return nil;
+    // The UTF-8 buffers live as long as the autoreleased strings they came from.
+    for (NSUInteger i = 0; i < count; i++) candidates[i] = orderedIds[i].UTF8String ?: "";
+    size_t index;
+    @synchronized (self) {
+        index = ProfilePredictorPredict(&_history, current.UTF8String, candidates, count);
+    }
+    free(candidates);
+    return index == SIZE_MAX ? nil : orderedIds[index];
+}
+
+@end
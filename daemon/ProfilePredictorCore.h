@@ -0,0 +1,34 @@
+#ifndef PROFILE_PREDICTOR_CORE_H
+#define PROFILE_PREDICTOR_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// ProfilePredictor's history and guess, plain C so bench/ can measure its hit
+// rate on simulated switching patterns. Not thread-safe; ProfilePredictor
+// locks around it.
+
+// Only the most recent transitions count, so a changed cycling pattern wins quickly.
+#define kProfilePredictorMaxTransitions 64
+
+typedef struct {
+    char *from;
+    char *to;
+} ProfileTransition;
+
+typedef struct {
+    ProfileTransition ring[kProfilePredictorMaxTransitions];
+    size_t start; // oldest entry
+    size_t count;
+} ProfilePredictorHistory;
+
+// history must be zeroed before first use.
+void ProfilePredictorRecord(ProfilePredictorHistory *history, const char *from, const char *to);
+// Most frequent successor of current among candidates in the recent history,
+// ties going to the most recent; without history the candidate after current
+// (wrapping). Never current. Returns an index into candidates, or SIZE_MAX.
+size_t ProfilePredictorPredict(const ProfilePredictorHistory *history, const char *current,
+                               const char *const *candidates, size_t candidateCount);
+void ProfilePredictorFree(ProfilePredictorHistory *history);
+
+#endif
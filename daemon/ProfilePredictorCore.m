@@ -0,0 +1,80 @@
+#include "ProfilePredictorCore.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ---- History ----
+
+static void freeTransition(ProfileTransition *t) {
+    free(t->from);
+    free(t->to);
+    t->from = t->to = NULL;
+}
+
+void ProfilePredictorRecord(ProfilePredictorHistory *history, const char *from, const char *to) {
+    if (!from || !to || !from[0] || !to[0] || strcmp(from, to) == 0) return;
+    char *fromCopy = strdup(from), *toCopy = strdup(to);
+    if (!fromCopy || !toCopy) {
+        free(fromCopy);
+        free(toCopy);
+        return;
+    }
+    ProfileTransition *slot;
+    if (history->count == kProfilePredictorMaxTransitions) {
+        slot = &history->ring[history->start];
+        freeTransition(slot);
+        history->start = (history->start + 1) % kProfilePredictorMaxTransitions;
+    } else {
+        slot = &history->ring[(history->start + history->count++) % kProfilePredictorMaxTransitions];
+    }
+    slot->from = fromCopy;
+    slot->to = toCopy;
+}
+
+void ProfilePredictorFree(ProfilePredictorHistory *history) {
+    for (size_t i = 0; i < history->count; i++) {
+        freeTransition(&history->ring[(history->start + i) % kProfilePredictorMaxTransitions]);
+    }
+    history->start = history->count = 0;
+}
+
+// ---- Prediction ----
+
+static size_t candidateIndex(const char *id, const char *const *candidates, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(candidates[i], id) == 0) return i;
+    }
+    return SIZE_MAX;
+}
+
+size_t ProfilePredictorPredict(const ProfilePredictorHistory *history, const char *current,
+                               const char *const *candidates, size_t candidateCount) {
+    if (!current || !current[0]) return SIZE_MAX;
+
+    // Successor of each matching transition, newest first, as a candidate index.
+    size_t successors[kProfilePredictorMaxTransitions];
+    size_t matches = 0;
+    for (size_t i = history->count; i-- > 0;) {
+        const ProfileTransition *t = &history->ring[(history->start + i) % kProfilePredictorMaxTransitions];
+        if (strcmp(t->from, current) != 0) continue;
+        size_t index = candidateIndex(t->to, candidates, candidateCount);
+        if (index != SIZE_MAX) successors[matches++] = index;
+    }
+    // Scanning newest first and replacing only on a higher count gives ties to
+    // the most recent successor.
+    size_t best = SIZE_MAX, bestCount = 0;
+    for (size_t i = 0; i < matches; i++) {
+        size_t count = 0;
+        for (size_t j = 0; j < matches; j++) count += successors[j] == successors[i];
+        if (count > bestCount) {
+            best = successors[i];
+            bestCount = count;
+        }
+    }
+    if (best != SIZE_MAX) return best;
+
+    size_t index = candidateIndex(current, candidates, candidateCount);
+    if (index == SIZE_MAX || candidateCount < 2) return SIZE_MAX;
+    return (index + 1) % candidateCount;
+}
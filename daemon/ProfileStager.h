@@ -0,0 +1,21 @@
+#import <Foundation/Foundation.h>
+
+// Speculative work done between jobs: the containers of the profile most likely
+// to be switched to next are cloned into a staging area. Everything runs as idle
+// work on the job queue and is dropped as soon as a real job is waiting or space
+// runs low. Pre-generated PhoneInfo lives in PhoneInfoPool.
+@interface ProfileStager : NSObject
+
++ (instancetype)sharedManager;
+
+// Called after a switch; records the transition and stages the predicted next profile.
+- (void)profileDidChangeFrom:(NSString *)from to:(NSString *)to;
+
+// Moves the staged copy of <profile>/<bundle>/<folder> to dst (which must not
+// exist). Returns NO when nothing usable is staged; the caller then clones.
+- (BOOL)takeStagedFolder:(NSString *)folder bundle:(NSString *)bundleId profile:(NSString *)profileId toPath:(NSString *)dst;
+
+// The profile's backup changed or was removed; its staged copy is stale.
+- (void)invalidateProfile:(NSString *)profileId;
+
+@end
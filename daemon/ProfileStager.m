@@ -0,0 +1,189 @@
+#import "ProfileStager.h"
+#import "ProfilePredictor.h"
+#import "ProfileManager.h"
+#import "AppScopeManager.h"
+#import "JobManager.h"
+#import "FileRemover.h"
+#import "FileCloner.h"
+#import "ProfileArchiver.h"
+#import "ProjectXLogging.h"
+#include <sys/mount.h>
+#include <sys/resource.h>
+
+#define kProfileRoot @"/private/var/mobile/Media/ProjectX"
+#define kStagingRoot @"/private/var/mobile/Media/ProjectX/.staging"
+
+// Below this much free space staged data is discarded and nothing new is staged.
+static const uint64_t kMinFreeBytes = 2ULL << 30;
+
+@interface ProfileStager ()
+@property (nonatomic, strong) ProfilePredictor *predictor;
+// Profile whose containers are fully staged, nil if none.
+@property (nonatomic, copy) NSString *stagedProfileId;
+// Profile stageProfile: is copying right now, nil if none.
+@property (nonatomic, copy) NSString *stagingProfileId;
+// Set when that profile is invalidated mid-copy; the copy is then not published.
+@property (nonatomic, assign) BOOL stagingCancelled;
+@end
+
+@implementation ProfileStager
+
++ (instancetype)sharedManager {
+    static ProfileStager *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _predictor = [ProfilePredictor new];
+        // Anything left from a previous daemon run is of unknown state.
+        removeItemTree(kStagingRoot, 1, nil);
+    }
+    return self;
+}
+
+- (BOOL)isLowOnSpace {
+    struct statfs fs;
+    if (statfs(kProfileRoot.fileSystemRepresentation, &fs) != 0) return YES;
+    return (uint64_t)fs.f_bavail * fs.f_bsize < kMinFreeBytes;
+}
+
+- (void)discardStaging {
+    @synchronized (self) {
+        _stagedProfileId = nil;
+    }
+    removeItemTree(kStagingRoot, 1, ^(NSString *path, int err) {
+        PXLog(@"[ProfileStager] Failed to discard %@: %s", path, strerror(err));
+    });
+}
+
+- (void)profileDidChangeFrom:(NSString *)from to:(NSString *)to {
+    [_predictor recordSwitchFrom:from to:to];
+    [self invalidateProfile:from];
+    [self invalidateProfile:to];
+
+    ProfileManager *profileManager = [ProfileManager sharedManager];
+    NSArray<Profile *> *profiles = [profileManager profilesSnapshot];
+    NSMutableArray<NSString *> *ids = [NSMutableArray array];
+    for (Profile *profile in profiles) {
+        if (profile.id) [ids addObject:profile.id];
+    }
+    NSString *next = [_predictor predictNextAfter:to candidates:ids];
+    if (!next) return;
+    PXLog(@"[ProfileStager] Predicted next profile %@ after %@", next, to);
+    [[JobManager sharedManager] runWhenIdle:^{
+        [self stageProfile:next];
+    }];
+}
+
+// Runs on the job queue between jobs, at background QoS with throttled disk I/O.
+- (void)stageProfile:(NSString *)profileId {
+    if ([[JobManager sharedManager] hasPendingJobs]) return;
+    if ([self isLowOnSpace]) {
+        PXLog(@"[ProfileStager] Low on space; dropping staged data");
+        [self discardStaging];
+        return;
+    }
+    @synchronized (self) {
+        if ([_stagedProfileId isEqualToString:profileId]) return;
+        _stagingProfileId = [profileId copy];
+        _stagingCancelled = NO;
+    }
+    [self discardStaging];
+
+    int oldPolicy = getiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD);
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+
+    // A predicted profile that was archived is unpacked now rather than during the switch.
+    if ([[ProfileArchiver sharedManager] isArchived:profileId] &&
+        ![[ProfileArchiver sharedManager] unpackProfile:profileId parallelism:1 shouldStop:^BOOL {
+            return [[JobManager sharedManager] hasPendingJobs] || [self isStagingCancelled];
+        }]) {
+        setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, oldPolicy);
+        [self endStagingProfile:profileId complete:NO];
+        return;
+    }
+
+    NSFileManager *fm = [NSFileManager defaultManager];
+    NSString *backupPath = [[ProfileManager sharedManager] pathForProfileId:profileId];
+    NSString *stagePath = [kStagingRoot stringByAppendingPathComponent:profileId];
+    NSArray *folders = @[@"Documents", @"tmp", @"Library", @"SystemData"];
+    BOOL complete = YES;
+    for (NSString *bundleId in [[AppScopeManager sharedManager] loadPreferences]) {
+        for (NSString *folder in folders) {
+            if ([[JobManager sharedManager] hasPendingJobs] || [self isStagingCancelled]) {
+                complete = NO;
+                break;
+            }
+            NSString *src = [[backupPath stringByAppendingPathComponent:bundleId] stringByAppendingPathComponent:folder];
+            BOOL isDir = NO;
+            if (![fm fileExistsAtPath:src isDirectory:&isDir] || !isDir) continue;
+            NSString *dst = [[stagePath stringByAppendingPathComponent:bundleId] stringByAppendingPathComponent:folder];
+            [fm createDirectoryAtPath:[dst stringByDeletingLastPathComponent] withIntermediateDirectories:YES attributes:nil error:nil];
+            // Ownership is fixed here, at idle time, so a swap can use the copy as-is.
+            if (cloneItemTree(src, dst, MobileOwnership(), nil) == FileCloneFailed) {
+                complete = NO;
+                break;
+            }
+        }
+        if (!complete) break;
+    }
+
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, oldPolicy);
+    if (![self endStagingProfile:profileId complete:complete]) {
+        PXLog(@"[ProfileStager] Staging of %@ interrupted", profileId);
+        [self discardStaging];
+        return;
+    }
+    PXLog(@"[ProfileStager] Staged profile %@", profileId);
+}
+
+- (BOOL)isStagingCancelled {
+    @synchronized (self) {
+        return _stagingCancelled;
+    }
+}
+
+// Ends the in-progress copy. A complete one is published as staged unless it
+// was invalidated meanwhile, checked under the same lock invalidateProfile: takes.
+- (BOOL)endStagingProfile:(NSString *)profileId complete:(BOOL)complete {
+    @synchronized (self) {
+        BOOL publish = complete && !_stagingCancelled;
+        _stagingProfileId = nil;
+        _stagingCancelled = NO;
+        if (publish) _stagedProfileId = [profileId copy];
+        return publish;
+    }
+}
+
+- (BOOL)takeStagedFolder:(NSString *)folder bundle:(NSString *)bundleId profile:(NSString *)profileId toPath:(NSString *)dst {
+    @synchronized (self) {
+        if (!profileId || ![_stagedProfileId isEqualToString:profileId]) return NO;
+    }
+    NSString *staged = [[[kStagingRoot stringByAppendingPathComponent:profileId]
+                         stringByAppendingPathComponent:bundleId] stringByAppendingPathComponent:folder];
+    if (rename(staged.fileSystemRepresentation, dst.fileSystemRepresentation) != 0) return NO;
+    PXLog(@"[ProfileStager] Using staged %@", staged);
+    return YES;
+}
+
+- (void)invalidateProfile:(NSString *)profileId {
+    if (!profileId) return;
+    @synchronized (self) {
+        // A copy in progress is stopped by stageProfile: itself, which owns the
+        // staging directory until it returns.
+        if ([_stagingProfileId isEqualToString:profileId]) {
+            _stagingCancelled = YES;
+            return;
+        }
+        if (![_stagedProfileId isEqualToString:profileId]) return;
+    }
+    [self discardStaging];
+}
+
+@end
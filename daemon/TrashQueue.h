@@ -0,0 +1,22 @@
+#import <Foundation/Foundation.h>
+
+// Deferred deletion. A tree is renamed into the .projectx_trash directory at the
+// root of its volume, which takes constant time and makes the path free again at
+// once; a background reaper then removes it at background QoS with throttled
+// disk I/O, pausing while jobs are waiting. The trash directories are the queue:
+// whatever is left in them when the daemon exits is reaped after the next start.
+@interface TrashQueue : NSObject
+
++ (instancetype)sharedManager;
+
+// Moves path into its volume's trash. Returns NO (leaving path untouched) when
+// that is not possible, e.g. on a read-only volume; the caller deletes in place.
+- (BOOL)moveToTrash:(NSString *)path;
+
+// @{entries, bytes}: trees waiting to be reaped and their allocated size as
+// measured by the reaper so far (entries not measured yet count 0). bytes is an
+// upper bound on what reaping frees: blocks a tree shares with a clone or a
+// snapshot are counted but stay allocated.
+- (NSDictionary *)status;
+
+@end
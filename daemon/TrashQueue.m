@@ -0,0 +1,200 @@
+#import "TrashQueue.h"
+#import "FileRemover.h"
+#import "JobManager.h"
+#import "ProjectXLogging.h"
+#include "TrashQueueCore.h"
+#include <sys/mount.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define kTrashName @".projectx_trash"
+
+// While jobs are waiting the reaper looks again after this long.
+static const useconds_t kJobWaitMicros = 500 * 1000;
+
+static void waitForJobs(void) {
+    while ([[JobManager sharedManager] hasPendingJobs]) usleep(kJobWaitMicros);
+}
+
+@interface TrashQueue ()
+@property (nonatomic, strong) dispatch_queue_t reaperQueue;
+// st_dev -> trash directory on that volume.
+@property (nonatomic, strong) NSMutableDictionary<NSNumber *, NSString *> *trashByDevice;
+// Entries waiting to be reaped, oldest first, and the sizes measured so far.
+@property (nonatomic, strong) NSMutableArray<NSString *> *pending;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSNumber *> *sizes;
+@property (nonatomic, assign) uint64_t sequence;
+@property (nonatomic, assign) BOOL reaping;
+@end
+
+@implementation TrashQueue
+
++ (instancetype)sharedManager {
+    static TrashQueue *sharedManager = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sharedManager = [[self alloc] init];
+    });
+    return sharedManager;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _reaperQueue = dispatch_queue_create("com.projectx.trashreaper",
+                                             dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_BACKGROUND, 0));
+        _trashByDevice = [NSMutableDictionary dictionary];
+        _pending = [NSMutableArray array];
+        _sizes = [NSMutableDictionary dictionary];
+        [self recoverTrash];
+    }
+    return self;
+}
+
+// Picks up what a previous run left in the trash of every mounted volume.
+- (void)recoverTrash {
+    struct statfs *mounts = NULL;
+    int count = getmntinfo(&mounts, MNT_NOWAIT);
+    for (int i = 0; i < count; i++) {
+        NSString *trash = [@(mounts[i].f_mntonname) stringByAppendingPathComponent:kTrashName];
+        struct stat st;
+        if (lstat(trash.fileSystemRepresentation, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+        _trashByDevice[@(st.st_dev)] = trash;
+        char **names;
+        size_t entries;
+        if (TrashQueueListEntries(trash.fileSystemRepresentation, &names, &entries) != 0) continue;
+        for (size_t j = 0; j < entries; j++) {
+            [_pending addObject:[trash stringByAppendingPathComponent:@(names[j])]];
+        }
+        TrashQueueFreeNames(names, entries);
+    }
+    if (_pending.count > 0) {
+        PXLog(@"[TrashQueue] Resuming %lu entries left from the previous run", (unsigned long)_pending.count);
+        [self wakeReaper];
+    }
+}
+
+// The trash directory at the root of the volume holding a tree on device dev.
+- (NSString *)trashForDevice:(dev_t)dev path:(NSString *)path {
+    @synchronized (self) {
+        NSString *trash = _trashByDevice[@(dev)];
+        if (trash) return trash;
+    }
+    struct statfs fs;
+    if (statfs(path.fileSystemRepresentation, &fs) != 0) return nil;
+    NSString *trash = [@(fs.f_mntonname) stringByAppendingPathComponent:kTrashName];
+    if (mkdir(trash.fileSystemRepresentation, 0700) != 0 && errno != EEXIST) return nil;
+    struct stat st;
+    if (lstat(trash.fileSystemRepresentation, &st) != 0 || !S_ISDIR(st.st_mode) || st.st_dev != dev) return nil;
+    @synchronized (self) {
+        _trashByDevice[@(dev)] = trash;
+    }
+    return trash;
+}
+
+- (BOOL)moveToTrash:(NSString *)path {
+    if (!path.length) return NO;
+    struct stat st;
+    if (lstat(path.fileSystemRepresentation, &st) != 0) return NO;
+    NSString *trash = [self trashForDevice:st.st_dev path:path];
+    if (!trash || [path hasPrefix:trash]) return NO;
+
+    uint64_t sequence;
+    @synchronized (self) {
+        sequence = ++_sequence;
+    }
+    // Names sort by age, so entries recovered after a restart keep their order.
+    char name[kTrashQueueNameSize];
+    int err = TrashQueueMove(path.fileSystemRepresentation, trash.fileSystemRepresentation, sequence, name);
+    if (err != 0) {
+        PXLog(@"[TrashQueue] Cannot move %@ to trash: %s", path, strerror(err));
+        return NO;
+    }
+    NSString *entry = [trash stringByAppendingPathComponent:@(name)];
+    @synchronized (self) {
+        [_pending addObject:entry];
+    }
+    [self wakeReaper];
+    return YES;
+}
+
+- (NSDictionary *)status {
+    @synchronized (self) {
+        uint64_t bytes = 0;
+        for (NSNumber *size in _sizes.allValues) bytes += size.unsignedLongLongValue;
+        return @{ @"entries": @(_pending.count), @"bytes": @(bytes) };
+    }
+}
+
+- (void)wakeReaper {
+    @synchronized (self) {
+        if (_reaping) return;
+        _reaping = YES;
+    }
+    dispatch_async(_reaperQueue, ^{
+        @autoreleasepool {
+            [self reap];
+        }
+    });
+}
+
+// Runs on the reaper queue at background QoS with throttled disk I/O.
+- (void)reap {
+    int oldPolicy = getiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD);
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE);
+    NSUInteger reaped = 0;
+    for (;;) {
+        NSString *entry;
+        NSMutableArray<NSString *> *unmeasured = [NSMutableArray array];
+        @synchronized (self) {
+            if (_pending.count == 0) {
+                _reaping = NO;
+                break;
+            }
+            entry = _pending.firstObject;
+            for (NSString *queued in _pending) {
+                if (!_sizes[queued]) [unmeasured addObject:queued];
+            }
+        }
+        // Everything queued is measured before anything is removed, so status
+        // covers the whole queue rather than just the entry being reaped.
+        for (NSString *queued in unmeasured) {
+            @autoreleasepool {
+                uint64_t bytes = TrashQueueAllocatedBytes(queued.fileSystemRepresentation);
+                @synchronized (self) {
+                    _sizes[queued] = @(bytes);
+                }
+            }
+        }
+        @autoreleasepool {
+            [self removeEntry:entry];
+        }
+        @synchronized (self) {
+            [_pending removeObject:entry];
+            [_sizes removeObjectForKey:entry];
+        }
+        reaped++;
+    }
+    setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, oldPolicy);
+    PXLog(@"[TrashQueue] Reaped %lu entries", (unsigned long)reaped);
+}
+
+// Child by child, so the reaper can stand aside for a job between them.
+- (void)removeEntry:(NSString *)entry {
+    struct stat st;
+    if (lstat(entry.fileSystemRepresentation, &st) == 0 && S_ISDIR(st.st_mode)) {
+        for (NSString *name in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:entry error:nil]) {
+            waitForJobs();
+            removeItemTree([entry stringByAppendingPathComponent:name], 1, nil);
+        }
+    }
+    waitForJobs();
+    NSUInteger failures = removeItemTree(entry, 1, ^(NSString *path, int err) {
+        PXLog(@"[TrashQueue] Failed to remove %@: %s", path, strerror(err));
+    });
+    // Left in the trash; the next start tries again.
+    if (failures > 0) PXLog(@"[TrashQueue] %@ left %lu entries", entry, (unsigned long)failures);
+}
+
+@end
@@ -0,0 +1,33 @@
+#ifndef TRASH_QUEUE_CORE_H
+#define TRASH_QUEUE_CORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// TrashQueue's file system side, plain C so bench/ can check restart recovery
+// and time it against deleting in place on any host. TrashQueue keeps the
+// in-memory queue and the reaper; this only names, moves, lists and measures
+// trash entries.
+
+// Longest entry name TrashQueueMove produces, with its NUL.
+#define kTrashQueueNameSize 34
+
+// Renames path to trash/<name> and writes the name to name. Names are the
+// CLOCK_REALTIME nanoseconds and sequence, both fixed-width hex, so they sort
+// by age even within one clock tick. Returns 0 or the errno of rename(), which
+// fails with EXDEV when trash is on another volume.
+int TrashQueueMove(const char *path, const char *trash, uint64_t sequence, char name[kTrashQueueNameSize]);
+
+// The entries left in trash, oldest first: the queue after a restart. *names
+// holds *count malloc'd names in one malloc'd array; free them with
+// TrashQueueFreeNames. Returns 0 or an errno (ENOENT when there is no trash).
+int TrashQueueListEntries(const char *trash, char ***names, size_t *count);
+void TrashQueueFreeNames(char **names, size_t count);
+
+// Blocks allocated to the tree at path, in bytes, from one metadata-only pass
+// that does not cross volumes. Files with several links are counted once. An
+// upper bound on what removing the tree frees: st_blocks cannot tell blocks
+// shared with a clone or a snapshot, which stay allocated afterwards.
+uint64_t TrashQueueAllocatedBytes(const char *path);
+
+#endif
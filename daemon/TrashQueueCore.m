@@ -0,0 +1,136 @@
+#include "TrashQueueCore.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fts.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+// ---- Entries ----
+
+int TrashQueueMove(const char *path, const char *trash, uint64_t sequence, char name[kTrashQueueNameSize]) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    uint64_t nanos = (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+    snprintf(name, kTrashQueueNameSize, "%016llx-%016llx", (unsigned long long)nanos, (unsigned long long)sequence);
+
+    size_t length = strlen(trash) + 1 + strlen(name) + 1;
+    char *entry = malloc(length);
+    if (!entry) return ENOMEM;
+    snprintf(entry, length, "%s/%s", trash, name);
+    int err = rename(path, entry) == 0 ? 0 : errno;
+    free(entry);
+    return err;
+}
+
+static int compareNames(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+int TrashQueueListEntries(const char *trash, char ***names, size_t *count) {
+    *names = NULL;
+    *count = 0;
+    DIR *dir = opendir(trash);
+    if (!dir) return errno;
+    char **list = NULL;
+    size_t length = 0, capacity = 0;
+    int err = 0;
+    struct dirent *entry;
+    errno = 0;
+    while ((entry = readdir(dir))) {
+        const char *name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+        if (length == capacity) {
+            size_t grown = capacity ? capacity * 2 : 16;
+            char **bigger = realloc(list, grown * sizeof(char *));
+            if (!bigger) {
+                err = ENOMEM;
+                break;
+            }
+            list = bigger;
+            capacity = grown;
+        }
+        if (!(list[length] = strdup(name))) {
+            err = ENOMEM;
+            break;
+        }
+        length++;
+        errno = 0;
+    }
+    if (!err && errno) err = errno;
+    closedir(dir);
+    if (err) {
+        TrashQueueFreeNames(list, length);
+        return err;
+    }
+    if (length > 1) qsort(list, length, sizeof(char *), compareNames);
+    *names = list;
+    *count = length;
+    return 0;
+}
+
+void TrashQueueFreeNames(char **names, size_t count) {
+    for (size_t i = 0; i < count; i++) free(names[i]);
+    free(names);
+}
+
+// ---- Measuring ----
+
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    uint64_t bytes;
+} LinkedFile;
+
+static int compareLinkedFiles(const void *a, const void *b) {
+    const LinkedFile *x = a, *y = b;
+    if (x->dev != y->dev) return x->dev < y->dev ? -1 : 1;
+    if (x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+    return 0;
+}
+
+uint64_t TrashQueueAllocatedBytes(const char *path) {
+    char *roots[] = { (char *)path, NULL };
+    FTS *fts = fts_open(roots, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL);
+    if (!fts) return 0;
+    uint64_t bytes = 0;
+    // Files with several links, summed once each after the walk.
+    LinkedFile *linked = NULL;
+    size_t linkedCount = 0, linkedCapacity = 0;
+    FTSENT *entry;
+    while ((entry = fts_read(fts))) {
+        if (entry->fts_info == FTS_DP || entry->fts_info == FTS_DNR || entry->fts_info == FTS_ERR ||
+            entry->fts_info == FTS_NS || !entry->fts_statp) {
+            continue;
+        }
+        const struct stat *st = entry->fts_statp;
+        uint64_t blocks = (uint64_t)st->st_blocks * 512;
+        if (S_ISDIR(st->st_mode) || st->st_nlink < 2) {
+            bytes += blocks;
+            continue;
+        }
+        if (linkedCount == linkedCapacity) {
+            size_t grown = linkedCapacity ? linkedCapacity * 2 : 64;
+            LinkedFile *bigger = realloc(linked, grown * sizeof(LinkedFile));
+            if (!bigger) {
+                // Out of memory: count it again rather than not at all.
+                bytes += blocks;
+                continue;
+            }
+            linked = bigger;
+            linkedCapacity = grown;
+        }
+        linked[linkedCount++] = (LinkedFile){ st->st_dev, st->st_ino, blocks };
+    }
+    fts_close(fts);
+    if (linkedCount > 1) qsort(linked, linkedCount, sizeof(LinkedFile), compareLinkedFiles);
+    for (size_t i = 0; i < linkedCount; i++) {
+        if (i == 0 || compareLinkedFiles(&linked[i - 1], &linked[i]) != 0) bytes += linked[i].bytes;
+    }
+    free(linked);
+    return bytes;
+}
@@ -0,0 +1,26 @@
+#import <Foundation/Foundation.h>
+#include <sys/types.h>
+
+// Owner and mode applied to every entry of a container tree (symlinks only get
+// the owner).
+typedef struct {
+    uid_t uid;
+    gid_t gid;
+    mode_t mode;
+} TreeOwnership;
+
+// mobile:mobile 0755, what app containers expect.
+const TreeOwnership *MobileOwnership(void);
+
+// Fixes a single entry (not its children).
+BOOL fixupItemOwnership(NSString *path, const TreeOwnership *owner);
+
+// One streaming fts pass over path (constant memory, symlinks not followed)
+// that applies owner/mode; entries that already match are not written.
+// Returns the number of entries that could not be fixed.
+NSUInteger fixupTreeOwnership(NSString *path, const TreeOwnership *owner);
+
+// Copies src to dst (which must not exist) in one fts pass. With owner set,
+// each created entry gets it in the same pass, so no separate fixup walk is
+// needed; without, the source mode/owner/times are preserved.
+BOOL copyTreeWithOwnership(NSString *src, NSString *dst, const TreeOwnership *owner, NSError **error);
@@ -0,0 +1,158 @@
+#import "TreeWalker.h"
+#import "ProjectXLogging.h"
+#include <copyfile.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fts.h>
+#include <pwd.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const TreeOwnership *MobileOwnership(void) {
+    static TreeOwnership mobile = { 501, 501, 0755 };
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        struct passwd *pw = getpwnam("mobile");
+        if (pw) {
+            mobile.uid = pw->pw_uid;
+            mobile.gid = pw->pw_gid;
+        }
+    });
+    return &mobile;
+}
+
+// Applies owner to one entry given its current stat; returns NO on failure.
+static BOOL applyOwnership(const char *path, const struct stat *st, const TreeOwnership *owner) {
+    if ((st->st_uid != owner->uid || st->st_gid != owner->gid) &&
+        fchownat(AT_FDCWD, path, owner->uid, owner->gid, AT_SYMLINK_NOFOLLOW) != 0) {
+        return NO;
+    }
+    if (!S_ISLNK(st->st_mode) && (st->st_mode & 07777) != owner->mode &&
+        fchmodat(AT_FDCWD, path, owner->mode, 0) != 0) {
+        return NO;
+    }
+    return YES;
+}
+
+BOOL fixupItemOwnership(NSString *path, const TreeOwnership *owner) {
+    struct stat st;
+    if (lstat(path.fileSystemRepresentation, &st) != 0) return NO;
+    return applyOwnership(path.fileSystemRepresentation, &st, owner);
+}
+
+NSUInteger fixupTreeOwnership(NSString *path, const TreeOwnership *owner) {
+    char *roots[] = { (char *)path.fileSystemRepresentation, NULL };
+    FTS *fts = fts_open(roots, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL);
+    if (!fts) return 1;
+
+    NSUInteger failures = 0;
+    FTSENT *entry;
+    while ((entry = fts_read(fts))) {
+        switch (entry->fts_info) {
+            case FTS_DP:
+                break;
+            case FTS_NS:
+            case FTS_ERR:
+                if (entry->fts_errno != ENOENT) failures++;
+                break;
+            case FTS_DNR:
+                // Unreadable directory: fixing its mode lets the next walk descend.
+                if (!applyOwnership(entry->fts_accpath, entry->fts_statp, owner)) failures++;
+                break;
+            default:
+                // Directories are fixed in preorder, before fts reads their children.
+                if (!applyOwnership(entry->fts_accpath, entry->fts_statp, owner)) failures++;
+                break;
+        }
+    }
+    fts_close(fts);
+    return failures;
+}
+
+static BOOL copyEntry(FTSENT *entry, const char *dst, const TreeOwnership *owner) {
+    const struct stat *st = entry->fts_statp;
+    switch (entry->fts_info) {
+        case FTS_D:
+            if (mkdir(dst, owner ? owner->mode : (st->st_mode & 07777)) != 0) return NO;
+            break;
+        case FTS_F: {
+            copyfile_flags_t flags = COPYFILE_NOFOLLOW | (owner ? (COPYFILE_DATA | COPYFILE_XATTR) : COPYFILE_ALL);
+            if (copyfile(entry->fts_accpath, dst, NULL, flags) != 0) return NO;
+            break;
+        }
+        case FTS_SL:
+        case FTS_SLNONE: {
+            char target[PATH_MAX];
+            ssize_t n = readlink(entry->fts_accpath, target, sizeof(target) - 1);
+            if (n < 0) return NO;
+            target[n] = '\0';
+            if (symlink(target, dst) != 0) return NO;
+            break;
+        }
+        default:
+            // Sockets, fifos and devices have no place in a container backup.
+            return YES;
+    }
+    if (!owner) {
+        if (fchownat(AT_FDCWD, dst, st->st_uid, st->st_gid, AT_SYMLINK_NOFOLLOW) != 0 && errno != EPERM) return NO;
+        return YES;
+    }
+    struct stat created;
+    return fstatat(AT_FDCWD, dst, &created, AT_SYMLINK_NOFOLLOW) == 0 && applyOwnership(dst, &created, owner);
+}
+
+BOOL copyTreeWithOwnership(NSString *src, NSString *dst, const TreeOwnership *owner, NSError **error) {
+    char *roots[] = { (char *)src.fileSystemRepresentation, NULL };
+    FTS *fts = fts_open(roots, FTS_PHYSICAL | FTS_NOCHDIR | FTS_XDEV, NULL);
+    if (!fts) {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:nil];
+        return NO;
+    }
+
+    // Destination path = dst + (entry path minus the src prefix); one reusable buffer.
+    const char *dstRoot = dst.fileSystemRepresentation;
+    size_t dstLen = strlen(dstRoot);
+    char target[PATH_MAX];
+    if (dstLen >= sizeof(target)) {
+        fts_close(fts);
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:ENAMETOOLONG userInfo:nil];
+        return NO;
+    }
+    memcpy(target, dstRoot, dstLen);
+
+    int failure = 0;
+    FTSENT *entry;
+    size_t srcLen = strlen(roots[0]);
+    while ((entry = fts_read(fts))) {
+        if (entry->fts_info == FTS_DNR || entry->fts_info == FTS_ERR || entry->fts_info == FTS_NS) {
+            failure = entry->fts_errno;
+            break;
+        }
+        // fts_path of the root is src itself, children are "<src>/<relative>".
+        size_t rootLen = entry->fts_level == 0 ? entry->fts_pathlen : srcLen;
+        size_t relLen = entry->fts_pathlen - rootLen;
+        if (dstLen + relLen >= sizeof(target)) {
+            failure = ENAMETOOLONG;
+            break;
+        }
+        memcpy(target + dstLen, entry->fts_path + rootLen, relLen + 1);
+
+        if (entry->fts_info == FTS_DP) {
+            if (!owner) {
+                // Directory times are set once its children have been written.
+                struct timespec times[2] = { entry->fts_statp->st_atimespec, entry->fts_statp->st_mtimespec };
+                utimensat(AT_FDCWD, target, times, AT_SYMLINK_NOFOLLOW);
+            }
+            continue;
+        }
+        if (!copyEntry(entry, target, owner)) {
+            failure = errno ?: EIO;
+            PXLog(@"[TreeWalker] Copy failed at %s: %s", entry->fts_path, strerror(failure));
+            break;
+        }
+    }
+    fts_close(fts);
+    if (failure && error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain code:failure userInfo:nil];
+    return failure == 0;
+}
@@ -9,7 +9,15 @@
 #import "DataGenManager.h"
 #import "ActionManager.h"
 #import "ProfileManager.h"
-#import "DBManager.h"
+#import "DeviceCatalog.h"
+#import "JobManager.h"
+#import "BackupRules.h"
+#import "TrashQueue.h"
+#import "DiskUsageIndex.h"
+
+// Longest a /jobStatus long-poll is held open; stays below the client's long-poll
+// request timeout (kJobPollTimeout in DaemonApiManager.m).
+static const NSTimeInterval kJobStatusMaxWait = 25.0;
 
 NSDictionary* getJsonBody(GCDWebServerDataRequest *request, NSError **jsonError)
 {
@@ -98,12 +106,15 @@ GCDWebServerErrorResponse* jsonFormatErrorResponse()
                       requestClass:[GCDWebServerDataRequest class] // 必须是 DataRequest 才能读取 Body
                       processBlock:^GCDWebServerResponse *(GCDWebServerDataRequest *request) {
 
-        [[ActionManager sharedManager] newPhone];
+        DaemonJob *job = [[JobManager sharedManager] submitJobWithType:@"newPhone" work:^BOOL(DaemonJob *runningJob, NSString **error) {
+            return [[ActionManager sharedManager] newPhone:runningJob];
+        }];
         NSMutableSet *scopeSet = [[AppScopeManager sharedManager] loadPreferences];
         NSArray *scopedApps = scopeSet ? [scopeSet allObjects] : @[];
         return dataResponse(@{
             @"status": @"success",
-            @"data": scopedApps
+            @"data": scopedApps,
+            @"jobId": job.jobId
         });
     }];
 
@@ -136,6 +147,57 @@ GCDWebServerErrorResponse* jsonFormatErrorResponse()
     });
 }];
 
+[webServer addHandlerForMethod:@"POST"
+                          path:SAVE_BACKUP_RULES
+                  requestClass:[GCDWebServerDataRequest class]
+                  processBlock:^GCDWebServerResponse *(GCDWebServerRequest *request) {
+    NSError *error = nil;
+    NSDictionary *body = jsonObjectFromRequest((GCDWebServerDataRequest *)request, &error);
+    if (error || ![body isKindOfClass:[NSDictionary class]]) {
+        return jsonFormatErrorResponse();
+    }
+    NSString *message = nil;
+    if (![[BackupRules sharedManager] saveRules:body[@"data"] error:&message]) {
+        return dataResponse(@{
+            @"status": @"error",
+            @"message": message ?: @"invalid rules"
+        });
+    }
+    return staticSuccessResponse();
+}];
+
+[webServer addHandlerForMethod:@"GET"
+                          path:GET_BACKUP_RULES
+                  requestClass:[GCDWebServerRequest class]
+                  processBlock:^GCDWebServerResponse *(GCDWebServerRequest *request) {
+    return dataResponse(@{
+        @"status": @"success",
+        @"data": [[BackupRules sharedManager] loadRules]
+    });
+}];
+
+[webServer addHandlerForMethod:@"GET"
+                          path:TRASH_STATUS
+                  requestClass:[GCDWebServerRequest class]
+                  processBlock:^GCDWebServerResponse *(GCDWebServerRequest *request) {
+    return dataResponse(@{
+        @"status": @"success",
+        @"data": [[TrashQueue sharedManager] status]
+    });
+}];
+
+[webServer addHandlerForMethod:@"GET"
+                          path:DISK_USAGE
+                  requestClass:[GCDWebServerRequest class]
+                  processBlock:^GCDWebServerResponse *(GCDWebServerRequest *request) {
+    NSString *profileId = request.query[@"id"];
+    DiskUsageIndex *index = [DiskUsageIndex sharedManager];
+    return dataResponse(@{
+        @"status": @"success",
+        @"data": profileId ? ([index usageForProfile:profileId] ?: @{}) : [index usage]
+    });
+}];
+
     // 保存选中应用
     [webServer addHandlerForMethod:@"POST"
                               path:SAVE_SCOPE_APPS
@@ -227,19 +289,62 @@ GCDWebServerErrorResponse* jsonFormatErrorResponse()
         if (error || !dict) {
             return jsonFormatErrorResponse();
         }
-        [[ActionManager sharedManager] switchBackup:dict[@"id"]];
-        return staticSuccessResponse();
+        NSString *profileId = dict[@"id"];
+        DaemonJob *job = [[JobManager sharedManager] submitJobWithType:@"switchBackup" work:^BOOL(DaemonJob *runningJob, NSString **error) {
+            return [[ActionManager sharedManager] switchBackup:profileId job:runningJob];
+        }];
+        return dataResponse(@{
+            @"status": @"success",
+            @"jobId": job.jobId
+        });
+    }];
+
+    // 任务进度: /jobStatus?id=<jobId>&since=<seq>&wait=<秒>
+    // since 为上次拿到的 seq，任务有新进度或结束时立即返回，否则最多挂起 wait 秒
+    [webServer addHandlerForMethod:@"GET"
+                              path:JOB_STATUS
+                      requestClass:[GCDWebServerRequest class]
+                 asyncProcessBlock:^(GCDWebServerRequest *request, GCDWebServerCompletionBlock completionBlock) {
+        DaemonJob *job = [[JobManager sharedManager] jobWithId:request.query[@"id"]];
+        if (!job) {
+            completionBlock(missingParamResponse());
+            return;
+        }
+        NSString *sinceParam = request.query[@"since"];
+        NSTimeInterval wait = MIN(MAX([request.query[@"wait"] doubleValue], 0), kJobStatusMaxWait);
+        if (!sinceParam || wait <= 0) {
+            completionBlock(dataResponse(@{ @"status": @"success", @"data": [job toDictionary] }));
+            return;
+        }
+        uint64_t since = strtoull(sinceParam.UTF8String, NULL, 10);
+        // 不占用线程等待：任务变化或超时时才回调
+        [job notifyWhenChangedSince:since timeout:wait handler:^{
+            completionBlock(dataResponse(@{ @"status": @"success", @"data": [job toDictionary] }));
+        }];
+    }];
+
+    [webServer addHandlerForMethod:@"POST"
+                              path:CANCEL_JOB
+                      requestClass:[GCDWebServerDataRequest class]
+                      processBlock:^GCDWebServerResponse *(GCDWebServerDataRequest *request){
+        NSError *error = nil;
+        NSDictionary *dict = getJsonBody(request, &error);
+        if (error || ![dict isKindOfClass:[NSDictionary class]]) {
+            return jsonFormatErrorResponse();
+        }
+        BOOL cancelled = [[JobManager sharedManager] cancelJob:dict[@"id"]];
+        return dataResponse(@{
+            @"status": cancelled ? @"success" : @"error"
+        });
     }];
 
     [webServer addHandlerForMethod:@"GET"
                               path:GET_ALL_CARRIER
                       requestClass:[GCDWebServerRequest class] 
                       processBlock:^GCDWebServerResponse *(GCDWebServerRequest *request) {
-        NSArray<NSDictionary *> * data = [[DBManager sharedManager] query:@"select DISTINCT code from operator"];
-        NSArray *codes = data ? [data valueForKey:@"code"] : @[];
         return dataResponse(@{
             @"status": @"success",
-            @"data": codes
+            @"data": [DeviceCatalog sharedManager].operatorCodes
         });
     }];
 
@@ -247,11 +352,9 @@ GCDWebServerErrorResponse* jsonFormatErrorResponse()
                               path:GET_ALL_VERSIONS
                       requestClass:[GCDWebServerRequest class] 
                       processBlock:^GCDWebServerResponse *(GCDWebServerRequest *request) {
-        NSArray<NSDictionary *> * data = [[DBManager sharedManager] query:@"select version from KMOS"];
-        NSArray *versions = data ? [data valueForKey:@"version"] : @[];
         return dataResponse(@{
             @"status": @"success",
-            @"data": versions
+            @"data": [DeviceCatalog sharedManager].versionNames
         });
     }];
 
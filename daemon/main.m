@@ -1,5 +1,10 @@
 #import <Foundation/Foundation.h>
 #import "WebServerManager.h"
+#import "DeviceCatalog.h"
+#import "PhoneInfoPool.h"
+#import "ActionManager.h"
+#import "TrashQueue.h"
+#import "DiskUsageIndex.h"
 #import "kern_memorystatus.h"
 
 int main(int argc, char *argv[]) {
@@ -19,6 +24,16 @@ int main(int argc, char *argv[]) {
     if (rc < 0) { perror ("memorystatus_control"); exit(rc); }
 
     @autoreleasepool {
+        // 启动时一次性加载设备目录，之后生成参数不再查库
+        [DeviceCatalog sharedManager];
+        // 后台预生成新机参数，设置变更时自动重建
+        [[PhoneInfoPool sharedManager] scheduleRefill];
+        // 旧的平铺备份目录在空闲时迁移到分级布局
+        [[ActionManager sharedManager] scheduleLayoutMigration];
+        // 上次未删完的回收站条目在后台继续删除
+        [TrashQueue sharedManager];
+        // 空闲时校准磁盘占用索引（每天最多一次）
+        [[DiskUsageIndex sharedManager] scheduleReconcile];
         // 启动 Web 服务器
         [WebServerManager startWebServer];
         
@@ -7,30 +7,30 @@
 
 // Configuration for fingerprint noise
 #import "PXHookOptions.h"
+#import "PXConcurrentMap.h"
 static CGFloat kNoiseIntensity = 0.02;  // Default noise intensity (2% variation)
 static BOOL kConsistentNoise = YES;     // Whether to use consistent noise per session
 
 // Cache for noise seed values (to keep consistent noise per app session)
-static NSMutableDictionary *noiseSeedCache = nil;
+static PXConcurrentMap *noiseSeedCache = NULL;
 
 #pragma mark - Helper Functions
 
 // Get or create a noise seed for consistent variations
 static NSInteger getNoiseSeedForBundle(NSString *bundleID) {
-    if (!noiseSeedCache) {
-        noiseSeedCache = [NSMutableDictionary dictionary];
-    }
-    
-    NSNumber *cachedSeed = noiseSeedCache[bundleID];
-    if (cachedSeed) {
-        return [cachedSeed integerValue];
-    }
-    
-    // Create a new random seed
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        noiseSeedCache = PXConcurrentMapCreate(64);
+    });
+
+    char buf[PX_CMAP_KEY_BUFSIZE];
+    size_t len = 0;
+    const char *key = PXConcurrentMapKeyFromCFString((__bridge CFStringRef)bundleID, buf, sizeof(buf), &len);
+
+    // Create a new random seed; the first writer wins so every thread sees the same one
     NSInteger seed = arc4random_uniform(1000000);
-    noiseSeedCache[bundleID] = @(seed);
-    
-    return seed;
+    if (!key) return seed;
+    return (NSInteger)PXConcurrentMapGetOrInsert(noiseSeedCache, key, len, seed, NULL);
 }
 
 // Add subtle noise to image data based on seed
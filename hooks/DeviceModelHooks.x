@@ -12,6 +12,9 @@
 
 // Define the swap usage structure if it's not available
 #import "PXHookOptions.h"
+#import "PXHookProfiler.h"
+#import "PXConcurrentMap.h"
+#import "PXHookCore.h"
 #ifndef HAVE_XSW_USAGE
 typedef struct xsw_usage xsw_usage;
 #endif
@@ -23,70 +26,15 @@ static int (*orig_sysctl)(int *, u_int, void *, size_t *, void *, size_t);
 static __thread BOOL px_sysctlbyname_in_hook = NO;
 
 // Log throttling: log each sysctl key once per process (to avoid spam)
-static CFMutableSetRef gPXLoggedSysctlKeys = NULL;
+static PXConcurrentMap *gPXLoggedSysctlKeys = NULL;
 
-static void PXEnsureLoggedSysctlKeySet(void) {
+static BOOL PXShouldLogSysctlKeyOnce(const char *name) {
+    if (!name) return NO;
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        gPXLoggedSysctlKeys = CFSetCreateMutable(kCFAllocatorDefault, 0, &kCFTypeSetCallBacks);
+        gPXLoggedSysctlKeys = PXConcurrentMapCreate(128);
     });
-}
-
-static BOOL PXShouldLogSysctlKeyOnce(const char *name) {
-    if (!name) return NO;
-    PXEnsureLoggedSysctlKeySet();
-    CFStringRef key = CFStringCreateWithCString(kCFAllocatorDefault, name, kCFStringEncodingUTF8);
-    if (!key) return NO;
-    BOOL should = !CFSetContainsValue(gPXLoggedSysctlKeys, key);
-    if (should) CFSetAddValue(gPXLoggedSysctlKeys, key);
-    CFRelease(key);
-    return should;
-}
-
-static int PXWriteSysctlCString(const char *name, const char *value, void *oldp, size_t *oldlenp) {
-    if (!oldlenp || !value) { errno = EINVAL; return -1; }
-    size_t required = strlen(value) + 1; // include NUL
-    if (!oldp) {
-        *oldlenp = required;
-        return 0;
-    }
-    if (*oldlenp < required) {
-        *oldlenp = required;
-        errno = ENOMEM;
-        return -1;
-    }
-    memset(oldp, 0, *oldlenp);
-    memcpy(oldp, value, required);
-    *oldlenp = required;
-    return 0;
-}
-
-static int PXWriteSysctlInt64(const char *name, int64_t v, void *oldp, size_t *oldlenp) {
-    if (!oldlenp) { errno = EINVAL; return -1; }
-    // Keep caller's expected size when possible
-    if (!oldp) {
-        // Ask original for size if available; otherwise default to 8
-        *oldlenp = (*oldlenp ? *oldlenp : sizeof(int64_t));
-        return 0;
-    }
-    if (*oldlenp == sizeof(int)) {
-        *(int *)oldp = (int)v;
-        return 0;
-    }
-    if (*oldlenp == sizeof(uint32_t)) {
-        *(uint32_t *)oldp = (uint32_t)v;
-        return 0;
-    }
-    if (*oldlenp == sizeof(unsigned long)) {
-        *(unsigned long *)oldp = (unsigned long)v;
-        return 0;
-    }
-    if (*oldlenp >= sizeof(int64_t)) {
-        *(int64_t *)oldp = (int64_t)v;
-        return 0;
-    }
-    errno = ENOMEM;
-    return -1;
+    return PXConcurrentMapInsertOnce(gPXLoggedSysctlKeys, name, strlen(name));
 }
 
 %ctor {
@@ -157,6 +105,7 @@ static int hook_uname(struct utsname *buf) {
 
 // Hook for sysctlbyname - another common way to get device model
 static int hook_sysctlbyname(const char *name, void *oldp, size_t *oldlenp, void *newp, size_t newlen) {
+    PX_HOOK_PROFILE_SCOPE("sysctlbyname");
     if (!orig_sysctlbyname) return -1;
     if (px_sysctlbyname_in_hook) return orig_sysctlbyname(name, oldp, oldlenp, newp, newlen);
     if (!name) { errno = EINVAL; return -1; }
@@ -183,7 +132,7 @@ static int hook_sysctlbyname(const char *name, void *oldp, size_t *oldlenp, void
     // kern.ostype => "Darwin"
     if (strcmp(name, "kern.ostype") == 0) {
         const char *v = "Darwin";
-        int r = PXWriteSysctlCString(name, v, oldp, oldlenp);
+        int r = PXWriteSysctlCString(v, oldp, oldlenp);
         if (r == 0 && PXShouldLogSysctlKeyOnce(name)) {
             PXLog(@"[model] Spoofed sysctlbyname %s from: %s to: %s for app: %@", name, originalValue, v, bundleID);
         }
@@ -195,7 +144,7 @@ static int hook_sysctlbyname(const char *name, void *oldp, size_t *oldlenp, void
     if (strcmp(name, "kern.osrelease") == 0) {
         const char *v = iv.darwin ? [iv.darwin UTF8String] : NULL;
         if (v) {
-            int r = PXWriteSysctlCString(name, v, oldp, oldlenp);
+            int r = PXWriteSysctlCString(v, oldp, oldlenp);
             if (r == 0 && PXShouldLogSysctlKeyOnce(name)) {
                 PXLog(@"[model] Spoofed sysctlbyname %s from: %s to: %s for app: %@", name, originalValue, v, bundleID);
             }
@@ -208,7 +157,7 @@ static int hook_sysctlbyname(const char *name, void *oldp, size_t *oldlenp, void
     if (strcmp(name, "kern.version") == 0) {
         const char *v = iv.kernelVersion ? [iv.kernelVersion UTF8String] : NULL;
         if (v) {
-            int r = PXWriteSysctlCString(name, v, oldp, oldlenp);
+            int r = PXWriteSysctlCString(v, oldp, oldlenp);
             if (r == 0 && PXShouldLogSysctlKeyOnce(name)) {
                 PXLog(@"[model] Spoofed sysctlbyname %s for app: %@", name, bundleID);
             }
@@ -221,7 +170,7 @@ static int hook_sysctlbyname(const char *name, void *oldp, size_t *oldlenp, void
     if (strcmp(name, "kern.hostname") == 0) {
         const char *v = info.deviceName ? [info.deviceName UTF8String] : NULL;
         if (v) {
-            int r = PXWriteSysctlCString(name, v, oldp, oldlenp);
+            int r = PXWriteSysctlCString(v, oldp, oldlenp);
             if (r == 0 && PXShouldLogSysctlKeyOnce(name)) {
                 PXLog(@"[model] Spoofed sysctlbyname %s from: %s to: %s for app: %@", name, originalValue, v, bundleID);
             }
@@ -248,7 +197,7 @@ static int hook_sysctlbyname(const char *name, void *oldp, size_t *oldlenp, void
                 return 0;
             }
 
-            int r = PXWriteSysctlInt64(name, cores, oldp, oldlenp);
+            int r = PXWriteSysctlInt64(cores, oldp, oldlenp);
             if (r == 0 && PXShouldLogSysctlKeyOnce(name)) {
                 PXLog(@"[model] Spoofed sysctlbyname %s from: %s to: %lld for app: %@", name, originalValue, (long long)cores, bundleID);
             }
@@ -272,7 +221,7 @@ static int hook_sysctlbyname(const char *name, void *oldp, size_t *oldlenp, void
 
     if (spoofedStr) {
         const char *v = [spoofedStr UTF8String];
-        int r = PXWriteSysctlCString(name, v, oldp, oldlenp);
+        int r = PXWriteSysctlCString(v, oldp, oldlenp);
         if (r == 0 && PXShouldLogSysctlKeyOnce(name)) {
             PXLog(@"[model] Spoofed sysctlbyname %s from: %s to: %s for app: %@", name, originalValue, v, bundleID);
         }
@@ -291,7 +240,7 @@ static int hook_sysctlbyname(const char *name, void *oldp, size_t *oldlenp, void
                 px_sysctlbyname_in_hook = NO;
                 return 0;
             }
-            int r = PXWriteSysctlInt64(name, cores, oldp, oldlenp);
+            int r = PXWriteSysctlInt64(cores, oldp, oldlenp);
             if (r == 0 && PXShouldLogSysctlKeyOnce(name)) {
                 PXLog(@"[model] Spoofed sysctlbyname %s to: %lld for app: %@", name, (long long)cores, bundleID);
             }
@@ -12,6 +12,7 @@
 #import <mach-o/arch.h>
 #import <dlfcn.h>
 #import "DataManager.h"
+#import "PXDeviceSpecCache.h"
 
 
 // Original function pointers
@@ -32,32 +33,13 @@ static void logMemoryHook(NSString *apiName);
 
 // Function declarations
 
-static float getFreeMemoryPercentage(void);
-static void getConsistentMemoryStats(unsigned long long totalMemory, 
-                                    unsigned long long *freeMemory,
-                                    unsigned long long *wiredMemory,
-                                    unsigned long long *activeMemory,
-                                    unsigned long long *inactiveMemory);
 static kern_return_t hook_host_statistics64(host_t host, host_flavor_t flavor, host_info64_t info, mach_msg_type_number_t *count);
 static NXArchInfo* hook_nx_get_local_arch_info();
 
-static CGSize parseResolution(NSString *resolutionString);
 
 #pragma mark - Helper Functions
 
 
-// Parse resolution string (e.g., "2556x1179") into CGSize
-static CGSize parseResolution(NSString *resolutionString) {
-    if (!resolutionString) return CGSizeZero;
-    
-    NSArray *components = [resolutionString componentsSeparatedByString:@"x"];
-    if (components.count != 2) return CGSizeZero;
-    
-    CGFloat width = [components[0] floatValue];
-    CGFloat height = [components[1] floatValue];
-    
-    return CGSizeMake(width, height);
-}
 // 这堆修改屏幕大小的功能会导致部分应用闪退，后续作为可选配置打开
 #pragma mark - UIScreen Hooks
 
@@ -72,55 +54,34 @@ static CGSize parseResolution(NSString *resolutionString) {
 - (CGRect)bounds {
     CGRect originalBounds = %orig;
     
-    DeviceModel *model = CurrentPhoneInfo().deviceModel;
-    if (!model) {
-        return originalBounds;
-    }
-    
-    // Get the viewport resolution and device pixel ratio from specs
-    NSString *viewportResString = model.viewportResolution;
-    CGFloat pixelRatio = [model.devicePixelRatio floatValue];
-    
-    if (!viewportResString || pixelRatio <= 0) {
+    // Viewport / device pixel ratio, precomputed per profile
+    const PXDeviceSpecValues *spec = PXCurrentDeviceSpec();
+    if (!spec->hasBounds) {
         return originalBounds;
     }
     
-    // Parse the viewport resolution
-    CGSize viewportSize = parseResolution(viewportResString);
-    if (CGSizeEqualToSize(viewportSize, CGSizeZero)) {
-        return originalBounds;
-    }
-    
-    // Calculate bounds in points (logical pixels)
-    CGFloat width = viewportSize.width / pixelRatio;
-    CGFloat height = viewportSize.height / pixelRatio;
+    // bounds follows the interface orientation; keep the original's orientation
+    BOOL landscape = originalBounds.size.width > originalBounds.size.height;
+    CGRect spoofedBounds = landscape ? spec->boundsLandscape : spec->boundsPortrait;
     
     // Log the change the first time
     static BOOL loggedScreenBounds = NO;
     if (!loggedScreenBounds) {
         PXLog(@"[DeviceSpec] Spoofing UIScreen bounds from %@ to %@",
              NSStringFromCGRect(originalBounds),
-             NSStringFromCGRect(CGRectMake(0, 0, width, height)));
+             NSStringFromCGRect(spoofedBounds));
         loggedScreenBounds = YES;
     }
     
-    return CGRectMake(0, 0, width, height);
+    return spoofedBounds;
 }
 
 // Hook for nativeBounds (actual pixels)
 - (CGRect)nativeBounds {
     CGRect originalNativeBounds = %orig;
     
-    
-    // Get the screen resolution from specs
-    NSString *screenResString = CurrentPhoneInfo().deviceModel.resolution;
-    if (!screenResString) {
-        return originalNativeBounds;
-    }
-    
-    // Parse the screen resolution
-    CGSize screenSize = parseResolution(screenResString);
-    if (CGSizeEqualToSize(screenSize, CGSizeZero)) {
+    const PXDeviceSpecValues *spec = PXCurrentDeviceSpec();
+    if (!spec->hasNativeBounds) {
         return originalNativeBounds;
     }
     
@@ -129,35 +90,30 @@ static CGSize parseResolution(NSString *resolutionString) {
     if (!loggedNativeBounds) {
         PXLog(@"[DeviceSpec] Spoofing UIScreen nativeBounds from %@ to %@",
              NSStringFromCGRect(originalNativeBounds),
-             NSStringFromCGRect(CGRectMake(0, 0, screenSize.width, screenSize.height)));
+             NSStringFromCGRect(spec->nativeBounds));
         loggedNativeBounds = YES;
     }
     
-    return CGRectMake(0, 0, screenSize.width, screenSize.height);
+    return spec->nativeBounds;
 }
 
 // Hook for scale (affects UI element sizes)
 - (CGFloat)scale {
     CGFloat originalScale = %orig;
-    DeviceModel *model = CurrentPhoneInfo().deviceModel;
-    if (!model) {
-        return originalScale;
-    }
     
-    // Get the device pixel ratio from specs
-    CGFloat pixelRatio = [model.devicePixelRatio floatValue];
-    if (pixelRatio <= 0) {
+    const PXDeviceSpecValues *spec = PXCurrentDeviceSpec();
+    if (!spec->hasScale) {
         return originalScale;
     }
     
     // Log the change the first time
     static BOOL loggedScale = NO;
     if (!loggedScale) {
-        PXLog(@"[DeviceSpec] Spoofing UIScreen scale from %.2f to %.2f", originalScale, pixelRatio);
+        PXLog(@"[DeviceSpec] Spoofing UIScreen scale from %.2f to %.2f", originalScale, spec->scale);
         loggedScale = YES;
     }
     
-    return pixelRatio;
+    return spec->scale;
 }
 
 
@@ -171,29 +127,21 @@ static CGSize parseResolution(NSString *resolutionString) {
 - (CGFloat)native_scale {
     CGFloat originalScale = %orig;
     
-    DeviceModel *model = CurrentPhoneInfo().deviceModel;
-    if (!model) {
-        return originalScale;
-    }
-    
-    // Calculate from screen density (PPI)
-    NSInteger screenDensity = [model.screenDensity integerValue];
-    if (screenDensity <= 0) {
+    // screenDensity / 163 PPI, precomputed per profile
+    const PXDeviceSpecValues *spec = PXCurrentDeviceSpec();
+    if (!spec->hasNativeScale) {
         return originalScale;
     }
     
-    // iPhone reference point is 163 PPI for scale 1.0
-    CGFloat spoofedScale = screenDensity / 163.0;
-    
     // Log the change the first time
     static BOOL loggedNativeScale = NO;
     if (!loggedNativeScale) {
         PXLog(@"[DeviceSpec] Spoofing native scale from %.2f to %.2f (density: %ld PPI)",
-             originalScale, spoofedScale, (long)screenDensity);
+             originalScale, spec->nativeScale, (long)spec->screenDensity);
         loggedNativeScale = YES;
     }
     
-    return spoofedScale;
+    return spec->nativeScale;
 }
 
 %end
@@ -205,25 +153,18 @@ static CGSize parseResolution(NSString *resolutionString) {
 // Hook for physical memory (RAM)
 - (unsigned long long)physicalMemory {
     unsigned long long originalMemory = %orig;  
-    DeviceModel *model = CurrentPhoneInfo().deviceModel;
-    if (!model) {
+    const PXDeviceSpecValues *spec = PXCurrentDeviceSpec();
+    if (!spec->hasMemory) {
         return originalMemory;
     }
     
-    // Get the device memory from specs (in GB)
-    NSInteger deviceMemoryGB = [model.deviceMemory integerValue];
-    if (deviceMemoryGB <= 0) {
-        return originalMemory;
-    }
-    
-    // Convert GB to bytes
-    unsigned long long spoofedMemory = deviceMemoryGB * 1024 * 1024 * 1024;
+    unsigned long long spoofedMemory = spec->memory.totalBytes;
     
     // Log the change the first time
     static BOOL loggedMemory = NO;
     if (!loggedMemory) {
         PXLog(@"[DeviceSpec] Spoofing device memory from %llu bytes to %llu bytes (%ld GB)",
-             originalMemory, spoofedMemory, (long)deviceMemoryGB);
+             originalMemory, spoofedMemory, (long)spec->memoryGB);
         loggedMemory = YES;
     }
     
@@ -246,29 +187,19 @@ static CGSize parseResolution(NSString *resolutionString) {
 - (unsigned long long)availableMemory {
     unsigned long long originalAvailableMemory = %orig;
     
-    DeviceModel *model = CurrentPhoneInfo().deviceModel;
-    if (!model) {
-        return originalAvailableMemory;
-    }
-    
-    // Get the device memory from specs (in GB)
-    NSInteger deviceMemoryGB = [model.deviceMemory integerValue];
-    if (deviceMemoryGB <= 0) {
+    // Free share of the spoofed RAM, precomputed per profile
+    const PXDeviceSpecValues *spec = PXCurrentDeviceSpec();
+    if (!spec->hasMemory) {
         return originalAvailableMemory;
     }
     
-    // Calculate total memory
-    unsigned long long totalMemory = deviceMemoryGB * 1024 * 1024 * 1024;
-    
-    // Calculate free memory based on typical iOS behavior
-    float freePercentage = getFreeMemoryPercentage();
-    unsigned long long spoofedAvailableMemory = (unsigned long long)(totalMemory * freePercentage);
+    unsigned long long spoofedAvailableMemory = spec->memory.freeBytes;
     
     // Log the change the first time
     static BOOL loggedAvailableMemory = NO;
     if (!loggedAvailableMemory) {
         PXLog(@"[DeviceSpec] Spoofing available memory from %llu bytes to %llu bytes (%.1f%% of %ld GB)",
-             originalAvailableMemory, spoofedAvailableMemory, freePercentage * 100, (long)deviceMemoryGB);
+             originalAvailableMemory, spoofedAvailableMemory, spec->freePermille / 10.0, (long)spec->memoryGB);
         loggedAvailableMemory = YES;
     }
     
@@ -278,26 +209,20 @@ static CGSize parseResolution(NSString *resolutionString) {
 // Hook for processor count
 - (NSUInteger)processorCount {
     NSUInteger originalCount = %orig;
-    DeviceModel *model = CurrentPhoneInfo().deviceModel;
-    if (!model) {
-        return originalCount;
-    }
-    
-    // Get CPU core count from specs
-    NSInteger cpuCoreCount = [model.cpuCoreCount integerValue];
-    if (cpuCoreCount <= 0) {
+    const PXDeviceSpecValues *spec = PXCurrentDeviceSpec();
+    if (!spec->hasProcessorCount) {
         return originalCount;
     }
     
     // Log the change the first time
     static BOOL loggedProcessorCount = NO;
     if (!loggedProcessorCount) {
-        PXLog(@"[DeviceSpec] Spoofing processor count from %lu to %ld",
-             (unsigned long)originalCount, (long)cpuCoreCount);
+        PXLog(@"[DeviceSpec] Spoofing processor count from %lu to %lu",
+             (unsigned long)originalCount, (unsigned long)spec->processorCount);
         loggedProcessorCount = YES;
     }
     
-    return cpuCoreCount;
+    return spec->processorCount;
 }
 
 // Add hook for CPU architecture information
@@ -849,65 +774,6 @@ static void logMemoryHook(NSString *apiName) {
         PXLog(@"[DeviceSpec] Memory spoofing API '%@' was accessed", apiName);
     }
 }
-// Function to calculate free memory percentage based on device specs
-static float getFreeMemoryPercentage(void) {
-    // Default free memory percentage (typical for iOS devices under normal usage)
-    float defaultFreePercentage = 0.35; // 35% free
-    
-    
-    // Get device specs
-    DeviceModel *model = CurrentPhoneInfo().deviceModel;
-    if (!model) {
-        return defaultFreePercentage;
-    }
-    
-    
-    // Otherwise use a realistic value based on device memory
-    NSInteger deviceMemoryGB = [model.deviceMemory integerValue];
-    if (deviceMemoryGB <= 0) {
-        return defaultFreePercentage;
-    }
-    
-    // Larger memory devices typically have higher free percentage
-    if (deviceMemoryGB >= 6) {
-        return 0.45; // 45% free for 6GB+ devices
-    } else if (deviceMemoryGB >= 4) {
-        return 0.40; // 40% free for 4GB devices
-    } else if (deviceMemoryGB >= 3) {
-        return 0.35; // 35% free for 3GB devices
-    } else {
-        return 0.30; // 30% free for smaller memory devices
-    }
-}
-
-// Function to get consistent free/wired/active memory values based on total memory
-static void getConsistentMemoryStats(unsigned long long totalMemory, 
-                                    unsigned long long *freeMemory,
-                                    unsigned long long *wiredMemory,
-                                    unsigned long long *activeMemory,
-                                    unsigned long long *inactiveMemory) {
-    
-    float freePercentage = getFreeMemoryPercentage();
-    float wiredPercentage = 0.20; // 20% wired (kernel, system)
-    float activePercentage = 0.30; // 30% active (running apps)
-    float inactivePercentage = 1.0 - freePercentage - wiredPercentage - activePercentage;
-    
-    if (freeMemory) {
-        *freeMemory = (unsigned long long)(totalMemory * freePercentage);
-    }
-    
-    if (wiredMemory) {
-        *wiredMemory = (unsigned long long)(totalMemory * wiredPercentage);
-    }
-    
-    if (activeMemory) {
-        *activeMemory = (unsigned long long)(totalMemory * activePercentage);
-    }
-    
-    if (inactiveMemory) {
-        *inactiveMemory = (unsigned long long)(totalMemory * inactivePercentage);
-    }
-}
 static NXArchInfo* hook_nx_get_local_arch_info()
 {
     if (!orig_nx_get_local_arch_info) {
@@ -1003,100 +869,60 @@ static kern_return_t hook_host_statistics64(host_t host, host_flavor_t flavor, h
         return result;
     }
     
-    // Get device specs
-    DeviceModel *model = CurrentPhoneInfo().deviceModel;
-    if (!model) {
+    // Scaled byte and page figures are precomputed per profile; this path is
+    // integer stores only.
+    const PXDeviceSpecValues *spec = PXCurrentDeviceSpec();
+    if (!spec->hasMemory) {
         return result;
     }
-    
-    // Get the device memory from specs (in GB)
-    NSInteger deviceMemoryGB = [model.deviceMemory integerValue];
-    if (deviceMemoryGB <= 0) {
-        return result;
-    }
-    
-    // Calculate total memory in bytes
-    unsigned long long totalMemory = deviceMemoryGB * 1024 * 1024 * 1024;
+    const PXMemoryFigures *mem = &spec->memory;
     
     // Handle specific host info types
-    if (flavor == HOST_VM_INFO64 || flavor == HOST_VM_INFO) {
-        // VM statistics (free memory, etc.)
-        if (flavor == HOST_VM_INFO64 && *count >= HOST_VM_INFO64_COUNT) {
-            vm_statistics64_data_t *vmStats = (vm_statistics64_data_t *)info;
-            
-            // Calculate consistent memory values
-            unsigned long long freeMemory, wiredMemory, activeMemory, inactiveMemory;
-            getConsistentMemoryStats(totalMemory, &freeMemory, &wiredMemory, &activeMemory, &inactiveMemory);
-            
-            // page size is typically 4096 or 16384 depending on device
-            vm_size_t pageSize = 4096;
-            host_page_size(host, &pageSize);
-            
-            // Convert bytes to pages
-            uint64_t freePages = freeMemory / pageSize;
-            uint64_t wiredPages = wiredMemory / pageSize;
-            uint64_t activePages = activeMemory / pageSize;
-            uint64_t inactivePages = inactiveMemory / pageSize;
-            
-            // Update stats consistently
-            vmStats->free_count = freePages;
-            vmStats->wire_count = wiredPages;
-            vmStats->active_count = activePages;
-            vmStats->inactive_count = inactivePages;
-            
-            // Log the change the first time
-            static BOOL loggedVMStats = NO;
-            if (!loggedVMStats) {
-                PXLog(@"[DeviceSpec] Spoofed vm_statistics64 with %llu free pages (%.1f%% of total memory)",
-                    freePages, (float)freeMemory * 100.0 / totalMemory);
-                loggedVMStats = YES;
-            }
-        } else if (flavor == HOST_VM_INFO && *count >= HOST_VM_INFO_COUNT) {
-            vm_statistics_data_t *vmStats = (vm_statistics_data_t *)info;
-            
-            // Calculate consistent memory values
-            unsigned long long freeMemory, wiredMemory, activeMemory, inactiveMemory;
-            getConsistentMemoryStats(totalMemory, &freeMemory, &wiredMemory, &activeMemory, &inactiveMemory);
-            
-            // page size is typically 4096 or 16384 depending on device
-            vm_size_t pageSize = 4096;
-            host_page_size(host, &pageSize);
-            
-            // Convert bytes to pages
-            unsigned int freePages = (unsigned int)(freeMemory / pageSize);
-            unsigned int wiredPages = (unsigned int)(wiredMemory / pageSize);
-            unsigned int activePages = (unsigned int)(activeMemory / pageSize);
-            unsigned int inactivePages = (unsigned int)(inactiveMemory / pageSize);
-            
-            // Update stats consistently
-            vmStats->free_count = freePages;
-            vmStats->wire_count = wiredPages;
-            vmStats->active_count = activePages;
-            vmStats->inactive_count = inactivePages;
-            
-            // Log the change the first time
-            static BOOL loggedVMStats32 = NO;
-            if (!loggedVMStats32) {
-                PXLog(@"[DeviceSpec] Spoofed vm_statistics with %u free pages (%.1f%% of total memory)",
-                    freePages, (float)freeMemory * 100.0 / totalMemory);
-                loggedVMStats32 = YES;
-            }
+    if (flavor == HOST_VM_INFO64 && *count >= HOST_VM_INFO64_COUNT) {
+        vm_statistics64_data_t *vmStats = (vm_statistics64_data_t *)info;
+        
+        // Update stats consistently
+        vmStats->free_count = (natural_t)mem->freePages;
+        vmStats->wire_count = (natural_t)mem->wiredPages;
+        vmStats->active_count = (natural_t)mem->activePages;
+        vmStats->inactive_count = (natural_t)mem->inactivePages;
+        
+        // Log the change the first time
+        static BOOL loggedVMStats = NO;
+        if (!loggedVMStats) {
+            PXLog(@"[DeviceSpec] Spoofed vm_statistics64 with %llu free pages (%.1f%% of total memory)",
+                mem->freePages, spec->freePermille / 10.0);
+            loggedVMStats = YES;
         }
-    } else if (flavor == HOST_BASIC_INFO) {
+    } else if (flavor == HOST_VM_INFO && *count >= HOST_VM_INFO_COUNT) {
+        vm_statistics_data_t *vmStats = (vm_statistics_data_t *)info;
+        
+        // Update stats consistently
+        vmStats->free_count = (natural_t)mem->freePages;
+        vmStats->wire_count = (natural_t)mem->wiredPages;
+        vmStats->active_count = (natural_t)mem->activePages;
+        vmStats->inactive_count = (natural_t)mem->inactivePages;
+        
+        // Log the change the first time
+        static BOOL loggedVMStats32 = NO;
+        if (!loggedVMStats32) {
+            PXLog(@"[DeviceSpec] Spoofed vm_statistics with %llu free pages (%.1f%% of total memory)",
+                mem->freePages, spec->freePermille / 10.0);
+            loggedVMStats32 = YES;
+        }
+    } else if (flavor == HOST_BASIC_INFO && *count >= HOST_BASIC_INFO_COUNT) {
         // Basic host info including memory size
-        if (*count >= HOST_BASIC_INFO_COUNT) {
-            host_basic_info_t basicInfo = (host_basic_info_t)info;
-            
-            // Spoof max memory to match our deviceMemory value
-            basicInfo->max_mem = totalMemory;
-            
-            // Log the change the first time
-            static BOOL loggedBasicInfo = NO;
-            if (!loggedBasicInfo) {
-                PXLog(@"[DeviceSpec] Spoofed host_basic_info max_mem to %llu bytes (%ld GB)",
-                    totalMemory, (long)deviceMemoryGB);
-                loggedBasicInfo = YES;
-            }
+        host_basic_info_t basicInfo = (host_basic_info_t)info;
+        
+        // Spoof max memory to match our deviceMemory value
+        basicInfo->max_mem = mem->totalBytes;
+        
+        // Log the change the first time
+        static BOOL loggedBasicInfo = NO;
+        if (!loggedBasicInfo) {
+            PXLog(@"[DeviceSpec] Spoofed host_basic_info max_mem to %llu bytes (%ld GB)",
+                mem->totalBytes, (long)spec->memoryGB);
+            loggedBasicInfo = YES;
         }
     }
     
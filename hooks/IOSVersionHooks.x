@@ -13,6 +13,7 @@
 // Add a macro for logging with a recognizable prefix
 // Set DEBUG_LOG to 0 to reduce logging in production
 #import "PXHookOptions.h"
+#import "PXHookFilters.h"
 #define DEBUG_LOG 0
 
 #if DEBUG_LOG
@@ -474,7 +475,7 @@ static void modifyUserAgentString(NSString **userAgentString, NSString *original
 
 - (void)setValue:(NSString *)value forHTTPHeaderField:(NSString *)field {
     @try {
-        if ([field isEqualToString:@"User-Agent"] && value) {
+        if (PX_UNLIKELY(PXIsUserAgentHeaderName((__bridge CFStringRef)field, NO)) && value) {
             NSString *spoofedVersion = CurrentPhoneInfo().iosVersion.version;
             NSString *originalVersion = [[UIDevice currentDevice] systemVersion];
             
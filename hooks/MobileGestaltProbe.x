@@ -3,37 +3,40 @@
 
 #import "ProjectXLogging.h"
 #import "PXHookOptions.h"
+#import "PXConcurrentMap.h"
 #import "../libs/fishhook.h"
 
 #pragma mark - Rate limit (log each key once)
 
-static CFMutableSetRef gSeenCFKeys = NULL;
+static PXConcurrentMap *gSeenCFKeys = NULL;
+static PXConcurrentMap *gSeenNSKeys = NULL;
 
 static void PXEnsureSeenSet(void) {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        gSeenCFKeys = CFSetCreateMutable(kCFAllocatorDefault, 0, &kCFTypeSetCallBacks);
+        gSeenCFKeys = PXConcurrentMapCreate(512);
+        gSeenNSKeys = PXConcurrentMapCreate(512);
     });
 }
 
+static Boolean PXShouldLogKeyIn(PXConcurrentMap *seen, CFStringRef key) {
+    char buf[PX_CMAP_KEY_BUFSIZE];
+    size_t len = 0;
+    const char *k = PXConcurrentMapKeyFromCFString(key, buf, sizeof(buf), &len);
+    if (!k) return false;
+    return PXConcurrentMapInsertOnce(seen, k, len);
+}
+
 static Boolean PXShouldLogCFKey(CFStringRef key) {
     if (!key) return false;
     PXEnsureSeenSet();
-    if (CFSetContainsValue(gSeenCFKeys, key)) return false;
-    CFSetAddValue(gSeenCFKeys, key);
-    return true;
+    return PXShouldLogKeyIn(gSeenCFKeys, key);
 }
 
 static BOOL PXShouldLogNSKey(NSString *key) {
-    static NSMutableSet *seen = nil;
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        seen = [NSMutableSet set];
-    });
-    if (!key) return NO;
-    if ([seen containsObject:key]) return NO;
-    [seen addObject:key];
-    return YES;
+    if (![key isKindOfClass:[NSString class]]) return NO;
+    PXEnsureSeenSet();
+    return PXShouldLogKeyIn(gSeenNSKeys, (__bridge CFStringRef)key);
 }
 
 static inline BOOL PXProbeEnabled(void) {
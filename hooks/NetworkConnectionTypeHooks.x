@@ -11,6 +11,8 @@
 #import <ifaddrs.h>
 #import <arpa/inet.h>
 #import "PXHookOptions.h"
+#import "PXHookProfiler.h"
+#import "PXHookCore.h"
 #include <dlfcn.h>
 #import "DataManager.h"
 
@@ -483,100 +485,32 @@ Boolean hooked_SCNetworkReachabilityGetFlags(SCNetworkReachabilityRef target, SC
 // Enable getifaddrs hook for local IP spoofing
 static int (*original_getifaddrs)(struct ifaddrs **);
 static int hooked_getifaddrs(struct ifaddrs **ifap) {
+    PX_HOOK_PROFILE_SCOPE("getifaddrs");
     NSLog(@"[NetworkHook] hooked_getifaddrs");
     if (!original_getifaddrs) {
         return -1;
     }
     int result = original_getifaddrs(ifap);
     if (result == 0 && ifap && *ifap) {
-        struct ifaddrs *ifa = *ifap;
         NetworkInfo * networkInfo = CurrentPhoneInfo().networkInfo;
-        NetworkConnectionType type = networkInfo.connectionType;
-        NSString *spoofedIP = networkInfo.localIPAddress;
         NSString *spoofedIPv6 = networkInfo.localIPv6Address;
 
         if (!spoofedIPv6) {
             spoofedIPv6 = @"fe80::1234:abcd:5678:9abc";
         }
-        // Generate plausible carrier IPv4/IPv6 for pdp_ip0
-        NSString *carrierIPv4 = @"10.0.0.5";
-        NSString *carrierIPv6 = @"2607:f8b0:4005:805::200e"; // Example global IPv6
-        while (ifa) {
-            if (ifa->ifa_addr) {
-                if (ifa->ifa_addr->sa_family == AF_INET) {
-                        struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
-
-                        char before[INET_ADDRSTRLEN];
-                        inet_ntop(AF_INET, &sin->sin_addr, before, sizeof(before));
-
-                        NSLog(@"[HOOK] BEFORE IPv4 %s -> %s", ifa->ifa_name, before);
-                    if (type == NetworkConnectionTypeWiFi || (type == NetworkConnectionTypeAuto && shouldUseWiFiForAutoMode())) {
-                        if (strcmp(ifa->ifa_name, "en0") == 0 && spoofedIP) {
-                            struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
-                            sin->sin_addr.s_addr = inet_addr([spoofedIP UTF8String]);
-                        }
-                        // Optionally, clear pdp_ip0
-                        if (strcmp(ifa->ifa_name, "pdp_ip0") == 0) {
-                            struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
-                            sin->sin_addr.s_addr = 0;
-                        }
-                    } else if (type == NetworkConnectionTypeCellular || (type == NetworkConnectionTypeAuto && !shouldUseWiFiForAutoMode())) {
-                        if (strcmp(ifa->ifa_name, "pdp_ip0") == 0 && carrierIPv4) {
-                            struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
-                            sin->sin_addr.s_addr = inet_addr([carrierIPv4 UTF8String]);
-                        }
-                        // Optionally, clear en0
-                        if (strcmp(ifa->ifa_name, "en0") == 0) {
-                            struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
-                            sin->sin_addr.s_addr = 0;
-                        }
-                    }
-
-                    
-                    // 修改完后再打印
-                    char after[INET_ADDRSTRLEN];
-                    inet_ntop(AF_INET, &sin->sin_addr, after, sizeof(after));
-
-                    NSLog(@"[HOOK] AFTER  IPv4 %s -> %s", ifa->ifa_name, after);
-                } else if (ifa->ifa_addr->sa_family == AF_INET6) {
-                    struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ifa->ifa_addr;
-
-                    char before6[INET6_ADDRSTRLEN];
-                    inet_ntop(AF_INET6, &sin6->sin6_addr, before6, sizeof(before6));
-
-                    NSLog(@"[HOOK] BEFORE IPv6 %s -> %s (scope=%d)",
-                        ifa->ifa_name, before6, sin6->sin6_scope_id);
-           
-                    if (type == NetworkConnectionTypeWiFi || (type == NetworkConnectionTypeAuto && shouldUseWiFiForAutoMode())) {
-                        if (strcmp(ifa->ifa_name, "en0") == 0 && spoofedIPv6) {
-                            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ifa->ifa_addr;
-                            inet_pton(AF_INET6, [spoofedIPv6 UTF8String], &sin6->sin6_addr);
-                        }
-                        // Optionally, clear pdp_ip0
-                        if (strcmp(ifa->ifa_name, "pdp_ip0") == 0) {
-                            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ifa->ifa_addr;
-                            memset(&sin6->sin6_addr, 0, sizeof(sin6->sin6_addr));
-                        }
-                    } else if (type == NetworkConnectionTypeCellular || (type == NetworkConnectionTypeAuto && !shouldUseWiFiForAutoMode())) {
-                        if (strcmp(ifa->ifa_name, "pdp_ip0") == 0 && carrierIPv6) {
-                            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ifa->ifa_addr;
-                            inet_pton(AF_INET6, [carrierIPv6 UTF8String], &sin6->sin6_addr);
-                        }
-                        // Optionally, clear en0
-                        if (strcmp(ifa->ifa_name, "en0") == 0) {
-                            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ifa->ifa_addr;
-                            memset(&sin6->sin6_addr, 0, sizeof(sin6->sin6_addr));
-                        }
-                    }
-                    char after6[INET6_ADDRSTRLEN];
-                    inet_ntop(AF_INET6, &sin6->sin6_addr, after6, sizeof(after6));
-
-                    NSLog(@"[HOOK] AFTER  IPv6 %s -> %s (scope=%d)",
-                    ifa->ifa_name, after6, sin6->sin6_scope_id);
-                }
-            }
-            ifa = ifa->ifa_next;
+        // Plausible carrier IPv4/IPv6 for pdp_ip0
+        static const char *const kCarrierIPv4 = "10.0.0.5";
+        static const char *const kCarrierIPv6 = "2607:f8b0:4005:805::200e"; // Example global IPv6
+
+        PXInterfaceSpoof spoof;
+        if (shouldShowAsWiFi()) {
+            PXMakeInterfaceSpoof(PXInterfaceSpoofWiFi, networkInfo.localIPAddress.UTF8String, spoofedIPv6.UTF8String, &spoof);
+        } else if (shouldShowAsCellular()) {
+            PXMakeInterfaceSpoof(PXInterfaceSpoofCellular, kCarrierIPv4, kCarrierIPv6, &spoof);
+        } else {
+            PXMakeInterfaceSpoof(PXInterfaceSpoofNone, NULL, NULL, &spoof);
         }
+        PXPatchInterfaceAddresses(*ifap, &spoof);
     }
     return result;
 }
@@ -0,0 +1,102 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Plain C so bench/ can build it on hosts without CoreFoundation; the CFString
+// key helper below is only available where CF is.
+#if __has_include(<CoreFoundation/CoreFoundation.h>)
+#include <CoreFoundation/CoreFoundation.h>
+#define PX_CMAP_HAVE_CF 1
+#else
+#define PX_CMAP_HAVE_CF 0
+#define CF_ASSUME_NONNULL_BEGIN
+#define CF_ASSUME_NONNULL_END
+#define _Nullable
+#endif
+
+CF_ASSUME_NONNULL_BEGIN
+
+// Small insert-only string -> int64 map for hook-side caches that are touched
+// from arbitrary threads (per-bundle seeds, change counters, log-once sets).
+//
+// Open addressing with linear probing over a fixed power-of-two slot array.
+// A slot is claimed by CAS on its hash word, the value is stored, then the key
+// pointer is published with release ordering. Lookups never take a lock; the
+// only waiting is a reader spinning on a slot whose key is being published.
+// Entries are never removed and keys are copied and kept for the process
+// lifetime, so size the map for the expected number of distinct keys.
+typedef struct PXConcurrentMap PXConcurrentMap;
+
+/// Capacity is rounded up to a power of two. Returns NULL on allocation failure.
+PXConcurrentMap *_Nullable PXConcurrentMapCreate(size_t capacity);
+
+/// Returns true and writes *outValue if key is present.
+bool PXConcurrentMapGet(PXConcurrentMap *map, const char *key, size_t len, int64_t *_Nullable outValue);
+
+/// Returns the stored value, inserting `value` first if key is absent.
+/// *inserted is set to true only for the caller whose insert won. When the map
+/// is full the key is not stored and `value` is returned.
+int64_t PXConcurrentMapGetOrInsert(PXConcurrentMap *map, const char *key, size_t len,
+                                   int64_t value, bool *_Nullable inserted);
+
+/// Atomically adds delta (inserting `initial` first if absent) and returns the new value.
+int64_t PXConcurrentMapAdd(PXConcurrentMap *map, const char *key, size_t len,
+                           int64_t initial, int64_t delta);
+
+/// Stores value and returns true with the previous value in *outOld if key existed.
+bool PXConcurrentMapExchange(PXConcurrentMap *map, const char *key, size_t len,
+                             int64_t value, int64_t *_Nullable outOld);
+
+/// Log-once helper: returns true exactly once per distinct key.
+static inline bool PXConcurrentMapInsertOnce(PXConcurrentMap *map, const char *key, size_t len) {
+    bool inserted = false;
+    PXConcurrentMapGetOrInsert(map, key, len, 1, &inserted);
+    return inserted;
+}
+
+#if PX_CMAP_HAVE_CF
+// CFString keys: uses the string's own UTF-8 buffer when CF exposes one,
+// otherwise converts into `buf`. Strings that do not convert into `buf`
+// (longer than bufSize - 1 UTF-8 bytes, or unpaired surrogates) get a hashed
+// key instead: 0xFF, which never occurs in UTF-8 and so cannot equal a
+// converted key, then the FNV-1a 64 of the UTF-16 code units and their count.
+// Two such strings share an entry only on a full 64-bit hash collision at the
+// same length. Returns NULL only for a NULL string or a buffer too small for
+// the hashed key (PX_CMAP_KEY_BUFSIZE always fits).
+static inline const char *_Nullable PXConcurrentMapKeyFromCFString(CFStringRef _Nullable str, char *buf,
+                                                                   size_t bufSize, size_t *outLen) {
+    if (!str) return NULL;
+    const char *p = CFStringGetCStringPtr(str, kCFStringEncodingUTF8);
+    if (p) {
+        *outLen = strlen(p);
+        return p;
+    }
+    if (CFStringGetCString(str, buf, (CFIndex)bufSize, kCFStringEncodingUTF8)) {
+        *outLen = strlen(buf);
+        return buf;
+    }
+
+    uint64_t hash = 1469598103934665603ULL;
+    uint64_t count = (uint64_t)CFStringGetLength(str);
+    if (bufSize < 1 + sizeof(hash) + sizeof(count)) return NULL;
+    UniChar chunk[64];
+    for (CFIndex i = 0; i < (CFIndex)count; i += 64) {
+        CFIndex n = (CFIndex)count - i < 64 ? (CFIndex)count - i : 64;
+        CFStringGetCharacters(str, CFRangeMake(i, n), chunk);
+        for (CFIndex j = 0; j < n; j++) {
+            hash = (hash ^ (chunk[j] & 0xFF)) * 1099511628211ULL;
+            hash = (hash ^ (chunk[j] >> 8)) * 1099511628211ULL;
+        }
+    }
+    buf[0] = (char)0xFF;
+    memcpy(buf + 1, &hash, sizeof(hash));
+    memcpy(buf + 1 + sizeof(hash), &count, sizeof(count));
+    *outLen = 1 + sizeof(hash) + sizeof(count);
+    return buf;
+}
+#endif
+
+#define PX_CMAP_KEY_BUFSIZE 256
+
+CF_ASSUME_NONNULL_END
@@ -0,0 +1,121 @@
+#include "PXConcurrentMap.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    _Atomic uint64_t hash;          // 0 = empty
+    _Atomic(const char *) key;      // NULL until published
+    size_t len;
+    _Atomic int64_t value;
+} PXCMapSlot;
+
+struct PXConcurrentMap {
+    size_t mask;
+    PXCMapSlot slots[];
+};
+
+// FNV-1a; 0 is reserved for empty slots.
+static inline uint64_t PXCMapHash(const char *key, size_t len) {
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
+    }
+    return h ? h : 1;
+}
+
+PXConcurrentMap *PXConcurrentMapCreate(size_t capacity) {
+    size_t n = 16;
+    while (n < capacity) n <<= 1;
+    PXConcurrentMap *map = calloc(1, sizeof(PXConcurrentMap) + n * sizeof(PXCMapSlot));
+    if (!map) return NULL;
+    map->mask = n - 1;
+    return map;
+}
+
+static inline const char *PXCMapWaitKey(PXCMapSlot *slot) {
+    const char *k;
+    while (!(k = atomic_load_explicit(&slot->key, memory_order_acquire))) {
+        // Another thread claimed the slot and is copying the key.
+    }
+    return k;
+}
+
+static inline bool PXCMapKeyEquals(PXCMapSlot *slot, const char *key, size_t len) {
+    const char *k = PXCMapWaitKey(slot);
+    return slot->len == len && memcmp(k, key, len) == 0;
+}
+
+// Finds the slot for key, claiming an empty one when `insert` is set.
+// Returns NULL if absent (lookup) or if the table is full (insert).
+static PXCMapSlot *PXCMapFind(PXConcurrentMap *map, const char *key, size_t len,
+                              bool insert, int64_t initial, bool *inserted) {
+    uint64_t h = PXCMapHash(key, len);
+    size_t i = (size_t)h & map->mask;
+    for (size_t probes = 0; probes <= map->mask; probes++, i = (i + 1) & map->mask) {
+        PXCMapSlot *slot = &map->slots[i];
+        uint64_t cur = atomic_load_explicit(&slot->hash, memory_order_acquire);
+        if (cur == 0) {
+            if (!insert) return NULL;
+            uint64_t expected = 0;
+            if (atomic_compare_exchange_strong_explicit(&slot->hash, &expected, h,
+                                                        memory_order_acq_rel, memory_order_acquire)) {
+                static char kEmptyKey[1];
+                char *copy = malloc(len + 1);
+                if (!copy) {
+                    // Leave the slot claimed with an unmatchable key so readers do not spin forever.
+                    copy = kEmptyKey;
+                    slot->len = (size_t)-1;
+                } else {
+                    memcpy(copy, key, len);
+                    copy[len] = '\0';
+                    slot->len = len;
+                }
+                atomic_store_explicit(&slot->value, initial, memory_order_relaxed);
+                atomic_store_explicit(&slot->key, copy, memory_order_release);
+                if (slot->len != len) return NULL;
+                if (inserted) *inserted = true;
+                return slot;
+            }
+            cur = expected;
+        }
+        if (cur == h && PXCMapKeyEquals(slot, key, len)) return slot;
+    }
+    return NULL;
+}
+
+bool PXConcurrentMapGet(PXConcurrentMap *map, const char *key, size_t len, int64_t *outValue) {
+    if (!map || !key) return false;
+    PXCMapSlot *slot = PXCMapFind(map, key, len, false, 0, NULL);
+    if (!slot) return false;
+    if (outValue) *outValue = atomic_load_explicit(&slot->value, memory_order_relaxed);
+    return true;
+}
+
+int64_t PXConcurrentMapGetOrInsert(PXConcurrentMap *map, const char *key, size_t len,
+                                   int64_t value, bool *inserted) {
+    if (inserted) *inserted = false;
+    if (!map || !key) return value;
+    PXCMapSlot *slot = PXCMapFind(map, key, len, true, value, inserted);
+    return slot ? atomic_load_explicit(&slot->value, memory_order_relaxed) : value;
+}
+
+int64_t PXConcurrentMapAdd(PXConcurrentMap *map, const char *key, size_t len,
+                           int64_t initial, int64_t delta) {
+    if (!map || !key) return initial + delta;
+    PXCMapSlot *slot = PXCMapFind(map, key, len, true, initial, NULL);
+    if (!slot) return initial + delta;
+    return atomic_fetch_add_explicit(&slot->value, delta, memory_order_relaxed) + delta;
+}
+
+bool PXConcurrentMapExchange(PXConcurrentMap *map, const char *key, size_t len,
+                             int64_t value, int64_t *outOld) {
+    if (!map || !key) return false;
+    bool inserted = false;
+    PXCMapSlot *slot = PXCMapFind(map, key, len, true, value, &inserted);
+    if (!slot || inserted) return false;
+    int64_t old = atomic_exchange_explicit(&slot->value, value, memory_order_relaxed);
+    if (outOld) *outOld = old;
+    return true;
+}
@@ -0,0 +1,38 @@
+#import <Foundation/Foundation.h>
+#import <CoreGraphics/CoreGraphics.h>
+#import "PXHookCore.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Spoofed device-spec values derived from CurrentPhoneInfo(), computed once per
+// PhoneInfo generation so the UIScreen / memory hooks are a load-and-return.
+typedef struct {
+    uint32_t generation;
+
+    // UIScreen. Portrait and landscape variants are both precomputed; hooks pick
+    // one based on the orientation of the original value.
+    BOOL hasBounds;
+    CGRect boundsPortrait;
+    CGRect boundsLandscape;
+    BOOL hasNativeBounds;
+    CGRect nativeBounds;        // nativeBounds is always portrait
+    BOOL hasScale;
+    CGFloat scale;
+    BOOL hasNativeScale;
+    CGFloat nativeScale;
+    NSInteger screenDensity;
+
+    // NSProcessInfo / host_statistics64
+    BOOL hasMemory;
+    NSInteger memoryGB;
+    uint32_t freePermille;
+    PXMemoryFigures memory;
+    BOOL hasProcessorCount;
+    NSUInteger processorCount;
+} PXDeviceSpecValues;
+
+/// Returns the values for the current PhoneInfo, rebuilding them if the profile
+/// changed. The returned pointer stays valid for the process lifetime.
+const PXDeviceSpecValues *PXCurrentDeviceSpec(void);
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,105 @@
+#import "PXDeviceSpecCache.h"
+#import "DataManager.h"
+#import "ProjectXLogging.h"
+#include <mach/mach.h>
+#include <stdatomic.h>
+
+static _Atomic(PXDeviceSpecValues *) gPXDeviceSpec = NULL;
+
+static BOOL PXParsePortraitSize(NSString *str, CGSize *out) {
+    double shortSide = 0, longSide = 0;
+    if (!PXParsePortraitResolution(str.UTF8String, &shortSide, &longSide)) return NO;
+    *out = CGSizeMake(shortSide, longSide);
+    return YES;
+}
+
+static uint64_t PXHostPageSize(void) {
+    vm_size_t pageSize = 0;
+    mach_port_t host = mach_host_self();
+    if (host_page_size(host, &pageSize) != KERN_SUCCESS) pageSize = 0;
+    mach_port_deallocate(mach_task_self(), host);
+    return pageSize ?: 4096;
+}
+
+static void PXBuildDeviceSpec(PXDeviceSpecValues *v, DeviceModel *model) {
+    if (!model) return;
+
+    CGFloat pixelRatio = [model.devicePixelRatio doubleValue];
+    if (pixelRatio > 0) {
+        v->hasScale = YES;
+        v->scale = pixelRatio;
+
+        CGSize viewport;
+        if (PXParsePortraitSize(model.viewportResolution, &viewport)) {
+            CGFloat w = viewport.width / pixelRatio;
+            CGFloat h = viewport.height / pixelRatio;
+            v->hasBounds = YES;
+            v->boundsPortrait = CGRectMake(0, 0, w, h);
+            v->boundsLandscape = CGRectMake(0, 0, h, w);
+        }
+    }
+
+    // Portrait like the real nativeBounds ({0, 0, 1170, 2532} on an iPhone 13),
+    // whatever order the profile stores the sides in.
+    CGSize native;
+    if (PXParsePortraitSize(model.resolution, &native)) {
+        v->hasNativeBounds = YES;
+        v->nativeBounds = CGRectMake(0, 0, native.width, native.height);
+    }
+
+    // iPhone reference point is 163 PPI for scale 1.0
+    NSInteger screenDensity = [model.screenDensity integerValue];
+    if (screenDensity > 0) {
+        v->hasNativeScale = YES;
+        v->screenDensity = screenDensity;
+        v->nativeScale = screenDensity / 163.0;
+    }
+
+    NSInteger memoryGB = [model.deviceMemory integerValue];
+    if (memoryGB > 0) {
+        v->hasMemory = YES;
+        v->memoryGB = memoryGB;
+        v->freePermille = PXFreeMemoryPermille(memoryGB);
+        PXComputeMemoryFigures((uint64_t)memoryGB << 30, v->freePermille, PXHostPageSize(), &v->memory);
+    }
+
+    NSInteger cpuCoreCount = [model.cpuCoreCount integerValue];
+    if (cpuCoreCount > 0) {
+        v->hasProcessorCount = YES;
+        v->processorCount = (NSUInteger)cpuCoreCount;
+    }
+}
+
+const PXDeviceSpecValues *PXCurrentDeviceSpec(void) {
+    static PXDeviceSpecValues empty;
+    PXDeviceSpecValues *cur = atomic_load_explicit(&gPXDeviceSpec, memory_order_acquire);
+    uint32_t gen = PXPhoneInfoGeneration();
+    if (cur && cur->generation == gen) return cur;
+
+    static NSObject *lock = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        lock = [NSObject new];
+    });
+
+    @synchronized (lock) {
+        cur = atomic_load_explicit(&gPXDeviceSpec, memory_order_acquire);
+        // Read the generation before the data: a concurrent refresh then only
+        // causes one extra rebuild instead of caching stale values as current.
+        gen = PXPhoneInfoGeneration();
+        if (cur && cur->generation == gen) return cur;
+
+        PXDeviceSpecValues *next = calloc(1, sizeof(PXDeviceSpecValues));
+        if (!next) return cur ?: &empty;
+        @try {
+            PXBuildDeviceSpec(next, CurrentPhoneInfo().deviceModel);
+        } @catch (NSException *exception) {
+            PXLog(@"[DeviceSpec] ⚠️ Failed to build spec cache: %@", exception);
+        }
+        next->generation = gen;
+        // The previous snapshot is intentionally leaked: hooks on other threads
+        // may still be reading it, and it only changes once per profile.
+        atomic_store_explicit(&gPXDeviceSpec, next, memory_order_release);
+        return next;
+    }
+}
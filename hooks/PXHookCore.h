@@ -0,0 +1,95 @@
+#ifndef PX_HOOK_CORE_H
+#define PX_HOOK_CORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+
+// Portable C cores of the hook bodies: no Foundation, CoreFoundation or Mach,
+// so bench/ can build and time them on any host against stub originals.
+
+// Spoofed RAM split, all integer. Invariants: free + wired + active + inactive
+// == total, each *Pages == *Bytes / pageSize.
+typedef struct {
+    uint64_t totalBytes;
+    uint64_t freeBytes;
+    uint64_t wiredBytes;
+    uint64_t activeBytes;
+    uint64_t inactiveBytes;
+    uint64_t pageSize;
+    uint64_t freePages;
+    uint64_t wiredPages;
+    uint64_t activePages;
+    uint64_t inactivePages;
+} PXMemoryFigures;
+
+/// Parses "2556x1179", "2436×1125" or "1792 × 828" (any run of spaces, x/X or
+/// non-ASCII separator bytes between two plain decimals). Returns false on
+/// malformed or NULL input, zero sides and sides over a million.
+bool PXParseResolutionCString(const char *str, double *width, double *height);
+
+/// PXParseResolutionCString, then sorted so *shortSide <= *longSide. IOS.db
+/// stores sizes long side first; UIScreen reports bounds and nativeBounds in
+/// portrait.
+bool PXParsePortraitResolution(const char *str, double *shortSide, double *longSide);
+
+/// Free share of RAM for a device class, in 1/1000: larger memory devices
+/// typically show a higher free percentage.
+uint32_t PXFreeMemoryPermille(long memoryGB);
+
+/// Splits totalBytes into free/wired(20%)/active(30%)/inactive(remainder) and
+/// converts to pages. Integer-only; pageSize 0 is treated as 4096.
+void PXComputeMemoryFigures(uint64_t totalBytes, uint32_t freePermille, uint64_t pageSize, PXMemoryFigures *out);
+
+/// statfs paths whose sizes are spoofed: "/", "/var", "/private/var" and
+/// anything under /var/mobile or /private/var/mobile.
+bool PXIsSpoofedStatfsPath(const char *path);
+
+/// Blocks needed for bytes, rounding up; blockSize 0 is treated as 4096.
+uint64_t PXStatfsBlockCount(uint64_t bytes, uint32_t blockSize);
+
+/// sysctl string reply: sizes only when oldp is NULL, ENOMEM (with the needed
+/// size in *oldlenp) when the caller's buffer is short.
+int PXWriteSysctlCString(const char *value, void *oldp, size_t *oldlenp);
+
+/// sysctl integer reply sized to the caller's buffer (int, uint32_t, long or int64_t).
+int PXWriteSysctlInt64(int64_t v, void *oldp, size_t *oldlenp);
+
+/// ASCII fast paths of PXHookFilters.h: a header name equal to "User-Agent"
+/// (ignoring ASCII case when asked), a notification name containing
+/// "Pasteboard". length is the string's length in bytes.
+bool PXIsUserAgentHeaderBytes(const char *field, size_t length, bool caseInsensitive);
+bool PXHasPasteboardBytes(const char *name, size_t length);
+
+/// PXHookEnabled's resolved-value cache. Entries are tagged with the prefs
+/// generation they were resolved under and ignored once it moves on.
+/// Lookup returns false on a miss or a stale entry.
+struct PXConcurrentMap;
+bool PXHookGateLookup(struct PXConcurrentMap *cache, const char *key, size_t len, uint32_t generation, bool *enabled);
+void PXHookGateStore(struct PXConcurrentMap *cache, const char *key, size_t len, uint32_t generation, bool enabled);
+
+/// getifaddrs rewrite: the interface the spoofed connection type uses (en0
+/// for WiFi, pdp_ip0 for cellular) gets the spoofed addresses, the other one
+/// is zeroed. Other interfaces and address families pass through.
+typedef enum {
+    PXInterfaceSpoofNone,
+    PXInterfaceSpoofWiFi,
+    PXInterfaceSpoofCellular,
+} PXInterfaceSpoofMode;
+
+typedef struct {
+    PXInterfaceSpoofMode mode;
+    bool hasIPv4;
+    bool hasIPv6;
+    struct in_addr ipv4;
+    struct in6_addr ipv6;
+} PXInterfaceSpoof;
+
+/// Parses the spoofed addresses (either may be NULL or malformed, leaving that
+/// family of the active interface untouched).
+void PXMakeInterfaceSpoof(PXInterfaceSpoofMode mode, const char *ipv4, const char *ipv6, PXInterfaceSpoof *out);
+void PXPatchInterfaceAddresses(struct ifaddrs *list, const PXInterfaceSpoof *spoof);
+
+#endif
@@ -0,0 +1,227 @@
+#include "PXHookCore.h"
+#include "PXConcurrentMap.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+static inline bool PXIsResolutionSeparator(unsigned char c) {
+    return c == 'x' || c == 'X' || c == ' ' || c == '\t' || c >= 0x80;
+}
+
+// Plain decimal ("1179", "2.5"): no sign, exponent, hex, inf or nan, which
+// strtod would all take. Returns the end, or NULL if there is no digit.
+static const char *PXParseDecimal(const char *p, double *out) {
+    if (*p < '0' || *p > '9') return NULL;
+    double value = 0;
+    while (*p >= '0' && *p <= '9') value = value * 10 + (*p++ - '0');
+    if (*p == '.') {
+        double scale = 0.1;
+        for (p++; *p >= '0' && *p <= '9'; p++, scale /= 10) value += (*p - '0') * scale;
+    }
+    *out = value;
+    return p;
+}
+
+bool PXParseResolutionCString(const char *str, double *width, double *height) {
+    if (!str) return false;
+    while (*str == ' ' || *str == '\t') str++;
+    double w = 0;
+    const char *p = PXParseDecimal(str, &w);
+    if (!p) return false;
+
+    bool sawSeparator = false;
+    while (*p && PXIsResolutionSeparator((unsigned char)*p)) {
+        sawSeparator = true;
+        p++;
+    }
+    if (!sawSeparator) return false;
+
+    double h = 0;
+    const char *end = PXParseDecimal(p, &h);
+    if (!end) return false;
+    while (*end == ' ' || *end == '\t') end++;
+    if (*end != '\0') return false;
+    if (!(w > 0) || !(h > 0) || w > 1e6 || h > 1e6) return false;
+
+    *width = w;
+    *height = h;
+    return true;
+}
+
+bool PXParsePortraitResolution(const char *str, double *shortSide, double *longSide) {
+    double a = 0, b = 0;
+    if (!PXParseResolutionCString(str, &a, &b)) return false;
+    *shortSide = a < b ? a : b;
+    *longSide = a < b ? b : a;
+    return true;
+}
+
+uint32_t PXFreeMemoryPermille(long memoryGB) {
+    if (memoryGB <= 0) return 350; // typical for iOS devices under normal usage
+    if (memoryGB >= 6) return 450;
+    if (memoryGB >= 4) return 400;
+    if (memoryGB >= 3) return 350;
+    return 300;
+}
+
+void PXComputeMemoryFigures(uint64_t totalBytes, uint32_t freePermille, uint64_t pageSize, PXMemoryFigures *out) {
+    static const uint32_t kWiredPermille = 200;  // kernel, system
+    static const uint32_t kActivePermille = 300; // running apps
+    if (freePermille > 1000 - kWiredPermille - kActivePermille) {
+        freePermille = 1000 - kWiredPermille - kActivePermille;
+    }
+    if (pageSize == 0) pageSize = 4096;
+
+    // total / 1000 * p + (total % 1000) * p / 1000 cannot overflow for any total.
+    #define PX_SCALE(t, p) ((t) / 1000 * (p) + (t) % 1000 * (p) / 1000)
+    out->totalBytes = totalBytes;
+    out->freeBytes = PX_SCALE(totalBytes, freePermille);
+    out->wiredBytes = PX_SCALE(totalBytes, kWiredPermille);
+    out->activeBytes = PX_SCALE(totalBytes, kActivePermille);
+    out->inactiveBytes = totalBytes - out->freeBytes - out->wiredBytes - out->activeBytes;
+    #undef PX_SCALE
+
+    out->pageSize = pageSize;
+    out->freePages = out->freeBytes / pageSize;
+    out->wiredPages = out->wiredBytes / pageSize;
+    out->activePages = out->activeBytes / pageSize;
+    out->inactivePages = out->inactiveBytes / pageSize;
+}
+
+bool PXIsSpoofedStatfsPath(const char *path) {
+    return path && (
+        strcmp(path, "/") == 0 ||
+        strcmp(path, "/var") == 0 ||
+        strcmp(path, "/private/var") == 0 ||
+        strncmp(path, "/var/mobile", 11) == 0 ||
+        strncmp(path, "/private/var/mobile", 19) == 0);
+}
+
+uint64_t PXStatfsBlockCount(uint64_t bytes, uint32_t blockSize) {
+    if (blockSize == 0) {
+        // Default to 4K blocks if block size is zero (shouldn't happen, but safety first)
+        blockSize = 4096;
+    }
+
+    // Calculate block count, rounding up for partial blocks
+    return (bytes + blockSize - 1) / blockSize;
+}
+
+int PXWriteSysctlCString(const char *value, void *oldp, size_t *oldlenp) {
+    if (!oldlenp || !value) { errno = EINVAL; return -1; }
+    size_t required = strlen(value) + 1; // include NUL
+    if (!oldp) {
+        *oldlenp = required;
+        return 0;
+    }
+    if (*oldlenp < required) {
+        *oldlenp = required;
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(oldp, 0, *oldlenp);
+    memcpy(oldp, value, required);
+    *oldlenp = required;
+    return 0;
+}
+
+int PXWriteSysctlInt64(int64_t v, void *oldp, size_t *oldlenp) {
+    if (!oldlenp) { errno = EINVAL; return -1; }
+    // Keep caller's expected size when possible
+    if (!oldp) {
+        // Ask original for size if available; otherwise default to 8
+        *oldlenp = (*oldlenp ? *oldlenp : sizeof(int64_t));
+        return 0;
+    }
+    if (*oldlenp == sizeof(int)) {
+        *(int *)oldp = (int)v;
+        return 0;
+    }
+    if (*oldlenp == sizeof(uint32_t)) {
+        *(uint32_t *)oldp = (uint32_t)v;
+        return 0;
+    }
+    if (*oldlenp == sizeof(unsigned long)) {
+        *(unsigned long *)oldp = (unsigned long)v;
+        return 0;
+    }
+    if (*oldlenp >= sizeof(int64_t)) {
+        *(int64_t *)oldp = (int64_t)v;
+        return 0;
+    }
+    errno = ENOMEM;
+    return -1;
+}
+
+bool PXIsUserAgentHeaderBytes(const char *field, size_t length, bool caseInsensitive) {
+    static const char kUserAgent[] = "User-Agent";
+    if (!field || length != sizeof(kUserAgent) - 1) return false;
+    if (field[0] != 'U' && !(caseInsensitive && field[0] == 'u')) return false;
+    if (!caseInsensitive) return memcmp(field, kUserAgent, length) == 0;
+    for (size_t i = 1; i < length; i++) {
+        unsigned char c = (unsigned char)field[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        unsigned char k = (unsigned char)kUserAgent[i];
+        if (k >= 'A' && k <= 'Z') k += 'a' - 'A';
+        if (c != k) return false;
+    }
+    return true;
+}
+
+bool PXHasPasteboardBytes(const char *name, size_t length) {
+    static const char kPasteboard[] = "Pasteboard";
+    static const size_t kLength = sizeof(kPasteboard) - 1;
+    if (!name || length < kLength) return false;
+    const char *last = name + length - kLength;
+    for (const char *p = name; p <= last; p++) {
+        p = memchr(p, 'P', (size_t)(last - p) + 1);
+        if (!p) return false;
+        if (memcmp(p + 1, kPasteboard + 1, kLength - 1) == 0) return true;
+    }
+    return false;
+}
+
+// Cached as generation << 1 | enabled.
+bool PXHookGateLookup(struct PXConcurrentMap *cache, const char *key, size_t len, uint32_t generation, bool *enabled) {
+    int64_t value;
+    if (!cache || !PXConcurrentMapGet(cache, key, len, &value)) return false;
+    if ((uint32_t)(value >> 1) != generation) return false;
+    *enabled = value & 1;
+    return true;
+}
+
+void PXHookGateStore(struct PXConcurrentMap *cache, const char *key, size_t len, uint32_t generation, bool enabled) {
+    if (!cache) return;
+    PXConcurrentMapExchange(cache, key, len, ((int64_t)generation << 1) | (enabled ? 1 : 0), NULL);
+}
+
+void PXMakeInterfaceSpoof(PXInterfaceSpoofMode mode, const char *ipv4, const char *ipv6, PXInterfaceSpoof *out) {
+    memset(out, 0, sizeof(*out));
+    out->mode = mode;
+    out->hasIPv4 = ipv4 && inet_pton(AF_INET, ipv4, &out->ipv4) == 1;
+    out->hasIPv6 = ipv6 && inet_pton(AF_INET6, ipv6, &out->ipv6) == 1;
+}
+
+void PXPatchInterfaceAddresses(struct ifaddrs *list, const PXInterfaceSpoof *spoof) {
+    if (spoof->mode == PXInterfaceSpoofNone) return;
+    const char *active = spoof->mode == PXInterfaceSpoofWiFi ? "en0" : "pdp_ip0";
+    const char *inactive = spoof->mode == PXInterfaceSpoofWiFi ? "pdp_ip0" : "en0";
+    for (struct ifaddrs *ifa = list; ifa; ifa = ifa->ifa_next) {
+        if (!ifa->ifa_addr || !ifa->ifa_name) continue;
+        int family = ifa->ifa_addr->sa_family;
+        if (family != AF_INET && family != AF_INET6) continue;
+        bool isActive = strcmp(ifa->ifa_name, active) == 0;
+        if (!isActive && strcmp(ifa->ifa_name, inactive) != 0) continue;
+
+        if (family == AF_INET) {
+            struct sockaddr_in *sin = (struct sockaddr_in *)ifa->ifa_addr;
+            if (!isActive) sin->sin_addr.s_addr = 0;
+            else if (spoof->hasIPv4) sin->sin_addr = spoof->ipv4;
+        } else {
+            struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)ifa->ifa_addr;
+            if (!isActive) memset(&sin6->sin6_addr, 0, sizeof(sin6->sin6_addr));
+            else if (spoof->hasIPv6) sin6->sin6_addr = spoof->ipv6;
+        }
+    }
+}
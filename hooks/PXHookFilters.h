@@ -0,0 +1,36 @@
+#import <Foundation/Foundation.h>
+#import <CoreFoundation/CoreFoundation.h>
+#include "PXHookCore.h"
+
+// Cheap pre-filters for hooks that sit on very hot Foundation/CFNetwork paths.
+// Each predicate rejects the common (pass-through) case with a pointer compare,
+// a length check or a first-byte test before doing any real string work.
+
+#define PX_LIKELY(x)   __builtin_expect(!!(x), 1)
+#define PX_UNLIKELY(x) __builtin_expect(!!(x), 0)
+
+// "User-Agent" header name. CFNetwork matches header names case-insensitively,
+// NSMutableURLRequest callers are compared exactly.
+static inline BOOL PXIsUserAgentHeaderName(CFStringRef field, BOOL caseInsensitive) {
+    if (!field) return NO;
+    if (field == CFSTR("User-Agent")) return YES;
+    if (CFStringGetLength(field) != 10) return NO;
+    const char *ascii = CFStringGetCStringPtr(field, kCFStringEncodingASCII);
+    if (ascii) return PXIsUserAgentHeaderBytes(ascii, 10, caseInsensitive);
+    UniChar c = CFStringGetCharacterAtIndex(field, 0);
+    if (c != 'U' && !(caseInsensitive && c == 'u')) return NO;
+    return CFStringCompare(field, CFSTR("User-Agent"), caseInsensitive ? kCFCompareCaseInsensitive : 0) == kCFCompareEqualTo;
+}
+
+// Pasteboard notification names ("UIPasteboardChangedNotification",
+// "UIPasteboard*", anything containing "Pasteboard").
+static inline BOOL PXIsPasteboardNotificationName(NSString *name, NSString *changedName) {
+    if (!name) return NO;
+    if (name == changedName) return YES;
+    CFStringRef cf = (__bridge CFStringRef)name;
+    CFIndex length = CFStringGetLength(cf);
+    if (length < 10) return NO;
+    const char *ascii = CFStringGetCStringPtr(cf, kCFStringEncodingASCII);
+    if (ascii) return PXHasPasteboardBytes(ascii, (size_t)length);
+    return CFStringFind(cf, CFSTR("Pasteboard"), 0).location != kCFNotFound;
+}
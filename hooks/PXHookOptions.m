@@ -1,7 +1,11 @@
 #import "PXHookOptions.h"
 #import <CoreFoundation/CoreFoundation.h>
 #import <dispatch/dispatch.h>
+#import <stdatomic.h>
+#import "PXConcurrentMap.h"
+#import "PXHookCore.h"
 #import "PXHookKeys.h"
+#import "PXHookProfiler.h"
 
 #if __has_include(<roothide.h>)
 #import <roothide.h>
@@ -15,6 +19,10 @@ CFStringRef const kPXHookPrefsChangedNotification = CFSTR("com.projectx.hookpref
 
 static NSDictionary *gPXPrefs = nil;
 
+// Bumped after every reload so cached PXHookEnabled answers go stale.
+static _Atomic uint32_t gPXPrefsGeneration = 0;
+static PXConcurrentMap *gPXGateCache = NULL;
+
 // Dedicated lock for prefs access.
 // Do NOT synchronize on a class name (e.g. [PXHookOptions class]) because this
 // file is C-function based and may not declare such an Objective-C class.
@@ -72,6 +80,7 @@ static NSDictionary *PXCopyPrefsSnapshot(void) {
 
 static void PXLoadPrefsLocked(void) {
     gPXPrefs = PXCopyPrefsSnapshot();
+    atomic_fetch_add_explicit(&gPXPrefsGeneration, 1, memory_order_release);
 }
 
 void PXReloadHookPrefs(void) {
@@ -88,22 +97,40 @@ static NSDictionary *PXPrefs(void) {
 }
 
 BOOL PXHookEnabled(NSString *key) {
+    PX_HOOK_PROFILE_SCOPE("PXHookEnabled");
     if (key.length == 0) return YES;
 
+    // Hooks ask for a handful of keys on every call; answer from the cache
+    // until prefs change. The generation is read before the prefs so a reload
+    // in between leaves the stored answer stale rather than wrong.
+    uint32_t generation = atomic_load_explicit(&gPXPrefsGeneration, memory_order_acquire);
+    char keyBuf[PX_CMAP_KEY_BUFSIZE];
+    size_t keyLen = 0;
+    const char *cacheKey = PXConcurrentMapKeyFromCFString((__bridge CFStringRef)key, keyBuf, sizeof(keyBuf), &keyLen);
+    bool cached = false;
+    if (cacheKey && PXHookGateLookup(gPXGateCache, cacheKey, keyLen, generation, &cached)) {
+        return cached;
+    }
+
     // IMPORTANT: do NOT use -[NSBundle bundleIdentifier] here.
     // Many tweaks (including ours) can hook NSBundle methods. If we call the
     // Objective-C selector, the returned bundle id can be spoofed (causing
     // per-app matching to fail), or we can even trigger recursion/stack overflows
     // when our own Identifier hooks are enabled.
     // Use CoreFoundation APIs instead.
-    NSString *bundleID = @"";
-    CFBundleRef mainBundle = CFBundleGetMainBundle();
-    if (mainBundle) {
-        CFStringRef cfBid = CFBundleGetIdentifier(mainBundle);
-        if (cfBid) {
-            bundleID = [NSString stringWithString:(__bridge NSString *)cfBid];
+    // The main bundle never changes within a process, so resolve it once
+    // instead of copying the identifier on every (hot) call.
+    static NSString *bundleID = @"";
+    static dispatch_once_t bundleOnce;
+    dispatch_once(&bundleOnce, ^{
+        CFBundleRef mainBundle = CFBundleGetMainBundle();
+        if (mainBundle) {
+            CFStringRef cfBid = CFBundleGetIdentifier(mainBundle);
+            if (cfBid) {
+                bundleID = [NSString stringWithString:(__bridge NSString *)cfBid];
+            }
         }
-    }
+    });
     NSDictionary *prefs = PXPrefs();
 
     NSDictionary *global = prefs[kPXHookPrefsGlobalKey];
@@ -118,10 +145,9 @@ BOOL PXHookEnabled(NSString *key) {
         v = global[key];
     }
 
-    if ([v isKindOfClass:[NSNumber class]]) {
-        return [(NSNumber *)v boolValue];
-    }
-    return YES;
+    BOOL enabled = [v isKindOfClass:[NSNumber class]] ? [(NSNumber *)v boolValue] : YES;
+    if (cacheKey) PXHookGateStore(gPXGateCache, cacheKey, keyLen, generation, enabled);
+    return enabled;
 }
 
 static void PXPrefsChanged(CFNotificationCenterRef center,
@@ -134,6 +160,7 @@ static void PXPrefsChanged(CFNotificationCenterRef center,
 
 __attribute__((constructor))
 static void PXHookOptionsInit(void) {
+    gPXGateCache = PXConcurrentMapCreate(128);
     PXReloadHookPrefs();
     CFNotificationCenterAddObserver(CFNotificationCenterGetDarwinNotifyCenter(),
                                     NULL,
@@ -0,0 +1,47 @@
+#import <Foundation/Foundation.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+// Opt-in per-hook timing. Build with `make PX_HOOK_PROFILE=1` (or
+// -DPX_HOOK_PROFILE=1) to collect call counts and time spent in the hot hook
+// bodies; in normal builds every macro below compiles to nothing.
+#ifndef PX_HOOK_PROFILE
+#define PX_HOOK_PROFILE 0
+#endif
+
+/// Darwin notify name that makes the current process write its profile to disk.
+FOUNDATION_EXPORT CFStringRef const kPXHookProfileDumpNotification;
+
+typedef struct PXHookProfileSite {
+    const char *name;
+    _Atomic uint64_t calls;
+    _Atomic uint64_t ticks;
+    _Atomic uint64_t maxTicks;
+    _Atomic int registered;
+    struct PXHookProfileSite *_Nullable next;
+} PXHookProfileSite;
+
+typedef struct {
+    PXHookProfileSite *site;
+    uint64_t start;
+} PXHookProfileScope;
+
+PXHookProfileScope PXHookProfileScopeBegin(PXHookProfileSite *site);
+void PXHookProfileScopeEnd(PXHookProfileScope *scope);
+
+/// Writes {"process","bundle","sites":[{name,calls,total_ns,avg_ns,max_ns}]} to
+/// <tmp>/px_hook_profile.json. Returns the path, or nil when profiling is off.
+NSString *_Nullable PXHookProfileDump(void);
+
+#if PX_HOOK_PROFILE
+#define PX_HOOK_PROFILE_SCOPE(label) \
+    static PXHookProfileSite _pxProfileSite = { .name = (label) }; \
+    __attribute__((cleanup(PXHookProfileScopeEnd), unused)) \
+    PXHookProfileScope _pxProfileScope = PXHookProfileScopeBegin(&_pxProfileSite)
+#else
+#define PX_HOOK_PROFILE_SCOPE(label) do {} while (0)
+#endif
+
+NS_ASSUME_NONNULL_END
@@ -0,0 +1,99 @@
+#import "PXHookProfiler.h"
+#import "ProjectXLogging.h"
+#import <CoreFoundation/CoreFoundation.h>
+#import <mach/mach_time.h>
+
+CFStringRef const kPXHookProfileDumpNotification = CFSTR("com.projectx.hookprofile.dump");
+
+// Sites register themselves on first use; the list is push-only so readers
+// (the dump) can walk it without a lock.
+static _Atomic(PXHookProfileSite *) gPXProfileSites = NULL;
+
+static void PXHookProfileRegister(PXHookProfileSite *site) {
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(&site->registered, &expected, 1)) return;
+    PXHookProfileSite *head = atomic_load_explicit(&gPXProfileSites, memory_order_relaxed);
+    do {
+        site->next = head;
+    } while (!atomic_compare_exchange_weak_explicit(&gPXProfileSites, &head, site,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+PXHookProfileScope PXHookProfileScopeBegin(PXHookProfileSite *site) {
+    if (!atomic_load_explicit(&site->registered, memory_order_relaxed)) {
+        PXHookProfileRegister(site);
+    }
+    return (PXHookProfileScope){ site, mach_absolute_time() };
+}
+
+void PXHookProfileScopeEnd(PXHookProfileScope *scope) {
+    uint64_t elapsed = mach_absolute_time() - scope->start;
+    PXHookProfileSite *site = scope->site;
+    atomic_fetch_add_explicit(&site->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&site->ticks, elapsed, memory_order_relaxed);
+    uint64_t prev = atomic_load_explicit(&site->maxTicks, memory_order_relaxed);
+    while (elapsed > prev &&
+           !atomic_compare_exchange_weak_explicit(&site->maxTicks, &prev, elapsed,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static double PXTicksToNanos(uint64_t ticks) {
+    static mach_timebase_info_data_t tb;
+    if (tb.denom == 0) mach_timebase_info(&tb);
+    return (double)ticks * tb.numer / tb.denom;
+}
+
+NSString *PXHookProfileDump(void) {
+#if PX_HOOK_PROFILE
+    NSMutableArray *sites = [NSMutableArray array];
+    for (PXHookProfileSite *s = atomic_load_explicit(&gPXProfileSites, memory_order_acquire); s; s = s->next) {
+        uint64_t calls = atomic_load_explicit(&s->calls, memory_order_relaxed);
+        double total = PXTicksToNanos(atomic_load_explicit(&s->ticks, memory_order_relaxed));
+        [sites addObject:@{
+            @"name": @(s->name),
+            @"calls": @(calls),
+            @"total_ns": @(total),
+            @"avg_ns": @(calls ? total / calls : 0),
+            @"max_ns": @(PXTicksToNanos(atomic_load_explicit(&s->maxTicks, memory_order_relaxed)))
+        }];
+    }
+    CFBundleRef mainBundle = CFBundleGetMainBundle();
+    CFStringRef bid = mainBundle ? CFBundleGetIdentifier(mainBundle) : NULL;
+    NSDictionary *root = @{
+        @"process": [[NSProcessInfo processInfo] processName] ?: @"",
+        @"bundle": bid ? (__bridge NSString *)bid : @"",
+        @"sites": sites
+    };
+    NSData *data = [NSJSONSerialization dataWithJSONObject:root options:NSJSONWritingPrettyPrinted error:nil];
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"px_hook_profile.json"];
+    if (![data writeToFile:path atomically:YES]) {
+        PXLog(@"[HookProfile] Failed to write profile to %@", path);
+        return nil;
+    }
+    PXLog(@"[HookProfile] Wrote %lu sites to %@", (unsigned long)sites.count, path);
+    return path;
+#else
+    return nil;
+#endif
+}
+
+#if PX_HOOK_PROFILE
+static void PXHookProfileDumpRequested(CFNotificationCenterRef center,
+                                       void *observer,
+                                       CFStringRef name,
+                                       const void *object,
+                                       CFDictionaryRef userInfo) {
+    PXHookProfileDump();
+}
+
+__attribute__((constructor))
+static void PXHookProfilerInit(void) {
+    CFNotificationCenterAddObserver(CFNotificationCenterGetDarwinNotifyCenter(),
+                                    NULL,
+                                    PXHookProfileDumpRequested,
+                                    kPXHookProfileDumpNotification,
+                                    NULL,
+                                    CFNotificationSuspensionBehaviorDeliverImmediately);
+}
+#endif
@@ -7,39 +7,44 @@
 
 
 #import "PXHookOptions.h"
-static NSMutableDictionary *customChangeCountMap = nil; // Store custom change counts per app
-static NSMutableDictionary *lastKnownPasteboardData = nil; // Cache pasteboard content hash
+#import "PXConcurrentMap.h"
+#import "PXHookFilters.h"
+// Per-app state, touched from any thread that reads the pasteboard
+static PXConcurrentMap *customChangeCountMap = NULL; // Store custom change counts per app
+static PXConcurrentMap *lastKnownPasteboardData = NULL; // Cache pasteboard content hash
+
+static void PXEnsurePasteboardMaps(void) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        customChangeCountMap = PXConcurrentMapCreate(64);
+        lastKnownPasteboardData = PXConcurrentMapCreate(64);
+    });
+}
 
 // Helper for safe change count management
 static NSInteger getCustomChangeCount(NSString *bundleID, NSInteger originalCount) {
-    if (!customChangeCountMap) {
-        customChangeCountMap = [NSMutableDictionary dictionary];
-    }
-    
-    NSNumber *currentValue = customChangeCountMap[bundleID];
-    if (!currentValue) {
-        // First time seeing this app, initialize with original count
-        NSInteger initialValue = originalCount;
-        customChangeCountMap[bundleID] = @(initialValue);
-        return initialValue;
-    }
-    
-    return [currentValue integerValue];
+    PXEnsurePasteboardMaps();
+    char buf[PX_CMAP_KEY_BUFSIZE];
+    size_t len = 0;
+    const char *key = PXConcurrentMapKeyFromCFString((__bridge CFStringRef)bundleID, buf, sizeof(buf), &len);
+    if (!key) return originalCount;
+
+    // First time seeing this app, initialize with original count
+    return (NSInteger)PXConcurrentMapGetOrInsert(customChangeCountMap, key, len, originalCount, NULL);
 }
 
 // Helper to safely increment change count
 static void incrementCustomChangeCount(NSString *bundleID) {
-    if (!customChangeCountMap) {
-        customChangeCountMap = [NSMutableDictionary dictionary];
-    }
-    
-    NSNumber *currentValue = customChangeCountMap[bundleID];
-    NSInteger newValue = currentValue ? [currentValue integerValue] + 1 : 1;
-    customChangeCountMap[bundleID] = @(newValue);
+    PXEnsurePasteboardMaps();
+    char buf[PX_CMAP_KEY_BUFSIZE];
+    size_t len = 0;
+    const char *key = PXConcurrentMapKeyFromCFString((__bridge CFStringRef)bundleID, buf, sizeof(buf), &len);
+    if (!key) return;
+    PXConcurrentMapAdd(customChangeCountMap, key, len, 0, 1);
 }
 
 // Helper to compute a hash of pasteboard content for change detection
-static NSString *getPasteboardContentHash(UIPasteboard *pasteboard) {
+static NSUInteger getPasteboardContentHash(UIPasteboard *pasteboard) {
     @try {
         NSMutableString *hashInput = [NSMutableString string];
         
@@ -68,29 +73,29 @@ static NSString *getPasteboardContentHash(UIPasteboard *pasteboard) {
         }
         
         // Compute hash of the combined content
-        return [NSString stringWithFormat:@"%lu", (unsigned long)[hashInput hash]];
+        return [hashInput hash];
         
     } @catch (NSException *exception) {
         PXLog(@"[WeaponX] ⚠️ Exception computing pasteboard hash: %@", exception);
-        return @"ERROR";
+        return 0;
     }
 }
 
 // Helper to check if pasteboard content has changed
 static BOOL hasPasteboardContentChanged(NSString *bundleID, UIPasteboard *pasteboard) {
     @try {
-        if (!lastKnownPasteboardData) {
-            lastKnownPasteboardData = [NSMutableDictionary dictionary];
-        }
-        
-        NSString *newHash = getPasteboardContentHash(pasteboard);
-        NSString *oldHash = lastKnownPasteboardData[bundleID];
-        
-        // Update stored hash
-        lastKnownPasteboardData[bundleID] = newHash;
-        
-        // If no previous hash or different hash, it changed
-        return !oldHash || ![oldHash isEqualToString:newHash];
+        PXEnsurePasteboardMaps();
+        char buf[PX_CMAP_KEY_BUFSIZE];
+        size_t len = 0;
+        const char *key = PXConcurrentMapKeyFromCFString((__bridge CFStringRef)bundleID, buf, sizeof(buf), &len);
+        if (!key) return NO;
+
+        int64_t newHash = (int64_t)getPasteboardContentHash(pasteboard);
+        int64_t oldHash = 0;
+
+        // Update stored hash; if no previous hash or different hash, it changed
+        BOOL existed = PXConcurrentMapExchange(lastKnownPasteboardData, key, len, newHash, &oldHash);
+        return !existed || oldHash != newHash;
         
     } @catch (NSException *exception) {
         PXLog(@"[WeaponX] ⚠️ Exception checking pasteboard changes: %@", exception);
@@ -489,9 +494,7 @@ static BOOL hasPasteboardContentChanged(NSString *bundleID, UIPasteboard *pasteb
         NSString *name = notification.name;
         
         // Check for UIPasteboard change notifications
-        if ([name isEqualToString:UIPasteboardChangedNotification] ||
-            [name hasPrefix:@"UIPasteboard"] ||
-            [name containsString:@"Pasteboard"]) {
+        if (PX_UNLIKELY(PXIsPasteboardNotificationName(name, UIPasteboardChangedNotification))) {
             
             NSString *bundleID = PXSafeBundleIdentifier();
             // Let these through but log them for tracking fingerprinting
@@ -31,6 +31,8 @@
 
 // Constants for proper size calculations - use only marketing units (1000-based)
 #import "PXHookOptions.h"
+#import "PXHookProfiler.h"
+#import "PXHookCore.h"
 
 // Runtime gate so Global/Per-App toggles take effect immediately.
 // IMPORTANT: Every hook in this file must consult this before spoofing.
@@ -119,19 +121,6 @@ static uint64_t __attribute__((unused)) normalizeStorageBytes(uint64_t bytes) {
     return (uint64_t)(gbValue * BYTES_PER_GB);
 }
 
-// Helper to calculate block count from bytes and block size
-static uint64_t calculateBlockCount(uint64_t bytes, uint32_t blockSize) {
-    if (blockSize == 0) {
-        // Default to 4K blocks if block size is zero (shouldn't happen, but safety first)
-        blockSize = DEFAULT_BLOCK_SIZE;
-    }
-    
-    // Calculate block count, rounding up for partial blocks
-    return (bytes + blockSize - 1) / blockSize;
-}
-
-
-
 // Function to get storage values with universal compatibility
 static void getStorageValuesForApp(uint64_t *totalBytes, uint64_t *freeBytes) {
     if (!totalBytes || !freeBytes) return;
@@ -296,11 +285,11 @@ static void modifyStatfsWithSpoofedValues(struct statfs *buf) {
     
     // Calculate blocks
     if (totalBytes > 0) {
-        buf->f_blocks = calculateBlockCount(totalBytes, buf->f_bsize);
+        buf->f_blocks = PXStatfsBlockCount(totalBytes, buf->f_bsize);
     }
     
     if (freeBytes > 0) {
-        buf->f_bfree = calculateBlockCount(freeBytes, buf->f_bsize);
+        buf->f_bfree = PXStatfsBlockCount(freeBytes, buf->f_bsize);
         buf->f_bavail = buf->f_bfree; // Available blocks = free blocks for non-root
     }
 }
@@ -320,17 +309,18 @@ static void modifyStatfs64WithSpoofedValues(struct statfs64 *buf) {
     
     // Calculate blocks
     if (totalBytes > 0) {
-        buf->f_blocks = calculateBlockCount(totalBytes, buf->f_bsize);
+        buf->f_blocks = PXStatfsBlockCount(totalBytes, buf->f_bsize);
     }
     
     if (freeBytes > 0) {
-        buf->f_bfree = calculateBlockCount(freeBytes, buf->f_bsize);
+        buf->f_bfree = PXStatfsBlockCount(freeBytes, buf->f_bsize);
         buf->f_bavail = buf->f_bfree; // Available blocks = free blocks for non-root
     }
 }
 
 // Replacement for statfs to spoof filesystem info
 static int replaced_statfs(const char *path, struct statfs *buf) {
+    PX_HOOK_PROFILE_SCOPE("statfs");
     // Check for null pointers
     if (!path || !buf) {
         return -1; // EINVAL
@@ -350,13 +340,7 @@ static int replaced_statfs(const char *path, struct statfs *buf) {
     if (ret == 0 && buf != NULL) {
         @try {
             // Only apply spoofing for the main file system paths
-            if (path && (
-                strcmp(path, "/") == 0 || 
-                strcmp(path, "/var") == 0 || 
-                strcmp(path, "/private/var") == 0 ||
-                strncmp(path, "/var/mobile", 11) == 0 ||
-                strncmp(path, "/private/var/mobile", 19) == 0)
-            ) {
+            if (PXIsSpoofedStatfsPath(path)) {
                 modifyStatfsWithSpoofedValues(buf);
             }
         } @catch (NSException *exception) {
@@ -383,6 +367,7 @@ static int replaced_fstatfs(int fd, struct statfs *buf) {
 }
 
 static int replaced_statfs64(const char *path, struct statfs64 *buf) {
+    PX_HOOK_PROFILE_SCOPE("statfs64");
     // Check for null pointers
     if (!path || !buf) {
         return -1; // EINVAL
@@ -401,13 +386,7 @@ static int replaced_statfs64(const char *path, struct statfs64 *buf) {
     if (ret == 0 && buf != NULL) {
         @try {
             // Only apply spoofing for the main file system paths
-            if (path && (
-                strcmp(path, "/") == 0 || 
-                strcmp(path, "/var") == 0 || 
-                strcmp(path, "/private/var") == 0 ||
-                strncmp(path, "/var/mobile", 11) == 0 ||
-                strncmp(path, "/private/var/mobile", 19) == 0)
-            ) {
+            if (PXIsSpoofedStatfsPath(path)) {
                 modifyStatfs64WithSpoofedValues(buf);
             }
         } @catch (NSException *exception) {
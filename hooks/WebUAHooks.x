@@ -6,6 +6,8 @@
 #import "ProjectXLogging.h"
 #import "DataManager.h"
 #import "PXHookOptions.h"
+#import "PXHookProfiler.h"
+#import "PXHookFilters.h"
 
 // ============================================================================
 // Web/User-Agent coverage hooks (3 paths) — PLIST SOURCE OF TRUTH (Option A)
@@ -115,10 +117,11 @@ static NSString *PXGetSpoofedUserAgent(void) {
 // 2) CFNetwork UA: CFHTTPMessageSetHeaderFieldValue
 // ----------------------------------------------------------------------------
 %hookf(void, CFHTTPMessageSetHeaderFieldValue, CFHTTPMessageRef message, CFStringRef headerField, CFStringRef value) {
+    PX_HOOK_PROFILE_SCOPE("CFHTTPMessageSetHeaderFieldValue");
 
-    if (PXWebUASpoofEnabled() &&
-        headerField &&
-        CFStringCompare(headerField, CFSTR("User-Agent"), kCFCompareCaseInsensitive) == kCFCompareEqualTo) {
+    // Header name first: almost every call is some other header.
+    if (PX_UNLIKELY(PXIsUserAgentHeaderName(headerField, YES)) &&
+        PXWebUASpoofEnabled()) {
 
         NSString *ua = PXGetSpoofedUserAgent();
         if (ua.length) {
@@ -12,5 +12,19 @@
 #define GET_ALL_CARRIER @"/getAllCarrier"
 #define GET_ALL_VERSIONS @"/getAllVersions"
 
+// 耗时操作(newPhone/switchBackup)返回 jobId，通过以下接口查询进度
+#define JOB_STATUS @"/jobStatus"
+#define CANCEL_JOB @"/cancelJob"
+
 #define SAVE_HOOK_OPTIONS @"/saveHookOptions"
 #define GET_HOOK_OPTIONS @"/loadHookOptions"
+
+// 备份范围规则(include/exclude)
+#define SAVE_BACKUP_RULES @"/saveBackupRules"
+#define GET_BACKUP_RULES @"/loadBackupRules"
+
+// 回收站中等待后台删除的条目数与字节数
+#define TRASH_STATUS @"/trashStatus"
+
+// 各配置及其应用的磁盘占用(来自索引，不遍历目录)；可选参数 id 只取单个配置
+#define DISK_USAGE @"/diskUsage"
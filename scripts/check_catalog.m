@@ -0,0 +1,168 @@
+// Checks the daemon's catalog reader (daemon/CatalogFile.m) against IOS.db on
+// the build host: every compiled table row for row, every stored index against
+// ORDER BY, and CatalogLeftJoin against the SQL LEFT JOIN DeviceCatalog falls
+// back to. compile_catalog.py only proves its own encoder and decoder agree;
+// this runs the code that ships.
+//
+// The IOS.catalog rule in the Makefile builds and runs it on macOS hosts:
+//   clang -fobjc-arc -Idaemon -Icommon scripts/check_catalog.m daemon/CatalogFile.m \
+//         -framework Foundation -lsqlite3 -o check_catalog
+//   ./check_catalog IOS.db IOS.catalog
+#import <Foundation/Foundation.h>
+#import <sqlite3.h>
+#import "CatalogFile.h"
+
+// Tables DeviceCatalog reads from the catalog; it falls back to IOS.db without them.
+static NSArray<NSString *> *requiredTables(void) {
+    return @[ @"KMOS", @"KMDevices", @"CPU", @"operator" ];
+}
+
+// CatalogFile logs through PXLog, which in the daemon writes to device log files.
+void PXLog(NSString *format, ...) {
+    va_list args;
+    va_start(args, format);
+    NSString *message = [[NSString alloc] initWithFormat:format arguments:args];
+    va_end(args);
+    fprintf(stderr, "%s\n", message.UTF8String);
+}
+
+// Rows as DBManager builds them (PXRowDictionary): column name -> NSNumber,
+// NSString or NSNull, later columns replacing earlier ones of the same name.
+static NSArray<NSDictionary *> *query(sqlite3 *db, NSString *sql) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, sql.UTF8String, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "check_catalog: %s: %s\n", sql.UTF8String, sqlite3_errmsg(db));
+        return nil;
+    }
+    NSMutableArray<NSDictionary *> *rows = [NSMutableArray array];
+    int rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        NSMutableDictionary *row = [NSMutableDictionary dictionary];
+        for (int i = 0; i < sqlite3_column_count(stmt); i++) {
+            id value = [NSNull null];
+            switch (sqlite3_column_type(stmt, i)) {
+                case SQLITE_INTEGER:
+                    value = @(sqlite3_column_int64(stmt, i));
+                    break;
+                case SQLITE_FLOAT:
+                    value = @(sqlite3_column_double(stmt, i));
+                    break;
+                case SQLITE_TEXT:
+                    value = [NSString stringWithUTF8String:(const char *)sqlite3_column_text(stmt, i)] ?: [NSNull null];
+                    break;
+            }
+            row[@(sqlite3_column_name(stmt, i))] = value;
+        }
+        [rows addObject:row];
+    }
+    if (rc != SQLITE_DONE) {
+        fprintf(stderr, "check_catalog: %s: %s\n", sql.UTF8String, sqlite3_errmsg(db));
+        rows = nil;
+    }
+    sqlite3_finalize(stmt);
+    return rows;
+}
+
+// Same class of value and same value; an integer never matches a real.
+static BOOL sameValue(id a, id b) {
+    if (a == [NSNull null] || b == [NSNull null]) return a == b;
+    if ([a isKindOfClass:[NSString class]]) return [b isKindOfClass:[NSString class]] && [a isEqualToString:b];
+    if ([a isKindOfClass:[NSNumber class]]) {
+        return [b isKindOfClass:[NSNumber class]] && strcmp([a objCType], [b objCType]) == 0 && [a isEqualToNumber:b];
+    }
+    return NO;
+}
+
+static BOOL sameRow(NSDictionary *a, NSDictionary *b) {
+    if (a.count != b.count) return NO;
+    for (NSString *column in a) {
+        id other = b[column];
+        if (!other || !sameValue(a[column], other)) return NO;
+    }
+    return YES;
+}
+
+static BOOL compareRows(NSString *what, NSArray<NSDictionary *> *got, NSArray<NSDictionary *> *expected) {
+    if (!got || !expected) {
+        fprintf(stderr, "check_catalog: %s: %s\n", what.UTF8String, got ? "query failed" : "missing from the catalog");
+        return NO;
+    }
+    if (got.count != expected.count) {
+        fprintf(stderr, "check_catalog: %s: %lu rows, IOS.db has %lu\n", what.UTF8String,
+                (unsigned long)got.count, (unsigned long)expected.count);
+        return NO;
+    }
+    for (NSUInteger i = 0; i < got.count; i++) {
+        if (!sameRow(got[i], expected[i])) {
+            fprintf(stderr, "check_catalog: %s: row %lu differs\n  catalog: %s\n  IOS.db:  %s\n", what.UTF8String,
+                    (unsigned long)i, got[i].description.UTF8String, expected[i].description.UTF8String);
+            return NO;
+        }
+    }
+    return YES;
+}
+
+static NSString *quoted(NSString *identifier) {
+    return [NSString stringWithFormat:@"\"%@\"", [identifier stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""]];
+}
+
+int main(int argc, char *argv[]) {
+    @autoreleasepool {
+        if (argc != 3) {
+            fprintf(stderr, "usage: %s IOS.db IOS.catalog\n", argv[0]);
+            return 2;
+        }
+        sqlite3 *db = NULL;
+        if (sqlite3_open_v2(argv[1], &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+            fprintf(stderr, "check_catalog: cannot open %s: %s\n", argv[1], db ? sqlite3_errmsg(db) : "out of memory");
+            sqlite3_close(db);
+            return 1;
+        }
+        CatalogFile *catalog = [CatalogFile catalogAtPath:@(argv[2])];
+        if (!catalog) {
+            fprintf(stderr, "check_catalog: %s does not load\n", argv[2]);
+            sqlite3_close(db);
+            return 1;
+        }
+
+        BOOL ok = YES;
+        NSUInteger indexes = 0;
+        NSArray<NSString *> *tables = [catalog tableNames];
+        for (NSString *table in requiredTables()) {
+            if (![tables containsObject:table]) {
+                fprintf(stderr, "check_catalog: %s is not compiled in\n", table.UTF8String);
+                ok = NO;
+            }
+        }
+        for (NSString *table in tables) {
+            NSString *from = quoted(table);
+            ok &= compareRows(table, [catalog rowsOfTable:table],
+                              query(db, [NSString stringWithFormat:@"SELECT * FROM %@ ORDER BY rowid", from]));
+            for (NSDictionary *info in query(db, [NSString stringWithFormat:@"PRAGMA table_info(%@)", from])) {
+                NSString *column = info[@"name"];
+                NSArray<NSDictionary *> *ordered = [catalog rowsOfTable:table orderedBy:column];
+                if (!ordered) continue;
+                indexes++;
+                // The index promises NULLs first, then UTF-8 byte order, ties in table order.
+                NSString *sql = [NSString stringWithFormat:@"SELECT * FROM %@ ORDER BY %@ COLLATE BINARY, rowid",
+                                 from, quoted(column)];
+                ok &= compareRows([NSString stringWithFormat:@"%@ ordered by %@", table, column], ordered, query(db, sql));
+            }
+        }
+        if (![catalog rowsOfTable:@"KMOS" orderedBy:@"sortVersion"]) {
+            fprintf(stderr, "check_catalog: KMOS has no sortVersion index\n");
+            ok = NO;
+        }
+
+        NSArray<NSDictionary *> *joined = CatalogLeftJoin([catalog rowsOfTable:@"KMDevices"], [catalog rowsOfTable:@"CPU"],
+                                                          @"CPU", @"name");
+        ok &= compareRows(@"KMDevices LEFT JOIN CPU", joined,
+                          query(db, @"SELECT * FROM KMDevices d LEFT JOIN CPU c ON d.CPU = c.name ORDER BY d.rowid, c.rowid"));
+        sqlite3_close(db);
+
+        if (!ok) return 1;
+        printf("%s: %lu tables, %lu indexes and %lu joined rows match %s\n", argv[2], (unsigned long)tables.count,
+               (unsigned long)indexes, (unsigned long)joined.count, argv[1]);
+        return 0;
+    }
+}
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""Compile the device catalog tables of IOS.db into a flat, mmap-able file.
+
+IOS.db stays the authoring format; the daemon reads the compiled file
+(daemon/CatalogFile.m) and only falls back to SQLite when it is missing.
+
+Layout, little-endian, every section 8-byte aligned:
+
+  header (40 bytes)
+    char[8] magic "PXCATLG\\0"
+    u32     format version
+    u32     table count
+    u32     string pool offset      (payload-relative)
+    u32     string pool length
+    u64     payload length          (everything after the header)
+    u64     payload checksum        (FNV-1a 64)
+  payload
+    table records, 32 bytes each:
+      u32 name offset, u32 name length       (string pool)
+      u32 column count, u32 row count
+      u32 columns offset                     column count x (u32 offset, u32 length)
+      u32 cells offset                       row count x column count cells
+      u32 index count, u32 indexes offset    index count x (u32 column, u32 rows offset)
+    cells, 16 bytes: u8 type (0 null, 1 integer, 2 real, 3 text), 7 bytes pad,
+      then i64 / f64 / (u32 offset, u32 length) into the string pool
+    index rows: row count x u32 row numbers, ordered by the column's UTF-8 bytes
+      (NULLs first, ties in table order)
+    string pool: deduplicated UTF-8, not NUL-terminated
+
+Usage: compile_catalog.py IOS.db IOS.catalog
+The output is read back and compared row for row with the database before it
+is moved into place. That only proves this encoder against this decoder; the
+Makefile then runs scripts/check_catalog.m, which checks the daemon's own
+reader and its devices/CPU join against IOS.db on macOS hosts.
+"""
+
+import os
+import sqlite3
+import struct
+import sys
+
+MAGIC = b"PXCATLG\0"
+FORMAT_VERSION = 1
+HEADER = struct.Struct("<8sIIIIQQ")
+TABLE = struct.Struct("<IIIIIIII")
+CELL = struct.Struct("<B7xQ")
+PAIR = struct.Struct("<II")
+
+TABLES = ["KMDevices", "KMOS", "CPU", "operator", "KMDevSpecial"]
+INDEXES = {
+    "KMOS": ["sortVersion"],
+    "KMDevices": ["defaultOSV"],
+    "CPU": ["name"],
+    "operator": ["code"],
+}
+
+T_NULL, T_INT, T_REAL, T_TEXT = 0, 1, 2, 3
+
+
+def fnv1a64(data):
+    h = 0xCBF29CE484222325
+    for b in data:
+        h ^= b
+        h = (h * 0x100000001B3) & 0xFFFFFFFFFFFFFFFF
+    return h
+
+
+def align(buf):
+    buf.extend(b"\0" * (-len(buf) % 8))
+
+
+class StringPool:
+    def __init__(self):
+        self.data = bytearray()
+        self.offsets = {}
+
+    def add(self, text):
+        raw = text.encode("utf-8")
+        if raw not in self.offsets:
+            self.offsets[raw] = len(self.data)
+            self.data.extend(raw)
+        return self.offsets[raw], len(raw)
+
+
+def load_tables(db_path):
+    db = sqlite3.connect("file:%s?mode=ro" % db_path, uri=True)
+    tables = []
+    for name in TABLES:
+        cursor = db.execute('SELECT * FROM "%s" ORDER BY rowid' % name)
+        columns = [d[0] for d in cursor.description]
+        rows = [list(row) for row in cursor]
+        tables.append((name, columns, rows))
+    db.close()
+    return tables
+
+
+def sort_key(value):
+    # NULLs first, then UTF-8 byte order, which is how SQLite compares TEXT.
+    if value is None:
+        return (0, b"")
+    if isinstance(value, str):
+        return (1, value.encode("utf-8"))
+    return (1, str(value).encode("utf-8"))
+
+
+def compile_catalog(tables):
+    pool = StringPool()
+    body = bytearray(TABLE.size * len(tables))
+    records = []
+    for name, columns, rows in tables:
+        align(body)
+        columns_offset = len(body)
+        for column in columns:
+            body.extend(PAIR.pack(*pool.add(column)))
+
+        align(body)
+        cells_offset = len(body)
+        for row in rows:
+            for value in row:
+                if value is None or isinstance(value, bytes):
+                    # The daemon maps BLOBs to NSNull, like DBManager does.
+                    body.extend(CELL.pack(T_NULL, 0))
+                elif isinstance(value, int):
+                    body.extend(CELL.pack(T_INT, value & 0xFFFFFFFFFFFFFFFF))
+                elif isinstance(value, float):
+                    body.extend(CELL.pack(T_REAL, struct.unpack("<Q", struct.pack("<d", value))[0]))
+                else:
+                    offset, length = pool.add(value)
+                    body.extend(CELL.pack(T_TEXT, offset | (length << 32)))
+
+        index_columns = [columns.index(c) for c in INDEXES.get(name, []) if c in columns]
+        index_rows = []
+        for column in index_columns:
+            align(body)
+            index_rows.append((column, len(body)))
+            order = sorted(range(len(rows)), key=lambda r: (sort_key(rows[r][column]), r))
+            body.extend(struct.pack("<%dI" % len(order), *order))
+        align(body)
+        indexes_offset = len(body)
+        for column, rows_offset in index_rows:
+            body.extend(PAIR.pack(column, rows_offset))
+
+        records.append((pool.add(name), len(columns), len(rows), columns_offset,
+                        cells_offset, len(index_rows), indexes_offset))
+
+    for i, ((name_offset, name_length), ncols, nrows, cols, cells, nidx, idx) in enumerate(records):
+        TABLE.pack_into(body, i * TABLE.size, name_offset, name_length, ncols, nrows, cols, cells, nidx, idx)
+
+    align(body)
+    pool_offset = len(body)
+    body.extend(pool.data)
+    align(body)
+    header = HEADER.pack(MAGIC, FORMAT_VERSION, len(tables), pool_offset, len(pool.data),
+                         len(body), fnv1a64(body))
+    return header + bytes(body)
+
+
+def read_catalog(data):
+    """Decodes a compiled catalog; the reference for daemon/CatalogFile.m."""
+    magic, version, count, pool_offset, pool_length, length, checksum = HEADER.unpack_from(data, 0)
+    body = data[HEADER.size:]
+    if magic != MAGIC or version != FORMAT_VERSION or length != len(body) or checksum != fnv1a64(body):
+        raise ValueError("bad catalog header or checksum")
+    pool = body[pool_offset:pool_offset + pool_length]
+
+    def text(offset, size):
+        return pool[offset:offset + size].decode("utf-8")
+
+    tables = {}
+    for i in range(count):
+        name_offset, name_length, ncols, nrows, cols, cells, nidx, idx = TABLE.unpack_from(body, i * TABLE.size)
+        columns = [text(*PAIR.unpack_from(body, cols + c * PAIR.size)) for c in range(ncols)]
+        rows = []
+        for r in range(nrows):
+            row = []
+            for c in range(ncols):
+                kind, value = CELL.unpack_from(body, cells + (r * ncols + c) * CELL.size)
+                if kind == T_INT:
+                    row.append(value - (1 << 64) if value >> 63 else value)
+                elif kind == T_REAL:
+                    row.append(struct.unpack("<d", struct.pack("<Q", value))[0])
+                elif kind == T_TEXT:
+                    row.append(text(value & 0xFFFFFFFF, value >> 32))
+                else:
+                    row.append(None)
+            rows.append(row)
+        indexes = {}
+        for k in range(nidx):
+            column, rows_offset = PAIR.unpack_from(body, idx + k * PAIR.size)
+            indexes[columns[column]] = list(struct.unpack_from("<%dI" % nrows, body, rows_offset))
+        tables[text(name_offset, name_length)] = (columns, rows, indexes)
+    return tables
+
+
+def verify(tables, data):
+    decoded = read_catalog(data)
+    for name, columns, rows in tables:
+        got_columns, got_rows, indexes = decoded[name]
+        if got_columns != columns:
+            raise ValueError("%s: columns differ" % name)
+        expected = [[None if isinstance(v, bytes) else v for v in row] for row in rows]
+        if got_rows != expected:
+            raise ValueError("%s: rows differ" % name)
+        for column, order in indexes.items():
+            c = columns.index(column)
+            keys = [sort_key(rows[r][c]) for r in order]
+            if sorted(order) != list(range(len(rows))) or keys != sorted(keys):
+                raise ValueError("%s: index on %s is not a sorted permutation" % (name, column))
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write("usage: %s IOS.db IOS.catalog\n" % argv[0])
+        return 2
+    db_path, out_path = argv[1], argv[2]
+    tables = load_tables(db_path)
+    data = compile_catalog(tables)
+    verify(tables, data)
+    tmp_path = out_path + ".tmp"
+    with open(tmp_path, "wb") as f:
+        f.write(data)
+    os.replace(tmp_path, out_path)
+    print("%s: %d tables, %d rows, %d bytes" % (out_path, len(tables), sum(len(t[2]) for t in tables), len(data)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))